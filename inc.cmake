@@ -15,21 +15,76 @@ if(NOT DEFINED REDISCPP_SDIR)
 		"${REDISCPP_SDIR}/pool_wrapper.cpp"
 		"${REDISCPP_SDIR}/connection_param.cpp"
 		"${REDISCPP_SDIR}/exception.cpp"
+		"${REDISCPP_SDIR}/sentinel.cpp"
+		"${REDISCPP_SDIR}/scanner.cpp"
+		"${REDISCPP_SDIR}/codec.cpp"
+		"${REDISCPP_SDIR}/hedged_reader.cpp"
+		"${REDISCPP_SDIR}/single_flight.cpp"
+		"${REDISCPP_SDIR}/auto_batcher.cpp"
+		"${REDISCPP_SDIR}/multiplexed_connection.cpp"
+		"${REDISCPP_SDIR}/capabilities.cpp"
+		"${REDISCPP_SDIR}/deadline.cpp"
+		"${REDISCPP_SDIR}/admission.cpp"
+		"${REDISCPP_SDIR}/script.cpp"
+		"${REDISCPP_SDIR}/lock.cpp"
+		"${REDISCPP_SDIR}/rate_limiter.cpp"
+		"${REDISCPP_SDIR}/bloom_filter.cpp"
+		"${REDISCPP_SDIR}/bitfield.cpp"
+		"${REDISCPP_SDIR}/hyperloglog.cpp"
+		"${REDISCPP_SDIR}/stream_consumer.cpp"
+		"${REDISCPP_SDIR}/list_queue.cpp"
 	)
 
+	#Optional value compression algorithms for CompressionCodec
+	find_path(LZ4_INCLUDE_DIR lz4.h)
+	find_library(LZ4_LIBRARY lz4)
+	if(LZ4_INCLUDE_DIR AND LZ4_LIBRARY)
+		add_definitions(-DREDISCPP_WITH_LZ4)
+		include_directories(${LZ4_INCLUDE_DIR})
+		set(REDISCPP_CODEC_LIBS ${REDISCPP_CODEC_LIBS} "${LZ4_LIBRARY}")
+	endif()
+	find_path(ZSTD_INCLUDE_DIR zstd.h)
+	find_library(ZSTD_LIBRARY zstd)
+	if(ZSTD_INCLUDE_DIR AND ZSTD_LIBRARY)
+		add_definitions(-DREDISCPP_WITH_ZSTD)
+		include_directories(${ZSTD_INCLUDE_DIR})
+		set(REDISCPP_CODEC_LIBS ${REDISCPP_CODEC_LIBS} "${ZSTD_LIBRARY}")
+	endif()
+
 	add_library(rediscpp-static STATIC
 		${REDISCPP_SOURCE}
 	)
 
+	find_package(Threads)
+
+	#In-process RESP server and fault injecting proxy for tests and benchmarks, not installed
+	add_library(rediscpp-mock STATIC
+		"${REDISCPP_SDIR}/tests/mock_server.cpp"
+		"${REDISCPP_SDIR}/tests/fault_proxy.cpp"
+	)
+
+	add_executable(fault_proxy
+		"${REDISCPP_SDIR}/tests/fault_proxy_main.cpp"
+	)
+	target_link_libraries(fault_proxy rediscpp-mock rediscpp-static hiredis ${REDISCPP_CODEC_LIBS} ${CMAKE_THREAD_LIBS_INIT})
+
 	#cppunit is broken in brew in mac os x
 	if( NOT ${CMAKE_SYSTEM_NAME} MATCHES "Darwin")
 	add_executable(test
 		"${REDISCPP_SDIR}/tests/connection_test_abstract.cpp"
 		"${REDISCPP_SDIR}/tests/connection_test_plain.cpp"
+		"${REDISCPP_SDIR}/tests/connection_test_unix.cpp"
+		"${REDISCPP_SDIR}/tests/connection_test_codec.cpp"
+		"${REDISCPP_SDIR}/tests/connection_test_mock.cpp"
 		"${REDISCPP_SDIR}/tests/run_tests.cpp"
 	)
 	set_target_properties(test PROPERTIES COMPILE_FLAGS "-Wno-effc++")
 
-	target_link_libraries(test cppunit rediscpp-static hiredis)
+	target_link_libraries(test cppunit rediscpp-mock rediscpp-static hiredis ${REDISCPP_CODEC_LIBS} ${CMAKE_THREAD_LIBS_INIT})
 	endif()
+
+	add_executable(benchmark
+		"${REDISCPP_SDIR}/tests/benchmark.cpp"
+	)
+	target_link_libraries(benchmark rediscpp-mock rediscpp-static hiredis ${REDISCPP_CODEC_LIBS} ${CMAKE_THREAD_LIBS_INIT})
 endif(NOT DEFINED REDISCPP_SDIR)
@@ -0,0 +1,144 @@
+#include "admission.hpp"
+#include "deadline.hpp"
+#include "exception.hpp"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+namespace Redis {
+    class AdmissionControl::Impl {
+        friend class AdmissionControl;
+        typedef std::chrono::steady_clock Clock;
+        //Nobody knows when a slot is released, so waiters check for it this often
+        static constexpr long long slot_poll_ns = 100000;
+
+        Limits limits;
+        //Token bucket as virtual scheduling: tat_ns is the time when the bucket is full again
+        long long interval_ns;
+        long long tolerance_ns;
+        std::atomic<long long> tat_ns;
+        std::atomic<unsigned int> in_flight;
+        std::atomic<unsigned long long> admitted_count;
+        std::atomic<unsigned long long> rejected_count;
+
+        Impl(const Limits& _limits) :
+            limits(_limits),
+            interval_ns(_limits.rate > 0 ? static_cast<long long>(1e9 / _limits.rate) : 0),
+            tolerance_ns(interval_ns * std::max(_limits.burst, 1u)),
+            tat_ns(0),
+            in_flight(0),
+            admitted_count(0),
+            rejected_count(0)
+        {
+            if(limits.rate < 0) {
+                throw Redis::Exception("Admission rate can't be negative");
+            }
+        }
+
+        static long long now_ns() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+        }
+
+        /* Returns 0 if admitted, otherwise how long to wait before the next try */
+        long long try_admit(long long now) {
+            if(limits.max_in_flight != 0) {
+                unsigned int current = in_flight.load(std::memory_order_relaxed);
+                do {
+                    if(current >= limits.max_in_flight) {
+                        return slot_poll_ns;
+                    }
+                } while(!in_flight.compare_exchange_weak(current, current + 1, std::memory_order_acquire, std::memory_order_relaxed));
+            }
+            else {
+                in_flight.fetch_add(1, std::memory_order_relaxed);
+            }
+            if(interval_ns == 0) {
+                return 0;
+            }
+            long long tat = tat_ns.load(std::memory_order_relaxed);
+            long long new_tat;
+            do {
+                new_tat = std::max(tat, now) + interval_ns;
+                if(new_tat - now > tolerance_ns) {
+                    in_flight.fetch_sub(1, std::memory_order_release);
+                    return new_tat - now - tolerance_ns;
+                }
+            } while(!tat_ns.compare_exchange_weak(tat, new_tat, std::memory_order_relaxed));
+            return 0;
+        }
+
+        bool admitted() {
+            admitted_count.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        bool rejected() {
+            rejected_count.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    };
+    constexpr long long AdmissionControl::Impl::slot_poll_ns;
+
+    AdmissionControl::AdmissionControl(const Limits& limits) :
+        d(new AdmissionControl::Impl(limits))
+    {}
+
+    AdmissionControl::~AdmissionControl() {
+        if(d != nullptr) {
+            delete d;
+        }
+    }
+
+    bool AdmissionControl::try_acquire() {
+        return d->try_admit(Impl::now_ns()) == 0 ? d->admitted() : d->rejected();
+    }
+
+    bool AdmissionControl::acquire() {
+        long long now = Impl::now_ns();
+        long long wait_ns = d->try_admit(now);
+        if(wait_ns == 0) {
+            return d->admitted();
+        }
+        if(d->limits.queue_timeout_ms == 0) {
+            return d->rejected();
+        }
+        long long queue_deadline = now + static_cast<long long>(d->limits.queue_timeout_ms) * 1000000;
+        const Deadline* deadline = Deadline::current();
+        if(deadline != nullptr) {
+            queue_deadline = std::min(queue_deadline, now + static_cast<long long>(deadline->get_remaining_ms()) * 1000000);
+        }
+        while(true) {
+            //Token which comes after the deadline is not worth waiting for
+            if(now + wait_ns > queue_deadline) {
+                return d->rejected();
+            }
+            std::this_thread::sleep_for(std::chrono::nanoseconds(wait_ns));
+            now = Impl::now_ns();
+            wait_ns = d->try_admit(now);
+            if(wait_ns == 0) {
+                return d->admitted();
+            }
+        }
+    }
+
+    void AdmissionControl::release() {
+        d->in_flight.fetch_sub(1, std::memory_order_release);
+    }
+
+    const AdmissionControl::Limits& AdmissionControl::get_limits() const {
+        return d->limits;
+    }
+
+    unsigned int AdmissionControl::get_in_flight() const {
+        return d->in_flight.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long AdmissionControl::get_admitted_count() const {
+        return d->admitted_count.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long AdmissionControl::get_rejected_count() const {
+        return d->rejected_count.load(std::memory_order_relaxed);
+    }
+}
\ No newline at end of file
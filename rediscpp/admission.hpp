@@ -0,0 +1,71 @@
+#pragma once
+namespace Redis {
+    /**
+    * Admission control of one endpoint: token bucket for request rate and limit of requests waiting for reply.
+    * Set with ConnectionParam::admission or NamedPool::create. Connections sharing the object share the limits,
+    * so one busy service can't saturate a shard and raise latency for everyone else.
+    * Request is a round trip: a command, or the whole pipeline of Scanner/HedgedReader and friends. Blocking commands hold their slot while blocked.
+    * Over-limit request waits up to queue_timeout_ms (and not longer than Deadline of the thread) or fails with Connection::Error::ADMISSION_REJECTED.
+    * Admission is lock free. Waiting requests sleep until the next token or poll for free slot.
+    * Thread safe.
+    *
+    *  F.e. :
+    *  Redis::AdmissionControl::Limits limits;
+    *  limits.rate = 50000;
+    *  limits.burst = 500;
+    *  limits.max_in_flight = 64;
+    *  Redis::NamedPool::create("cache", params, limits);
+    * */
+    class AdmissionControl {
+    public:
+        struct Limits {
+            //Requests per second. 0 disables rate limit
+            double rate;
+            //Requests which can be sent at once after idle period
+            unsigned int burst;
+            //Requests waiting for reply at the same time. 0 disables the limit
+            unsigned int max_in_flight;
+            //How long over-limit request waits for its turn. 0 fails it at once
+            unsigned int queue_timeout_ms;
+            Limits() : rate(0), burst(1), max_in_flight(0), queue_timeout_ms(0) {}
+
+            bool is_enabled() const {
+                return rate > 0 || max_in_flight != 0;
+            }
+
+            bool operator==(const Limits& other) const {
+                return
+                        rate == other.rate &&
+                        burst == other.burst &&
+                        max_in_flight == other.max_in_flight &&
+                        queue_timeout_ms == other.queue_timeout_ms;
+            }
+            bool operator!=(const Limits& other) const {
+                return !operator==(other);
+            }
+        };
+
+        explicit AdmissionControl(const Limits& limits);
+        ~AdmissionControl();
+        AdmissionControl(const AdmissionControl& other) = delete;
+        AdmissionControl& operator=(const AdmissionControl& other) = delete;
+
+        /* Takes a slot and a token without waiting */
+        bool try_acquire();
+
+        /* Takes a slot and a token, waiting up to queue_timeout_ms */
+        bool acquire();
+
+        /* Returns slot taken by successful acquire */
+        void release();
+
+        const Limits& get_limits() const;
+        unsigned int get_in_flight() const;
+        unsigned long long get_admitted_count() const;
+        unsigned long long get_rejected_count() const;
+
+    private:
+        class Impl;
+        Impl* d;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,282 @@
+#include "auto_batcher.hpp"
+#include "exception.hpp"
+#include "log.hpp"
+#include <hiredis/hiredis.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <cstring>
+
+namespace Redis {
+    static thread_local std::string last_error;
+
+    class AutoBatcher::Impl {
+        friend class AutoBatcher;
+        template <class T>
+        using Request = std::pair<std::string, std::promise<T>>;
+
+        struct Batch {
+            std::vector<Request<std::string>> gets;
+            std::vector<Request<bool>> exists;
+            std::vector<Request<long long>> ttls;
+            Batch() : gets(), exists(), ttls() {}
+            size_t size() const {
+                return gets.size() + exists.size() + ttls.size();
+            }
+        };
+
+        Connection connection;
+        Options options;
+        bool throw_on_error;
+        std::mutex lock;
+        std::condition_variable queue_cv;
+        Batch queue;
+        std::chrono::steady_clock::time_point batch_start;
+        bool stopping;
+        std::atomic<unsigned long long> request_count;
+        std::atomic<unsigned long long> batch_count;
+        std::thread flusher;
+
+        Impl(const ConnectionParam& connection_param, const Options& _options) :
+            connection(connection_param),
+            options(_options),
+            throw_on_error(connection_param.throw_on_error),
+            lock(),
+            queue_cv(),
+            queue(),
+            batch_start(),
+            stopping(false),
+            request_count(0),
+            batch_count(0),
+            flusher()
+        {
+            if(options.max_batch == 0) {
+                options.max_batch = 1;
+            }
+            flusher = std::thread(&Impl::run, this);
+        }
+
+        ~Impl() {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+            }
+            queue_cv.notify_all();
+            flusher.join();
+        }
+
+        template <class T>
+        std::future<T> enqueue(std::vector<Request<T>> Batch::* requests, const std::string& key) {
+            std::promise<T> promise;
+            std::future<T> future = promise.get_future();
+            request_count++;
+            bool notify = false;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                size_t queued = queue.size();
+                if(queued == 0) {
+                    batch_start = std::chrono::steady_clock::now();
+                }
+                (queue.*requests).emplace_back(key, std::move(promise));
+                notify = queued == 0 || queued + 1 >= options.max_batch;
+            }
+            if(notify) {
+                queue_cv.notify_all();
+            }
+            return future;
+        }
+
+        template <class T>
+        bool wait(std::future<T>&& future, T& result) {
+            try {
+                result = future.get();
+                return true;
+            }
+            catch(const Redis::Exception& e) {
+                last_error = e.what();
+                if(throw_on_error) {
+                    throw;
+                }
+                return false;
+            }
+        }
+
+        void run() {
+            std::unique_lock<std::mutex> guard(lock);
+            while(true) {
+                queue_cv.wait(guard, [this]() { return stopping || queue.size() != 0; });
+                if(queue.size() == 0) {
+                    return;
+                }
+                queue_cv.wait_until(guard, batch_start + std::chrono::microseconds(options.window_us), [this]() {
+                    return stopping || queue.size() >= options.max_batch;
+                });
+                Batch batch;
+                std::swap(batch, queue);
+                guard.unlock();
+                send(batch);
+                guard.lock();
+            }
+        }
+
+        template <class T>
+        static void fail(std::vector<Request<T>>& requests, size_t from, const std::string& error) {
+            for(size_t i = from; i < requests.size(); i++) {
+                requests[i].second.set_exception(std::make_exception_ptr(Redis::Exception(error)));
+            }
+        }
+
+        void send(Batch& batch) {
+            batch_count++;
+            //Replies are processed in order: MGET, EXISTS, TTL. Unprocessed ones are failed together on connection error
+            size_t gets_done = 0, exists_done = 0, ttls_done = 0;
+            std::string error;
+            try {
+                if(send_batch(batch, gets_done, exists_done, ttls_done)) {
+                    return;
+                }
+                error = connection.get_error();
+            }
+            catch(const std::exception& e) {
+                error = e.what();
+            }
+            rediscpp_debug(LL::WARNING, "AutoBatcher failed to send batch: " << error);
+            connection.abandon();
+            fail(batch.gets, gets_done, error);
+            fail(batch.exists, exists_done, error);
+            fail(batch.ttls, ttls_done, error);
+        }
+
+        bool append(const char* command, const std::string& key) {
+            std::string prefixed_key = connection.get_prefix() + key;
+            return connection.append_command({command, prefixed_key.c_str()}, {std::strlen(command), prefixed_key.size()});
+        }
+
+        /* Returns false if reply could not be read. Error replies fail only the requests of their command */
+        bool fetch(bool& ok) {
+            ok = connection.fetch_reply();
+            return ok || connection.get_errno() == Connection::Error::REPLY_ERR;
+        }
+
+        bool send_batch(Batch& batch, size_t& gets_done, size_t& exists_done, size_t& ttls_done) {
+            if(!batch.gets.empty()) {
+                std::vector<std::string> prefixed_keys;
+                std::vector<const char*> commands;
+                std::vector<size_t> sizes;
+                prefixed_keys.reserve(batch.gets.size());
+                commands.push_back("MGET");
+                sizes.push_back(4);
+                for(size_t i = 0; i < batch.gets.size(); i++) {
+                    prefixed_keys.push_back(connection.get_prefix() + batch.gets[i].first);
+                    commands.push_back(prefixed_keys.back().c_str());
+                    sizes.push_back(prefixed_keys.back().size());
+                }
+                if(!connection.append_command(commands, sizes)) {
+                    return false;
+                }
+            }
+            for(size_t i = 0; i < batch.exists.size(); i++) {
+                if(!append("EXISTS", batch.exists[i].first)) {
+                    return false;
+                }
+            }
+            for(size_t i = 0; i < batch.ttls.size(); i++) {
+                if(!append("TTL", batch.ttls[i].first)) {
+                    return false;
+                }
+            }
+            if(!connection.flush_commands()) {
+                return false;
+            }
+            bool ok = false;
+            if(!batch.gets.empty()) {
+                if(!fetch(ok)) {
+                    return false;
+                }
+                std::vector<std::string> values;
+                if(ok && connection.read_string_array_reply(values) && values.size() == batch.gets.size()) {
+                    for(; gets_done < batch.gets.size(); gets_done++) {
+                        batch.gets[gets_done].second.set_value(std::move(values[gets_done]));
+                    }
+                }
+                else {
+                    fail(batch.gets, 0, connection.get_error());
+                    gets_done = batch.gets.size();
+                }
+            }
+            long long integer = 0;
+            for(; exists_done < batch.exists.size(); exists_done++) {
+                if(!fetch(ok)) {
+                    return false;
+                }
+                if(ok && connection.read_integer_reply(integer)) {
+                    batch.exists[exists_done].second.set_value(integer != 0);
+                }
+                else {
+                    batch.exists[exists_done].second.set_exception(std::make_exception_ptr(Redis::Exception(connection.get_error())));
+                }
+            }
+            for(; ttls_done < batch.ttls.size(); ttls_done++) {
+                if(!fetch(ok)) {
+                    return false;
+                }
+                if(ok && connection.read_integer_reply(integer)) {
+                    batch.ttls[ttls_done].second.set_value(integer);
+                }
+                else {
+                    batch.ttls[ttls_done].second.set_exception(std::make_exception_ptr(Redis::Exception(connection.get_error())));
+                }
+            }
+            return true;
+        }
+    };
+
+    AutoBatcher::AutoBatcher(const ConnectionParam& connection_param, const Options& options) :
+        d(new AutoBatcher::Impl(connection_param, options))
+    {}
+
+    AutoBatcher::~AutoBatcher() {
+        if(d != nullptr) {
+            delete d;
+        }
+    }
+
+    std::future<std::string> AutoBatcher::get_async(const std::string& key) {
+        return d->enqueue(&Impl::Batch::gets, key);
+    }
+
+    std::future<bool> AutoBatcher::exists_async(const std::string& key) {
+        return d->enqueue(&Impl::Batch::exists, key);
+    }
+
+    std::future<long long> AutoBatcher::ttl_async(const std::string& key) {
+        return d->enqueue(&Impl::Batch::ttls, key);
+    }
+
+    bool AutoBatcher::get(const std::string& key, std::string& result) {
+        return d->wait(get_async(key), result);
+    }
+
+    bool AutoBatcher::exists(const std::string& key, bool& result) {
+        return d->wait(exists_async(key), result);
+    }
+
+    bool AutoBatcher::ttl(const std::string& key, long long& result) {
+        return d->wait(ttl_async(key), result);
+    }
+
+    unsigned long long AutoBatcher::get_request_count() {
+        return d->request_count.load();
+    }
+
+    unsigned long long AutoBatcher::get_batch_count() {
+        return d->batch_count.load();
+    }
+
+    std::string AutoBatcher::get_error() {
+        return last_error;
+    }
+}
\ No newline at end of file
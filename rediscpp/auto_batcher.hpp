@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <future>
+#include "connection.hpp"
+namespace Redis {
+    /**
+    * Collects single key reads from many threads into batches sent over one connection.
+    * Batch is sent when window_us passed since its first request or max_batch requests are collected.
+    * GETs of a batch are sent as a single MGET, EXISTS and TTL are pipelined after it.
+    * Async calls return futures which throw Redis::Exception on failure.
+    * Thread safe. Each batcher owns a connection and a flushing thread, so create one per endpoint and share it.
+    *
+    *  F.e. :
+    *  Redis::AutoBatcher batcher(Redis::ConnectionParam("10.0.0.1"));
+    *  std::future<std::string> value = batcher.get_async("key");
+    *  ...
+    *  value.get();
+    * */
+    class AutoBatcher {
+    public:
+        struct Options {
+            //Max time the first request of a batch waits for others
+            unsigned int window_us;
+            //Batch is sent immediately when it has that much requests
+            size_t max_batch;
+            Options() : window_us(50), max_batch(128) {}
+        };
+
+        AutoBatcher(const ConnectionParam& connection_param, const Options& options = Options());
+        /* Sends requests which are already queued and stops flushing thread */
+        ~AutoBatcher();
+        AutoBatcher(const AutoBatcher& other) = delete;
+        AutoBatcher& operator=(const AutoBatcher& other) = delete;
+
+        /* Value of a key. Empty string if key doesn't exist */
+        std::future<std::string> get_async(const std::string& key);
+
+        /* If key exists */
+        std::future<bool> exists_async(const std::string& key);
+
+        /* Time to live in seconds, -1 if key has no expire, -2 if key doesn't exist */
+        std::future<long long> ttl_async(const std::string& key);
+
+        /* Blocking versions. Wait for the batch to be sent */
+        bool get(const std::string& key, std::string& result);
+        bool exists(const std::string& key, bool& result);
+        bool ttl(const std::string& key, long long& result);
+
+        unsigned long long get_request_count();
+        unsigned long long get_batch_count();
+
+        /* Error of the last failed blocking call made by the calling thread */
+        static std::string get_error();
+
+    private:
+        class Impl;
+        Impl* d;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "bitfield.hpp"
+#include "exception.hpp"
+
+namespace Redis {
+    constexpr size_t BitField::default_max_operations;
+
+    BitField::Type::Type(bool _is_signed, unsigned int _bits) :
+        is_signed(_is_signed),
+        bits(_bits)
+    {
+        if(bits == 0 || bits > (is_signed ? 64 : 63)) {
+            throw Redis::Exception("Invalid BITFIELD type " + to_string());
+        }
+    }
+
+    std::string BitField::Type::to_string() const {
+        return (is_signed ? "i" : "u") + std::to_string(bits);
+    }
+
+    BitField::BitField(size_t _max_operations) :
+        operations(),
+        current_overflow(Overflow::WRAP),
+        max_operations(_max_operations == 0 ? default_max_operations : _max_operations)
+    {}
+
+    BitField& BitField::add(OperationType operation, const Type& type, unsigned long long offset, long long value) {
+        operations.push_back(Operation{operation, type, offset, value, current_overflow});
+        return *this;
+    }
+
+    BitField& BitField::get(const Type& type, unsigned long long offset) {
+        return add(OperationType::GET, type, offset, 0);
+    }
+
+    BitField& BitField::set(const Type& type, unsigned long long offset, long long value) {
+        return add(OperationType::SET, type, offset, value);
+    }
+
+    BitField& BitField::incrby(const Type& type, unsigned long long offset, long long increment) {
+        return add(OperationType::INCRBY, type, offset, increment);
+    }
+
+    BitField& BitField::overflow(Overflow mode) {
+        current_overflow = mode;
+        return *this;
+    }
+
+    size_t BitField::size() const {
+        return operations.size();
+    }
+
+    bool BitField::empty() const {
+        return operations.empty();
+    }
+
+    void BitField::clear() {
+        operations.clear();
+        current_overflow = Overflow::WRAP;
+    }
+
+    size_t BitField::get_max_operations() const {
+        return max_operations;
+    }
+
+    void BitField::append_arguments(size_t first, size_t last, std::vector<std::string>& args) const {
+        static const char* overflow_names[] = {"WRAP", "SAT", "FAIL"};
+        //Every command starts in WRAP, so mode is repeated at the start of each split part
+        Overflow overflow = Overflow::WRAP;
+        for(size_t i = first; i < last && i < operations.size(); i++) {
+            const Operation& operation = operations[i];
+            if(operation.operation != OperationType::GET && operation.overflow != overflow) {
+                overflow = operation.overflow;
+                args.push_back("OVERFLOW");
+                args.push_back(overflow_names[static_cast<int>(overflow)]);
+            }
+            switch(operation.operation) {
+                case OperationType::GET:
+                    args.push_back("GET");
+                    break;
+                case OperationType::SET:
+                    args.push_back("SET");
+                    break;
+                case OperationType::INCRBY:
+                    args.push_back("INCRBY");
+                    break;
+            }
+            args.push_back(operation.type.to_string());
+            args.push_back(std::to_string(operation.offset));
+            if(operation.operation != OperationType::GET) {
+                args.push_back(std::to_string(operation.value));
+            }
+        }
+    }
+}
\ No newline at end of file
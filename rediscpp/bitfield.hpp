@@ -0,0 +1,77 @@
+#pragma once
+#include <string>
+#include <vector>
+namespace Redis {
+    /**
+    * Sub-operations of BITFIELD command, run with Connection::bitfield.
+    * Each GET, SET and INCRBY gives one result, in order they were added.
+    * OVERFLOW applies to SET and INCRBY added after it, default is WRAP.
+    * Builder with more than max_operations sub-operations is sent as several BITFIELD commands in one pipeline,
+    * so huge batches are still one round trip but are not atomic as a whole.
+    *
+    *  F.e. packed 4 bit counters :
+    *  Redis::BitField ops;
+    *  ops.overflow(Redis::BitField::Overflow::SAT);
+    *  for(unsigned long long counter : counters) {
+    *      ops.incrby(Redis::BitField::u(4), counter * 4, 1);
+    *  }
+    *  std::vector<long long> values;
+    *  conn.bitfield("counters", ops, values);
+    * */
+    class BitField {
+    public:
+        static constexpr size_t default_max_operations = 1024;
+
+        enum class Overflow { WRAP, SAT, FAIL };
+
+        /* Integer type of a field: up to 64 bits signed, up to 63 bits unsigned */
+        struct Type {
+            bool is_signed;
+            unsigned int bits;
+            Type(bool _is_signed, unsigned int _bits);
+            std::string to_string() const;
+        };
+
+        static Type u(unsigned int bits) {
+            return Type(false, bits);
+        }
+
+        static Type i(unsigned int bits) {
+            return Type(true, bits);
+        }
+
+        explicit BitField(size_t max_operations = default_max_operations);
+
+        /* Offsets are in bits. Offset of n-th field of type t is n * t.bits */
+        BitField& get(const Type& type, unsigned long long offset);
+        BitField& set(const Type& type, unsigned long long offset, long long value);
+        BitField& incrby(const Type& type, unsigned long long offset, long long increment);
+        BitField& overflow(Overflow mode);
+
+        /* Number of results */
+        size_t size() const;
+        bool empty() const;
+        void clear();
+
+        size_t get_max_operations() const;
+
+        /* Arguments of sub-operations [first, last) as a standalone BITFIELD command, with OVERFLOW repeated where needed */
+        void append_arguments(size_t first, size_t last, std::vector<std::string>& args) const;
+
+    private:
+        enum class OperationType { GET, SET, INCRBY };
+        struct Operation {
+            OperationType operation;
+            Type type;
+            unsigned long long offset;
+            long long value;
+            Overflow overflow;
+        };
+
+        std::vector<Operation> operations;
+        Overflow current_overflow;
+        size_t max_operations;
+
+        BitField& add(OperationType operation, const Type& type, unsigned long long offset, long long value);
+    };
+}
\ No newline at end of file
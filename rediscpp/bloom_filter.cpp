@@ -0,0 +1,360 @@
+#include "bloom_filter.hpp"
+#include "pool.hpp"
+#include "named_pool.hpp"
+#include "exception.hpp"
+#include "macro.hpp"
+#include "log.hpp"
+#include <hiredis/hiredis.h>
+#include <mutex>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace Redis {
+    namespace {
+        inline uint64_t rotate_left(uint64_t value, int bits) {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        inline uint64_t fmix64(uint64_t k) {
+            k ^= k >> 33;
+            k *= 0xff51afd7ed558ccdULL;
+            k ^= k >> 33;
+            k *= 0xc4ceb9fe1a85ec53ULL;
+            k ^= k >> 33;
+            return k;
+        }
+
+        /* Little endian regardless of host, so filters are shared between platforms */
+        inline uint64_t read64(const unsigned char* bytes) {
+            uint64_t value = 0;
+            for(int i = 7; i >= 0; i--) {
+                value = value << 8 | bytes[i];
+            }
+            return value;
+        }
+
+        /* MurmurHash3 x64 128 */
+        void murmur3_128(const std::string& data, uint64_t seed, uint64_t& out1, uint64_t& out2) {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+            const size_t blocks = data.size() / 16;
+            const uint64_t c1 = 0x87c37b91114253d5ULL;
+            const uint64_t c2 = 0x4cf5ad432745937fULL;
+            uint64_t h1 = seed, h2 = seed;
+            for(size_t i = 0; i < blocks; i++) {
+                uint64_t k1 = read64(bytes + i * 16);
+                uint64_t k2 = read64(bytes + i * 16 + 8);
+                k1 *= c1;
+                k1 = rotate_left(k1, 31);
+                k1 *= c2;
+                h1 ^= k1;
+                h1 = rotate_left(h1, 27);
+                h1 += h2;
+                h1 = h1 * 5 + 0x52dce729;
+                k2 *= c2;
+                k2 = rotate_left(k2, 33);
+                k2 *= c1;
+                h2 ^= k2;
+                h2 = rotate_left(h2, 31);
+                h2 += h1;
+                h2 = h2 * 5 + 0x38495ab5;
+            }
+            const unsigned char* tail = bytes + blocks * 16;
+            const size_t rest = data.size() & 15;
+            uint64_t k1 = 0, k2 = 0;
+            for(size_t i = rest; i > 8; i--) {
+                k2 = k2 << 8 | tail[i - 1];
+            }
+            if(rest > 8) {
+                k2 *= c2;
+                k2 = rotate_left(k2, 33);
+                k2 *= c1;
+                h2 ^= k2;
+            }
+            for(size_t i = std::min(rest, static_cast<size_t>(8)); i > 0; i--) {
+                k1 = k1 << 8 | tail[i - 1];
+            }
+            if(rest > 0) {
+                k1 *= c1;
+                k1 = rotate_left(k1, 31);
+                k1 *= c2;
+                h1 ^= k1;
+            }
+            h1 ^= data.size();
+            h2 ^= data.size();
+            h1 += h2;
+            h2 += h1;
+            h1 = fmix64(h1);
+            h2 = fmix64(h2);
+            h1 += h2;
+            h2 += h1;
+            out1 = h1;
+            out2 = h2;
+        }
+    }
+
+    class BloomFilter::Impl {
+        friend class BloomFilter;
+
+        /* Hash of an item, positions are derived from it when the command is built */
+        struct Hash {
+            uint64_t h1;
+            uint64_t h2;
+            size_t shard;
+        };
+
+        std::string name;
+        Options options;
+        ConnectionParam param;
+        NamedPool* named_pool;
+        unsigned long long shard_bits;
+        unsigned int hash_count;
+        std::vector<std::string> shard_keys;
+        //Shards on the same server share pipeline
+        std::vector<size_t> shard_groups;
+        std::vector<size_t> group_shards;
+        std::mutex lock;
+        std::string err;
+
+        Impl(const std::string& _name, unsigned long long expected_items, double false_positive_rate,
+                const ConnectionParam& _param, NamedPool* _named_pool, const Options& _options) :
+            name(_name),
+            options(_options),
+            param(_param),
+            named_pool(_named_pool),
+            shard_bits(0),
+            hash_count(0),
+            shard_keys(),
+            shard_groups(),
+            group_shards(),
+            lock(),
+            err()
+        {
+            if(expected_items == 0 || !(false_positive_rate > 0 && false_positive_rate < 1) || options.shard_bits == 0 || options.pipeline_size == 0) {
+                throw Redis::Exception("Invalid parameters passed to Redis::BloomFilter");
+            }
+            const double ln2 = std::log(2.0);
+            double bits = std::ceil(-static_cast<double>(expected_items) * std::log(false_positive_rate) / (ln2 * ln2));
+            hash_count = static_cast<unsigned int>(std::max(1.0, std::round(bits / static_cast<double>(expected_items) * ln2)));
+            unsigned long long total_bits = static_cast<unsigned long long>(bits);
+            unsigned long long shards = (total_bits + options.shard_bits - 1) / options.shard_bits;
+            shard_bits = (total_bits + shards - 1) / shards;
+            std::vector<const ConnectionParam*> group_params;
+            for(unsigned long long i = 0; i < shards; i++) {
+                shard_keys.push_back(shards == 1 ? name : name + ":" + std::to_string(i));
+                const ConnectionParam* shard_param = named_pool != nullptr ? &named_pool->get_connection_param(shard_keys.back()) : &param;
+                size_t group = static_cast<size_t>(std::find(group_params.begin(), group_params.end(), shard_param) - group_params.begin());
+                if(group == group_params.size()) {
+                    group_params.push_back(shard_param);
+                    group_shards.push_back(shard_keys.size() - 1);
+                }
+                shard_groups.push_back(group);
+            }
+        }
+
+        Impl(const Impl& other) = delete;
+        Impl& operator=(const Impl& other) = delete;
+
+        void set_error(const std::string& error) {
+            rediscpp_debug(LL::WARNING, "BloomFilter " << name << ": " << error);
+            std::lock_guard<std::mutex> guard(lock);
+            err = error;
+        }
+
+        PoolWrapper lease(size_t group) {
+            const std::string& key = shard_keys[group_shards[group]];
+            return named_pool != nullptr ? named_pool->get(key) : Pool::instance().get(param);
+        }
+
+        Hash hash(const std::string& item) const {
+            Hash result;
+            murmur3_128(item, 0, result.h1, result.h2);
+            result.shard = static_cast<size_t>(fmix64(result.h1 ^ result.h2) % shard_keys.size());
+            return result;
+        }
+
+        /* BITFIELD key SET u1 pos 1 ... or BITFIELD key GET u1 pos ... GET uses BITFIELD_RO if possible, so it's served by replicas too */
+        bool append(Connection& conn, const Hash& item_hash, bool set, bool read_only, std::vector<std::string>& args,
+                std::vector<const char*>& commands, std::vector<size_t>& sizes) {
+            args.clear();
+            commands.clear();
+            sizes.clear();
+            args.push_back(conn.get_prefix() + shard_keys[item_hash.shard]);
+            //Enhanced double hashing (Dillinger, Manolios)
+            uint64_t x = item_hash.h1, y = item_hash.h2;
+            for(unsigned int i = 0; i < hash_count; i++) {
+                args.push_back(std::to_string(x % shard_bits));
+                x += y;
+                y += i;
+            }
+            commands.push_back(read_only ? "BITFIELD_RO" : "BITFIELD");
+            sizes.push_back(read_only ? 11 : 8);
+            commands.push_back(args[0].c_str());
+            sizes.push_back(args[0].size());
+            for(size_t i = 1; i < args.size(); i++) {
+                commands.push_back(set ? "SET" : "GET");
+                sizes.push_back(3);
+                commands.push_back("u1");
+                sizes.push_back(2);
+                commands.push_back(args[i].c_str());
+                sizes.push_back(args[i].size());
+                if(set) {
+                    commands.push_back("1");
+                    sizes.push_back(1);
+                }
+            }
+            return conn.append_command(commands, sizes);
+        }
+
+        /* For SET reply holds old bits: item is new if any was 0. For GET item is present if all are 1 */
+        static bool read(Connection& conn, bool set) {
+            const redisReply* reply = conn.get_reply();
+            redis_assert(reply->type == REDIS_REPLY_ARRAY);
+            for(size_t i = 0; i < reply->elements; i++) {
+                if(reply->element[i]->integer == 0) {
+                    return set;
+                }
+            }
+            return !set;
+        }
+
+        bool run(const std::vector<std::string>& items, bool set, std::vector<bool>& result) {
+            result.assign(items.size(), false);
+            std::vector<Hash> hashes;
+            std::vector<std::vector<size_t>> groups(group_shards.size());
+            hashes.reserve(items.size());
+            for(size_t i = 0; i < items.size(); i++) {
+                hashes.push_back(hash(items[i]));
+                groups[shard_groups[hashes.back().shard]].push_back(i);
+            }
+            bool ok = true;
+            std::vector<PoolWrapper> conns;
+            std::vector<bool> failed(groups.size(), false);
+            std::vector<bool> read_only(groups.size(), false);
+            conns.reserve(groups.size());
+            for(size_t i = 0; i < groups.size(); i++) {
+                conns.push_back(groups[i].empty() ? PoolWrapper() : lease(i));
+                if(!set && !groups[i].empty()) {
+                    //BITFIELD_RO is available since redis 6.0
+                    std::shared_ptr<const Capabilities> capabilities = conns[i]->get_capabilities();
+                    read_only[i] = capabilities != nullptr && capabilities->version >= 60000;
+                }
+            }
+            std::vector<std::string> args;
+            std::vector<const char*> commands;
+            std::vector<size_t> sizes;
+            //Pipelines are limited, so neither side blocks on a full socket buffer
+            for(size_t offset = 0; ; offset += options.pipeline_size) {
+                bool more = false;
+                std::vector<bool> sent(groups.size(), false);
+                for(size_t i = 0; i < groups.size(); i++) {
+                    if(failed[i] || groups[i].size() <= offset) {
+                        continue;
+                    }
+                    more = true;
+                    size_t end = std::min(groups[i].size(), offset + options.pipeline_size);
+                    bool appended = true;
+                    for(size_t j = offset; j < end && appended; j++) {
+                        appended = append(*conns[i], hashes[groups[i][j]], set, read_only[i], args, commands, sizes);
+                    }
+                    if(!appended || !conns[i]->flush_commands()) {
+                        conns[i]->abandon();
+                        set_error(conns[i]->get_error());
+                        failed[i] = true;
+                        ok = false;
+                        continue;
+                    }
+                    sent[i] = true;
+                }
+                if(!more) {
+                    return ok;
+                }
+                for(size_t i = 0; i < groups.size(); i++) {
+                    if(!sent[i]) {
+                        continue;
+                    }
+                    size_t end = std::min(groups[i].size(), offset + options.pipeline_size);
+                    for(size_t j = offset; j < end; j++) {
+                        if(conns[i]->fetch_reply()) {
+                            result[groups[i][j]] = read(*conns[i], set);
+                            continue;
+                        }
+                        set_error(conns[i]->get_error());
+                        ok = false;
+                        if(conns[i]->get_errno() != Connection::Error::REPLY_ERR) {
+                            failed[i] = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    };
+
+    BloomFilter::BloomFilter(const std::string& name, unsigned long long expected_items, double false_positive_rate,
+            const ConnectionParam& param, const Options& options) :
+        d(new BloomFilter::Impl(name, expected_items, false_positive_rate, param, nullptr, options))
+    {}
+
+    BloomFilter::BloomFilter(const std::string& name, unsigned long long expected_items, double false_positive_rate,
+            const std::string& pool_name, const Options& options) :
+        d(new BloomFilter::Impl(name, expected_items, false_positive_rate, ConnectionParam(), &NamedPool::get_pool(pool_name), options))
+    {}
+
+    BloomFilter::~BloomFilter() {
+        if(d != nullptr) {
+            delete d;
+        }
+    }
+
+    bool BloomFilter::add(const std::string& item, bool& added) {
+        std::vector<bool> result;
+        bool ok = d->run({item}, true, result);
+        added = result[0];
+        return ok;
+    }
+
+    bool BloomFilter::add(const std::vector<std::string>& items, std::vector<bool>& added) {
+        return d->run(items, true, added);
+    }
+
+    bool BloomFilter::contains(const std::string& item, bool& result) {
+        std::vector<bool> results;
+        bool ok = d->run({item}, false, results);
+        result = results[0];
+        return ok;
+    }
+
+    bool BloomFilter::contains(const std::vector<std::string>& items, std::vector<bool>& result) {
+        return d->run(items, false, result);
+    }
+
+    bool BloomFilter::clear() {
+        bool ok = true;
+        for(size_t i = 0; i < d->shard_keys.size(); i++) {
+            PoolWrapper conn = d->named_pool != nullptr ? d->named_pool->get(d->shard_keys[i]) : Pool::instance().get(d->param);
+            if(!conn->del(d->shard_keys[i])) {
+                d->set_error(conn->get_error());
+                ok = false;
+            }
+        }
+        return ok;
+    }
+
+    unsigned long long BloomFilter::get_bits() const {
+        return d->shard_bits * d->shard_keys.size();
+    }
+
+    unsigned int BloomFilter::get_hash_count() const {
+        return d->hash_count;
+    }
+
+    const std::vector<std::string>& BloomFilter::get_shard_keys() const {
+        return d->shard_keys;
+    }
+
+    std::string BloomFilter::get_error() {
+        std::lock_guard<std::mutex> guard(d->lock);
+        return d->err;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "connection.hpp"
+namespace Redis {
+    /**
+    * Bloom filter stored in redis bitmaps. Bit positions of an item are computed locally with MurmurHash3 and enhanced double hashing,
+    * and all of them are set or checked with a single BITFIELD, so an item costs one command instead of k SETBIT/GETBIT round trips.
+    * Batches are sent in pipelines of pipeline_size commands per server.
+    *
+    * Filters larger than shard_bits are split into shard keys name:0, name:1, ... Every item lives in a single shard,
+    * so it is still one command. With NamedPool shards are spread over its servers.
+    * Size and number of hashes are derived from expected_items and false_positive_rate, so all users of a filter must pass the same values.
+    * Filter doesn't support removal.
+    * Thread safe.
+    *
+    *  F.e. :
+    *  Redis::BloomFilter seen("seen_events", 10000000, 0.001);
+    *  std::vector<bool> added;
+    *  seen.add(event_ids, added);
+    * */
+    class BloomFilter {
+    public:
+        struct Options {
+            //Max bits in one key. Redis strings are limited to 2^32 bits
+            unsigned long long shard_bits;
+            //Commands sent to a server before replies are read
+            size_t pipeline_size;
+            Options() : shard_bits(1ULL << 27), pipeline_size(1024) {}
+        };
+
+        /* Shards live on a single server */
+        BloomFilter(const std::string& name, unsigned long long expected_items, double false_positive_rate,
+                const ConnectionParam& param = ConnectionParam(), const Options& options = Options());
+
+        /* Shards are spread by NamedPool, which must be created before */
+        BloomFilter(const std::string& name, unsigned long long expected_items, double false_positive_rate,
+                const std::string& pool_name, const Options& options = Options());
+
+        ~BloomFilter();
+        BloomFilter(const BloomFilter& other) = delete;
+        BloomFilter& operator=(const BloomFilter& other) = delete;
+
+        /* added is false if the item was already in the filter (or is a false positive) */
+        bool add(const std::string& item, bool& added);
+
+        /* Adds items, added[i] tells if items[i] was new. Returns false if any of them failed, failed ones are reported as not added */
+        bool add(const std::vector<std::string>& items, std::vector<bool>& added);
+
+        /* False result is exact, true result may be a false positive */
+        bool contains(const std::string& item, bool& result);
+
+        /* Checks items, failed ones are reported as missing */
+        bool contains(const std::vector<std::string>& items, std::vector<bool>& result);
+
+        /* Deletes all shards */
+        bool clear();
+
+        /* Total number of bits in all shards */
+        unsigned long long get_bits() const;
+        unsigned int get_hash_count() const;
+        const std::vector<std::string>& get_shard_keys() const;
+
+        /* Error of the last failed call */
+        std::string get_error();
+
+    private:
+        class Impl;
+        Impl* d;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#include "capabilities.hpp"
+#include <map>
+#include <mutex>
+
+namespace Redis {
+    static std::mutex cache_lock;
+    static std::map<std::string, std::shared_ptr<const Capabilities>> cache;
+
+    std::string CapabilityCache::get_endpoint(const ConnectionParam& connection_param) {
+        if(connection_param.is_unix_socket()) {
+            return connection_param.get_unix_socket_path();
+        }
+        return connection_param.host + ":" + std::to_string(connection_param.port);
+    }
+
+    std::shared_ptr<const Capabilities> CapabilityCache::get(const ConnectionParam& connection_param) {
+        std::string endpoint = get_endpoint(connection_param);
+        std::lock_guard<std::mutex> guard(cache_lock);
+        auto it = cache.find(endpoint);
+        return it == cache.end() ? nullptr : it->second;
+    }
+
+    void CapabilityCache::put(const ConnectionParam& connection_param, std::shared_ptr<const Capabilities> capabilities) {
+        std::string endpoint = get_endpoint(connection_param);
+        std::lock_guard<std::mutex> guard(cache_lock);
+        cache[endpoint] = capabilities;
+    }
+
+    void CapabilityCache::clear() {
+        std::lock_guard<std::mutex> guard(cache_lock);
+        cache.clear();
+    }
+}
\ No newline at end of file
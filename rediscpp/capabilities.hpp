@@ -0,0 +1,33 @@
+#pragma once
+#include <string>
+#include <set>
+#include <memory>
+#include "connection_param.hpp"
+namespace Redis {
+    /* What server behind an endpoint supports */
+    struct Capabilities {
+        //major * 10000 + minor * 100 + patch, the same as Connection::get_version
+        unsigned int version;
+        //Server knows HELLO and RESP3 (redis 6+)
+        bool resp3;
+        //Lower case names from COMMAND. Loaded on first Connection::has_command call
+        bool commands_loaded;
+        std::set<std::string> commands;
+        Capabilities() : version(0), resp3(false), commands_loaded(false), commands() {}
+    };
+
+    /**
+    * Capabilities shared by all connections to the same endpoint (host:port or unix socket), so only the first connection asks the server.
+    * Connection refreshes the entry when it reconnects after a failure, as server might have been restarted with other version.
+    * Thread safe.
+    * */
+    class CapabilityCache {
+    public:
+        static std::shared_ptr<const Capabilities> get(const ConnectionParam& connection_param);
+        static void put(const ConnectionParam& connection_param, std::shared_ptr<const Capabilities> capabilities);
+        /* Forget all endpoints, f.e. after servers were upgraded */
+        static void clear();
+    private:
+        static std::string get_endpoint(const ConnectionParam& connection_param);
+    };
+}
\ No newline at end of file
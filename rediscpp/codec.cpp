@@ -0,0 +1,282 @@
+#include "codec.hpp"
+#include "exception.hpp"
+#include "log.hpp"
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+#ifdef REDISCPP_WITH_LZ4
+#include <lz4.h>
+#endif
+#ifdef REDISCPP_WITH_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+namespace Redis {
+    constexpr size_t CompressionCodec::default_threshold;
+    constexpr size_t CompressionCodec::default_max_original_size;
+    constexpr size_t CompressionCodec::header_size;
+    constexpr unsigned char CompressionCodec::raw_id;
+
+    static const char magic[] = {'\xC0', 'R', 'Z'};
+    static constexpr size_t magic_size = sizeof(magic);
+
+    CompressionCodec::CompressionCodec(std::shared_ptr<const Compressor> _compressor, size_t _threshold, size_t _max_original_size) :
+        compressor(_compressor),
+        decompressors(),
+        threshold(_threshold < header_size ? header_size : _threshold),
+        max_original_size(std::min(_max_original_size, static_cast<size_t>(std::numeric_limits<uint32_t>::max())))
+    {
+        if(compressor == nullptr) {
+            throw Redis::Exception("Compressor passed to Redis::CompressionCodec is null. Probably library was built without it");
+        }
+        if(compressor->get_id() == raw_id) {
+            throw Redis::Exception("Compressor id 0 is reserved");
+        }
+        decompressors.push_back(compressor);
+    }
+
+    void CompressionCodec::add_decompressor(std::shared_ptr<const Compressor> decompressor) {
+        if(decompressor != nullptr) {
+            decompressors.push_back(decompressor);
+        }
+    }
+
+    bool CompressionCodec::has_header(const char* data, size_t size) {
+        return size >= header_size && std::memcmp(data, magic, magic_size) == 0;
+    }
+
+    static void write_header(unsigned char id, size_t original_size, std::string& out) {
+        out.append(magic, magic_size);
+        out.push_back(static_cast<char>(id));
+        for(size_t i = 0; i < 4; i++) {
+            out.push_back(static_cast<char>((original_size >> (8 * i)) & 0xFF));
+        }
+    }
+
+    bool CompressionCodec::encode(const char* data, size_t size, std::string& encoded) const {
+        if(size < threshold || size > max_original_size) {
+            if(!has_header(data, size)) {
+                return false;
+            }
+            encoded.clear();
+            write_header(raw_id, size, encoded);
+            encoded.append(data, size);
+            return true;
+        }
+        encoded.clear();
+        encoded.reserve(size);
+        write_header(compressor->get_id(), size, encoded);
+        if(compressor->compress(data, size, encoded) && encoded.size() < size) {
+            return true;
+        }
+        //Incompressible data, f.e. already compressed images
+        if(!has_header(data, size)) {
+            return false;
+        }
+        encoded.clear();
+        write_header(raw_id, size, encoded);
+        encoded.append(data, size);
+        return true;
+    }
+
+    bool CompressionCodec::decode(const char* data, size_t size, std::string& decoded) const {
+        if(!has_header(data, size)) {
+            decoded.assign(data, size);
+            return true;
+        }
+        unsigned char id = static_cast<unsigned char>(data[magic_size]);
+        size_t original_size = 0;
+        for(size_t i = 0; i < 4; i++) {
+            original_size |= static_cast<size_t>(static_cast<unsigned char>(data[magic_size + 1 + i])) << (8 * i);
+        }
+        data += header_size;
+        size -= header_size;
+        if(id == raw_id) {
+            decoded.assign(data, size);
+            return original_size == size;
+        }
+        if(original_size > max_original_size) {
+            rediscpp_debug(LL::WARNING, "Compressed value claims original size " << original_size << " above limit " << max_original_size);
+            return false;
+        }
+        for(size_t i = 0; i < decompressors.size(); i++) {
+            if(decompressors[i]->get_id() == id) {
+                decoded.clear();
+                decoded.reserve(original_size);
+                return decompressors[i]->decompress(data, size, original_size, decoded) && decoded.size() == original_size;
+            }
+        }
+        rediscpp_debug(LL::WARNING, "No decompressor for compressor id " << static_cast<unsigned int>(id));
+        return false;
+    }
+
+#ifdef REDISCPP_WITH_LZ4
+    class Lz4Compressor : public Compressor {
+    public:
+        static constexpr unsigned char id = 1;
+
+        unsigned char get_id() const override {
+            return id;
+        }
+
+        bool compress(const char* data, size_t size, std::string& out) const override {
+            if(size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+                return false;
+            }
+            size_t offset = out.size();
+            int bound = LZ4_compressBound(static_cast<int>(size));
+            out.resize(offset + static_cast<size_t>(bound));
+            int compressed_size = LZ4_compress_default(data, &out[offset], static_cast<int>(size), bound);
+            if(compressed_size <= 0) {
+                out.resize(offset);
+                return false;
+            }
+            out.resize(offset + static_cast<size_t>(compressed_size));
+            return true;
+        }
+
+        bool decompress(const char* data, size_t size, size_t original_size, std::string& out) const override {
+            if(size > static_cast<size_t>(std::numeric_limits<int>::max()) || original_size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+                return false;
+            }
+            size_t offset = out.size();
+            out.resize(offset + original_size);
+            int decompressed_size = LZ4_decompress_safe(data, &out[offset], static_cast<int>(size), static_cast<int>(original_size));
+            if(decompressed_size < 0) {
+                out.resize(offset);
+                return false;
+            }
+            out.resize(offset + static_cast<size_t>(decompressed_size));
+            return true;
+        }
+    };
+    constexpr unsigned char Lz4Compressor::id;
+
+    std::shared_ptr<Compressor> lz4_compressor() {
+        return std::make_shared<Lz4Compressor>();
+    }
+#else
+    std::shared_ptr<Compressor> lz4_compressor() {
+        return nullptr;
+    }
+#endif
+
+#ifdef REDISCPP_WITH_ZSTD
+    class ZstdCompressor : public Compressor {
+        struct CCtxDeleter {
+            void operator()(ZSTD_CCtx* ctx) const { ZSTD_freeCCtx(ctx); }
+        };
+        struct DCtxDeleter {
+            void operator()(ZSTD_DCtx* ctx) const { ZSTD_freeDCtx(ctx); }
+        };
+        struct CDictDeleter {
+            void operator()(ZSTD_CDict* dict) const { ZSTD_freeCDict(dict); }
+        };
+        struct DDictDeleter {
+            void operator()(ZSTD_DDict* dict) const { ZSTD_freeDDict(dict); }
+        };
+
+        //Contexts are expensive to create, so each thread keeps its own
+        static ZSTD_CCtx* get_cctx() {
+            static thread_local std::unique_ptr<ZSTD_CCtx, CCtxDeleter> cctx(ZSTD_createCCtx());
+            return cctx.get();
+        }
+
+        static ZSTD_DCtx* get_dctx() {
+            static thread_local std::unique_ptr<ZSTD_DCtx, DCtxDeleter> dctx(ZSTD_createDCtx());
+            return dctx.get();
+        }
+
+        int level;
+        std::unique_ptr<ZSTD_CDict, CDictDeleter> cdict;
+        std::unique_ptr<ZSTD_DDict, DDictDeleter> ddict;
+
+    public:
+        static constexpr unsigned char id = 2;
+
+        ZstdCompressor(int _level, const std::string& dictionary) :
+            level(_level),
+            cdict(),
+            ddict()
+        {
+            if(!dictionary.empty()) {
+                cdict.reset(ZSTD_createCDict(dictionary.data(), dictionary.size(), level));
+                ddict.reset(ZSTD_createDDict(dictionary.data(), dictionary.size()));
+                if(cdict == nullptr || ddict == nullptr) {
+                    throw Redis::Exception("Could not load zstd dictionary");
+                }
+            }
+        }
+
+        unsigned char get_id() const override {
+            return id;
+        }
+
+        bool compress(const char* data, size_t size, std::string& out) const override {
+            size_t offset = out.size();
+            size_t bound = ZSTD_compressBound(size);
+            out.resize(offset + bound);
+            size_t compressed_size = cdict != nullptr ?
+                ZSTD_compress_usingCDict(get_cctx(), &out[offset], bound, data, size, cdict.get()) :
+                ZSTD_compressCCtx(get_cctx(), &out[offset], bound, data, size, level);
+            if(ZSTD_isError(compressed_size)) {
+                rediscpp_debug(LL::WARNING, "zstd compression failed: " << ZSTD_getErrorName(compressed_size));
+                out.resize(offset);
+                return false;
+            }
+            out.resize(offset + compressed_size);
+            return true;
+        }
+
+        bool decompress(const char* data, size_t size, size_t original_size, std::string& out) const override {
+            size_t offset = out.size();
+            out.resize(offset + original_size);
+            size_t decompressed_size = ddict != nullptr ?
+                ZSTD_decompress_usingDDict(get_dctx(), &out[offset], original_size, data, size, ddict.get()) :
+                ZSTD_decompressDCtx(get_dctx(), &out[offset], original_size, data, size);
+            if(ZSTD_isError(decompressed_size)) {
+                rediscpp_debug(LL::WARNING, "zstd decompression failed: " << ZSTD_getErrorName(decompressed_size));
+                out.resize(offset);
+                return false;
+            }
+            out.resize(offset + decompressed_size);
+            return true;
+        }
+    };
+    constexpr unsigned char ZstdCompressor::id;
+
+    std::shared_ptr<Compressor> zstd_compressor(int level, const std::string& dictionary) {
+        return std::make_shared<ZstdCompressor>(level, dictionary);
+    }
+
+    bool zstd_train_dictionary(const std::vector<std::string>& samples, size_t dictionary_size, std::string& dictionary) {
+        std::string samples_buffer;
+        std::vector<size_t> sample_sizes;
+        sample_sizes.reserve(samples.size());
+        for(size_t i = 0; i < samples.size(); i++) {
+            samples_buffer.append(samples[i]);
+            sample_sizes.push_back(samples[i].size());
+        }
+        dictionary.resize(dictionary_size);
+        size_t result = ZDICT_trainFromBuffer(&dictionary[0], dictionary_size, samples_buffer.data(), sample_sizes.data(), static_cast<unsigned int>(sample_sizes.size()));
+        if(ZDICT_isError(result)) {
+            rediscpp_debug(LL::WARNING, "zstd dictionary training failed: " << ZDICT_getErrorName(result));
+            dictionary.clear();
+            return false;
+        }
+        dictionary.resize(result);
+        return true;
+    }
+#else
+    std::shared_ptr<Compressor> zstd_compressor(int, const std::string&) {
+        return nullptr;
+    }
+
+    bool zstd_train_dictionary(const std::vector<std::string>&, size_t, std::string& dictionary) {
+        dictionary.clear();
+        return false;
+    }
+#endif
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+namespace Redis {
+
+    /**
+    * Transforms values on their way to and from redis. Set with ConnectionParam::codec.
+    * Codec is shared between connections and must be thread safe.
+    * Values of GET/SET/GETSET/MGET/MSET and HGET/HSET/HSETNX/HGETALL/HSCAN are transformed. Keys and hash fields are sent as is.
+    * Scanners return raw values, they can be decoded with codec explicitly.
+    * Commands working on parts of value (APPEND, GETRANGE, SETRANGE, STRLEN) see encoded value.
+    * */
+    class ValueCodec {
+    public:
+        virtual ~ValueCodec() {}
+
+        /* Returns false if value should be sent as is */
+        virtual bool encode(const char* data, size_t size, std::string& encoded) const = 0;
+
+        /* Values which were sent as is must be returned unchanged. Returns false on corrupted data */
+        virtual bool decode(const char* data, size_t size, std::string& decoded) const = 0;
+    };
+
+    /* Compression algorithm for CompressionCodec. Must be thread safe */
+    class Compressor {
+    public:
+        virtual ~Compressor() {}
+
+        /* Stored in header of each compressed value. 0 is reserved for values stored as is */
+        virtual unsigned char get_id() const = 0;
+
+        /* Appends compressed data to out. Returns false if data can't be compressed */
+        virtual bool compress(const char* data, size_t size, std::string& out) const = 0;
+
+        /* Appends original data to out. original_size is taken from value header */
+        virtual bool decompress(const char* data, size_t size, size_t original_size, std::string& out) const = 0;
+    };
+
+    /**
+    * Compresses values which are at least threshold bytes long.
+    * Compressed value starts with header: magic (0xC0 'R' 'Z'), compressor id and 4 byte little endian original size.
+    * 0xC0 never appears in UTF-8, so text and JSON values never collide with header.
+    * Values are stored as is if they are short or compression doesn't make them smaller,
+    * so old uncompressed data and data written without codec can be read with codec enabled.
+    * Values that happen to start with magic are stored with raw header to keep them readable.
+    * Values longer than max_original_size are never compressed, and headers claiming more are rejected on decode,
+    * so corrupted header can't make decode allocate gigabytes. Default is the string size limit of redis.
+    *
+    *  F.e. :
+    *  Redis::ConnectionParam param;
+    *  param.codec = std::make_shared<Redis::CompressionCodec>(Redis::zstd_compressor(3));
+    * */
+    class CompressionCodec : public ValueCodec {
+    public:
+        static constexpr size_t default_threshold = 1024;
+        static constexpr size_t default_max_original_size = 512 * 1024 * 1024;
+        static constexpr size_t header_size = 8;
+        static constexpr unsigned char raw_id = 0;
+
+        CompressionCodec(std::shared_ptr<const Compressor> compressor, size_t threshold = default_threshold,
+                size_t max_original_size = default_max_original_size);
+
+        /* Allows reading values written with other compressor, f.e. while migrating from lz4 to zstd */
+        void add_decompressor(std::shared_ptr<const Compressor> decompressor);
+
+        bool encode(const char* data, size_t size, std::string& encoded) const override;
+        bool decode(const char* data, size_t size, std::string& decoded) const override;
+
+        static bool has_header(const char* data, size_t size);
+
+    private:
+        std::shared_ptr<const Compressor> compressor;
+        std::vector<std::shared_ptr<const Compressor>> decompressors;
+        size_t threshold;
+        size_t max_original_size;
+    };
+
+    /* Built in compressors. Return nullptr if library was built without corresponding algorithm */
+    std::shared_ptr<Compressor> lz4_compressor();
+
+    /* dictionary - trained with zstd_train_dictionary. The same dictionary is required to read values back */
+    std::shared_ptr<Compressor> zstd_compressor(int level = 3, const std::string& dictionary = std::string());
+
+    /* Trains zstd dictionary on typical values. Dictionary pays off for values of few KB and smaller */
+    bool zstd_train_dictionary(const std::vector<std::string>& samples, size_t dictionary_size, std::string& dictionary);
+}
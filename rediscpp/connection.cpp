@@ -1,32 +1,23 @@
 #include <cstring>
+#include <cctype>
+#include <algorithm>
 #include "connection.hpp"
 #include "exception.hpp"
 #include <iostream>
 #include <vector>
 #include <map>
 #include <atomic>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include "macro.hpp"
 #include "log.hpp"
+#include "deleters.hpp"
+#include "deadline.hpp"
 
 
 
 namespace Redis {
-    struct ReplyDeleter {
-        void operator()(redisReply* r) {
-            if(r != nullptr) {
-                freeReplyObject(r);
-            }
-        }
-    };
-
-    struct ContextDeleter {
-        void operator()(redisContext* c) {
-            if (c != nullptr) {
-                redisFree(c);
-            }
-        }
-    };
-
     static constexpr size_t max_connection_count = 1000;
     class Connection::Implementation {
         friend class Connection;
@@ -41,9 +32,20 @@ namespace Redis {
         std::unique_ptr<redisContext, ContextDeleter> context;
         std::hash<std::string> hash_fn;
         unsigned int redis_version;
+        std::shared_ptr<const Capabilities> capabilities;
+        //Timeout currently set on socket
+        unsigned int socket_timeout_ms;
+        //Server side timeout of running blocking command: -1 for regular commands, 0 blocks forever
+        long long blocking_timeout_ms;
         Error err;
         Error prev_err;
         Connection::Id id;
+        //Number of appended commands which replies were not read yet
+        size_t pending_replies;
+        //Admission control which slot is held by running request or pipeline
+        std::shared_ptr<AdmissionControl> admitted_by;
+        //Value decoded by codec for typed getters
+        Key decode_buffer;
         static std::atomic_long id_counter;
         static std::atomic_ulong connection_count;
 
@@ -56,9 +58,15 @@ namespace Redis {
                 context(),
                 hash_fn(),
                 redis_version(),
+                capabilities(),
+                socket_timeout_ms(0),
+                blocking_timeout_ms(-1),
                 err(),
                 prev_err(),
-                id()
+                id(),
+                pending_replies(0),
+                admitted_by(),
+                decode_buffer()
         {
             id = ++id_counter;
             unsigned long con_cnt = connection_count.load(std::memory_order_relaxed);
@@ -70,6 +78,7 @@ namespace Redis {
             rediscpp_debug(LogLevel::NOTICE, "Connection created. Est. current number of connections: " << con_cnt);
         }
         ~Implementation() {
+            release_admission();
             connection_count--;
             rediscpp_debug(LogLevel::NOTICE, "Connection destroyed. Est. current number of connections: " << connection_count.load(std::memory_order_relaxed));
         }
@@ -129,6 +138,12 @@ namespace Redis {
                     return "Reply returned error." + (context->err ? std::string("Context err is: ") + context->errstr : std::string()) + " Reply error is: " + (reply == nullptr ? "Reply is null. Please replort a bug." : std::string(reply->str, reply->len));
                 case Error::TOO_LONG_COMMAND :
                     return "Command was to long to perform. " + (context->err ? std::string("Context err is: ") + context->errstr : std::string()) + " Reply error is: " + (reply == nullptr ? "Reply is null. Please replort a bug." : std::string(reply->str, reply->len));
+                case Error::CODEC_ERROR:
+                    return "Value could not be decoded by codec. Value is corrupted or was written with unknown compressor";
+                case Error::DEADLINE_EXCEEDED:
+                    return "Deadline exceeded";
+                case Error::ADMISSION_REJECTED:
+                    return "Rejected by admission control: endpoint is over its rate or in-flight limit";
                 default:
                     redis_assert_unreachable();
                     return "";
@@ -137,6 +152,41 @@ namespace Redis {
 
         bool has_prefix() { return !connection_param.prefix.empty(); }
 
+        /* Points value to its encoded representation in buffer if codec transforms it */
+        void encode_value(const char*& value, size_t& value_size, std::string& buffer) {
+            if(connection_param.codec != nullptr && connection_param.codec->encode(value, value_size, buffer)) {
+                value = buffer.c_str();
+                value_size = buffer.size();
+            }
+        }
+
+        bool decode_value(const char* data, size_t size, std::string& result) {
+            if(connection_param.codec == nullptr) {
+                result.assign(data, size);
+                return true;
+            }
+            if(!connection_param.codec->decode(data, size, result)) {
+                set_error(Error::CODEC_ERROR);
+                return false;
+            }
+            return true;
+        }
+
+        /* Same as decode_value, but points to reply without copy if there is no codec */
+        bool decode_value(const char* data, size_t size, const char*& result, size_t& result_size) {
+            if(connection_param.codec == nullptr) {
+                result = data;
+                result_size = size;
+                return true;
+            }
+            if(!decode_value(data, size, decode_buffer)) {
+                return false;
+            }
+            result = decode_buffer.data();
+            result_size = decode_buffer.size();
+            return true;
+        }
+
         unsigned int get_version() { return redis_version; }
 
         Id get_id() { return id; }
@@ -161,10 +211,16 @@ namespace Redis {
 
         bool reconnect() {
             rediscpp_debug(LL::NOTICE, "Reconnecting");
+            pending_replies = 0;
             struct timeval timeout;
             timeout.tv_sec = static_cast<time_t>(connection_param.connect_timeout_ms / 1000);
             timeout.tv_usec = static_cast<suseconds_t>((connection_param.connect_timeout_ms % 1000) * 1000);
-            context.reset(redisConnectWithTimeout(connection_param.host.c_str(), connection_param.port, timeout));
+            if(connection_param.is_unix_socket()) {
+                context.reset(redisConnectUnixWithTimeout(connection_param.get_unix_socket_path().c_str(), timeout));
+            }
+            else {
+                context.reset(redisConnectWithTimeout(connection_param.host.c_str(), connection_param.port, timeout));
+            }
             if (context == nullptr) {
                 set_error(Error::CONTEXT_IS_NULL);
                 available = false;
@@ -176,6 +232,8 @@ namespace Redis {
                 available = (err == Error::NONE);
                 if(available) {
                     redisSetTimeout(context.get(), timeout);
+                    socket_timeout_ms = connection_param.operation_timeout_ms;
+                    apply_socket_options();
                 }
             }
             if(!available) {
@@ -194,9 +252,555 @@ namespace Redis {
                     rediscpp_debug(LL::WARNING, "Could not select DB: " << get_error());
                 }
             }
+            if(available) {
+                load_capabilities(capabilities != nullptr);
+            }
             return available;
         }
 
+        /* Pooled connection is leased with other client side settings. Socket and server side state are kept.
+        *  New operation timeout is set on socket by the next command
+        * */
+        void reconfigure(const ConnectionParam& lease_param) {
+            release_admission();
+            connection_param.prefix = lease_param.prefix;
+            connection_param.connect_timeout_ms = lease_param.connect_timeout_ms;
+            connection_param.operation_timeout_ms = lease_param.operation_timeout_ms;
+            connection_param.reconnect_on_failure = lease_param.reconnect_on_failure;
+            connection_param.throw_on_error = lease_param.throw_on_error;
+            connection_param.split_long_commands = lease_param.split_long_commands;
+            connection_param.codec = lease_param.codec;
+            connection_param.admission = lease_param.admission;
+        }
+
+        /* Takes slot of admission control for request. Commands of already admitted request (rest of pipeline, SELECT on reconnect) pass as is.
+        *  admitted is set if the slot was taken by this call and has to be released by caller
+        * */
+        bool admit(bool& admitted) {
+            admitted = false;
+            if(connection_param.admission == nullptr || admitted_by != nullptr) {
+                return true;
+            }
+            if(!connection_param.admission->acquire()) {
+                set_error(Error::ADMISSION_REJECTED);
+                return false;
+            }
+            admitted_by = connection_param.admission;
+            admitted = true;
+            return true;
+        }
+
+        void release_admission() {
+            if(admitted_by != nullptr) {
+                admitted_by->release();
+                admitted_by.reset();
+            }
+        }
+
+        bool is_deadline_expired() {
+            const Deadline* deadline = Deadline::current();
+            return deadline != nullptr && deadline->is_expired();
+        }
+
+        /* Socket timeout of the next command: operation timeout, extended for blocking command and cut by deadline of the thread */
+        void apply_call_timeout() {
+            unsigned int timeout_ms = connection_param.operation_timeout_ms;
+            if(blocking_timeout_ms == 0) {
+                timeout_ms = 0;
+            }
+            else if(blocking_timeout_ms > 0) {
+                timeout_ms += static_cast<unsigned int>(blocking_timeout_ms);
+            }
+            const Deadline* deadline = Deadline::current();
+            if(deadline != nullptr) {
+                unsigned int remaining_ms = std::max(deadline->get_remaining_ms(), 1u);
+                if(timeout_ms == 0 || remaining_ms < timeout_ms) {
+                    timeout_ms = remaining_ms;
+                }
+            }
+            if(timeout_ms == socket_timeout_ms || context == nullptr) {
+                return;
+            }
+            struct timeval timeout;
+            timeout.tv_sec = static_cast<time_t>(timeout_ms / 1000);
+            timeout.tv_usec = static_cast<suseconds_t>((timeout_ms % 1000) * 1000);
+            if(redisSetTimeout(context.get(), timeout) == REDIS_OK) {
+                socket_timeout_ms = timeout_ms;
+            }
+        }
+
+        /* Server side timeout of blocking command is capped by deadline of the thread, so the server gives up before the client does */
+        long long cap_blocking_timeout_ms(long long timeout_ms) {
+            const Deadline* deadline = Deadline::current();
+            if(deadline != nullptr) {
+                long long remaining_ms = deadline->get_remaining_ms();
+                //Part of budget is left for the reply to come back
+                long long budget_ms = std::max(remaining_ms - remaining_ms / 10, 1LL);
+                if(timeout_ms == 0 || budget_ms < timeout_ms) {
+                    timeout_ms = budget_ms;
+                }
+            }
+            return timeout_ms;
+        }
+
+        /* Runs command which may block on server for timeout_ms, 0 means without limit. Socket timeout is extended for the call */
+        bool run_blocked_command(std::vector<const char*>& commands, std::vector<size_t>& sizes, long long timeout_ms) {
+            struct BlockingGuard {
+                long long& blocking_timeout_ms;
+                ~BlockingGuard() { blocking_timeout_ms = -1; }
+            } guard = {blocking_timeout_ms};
+            blocking_timeout_ms = timeout_ms;
+            return run_command(commands, sizes);
+        }
+
+        /* Blocking commands with timeout in seconds as the last argument */
+        bool run_blocking_command(std::vector<const char*>& commands, std::vector<size_t>& sizes, long long timeout_s) {
+            if(is_deadline_expired()) {
+                set_error(Error::DEADLINE_EXCEEDED);
+                return false;
+            }
+            if(!ensure_connected()) {
+                return false;
+            }
+            long long timeout_ms = cap_blocking_timeout_ms(timeout_s * 1000);
+            //Fractional timeouts are supported since 6.0
+            std::string timeout_str;
+            if(redis_version >= 60000) {
+                std::string fraction = std::to_string(timeout_ms % 1000);
+                timeout_str = std::to_string(timeout_ms / 1000) + "." + std::string(3 - fraction.size(), '0') + fraction;
+            }
+            else {
+                timeout_str = std::to_string((timeout_ms + 999) / 1000);
+            }
+            commands.push_back(timeout_str.c_str());
+            sizes.push_back(timeout_str.size());
+            return run_blocked_command(commands, sizes, timeout_ms);
+        }
+
+        bool blocking_pop(const char* command, size_t command_size, const StringKeyHolder& keys, long long timeout, Key& chosen_key, Key& value) {
+            std::vector<const char*> commands = {command};
+            std::vector<size_t> sizes = {command_size};
+            KeyVec prefixed_keys;
+            append_c_strings_with_prefixes_and_sizes(keys, prefixed_keys, commands, sizes);
+            if(!run_blocking_command(commands, sizes, timeout)) {
+                return false;
+            }
+            if(reply->type == REDIS_REPLY_NIL) {
+                chosen_key.clear();
+                value.clear();
+                return true;
+            }
+            redis_assert(reply->type == REDIS_REPLY_ARRAY && reply->elements == 2);
+            const size_t prefix_size = connection_param.prefix.size();
+            chosen_key.assign(reply->element[0]->str + prefix_size, reply->element[0]->len - prefix_size);
+            value.assign(reply->element[1]->str, reply->element[1]->len);
+            return true;
+        }
+
+        static const char* get_direction_str(ListDirection direction, size_t& size) {
+            size = direction == ListDirection::LEFT ? 4 : 5;
+            return direction == ListDirection::LEFT ? "LEFT" : "RIGHT";
+        }
+
+        /* LPUSH/RPUSH. More than max_elements_per_push values are sent as several pipelined commands, list_length is the length after the last one */
+        bool push(const char* command, size_t command_size, const Key& key, const StringKeyHolder& values, long long& list_length) {
+            const Key prefixed_key = add_prefix_to_key(key);
+            const size_t parts = values.size() == 0 ? 1 : (values.size() + Connection::max_elements_per_push - 1) / Connection::max_elements_per_push;
+            std::vector<const char*> commands;
+            std::vector<size_t> sizes;
+            for(size_t part = 0; part < parts; part++) {
+                commands.assign({command, prefixed_key.c_str()});
+                sizes.assign({command_size, prefixed_key.size()});
+                const size_t end = std::min(values.size(), (part + 1) * Connection::max_elements_per_push);
+                for(size_t i = part * Connection::max_elements_per_push; i < end; i++) {
+                    commands.push_back(values[i].c_str());
+                    sizes.push_back(values[i].size());
+                }
+                if(parts == 1) {
+                    if(run_command(commands, sizes)) {
+                        list_length = reply->integer;
+                        return true;
+                    }
+                    return false;
+                }
+                if(!append_command(commands, sizes)) {
+                    if(part != 0) {
+                        abandon();
+                    }
+                    return false;
+                }
+            }
+            if(!flush_commands()) {
+                return false;
+            }
+            bool ok = true;
+            for(size_t part = 0; part < parts; part++) {
+                if(!fetch_reply()) {
+                    if(err != Error::REPLY_ERR) {
+                        return false;
+                    }
+                    ok = false;
+                    continue;
+                }
+                list_length = reply->integer;
+            }
+            return ok;
+        }
+
+        /* LPOP/RPOP of one value, empty value if list is empty */
+        bool pop(const char* command, size_t command_size, const Key& key, Key& value) {
+            const Key prefixed_key = add_prefix_to_key(key);
+            std::vector<const char*> commands = {command, prefixed_key.c_str()};
+            std::vector<size_t> sizes = {command_size, prefixed_key.size()};
+            if(!run_command(commands, sizes)) {
+                return false;
+            }
+            if(reply->type == REDIS_REPLY_NIL) {
+                value.clear();
+                return true;
+            }
+            redis_assert(reply->type == REDIS_REPLY_STRING);
+            value.assign(reply->str, reply->len);
+            return true;
+        }
+
+        /* LPOP/RPOP with count. Servers before 6.2 pop in a script, before 2.6 get up to max_elements_per_push single pops in one pipeline */
+        bool pop(const char* command, size_t command_size, const Key& key, size_t count, KeyVec& values) {
+            values.clear();
+            if(count == 0) {
+                return true;
+            }
+            const Key prefixed_key = add_prefix_to_key(key);
+            const std::string count_str = std::to_string(count);
+            std::vector<const char*> commands = {command, prefixed_key.c_str(), count_str.c_str()};
+            std::vector<size_t> sizes = {command_size, prefixed_key.size(), count_str.size()};
+            //Version is known only after connecting
+            if(!ensure_connected()) {
+                return false;
+            }
+            if(redis_version >= 20600) {
+                if(redis_version < 60200) {
+                    //Pops until the list is empty, so short list costs one command as well
+                    static const char script[] =
+                        "local values = {} "
+                        "for i = 1, tonumber(ARGV[2]) do "
+                            "local value = redis.call(ARGV[1], KEYS[1]) "
+                            "if not value then break end "
+                            "values[i] = value "
+                        "end "
+                        "return values";
+                    commands = {"EVAL", script, "1", prefixed_key.c_str(), command, count_str.c_str()};
+                    sizes = {4, sizeof(script) - 1, 1, prefixed_key.size(), command_size, count_str.size()};
+                }
+                if(!run_command(commands, sizes)) {
+                    return false;
+                }
+                if(reply->type == REDIS_REPLY_NIL) {
+                    return true;
+                }
+                redis_assert(reply->type == REDIS_REPLY_ARRAY);
+                values.reserve(reply->elements);
+                for(size_t i = 0; i < reply->elements; i++) {
+                    values.push_back(Key(reply->element[i]->str, reply->element[i]->len));
+                }
+                return true;
+            }
+            commands.pop_back();
+            sizes.pop_back();
+            const size_t pops = std::min(count, Connection::max_elements_per_push);
+            for(size_t i = 0; i < pops; i++) {
+                if(!append_command(commands, sizes)) {
+                    if(i != 0) {
+                        abandon();
+                    }
+                    return false;
+                }
+            }
+            if(!flush_commands()) {
+                return false;
+            }
+            //Replies of the rest are read even after error reply, so connection stays usable
+            bool old_throw_on_error = connection_param.throw_on_error;
+            connection_param.throw_on_error = false;
+            Error first_err = Error::NONE;
+            Reply first_err_reply;
+            for(size_t i = 0; i < pops; i++) {
+                if(!fetch_reply()) {
+                    if(first_err == Error::NONE) {
+                        first_err = err;
+                        first_err_reply = std::move(reply);
+                    }
+                    if(err != Error::REPLY_ERR) {
+                        break;
+                    }
+                    continue;
+                }
+                if(reply->type == REDIS_REPLY_STRING) {
+                    values.push_back(Key(reply->str, reply->len));
+                }
+            }
+            connection_param.throw_on_error = old_throw_on_error;
+            if(first_err != Error::NONE) {
+                reply = std::move(first_err_reply);
+                set_error(first_err);
+                return false;
+            }
+            return true;
+        }
+
+        bool read_optional_string(Key& result) {
+            if(reply->type == REDIS_REPLY_NIL) {
+                result.clear();
+                return true;
+            }
+            redis_assert(reply->type == REDIS_REPLY_STRING);
+            result.assign(reply->str, reply->len);
+            return true;
+        }
+
+        /* Entries array of XRANGE, XREADGROUP and XAUTOCLAIM. Ids missing from stream come as nil (XAUTOCLAIM of 6.2) and are skipped */
+        static void parse_stream_entries(const redisReply* array, std::vector<StreamEntry>& entries) {
+            redis_assert(array->type == REDIS_REPLY_ARRAY);
+            entries.reserve(entries.size() + array->elements);
+            for(size_t i = 0; i < array->elements; i++) {
+                const redisReply* entry = array->element[i];
+                if(entry->type != REDIS_REPLY_ARRAY) {
+                    continue;
+                }
+                redis_assert(entry->elements == 2 && entry->element[0]->type == REDIS_REPLY_STRING);
+                entries.push_back(StreamEntry());
+                StreamEntry& parsed = entries.back();
+                parsed.id = StringRef(entry->element[0]->str, entry->element[0]->len);
+                const redisReply* fields = entry->element[1];
+                if(fields->type != REDIS_REPLY_ARRAY) {
+                    continue;
+                }
+                redis_assert(fields->elements % 2 == 0);
+                parsed.fields.reserve(fields->elements / 2);
+                for(size_t j = 0; j < fields->elements; j += 2) {
+                    parsed.fields.push_back(std::make_pair(StringRef(fields->element[j]->str, fields->element[j]->len),
+                            StringRef(fields->element[j + 1]->str, fields->element[j + 1]->len)));
+                }
+            }
+        }
+
+        static void make_xadd(const Key& prefixed_key, const StreamFields& fields, const std::string& maxlen, bool approximate,
+                std::vector<const char*>& commands, std::vector<size_t>& sizes) {
+            commands.assign({"XADD", prefixed_key.c_str()});
+            sizes.assign({4, prefixed_key.size()});
+            if(!maxlen.empty()) {
+                commands.push_back("MAXLEN");
+                sizes.push_back(6);
+                if(approximate) {
+                    commands.push_back("~");
+                    sizes.push_back(1);
+                }
+                commands.push_back(maxlen.c_str());
+                sizes.push_back(maxlen.size());
+            }
+            commands.push_back("*");
+            sizes.push_back(1);
+            for(size_t i = 0; i < fields.size(); i++) {
+                commands.push_back(fields[i].first.c_str());
+                sizes.push_back(fields[i].first.size());
+                commands.push_back(fields[i].second.c_str());
+                sizes.push_back(fields[i].second.size());
+            }
+        }
+
+        bool xreadgroup(const Key& group, const Key& consumer, const Key& key, const Key& start_id, size_t count, long long block_ms, bool noack, std::vector<StreamEntry>& entries) {
+            entries.clear();
+            const Key prefixed_key = add_prefix_to_key(key);
+            const std::string count_str = std::to_string(count);
+            std::vector<const char*> commands = {"XREADGROUP", "GROUP", group.c_str(), consumer.c_str(), "COUNT", count_str.c_str()};
+            std::vector<size_t> sizes = {10, 5, group.size(), consumer.size(), 5, count_str.size()};
+            long long timeout_ms = -1;
+            std::string block_str;
+            if(block_ms >= 0) {
+                if(is_deadline_expired()) {
+                    set_error(Error::DEADLINE_EXCEEDED);
+                    return false;
+                }
+                timeout_ms = cap_blocking_timeout_ms(block_ms);
+                block_str = std::to_string(timeout_ms);
+                commands.push_back("BLOCK");
+                sizes.push_back(5);
+                commands.push_back(block_str.c_str());
+                sizes.push_back(block_str.size());
+            }
+            if(noack) {
+                commands.push_back("NOACK");
+                sizes.push_back(5);
+            }
+            commands.insert(commands.end(), {"STREAMS", prefixed_key.c_str(), start_id.c_str()});
+            sizes.insert(sizes.end(), {7, prefixed_key.size(), start_id.size()});
+            if(!(timeout_ms >= 0 ? run_blocked_command(commands, sizes, timeout_ms) : run_command(commands, sizes))) {
+                return false;
+            }
+            if(reply->type == REDIS_REPLY_NIL) {
+                return true;
+            }
+            redis_assert(reply->type == REDIS_REPLY_ARRAY && reply->elements == 1);
+            const redisReply* stream = reply->element[0];
+            redis_assert(stream->type == REDIS_REPLY_ARRAY && stream->elements == 2);
+            parse_stream_entries(stream->element[1], entries);
+            return true;
+        }
+
+        static unsigned int parse_version(const char* str, size_t len) {
+            unsigned int parts[3] = {0, 0, 0};
+            size_t part = 0;
+            for(size_t i = 0; i < len && part < 3; i++) {
+                if(str[i] == '.') {
+                    part++;
+                }
+                else if(str[i] >= '0' && str[i] <= '9') {
+                    parts[part] = parts[part] * 10 + static_cast<unsigned int>(str[i] - '0');
+                }
+                else {
+                    break;
+                }
+            }
+            return parts[0] * 10000 + parts[1] * 100 + parts[2];
+        }
+
+        /* The first connection to endpoint asks server with HELLO (INFO for servers older than 6.0), others take cached result.
+        *  Reconnect after failure asks again, as server might have been restarted with other version
+        * */
+        void load_capabilities(bool refresh) {
+            std::shared_ptr<const Capabilities> cached = CapabilityCache::get(connection_param);
+            if(!refresh && cached != nullptr) {
+                capabilities = cached;
+                redis_version = capabilities->version;
+                return;
+            }
+            //Commands are run internally, so neither reconnect nor throw
+            bool old_reconnect_on_failure = connection_param.reconnect_on_failure;
+            bool old_throw_on_error = connection_param.throw_on_error;
+            connection_param.reconnect_on_failure = false;
+            connection_param.throw_on_error = false;
+            std::shared_ptr<Capabilities> fetched = std::make_shared<Capabilities>();
+            bool ok = false;
+            if(run_command("HELLO 2")) {
+                fetched->resp3 = true;
+                for(size_t i = 0; i + 1 < reply->elements; i += 2) {
+                    const redisReply* name = reply->element[i];
+                    const redisReply* value = reply->element[i + 1];
+                    if(name->type == REDIS_REPLY_STRING && std::string(name->str, name->len) == "version" && value->type == REDIS_REPLY_STRING) {
+                        fetched->version = parse_version(value->str, value->len);
+                        ok = true;
+                    }
+                }
+            }
+            else if(err == Error::REPLY_ERR && fetch_version()) {
+                fetched->version = redis_version;
+                ok = true;
+            }
+            connection_param.reconnect_on_failure = old_reconnect_on_failure;
+            connection_param.throw_on_error = old_throw_on_error;
+            if(!ok) {
+                rediscpp_debug(LL::WARNING, "Could not fetch server capabilities: " << get_error());
+                return;
+            }
+            if(cached != nullptr && cached->version == fetched->version) {
+                fetched->commands_loaded = cached->commands_loaded;
+                fetched->commands = cached->commands;
+            }
+            redis_version = fetched->version;
+            capabilities = fetched;
+            CapabilityCache::put(connection_param, capabilities);
+        }
+
+        bool load_commands() {
+            if(!run_command("COMMAND")) {
+                return false;
+            }
+            redis_assert(reply->type == REDIS_REPLY_ARRAY);
+            std::shared_ptr<Capabilities> loaded = std::make_shared<Capabilities>(*capabilities);
+            for(size_t i = 0; i < reply->elements; i++) {
+                const redisReply* command = reply->element[i];
+                if(command->type == REDIS_REPLY_ARRAY && command->elements != 0 && command->element[0]->type == REDIS_REPLY_STRING) {
+                    std::string name(command->element[0]->str, command->element[0]->len);
+                    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+                    loaded->commands.insert(std::move(name));
+                }
+            }
+            loaded->commands_loaded = true;
+            capabilities = loaded;
+            CapabilityCache::put(connection_param, capabilities);
+            return true;
+        }
+
+        /* Failures are not fatal, connection is still usable with OS defaults */
+        void apply_socket_options() {
+            int fd = context->fd;
+            if(!connection_param.is_unix_socket()) {
+                int nodelay = connection_param.tcp_nodelay ? 1 : 0;
+                if(setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay)) != 0) {
+                    rediscpp_debug(LL::WARNING, "Could not set TCP_NODELAY: " << strerror(errno));
+                }
+                if(connection_param.tcp_keepalive && redisEnableKeepAlive(context.get()) != REDIS_OK) {
+                    rediscpp_debug(LL::WARNING, "Could not enable keepalive: " << context->errstr);
+                }
+            }
+            if(connection_param.send_buffer_size != 0) {
+                int size = static_cast<int>(connection_param.send_buffer_size);
+                if(setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) != 0) {
+                    rediscpp_debug(LL::WARNING, "Could not set SO_SNDBUF: " << strerror(errno));
+                }
+            }
+            if(connection_param.recv_buffer_size != 0) {
+                int size = static_cast<int>(connection_param.recv_buffer_size);
+                if(setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) != 0) {
+                    rediscpp_debug(LL::WARNING, "Could not set SO_RCVBUF: " << strerror(errno));
+                }
+            }
+            if(connection_param.busy_poll_us != 0) {
+#ifdef SO_BUSY_POLL
+                int busy_poll = static_cast<int>(connection_param.busy_poll_us);
+                if(setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(busy_poll)) != 0) {
+                    rediscpp_debug(LL::WARNING, "Could not set SO_BUSY_POLL: " << strerror(errno));
+                }
+#else
+                rediscpp_debug(LL::WARNING, "SO_BUSY_POLL is not supported on this platform");
+#endif
+            }
+            if(Log::get_log_level() >= LL::NOTICE) {
+                SocketInfo info;
+                get_socket_info(info);
+                rediscpp_debug(LL::NOTICE, "Socket options: nodelay=" << info.tcp_nodelay << " keepalive=" << info.tcp_keepalive
+                        << " sndbuf=" << info.send_buffer_size << " rcvbuf=" << info.recv_buffer_size << " busy_poll=" << info.busy_poll_us);
+            }
+        }
+
+        bool get_socket_info(SocketInfo& info) {
+            if(context == nullptr || !available) {
+                return false;
+            }
+            int fd = context->fd;
+            int val = 0;
+            socklen_t len = sizeof(val);
+            info.is_unix_socket = connection_param.is_unix_socket();
+            info.tcp_nodelay = false;
+            info.tcp_keepalive = false;
+            if(!info.is_unix_socket) {
+                len = sizeof(val);
+                info.tcp_nodelay = getsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &val, &len) == 0 && val != 0;
+                len = sizeof(val);
+                info.tcp_keepalive = getsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &val, &len) == 0 && val != 0;
+            }
+            len = sizeof(val);
+            info.send_buffer_size = getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &val, &len) == 0 ? val : -1;
+            len = sizeof(val);
+            info.recv_buffer_size = getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &val, &len) == 0 ? val : -1;
+            info.busy_poll_us = 0;
+#ifdef SO_BUSY_POLL
+            len = sizeof(val);
+            info.busy_poll_us = getsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &val, &len) == 0 ? val : -1;
+#endif
+            return true;
+        }
+
         Key add_prefix_to_key(const Key& key) {
             return has_prefix() ? (connection_param.prefix + key) : key;
         }
@@ -269,21 +873,156 @@ namespace Redis {
         }
 
 
-        bool run_command(std::function<void*(redisContext*)> callback) {
+        bool ensure_connected() {
             if (!connected) {
                 connected = true;
                 if (reconnect()) {
                     rediscpp_debug(LogLevel::NOTICE, __FUNCTION__ << ": Reconnect done");
-                    fetch_version();
                 }
                 else {
                     rediscpp_debug(LogLevel::NOTICE, __FUNCTION__ << ": Reconnect failed");
                 }
             }
-            if (!check_available()) {
+            return check_available();
+        }
+
+        /* Connection was left with unread pipelined replies (f.e. scanner was destroyed in the middle). Skip them to keep replies in sync with commands */
+        void discard_pending_replies() {
+            rediscpp_debug(LL::NOTICE, "Discarding " << pending_replies << " pending replies");
+            while(pending_replies != 0) {
+                void* raw_reply = nullptr;
+                pending_replies--;
+                if(redisGetReply(context.get(), &raw_reply) != REDIS_OK) {
+                    pending_replies = 0;
+                    available = false;
+                    release_admission();
+                    return;
+                }
+                freeReplyObject(raw_reply);
+            }
+            release_admission();
+        }
+
+        /* Drops pending replies, connection is reestablished on next command */
+        void abandon() {
+            rediscpp_debug(LL::NOTICE, "Abandoning connection with " << pending_replies << " pending replies");
+            //Context is kept for error reporting. It's replaced on reconnect
+            available = false;
+            pending_replies = 0;
+            release_admission();
+        }
+
+        /* Buffers command without sending it. Reply should be read with fetch_reply() */
+        bool append_command(const std::vector<const char*>& commands, const std::vector<size_t>& sizes) {
+            if(is_deadline_expired()) {
+                set_error(Error::DEADLINE_EXCEEDED);
+                return false;
+            }
+            bool admitted = false;
+            if(pending_replies == 0 && !admit(admitted)) {
+                return false;
+            }
+            if(pending_replies == 0 && !ensure_connected()) {
+                if(admitted) {
+                    release_admission();
+                }
+                return false;
+            }
+            apply_call_timeout();
+            if(!is_available()) {
+                set_error(Error::CONTEXT_IS_NULL);
+                return false;
+            }
+            redis_assert(!commands.empty());
+            if(redisAppendCommandArgv(context.get(), static_cast<int>(commands.size()), const_cast<const char**>(commands.data()), sizes.data()) != REDIS_OK) {
+                available = false;
+                pending_replies = 0;
+                release_admission();
+                set_error_from_context();
+                return false;
+            }
+            pending_replies++;
+            return true;
+        }
+
+        /* Sends all buffered commands without waiting for replies */
+        bool flush_commands() {
+            if(!is_available()) {
+                return false;
+            }
+            int done = 0;
+            do {
+                if(redisBufferWrite(context.get(), &done) != REDIS_OK) {
+                    available = false;
+                    pending_replies = 0;
+                    release_admission();
+                    set_error_from_context();
+                    return false;
+                }
+            } while(!done);
+            return true;
+        }
+
+        /* Reads reply for the oldest appended command into reply */
+        bool fetch_reply() {
+            //Pending replies are dropped on connection failure
+            if(!is_available() || pending_replies == 0) {
+                return false;
+            }
+            void* raw_reply = nullptr;
+            pending_replies--;
+            int ret = redisGetReply(context.get(), &raw_reply);
+            reply.reset(static_cast<redisReply*>(raw_reply));
+            if(pending_replies == 0) {
+                release_admission();
+            }
+            if(ret != REDIS_OK) {
+                //Connection is out of sync, next command will reconnect
+                available = false;
+                pending_replies = 0;
+                release_admission();
+                set_error_from_context();
+                return false;
+            }
+            if(reply.get() == nullptr) {
+                set_error(Error::REPLY_IS_NULL);
+                return false;
+            }
+            if(reply->type == REDIS_REPLY_ERROR) {
+                set_error(Error::REPLY_ERR);
+                return false;
+            }
+            set_error(Error::NONE);
+            return true;
+        }
+
+        bool run_command(std::function<void*(redisContext*)> callback) {
+            //Request which is already late is not worth a round trip
+            if (is_deadline_expired()) {
+                set_error(Error::DEADLINE_EXCEEDED);
+                return false;
+            }
+            if (pending_replies != 0) {
+                discard_pending_replies();
+            }
+            bool admitted = false;
+            if (!admit(admitted)) {
+                return false;
+            }
+            struct AdmissionGuard {
+                Implementation& impl;
+                bool admitted;
+                ~AdmissionGuard() {
+                    if(admitted) {
+                        impl.release_admission();
+                    }
+                }
+            } guard = {*this, admitted};
+            if (!ensure_connected()) {
                 return false;
             }
             redis_assert(context.get() != nullptr);
+            apply_call_timeout();
             reply.reset(static_cast<redisReply*>(callback(context.get())));
             if(reply.get() == nullptr) {
                 rediscpp_debug(LL::WARNING, "Got NULL reply");
@@ -291,6 +1030,12 @@ namespace Redis {
             else if(context->err) {
                 rediscpp_debug(LL::WARNING, "Error on context: " << context->err);
             }
+            if((reply.get() == nullptr || context->err) && is_deadline_expired()) {
+                //Reply may still come, so connection is out of sync. No retry, as there is no time left
+                available = false;
+                set_error(Error::DEADLINE_EXCEEDED);
+                return false;
+            }
             if((reply.get() == nullptr || context->err) && connection_param.reconnect_on_failure) {
                 rediscpp_debug(LL::NOTICE, "Reconnecting for command");
                 reconnect();
@@ -359,6 +1104,36 @@ namespace Redis {
             va_end(ap);
             return ret;
         }*/
+        /* One step of HSCAN/SSCAN/ZSCAN. On success reply->element[1] contains returned elements */
+        bool collection_scan(const char* command, const Key& key, unsigned long long& cursor, const Key& pattern, long count) {
+            const Key& prefixed_key = add_prefix_to_key(key);
+            const std::string cursor_str = std::to_string(cursor);
+            const std::string count_str = std::to_string(count);
+            std::vector<const char*> commands = {command, prefixed_key.c_str(), cursor_str.c_str()};
+            std::vector<size_t> sizes = {std::strlen(command), prefixed_key.size(), cursor_str.size()};
+            if(pattern != "*") {
+                commands.push_back("MATCH");
+                sizes.push_back(5);
+                commands.push_back(pattern.c_str());
+                sizes.push_back(pattern.size());
+            }
+            if(count != Connection::default_scan_count) {
+                commands.push_back("COUNT");
+                sizes.push_back(5);
+                commands.push_back(count_str.c_str());
+                sizes.push_back(count_str.size());
+            }
+            if(!run_command(commands, sizes)) {
+                return false;
+            }
+            redis_assert(reply->type == REDIS_REPLY_ARRAY);
+            redis_assert(reply->elements == 2);
+            redis_assert(reply->element[0]->type == REDIS_REPLY_STRING);
+            redis_assert(reply->element[1]->type == REDIS_REPLY_ARRAY);
+            cursor = std::stoull(std::string(reply->element[0]->str, reply->element[0]->len));
+            return true;
+        }
+
         bool info(const Key& section, Key& info_data) {
             if(!section.empty() && redis_version < 20600) {
                 set_error(Error::COMMAND_UNSUPPORTED);
@@ -453,6 +1228,13 @@ namespace Redis {
                     sizes[2*i+2] = static_cast<const Key&>(values[i]).size();
                 }
             }
+            KeyVec encoded_values;
+            if(connection_param.codec != nullptr) {
+                encoded_values.resize(sz);
+                for(size_t i=0; i<sz; i++) {
+                    encode_value(command_parts_c_strings[2*i+2], sizes[2*i+2], encoded_values[i]);
+                }
+            }
             if(run_command(command_parts_c_strings, sizes)) {
                 was_set = (reply->integer == 1);
                 return true;
@@ -467,6 +1249,8 @@ namespace Redis {
                 key = key_s.c_str();
                 key_size = key_s.size();
             }
+            Key encoded_value;
+            encode_value(value, value_size, encoded_value);
             if(redis_version >= 20612) {
                 bool ret;
                 if(expire_type == ExpireType::SEC) {
@@ -658,6 +1442,31 @@ namespace Redis {
     bool Connection::is_available() {
         return d->is_available();
     }
+    bool Connection::connect() {
+        return d->ensure_connected();
+    }
+    std::shared_ptr<const Capabilities> Connection::get_capabilities() {
+        if(!d->ensure_connected()) {
+            return nullptr;
+        }
+        return d->capabilities;
+    }
+    bool Connection::has_command(const Key& name, bool& supported) {
+        if(!d->ensure_connected()) {
+            return false;
+        }
+        if(d->capabilities == nullptr) {
+            d->set_error(Error::UNEXPECTED_INFO_RESULT);
+            return false;
+        }
+        if(!d->capabilities->commands_loaded && !d->load_commands()) {
+            return false;
+        }
+        Key lower_name(name);
+        std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(), ::tolower);
+        supported = d->capabilities->commands.count(lower_name) != 0;
+        return true;
+    }
     std::string Connection::get_error() {
         return d->get_error();
     }
@@ -673,6 +1482,123 @@ namespace Redis {
     size_t Connection::get_connection_count() {
         return Implementation::connection_count.load(std::memory_order_relaxed);
     }
+    bool Connection::get_socket_info(SocketInfo& info) {
+        return d->get_socket_info(info);
+    }
+    bool Connection::append_command(const std::vector<const char*>& commands, const std::vector<size_t>& sizes) {
+        return d->append_command(commands, sizes);
+    }
+    bool Connection::flush_commands() {
+        return d->flush_commands();
+    }
+    bool Connection::fetch_reply() {
+        return d->fetch_reply();
+    }
+    const redisReply* Connection::get_reply() {
+        return d->reply.get();
+    }
+    int Connection::get_fd() {
+        return d->context == nullptr || !d->available ? -1 : d->context->fd;
+    }
+    void Connection::abandon() {
+        d->abandon();
+    }
+    bool Connection::read_string_reply(Key& result) {
+        redis_assert(d->reply != nullptr);
+        if(d->reply->type == REDIS_REPLY_NIL) {
+            result.clear();
+            return true;
+        }
+        redis_assert(d->reply->type == REDIS_REPLY_STRING);
+        return d->decode_value(d->reply->str, d->reply->len, result);
+    }
+    bool Connection::read_string_array_reply(StringValueHolder&& result) {
+        redis_assert(d->reply != nullptr && d->reply->type == REDIS_REPLY_ARRAY);
+        for(size_t i = 0; i < d->reply->elements; i++) {
+            Key value;
+            if(d->reply->element[i]->type == REDIS_REPLY_STRING && !d->decode_value(d->reply->element[i]->str, d->reply->element[i]->len, value)) {
+                return false;
+            }
+            result.push_back(std::move(value));
+        }
+        return true;
+    }
+    bool Connection::read_integer_reply(long long& result) {
+        redis_assert(d->reply != nullptr && d->reply->type == REDIS_REPLY_INTEGER);
+        result = d->reply->integer;
+        return true;
+    }
+    void Connection::reconfigure(const ConnectionParam& lease_param) {
+        d->reconfigure(lease_param);
+    }
+    bool Connection::force_reconnect() {
+        d->connected = true;
+        return d->reconnect();
+    }
+    bool Connection::set_throw_on_error(bool throw_on_error) {
+        bool old_throw_on_error = d->connection_param.throw_on_error;
+        d->connection_param.throw_on_error = throw_on_error;
+        return old_throw_on_error;
+    }
+    const Connection::Key& Connection::get_prefix() {
+        return d->connection_param.prefix;
+    }
+    bool Connection::run_raw_set(const Key& key, const char* value, size_t value_size, SetType set_type, bool& was_set, long long expire, ExpireType expire_type) {
+        return d->set(key.c_str(), key.size(), value, value_size, set_type, was_set, expire, expire_type);
+    }
+    bool Connection::run_raw_hset(const Key& key, const Key& field, const char* value, size_t value_size, bool& was_created) {
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        Key encoded_value;
+        d->encode_value(value, value_size, encoded_value);
+        if(d->run_command("HSET %b %b %b", prefixed_key.c_str(), prefixed_key.size(), field.c_str(), field.size(), value, value_size)) {
+            redis_assert(d->reply->type == REDIS_REPLY_INTEGER);
+            was_created = d->reply->integer !=0;
+            return true;
+        }
+        return false;
+    }
+    bool Connection::run_raw_get(const Key& key, const char*& data, size_t& size, bool& found) {
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        if(d->run_command("GET %b", prefixed_key.c_str(), prefixed_key.size())) {
+            found = d->reply->type != REDIS_REPLY_NIL;
+            return !found || d->decode_value(d->reply->str, d->reply->len, data, size);
+        }
+        return false;
+    }
+    bool Connection::run_raw_hget(const Key& key, const Key& field, const char*& data, size_t& size, bool& found) {
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        if(d->run_command("HGET %b %b", prefixed_key.c_str(), prefixed_key.size(), field.c_str(), field.size())) {
+            redis_assert(d->reply->type == REDIS_REPLY_STRING || d->reply->type == REDIS_REPLY_NIL);
+            found = d->reply->type != REDIS_REPLY_NIL;
+            return !found || d->decode_value(d->reply->str, d->reply->len, data, size);
+        }
+        return false;
+    }
+    bool Connection::run_raw_mget(const StringKeyHolder& keys, size_t& count) {
+        std::vector<size_t> sizes(1);
+        std::vector<const char*> command_parts_c_strings(1);
+        command_parts_c_strings[0] = "MGET";
+        sizes[0] = 4;
+        KeyVec prefixed_keys;
+        d->append_c_strings_with_prefixes_and_sizes(keys, prefixed_keys, command_parts_c_strings, sizes);
+        if(d->run_command(command_parts_c_strings, sizes)) {
+            redis_assert(d->reply->elements == keys.size());
+            count = d->reply->elements;
+            return true;
+        }
+        return false;
+    }
+    bool Connection::fetch_raw_mget_result(size_t index, const char*& data, size_t& size, bool& found) {
+        redis_assert(index < d->reply->elements);
+        const redisReply* element = d->reply->element[index];
+        redis_assert(element->type == REDIS_REPLY_STRING || element->type == REDIS_REPLY_NIL);
+        found = element->type == REDIS_REPLY_STRING;
+        return !found || d->decode_value(element->str, element->len, data, size);
+    }
+    bool Connection::set_codec_error() {
+        d->set_error(Error::CODEC_ERROR);
+        return false;
+    }
     bool Connection::fetch_get_result(Key& result, size_t index) {
         if( index >= d->reply->elements ) {
             return false;
@@ -784,6 +1710,73 @@ namespace Redis {
         return false;
     }
 
+    /* Perform arbitrary bitfield integer operations on strings */
+    bool Connection::bitfield(const Key& key, const BitField& operations, std::vector<long long>& results) {
+        std::vector<bool> failed;
+        return bitfield(key, operations, results, failed);
+    }
+
+    /* Perform arbitrary bitfield integer operations on strings. Long builders are split into pipelined commands */
+    bool Connection::bitfield(const Key& key, const BitField& operations, std::vector<long long>& results, std::vector<bool>& failed) {
+        results.clear();
+        failed.clear();
+        if(operations.empty()) {
+            return true;
+        }
+        const Key prefixed_key = d->add_prefix_to_key(key);
+        const size_t max_operations = operations.get_max_operations();
+        const size_t parts = (operations.size() + max_operations - 1) / max_operations;
+        std::vector<std::string> args;
+        std::vector<const char*> commands;
+        std::vector<size_t> sizes;
+        for(size_t part = 0; part < parts; part++) {
+            args.clear();
+            operations.append_arguments(part * max_operations, (part + 1) * max_operations, args);
+            commands.assign({"BITFIELD", prefixed_key.c_str()});
+            sizes.assign({8, prefixed_key.size()});
+            for(size_t i = 0; i < args.size(); i++) {
+                commands.push_back(args[i].c_str());
+                sizes.push_back(args[i].size());
+            }
+            //Single command gets reconnect and retry of run_command
+            if(parts == 1) {
+                break;
+            }
+            if(!d->append_command(commands, sizes)) {
+                if(part != 0) {
+                    abandon();
+                }
+                return false;
+            }
+        }
+        if(parts != 1 && !d->flush_commands()) {
+            return false;
+        }
+        results.reserve(operations.size());
+        failed.reserve(operations.size());
+        bool ok = true;
+        for(size_t part = 0; part < parts; part++) {
+            if(!(parts == 1 ? d->run_command(commands, sizes) : d->fetch_reply())) {
+                if(get_errno() != Error::REPLY_ERR) {
+                    return false;
+                }
+                //Keeps results of the other parts aligned with operations
+                size_t part_size = std::min(max_operations, operations.size() - part * max_operations);
+                results.insert(results.end(), part_size, 0);
+                failed.insert(failed.end(), part_size, true);
+                ok = false;
+                continue;
+            }
+            redis_assert(d->reply->type == REDIS_REPLY_ARRAY);
+            for(size_t j = 0; j < d->reply->elements; j++) {
+                const redisReply* element = d->reply->element[j];
+                results.push_back(element->type == REDIS_REPLY_INTEGER ? element->integer : 0);
+                failed.push_back(element->type == REDIS_REPLY_NIL);
+            }
+        }
+        return ok;
+    }
+
     /* Decrement the integer value of a key by one */
     bool Connection::decr(const Key& key, long long& result_value) {
         const Key& prefixed_key = d->add_prefix_to_key(key);
@@ -820,25 +1813,21 @@ namespace Redis {
     bool Connection::get(const Key& key, Connection::Key& result) {
         const Key& prefixed_key = d->add_prefix_to_key(key);
         if(d->run_command("GET %b", prefixed_key.c_str(), prefixed_key.size())) {
-            result.assign(d->reply->str, d->reply->len);
-            return true;
+            return d->decode_value(d->reply->str, d->reply->len, result);
         }
         return false;
     }
 
-    /* Get the value of multiple keys */
-    bool Connection::get(const StringKeyHolder& keys, StringValueHolder&& result) {
-        std::vector<size_t> sizes(1);
-        std::vector<const char*> command_parts_c_strings(1);
-        command_parts_c_strings[0] = "MGET";
-        sizes[0] = 4;
-        KeyVec prefixed_keys;
-        d->append_c_strings_with_prefixes_and_sizes(keys, prefixed_keys, command_parts_c_strings, sizes);
-        if(d->run_command(command_parts_c_strings, sizes)) {
-            redis_assert(d->reply->elements == keys.size());
+    /* Get the value of multiple keys */
+    bool Connection::get(const StringKeyHolder& keys, StringValueHolder&& result) {
+        size_t count;
+        if(run_raw_mget(keys, count)) {
+            bool decoded = true;
             for(size_t index=0; index < d->reply->elements; index++) {
                 if(d->reply->element[index]->type == REDIS_REPLY_STRING) {
-                    result.push_back(d->reply->element[index]->str);
+                    Key value;
+                    decoded = d->decode_value(d->reply->element[index]->str, d->reply->element[index]->len, value) && decoded;
+                    result.push_back(std::move(value));
                 }
                 else if (d->reply->element[index]->type == REDIS_REPLY_NIL) {
                     result.push_back("");
@@ -847,7 +1836,7 @@ namespace Redis {
                     redis_assert_unreachable();
                 }
             }
-            return true;
+            return decoded;
         }
         return false;
     }
@@ -879,9 +1868,16 @@ namespace Redis {
     /* Set the string value of a key and return its old value */
     bool Connection::getset(const Key& key, const Key& value, Connection::Key& old_value) {
         const Key& prefixed_key = d->add_prefix_to_key(key);
-        if(d->run_command("GETSET %b %b", prefixed_key.c_str(), prefixed_key.size(), value.c_str(), value.size())) {
-            old_value.assign(d->reply->str, d->reply->len);
-            return true;
+        const char* value_data = value.c_str();
+        size_t value_size = value.size();
+        Key encoded_value;
+        d->encode_value(value_data, value_size, encoded_value);
+        if(d->run_command("GETSET %b %b", prefixed_key.c_str(), prefixed_key.size(), value_data, value_size)) {
+            if(d->reply->type == REDIS_REPLY_NIL) {
+                old_value.clear();
+                return true;
+            }
+            return d->decode_value(d->reply->str, d->reply->len, old_value);
         }
         return false;
     }
@@ -1117,18 +2113,40 @@ namespace Redis {
 //
 //
 //    /*********************** list commands ***********************/
-//    /* Remove and get the first element in a list, or block until one is available */
-//    bool Connection::blpop(const KeyVec& keys, long long timeout, Connection::Key& chosen_key, Connection::Key& value);
-//
-//    /* Remove and get the last element in a list, or block until one is available */
-//    bool Connection::brpop(const KeyVec& keys, long long timeout, Connection::Key& chosen_key, Connection::Key& value);
-//
-//    /* Pop a value from a list, push it to another list and return it; or block until one is available */
-//    bool Connection::brpoplpush(const Key& source, const Key& destination, long long timeout, Connection::Key& result);
-//
-//    /* Pop a value from a list, push it to another list and return it; or block until one is available */
-//    bool Connection::brpoplpush(const Key& source, const Key& destination, long long timeout);
-//
+    /* Remove and get the first element in a list, or block until one is available */
+    bool Connection::blpop(const StringKeyHolder& keys, long long timeout, Connection::Key& chosen_key, Connection::Key& value) {
+        return d->blocking_pop("BLPOP", 5, keys, timeout, chosen_key, value);
+    }
+
+    /* Remove and get the last element in a list, or block until one is available */
+    bool Connection::brpop(const StringKeyHolder& keys, long long timeout, Connection::Key& chosen_key, Connection::Key& value) {
+        return d->blocking_pop("BRPOP", 5, keys, timeout, chosen_key, value);
+    }
+
+    /* Pop a value from a list, push it to another list and return it; or block until one is available */
+    bool Connection::brpoplpush(const Key& source, const Key& destination, long long timeout, Connection::Key& result) {
+        const Key& prefixed_source = d->add_prefix_to_key(source);
+        const Key& prefixed_destination = d->add_prefix_to_key(destination);
+        std::vector<const char*> commands = {"BRPOPLPUSH", prefixed_source.c_str(), prefixed_destination.c_str()};
+        std::vector<size_t> sizes = {10, prefixed_source.size(), prefixed_destination.size()};
+        if(!d->run_blocking_command(commands, sizes, timeout)) {
+            return false;
+        }
+        if(d->reply->type == REDIS_REPLY_NIL) {
+            result.clear();
+            return true;
+        }
+        redis_assert(d->reply->type == REDIS_REPLY_STRING);
+        result.assign(d->reply->str, d->reply->len);
+        return true;
+    }
+
+    /* Pop a value from a list, push it to another list and return it; or block until one is available */
+    bool Connection::brpoplpush(const Key& source, const Key& destination, long long timeout) {
+        Key result;
+        return brpoplpush(source, destination, timeout, result);
+    }
+
 //    /* Get an element from a list by its index */
 //    bool Connection::lindex(const Key& key, long long index);
 //
@@ -1143,27 +2161,60 @@ namespace Redis {
 //    /* Insert an element before or after another element in a list */
 //    bool Connection::linsert(const Key& key, ListInsertType insert_type, const Key& pivot, const Key& value, long long& list_size);
 //
-//    /* Get the length of a list */
-//    bool Connection::llen(const Key& key, long long& length);
-//
-//    /* Remove and get the first element in a list */
-//    bool Connection::lpop(const Key& key, Connection::Key& value);
-//
-//    /* Remove and get the first element in a list */
-//    bool Connection::lpop(const Key& key);
-//
-//    /* Prepend one or multiple values to a list */
-//    bool Connection::lpush(const Key& key, const Key& value, long long& list_length);
-//
-//    /* Prepend one or multiple values to a list */
-//    bool Connection::lpush(const Key& key, const Key& value);
-//
-//    /* Prepend one or multiple values to a list */
-//    bool Connection::lpush(const Key& key, const KeyVec& values, long long& list_length);
-//
-//    /* Prepend one or multiple values to a list */
-//    bool Connection::lpush(const Key& key, const KeyVec& values);
-//
+
+    /* Get the length of a list */
+    bool Connection::llen(const Key& key, long long& length) {
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        if(d->run_command("LLEN %b", prefixed_key.c_str(), prefixed_key.size())) {
+            length = d->reply->integer;
+            return true;
+        }
+        return false;
+    }
+
+    /* Remove and get the first element in a list */
+    bool Connection::lpop(const Key& key, Connection::Key& value) {
+        return d->pop("LPOP", 4, key, value);
+    }
+
+    /* Remove and get the first element in a list */
+    bool Connection::lpop(const Key& key) {
+        Key value;
+        return d->pop("LPOP", 4, key, value);
+    }
+
+    /* Remove and get up to count first elements of a list */
+    bool Connection::lpop(const Key& key, size_t count, KeyVec& values) {
+        return d->pop("LPOP", 4, key, count, values);
+    }
+
+    /* Prepend one or multiple values to a list */
+    bool Connection::lpush(const Key& key, const Key& value, long long& list_length) {
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        if(d->run_command("LPUSH %b %b", prefixed_key.c_str(), prefixed_key.size(), value.c_str(), value.size())) {
+            list_length = d->reply->integer;
+            return true;
+        }
+        return false;
+    }
+
+    /* Prepend one or multiple values to a list */
+    bool Connection::lpush(const Key& key, const Key& value) {
+        long long list_length;
+        return lpush(key, value, list_length);
+    }
+
+    /* Prepend one or multiple values to a list */
+    bool Connection::lpush(const Key& key, const StringKeyHolder& values, long long& list_length) {
+        return d->push("LPUSH", 5, key, values, list_length);
+    }
+
+    /* Prepend one or multiple values to a list */
+    bool Connection::lpush(const Key& key, const StringKeyHolder& values) {
+        long long list_length;
+        return d->push("LPUSH", 5, key, values, list_length);
+    }
+
 //    /* Prepend a value to a list, only if the list exists */
 //    bool Connection::lpushx(const Key& key, const Key& value, long long& list_length);
 //
@@ -1171,26 +2222,176 @@ namespace Redis {
 //    bool Connection::lpushx(const Key& key, const Key& value);
 
 
+    /* Pop up to count elements from the first non empty list of keys */
+    bool Connection::lmpop(const StringKeyHolder& keys, ListDirection from, size_t count, Key& chosen_key, KeyVec& values) {
+        chosen_key.clear();
+        values.clear();
+        const std::string numkeys_str = std::to_string(keys.size());
+        const std::string count_str = std::to_string(count);
+        size_t direction_size;
+        const char* direction = Implementation::get_direction_str(from, direction_size);
+        std::vector<const char*> commands = {"LMPOP", numkeys_str.c_str()};
+        std::vector<size_t> sizes = {5, numkeys_str.size()};
+        KeyVec prefixed_keys;
+        d->append_c_strings_with_prefixes_and_sizes(keys, prefixed_keys, commands, sizes);
+        commands.insert(commands.end(), {direction, "COUNT", count_str.c_str()});
+        sizes.insert(sizes.end(), {direction_size, 5, count_str.size()});
+        if(!d->run_command(commands, sizes)) {
+            return false;
+        }
+        if(d->reply->type == REDIS_REPLY_NIL) {
+            return true;
+        }
+        redis_assert(d->reply->type == REDIS_REPLY_ARRAY && d->reply->elements == 2);
+        const redisReply* key = d->reply->element[0];
+        const redisReply* elements = d->reply->element[1];
+        const size_t prefix_size = d->connection_param.prefix.size();
+        chosen_key.assign(key->str + prefix_size, key->len - prefix_size);
+        values.reserve(elements->elements);
+        for(size_t i = 0; i < elements->elements; i++) {
+            values.push_back(Key(elements->element[i]->str, elements->element[i]->len));
+        }
+        return true;
+    }
+
+    /* Atomically move an element from one end of a list to an end of another list */
+    bool Connection::lmove(const Key& source, const Key& destination, ListDirection from, ListDirection to, Key& result) {
+        if(!d->ensure_connected()) {
+            return false;
+        }
+        if(d->redis_version < 60200 && from == ListDirection::RIGHT && to == ListDirection::LEFT) {
+            return rpoplpush(source, destination, result);
+        }
+        const Key& prefixed_source = d->add_prefix_to_key(source);
+        const Key& prefixed_destination = d->add_prefix_to_key(destination);
+        size_t from_size, to_size;
+        const char* from_str = Implementation::get_direction_str(from, from_size);
+        const char* to_str = Implementation::get_direction_str(to, to_size);
+        std::vector<const char*> commands = {"LMOVE", prefixed_source.c_str(), prefixed_destination.c_str(), from_str, to_str};
+        std::vector<size_t> sizes = {5, prefixed_source.size(), prefixed_destination.size(), from_size, to_size};
+        return d->run_command(commands, sizes) && d->read_optional_string(result);
+    }
+
+    /* Blocking lmove */
+    bool Connection::blmove(const Key& source, const Key& destination, ListDirection from, ListDirection to, long long timeout, Key& result) {
+        if(!d->ensure_connected()) {
+            return false;
+        }
+        if(d->redis_version < 60200 && from == ListDirection::RIGHT && to == ListDirection::LEFT) {
+            return brpoplpush(source, destination, timeout, result);
+        }
+        const Key& prefixed_source = d->add_prefix_to_key(source);
+        const Key& prefixed_destination = d->add_prefix_to_key(destination);
+        size_t from_size, to_size;
+        const char* from_str = Implementation::get_direction_str(from, from_size);
+        const char* to_str = Implementation::get_direction_str(to, to_size);
+        std::vector<const char*> commands = {"BLMOVE", prefixed_source.c_str(), prefixed_destination.c_str(), from_str, to_str};
+        std::vector<size_t> sizes = {6, prefixed_source.size(), prefixed_destination.size(), from_size, to_size};
+        return d->run_blocking_command(commands, sizes, timeout) && d->read_optional_string(result);
+    }
+
     /* Get a range of elements from a list */
-//        bool lrange(const Key& key, VAL start, VAL stop);
+    bool Connection::lrange(const Key& key, long long start, long long stop, KeyVec& values) {
+        values.clear();
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        const std::string start_str = std::to_string(start);
+        const std::string stop_str = std::to_string(stop);
+        std::vector<const char*> commands = {"LRANGE", prefixed_key.c_str(), start_str.c_str(), stop_str.c_str()};
+        std::vector<size_t> sizes = {6, prefixed_key.size(), start_str.size(), stop_str.size()};
+        if(!d->run_command(commands, sizes)) {
+            return false;
+        }
+        redis_assert(d->reply->type == REDIS_REPLY_ARRAY);
+        values.reserve(d->reply->elements);
+        for(size_t i = 0; i < d->reply->elements; i++) {
+            values.push_back(Key(d->reply->element[i]->str, d->reply->element[i]->len));
+        }
+        return true;
+    }
+
+    /* Remove elements from a list */
+    bool Connection::lrem(const Key& key, long long count, const Key& value, long long& removed) {
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        const std::string count_str = std::to_string(count);
+        std::vector<const char*> commands = {"LREM", prefixed_key.c_str(), count_str.c_str(), value.c_str()};
+        std::vector<size_t> sizes = {4, prefixed_key.size(), count_str.size(), value.size()};
+        if(d->run_command(commands, sizes)) {
+            removed = d->reply->integer;
+            return true;
+        }
+        return false;
+    }
 
     /* Remove elements from a list */
-//        bool lrem(const Key& key, VAL count, VAL value);
+    bool Connection::lrem(const Key& key, long long count, const Key& value) {
+        long long removed;
+        return lrem(key, count, value, removed);
+    }
 
     /* Set the value of an element in a list by its index */
 //        bool lset(const Key& key, VAL index, VAL value);
 
     /* Trim a list to the specified range */
-//        bool ltrim(const Key& key, VAL start, VAL stop);
+    bool Connection::ltrim(const Key& key, long long start, long long stop) {
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        const std::string start_str = std::to_string(start);
+        const std::string stop_str = std::to_string(stop);
+        std::vector<const char*> commands = {"LTRIM", prefixed_key.c_str(), start_str.c_str(), stop_str.c_str()};
+        std::vector<size_t> sizes = {5, prefixed_key.size(), start_str.size(), stop_str.size()};
+        return d->run_command(commands, sizes);
+    }
+
+    /* Remove and get the last element in a list */
+    bool Connection::rpop(const Key& key, Connection::Key& value) {
+        return d->pop("RPOP", 4, key, value);
+    }
 
     /* Remove and get the last element in a list */
-//        bool rpop(const Key& key);
+    bool Connection::rpop(const Key& key) {
+        Key value;
+        return d->pop("RPOP", 4, key, value);
+    }
+
+    /* Remove and get up to count last elements of a list */
+    bool Connection::rpop(const Key& key, size_t count, KeyVec& values) {
+        return d->pop("RPOP", 4, key, count, values);
+    }
 
     /* Remove the last element in a list, append it to another list and return it */
-//        bool rpoplpush(VAL source, VAL destination);
+    bool Connection::rpoplpush(const Key& source, const Key& destination, Key& result) {
+        const Key& prefixed_source = d->add_prefix_to_key(source);
+        const Key& prefixed_destination = d->add_prefix_to_key(destination);
+        std::vector<const char*> commands = {"RPOPLPUSH", prefixed_source.c_str(), prefixed_destination.c_str()};
+        std::vector<size_t> sizes = {9, prefixed_source.size(), prefixed_destination.size()};
+        return d->run_command(commands, sizes) && d->read_optional_string(result);
+    }
+
+    /* Append one or multiple values to a list */
+    bool Connection::rpush(const Key& key, const Key& value, long long& list_length) {
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        if(d->run_command("RPUSH %b %b", prefixed_key.c_str(), prefixed_key.size(), value.c_str(), value.size())) {
+            list_length = d->reply->integer;
+            return true;
+        }
+        return false;
+    }
+
+    /* Append one or multiple values to a list */
+    bool Connection::rpush(const Key& key, const Key& value) {
+        long long list_length;
+        return rpush(key, value, list_length);
+    }
+
+    /* Append one or multiple values to a list */
+    bool Connection::rpush(const Key& key, const StringKeyHolder& values, long long& list_length) {
+        return d->push("RPUSH", 5, key, values, list_length);
+    }
 
     /* Append one or multiple values to a list */
-//        bool rpush(const Key& key, VAL value [value ...]);
+    bool Connection::rpush(const Key& key, const StringKeyHolder& values) {
+        long long list_length;
+        return d->push("RPUSH", 5, key, values, list_length);
+    }
 
     /* Append a value to a list, only if the list exists */
 //        bool rpushx(const Key& key, VAL value);
@@ -1360,10 +2561,13 @@ namespace Redis {
             redis_assert(d->reply->element[0]->type == REDIS_REPLY_STRING);
             redis_assert(d->reply->element[1]->type == REDIS_REPLY_ARRAY);
             cursor = std::stoull(d->reply->element[0]->str);
+            //Matched keys always start with prefix whatever the pattern is
+            const size_t prefix_size = d->connection_param.prefix.size();
             for(size_t i=0; i < d->reply->element[1]->elements; i++) {
-                redis_assert(d->reply->element[1]->element[i]->type == REDIS_REPLY_STRING);
-                redis_assert(static_cast<size_t>(d->reply->element[1]->element[i]->len) >= prefixed_pattern.size());
-                result_keys.push_back(d->reply->element[1]->element[i]->str+prefixed_pattern.size()-1);
+                const redisReply* key_reply = d->reply->element[1]->element[i];
+                redis_assert(key_reply->type == REDIS_REPLY_STRING);
+                redis_assert(static_cast<size_t>(key_reply->len) >= prefix_size);
+                result_keys.push_back(Key(key_reply->str + prefix_size, static_cast<size_t>(key_reply->len) - prefix_size));
             }
             return true;
         }
@@ -1437,11 +2641,9 @@ namespace Redis {
             redis_assert(d->reply->type == REDIS_REPLY_STRING || d->reply->type == REDIS_REPLY_NIL);
             if(d->reply->type == REDIS_REPLY_NIL) {
                 value.clear();
+                return true;
             }
-            else {
-                value = std::string(d->reply->str, d->reply->len);
-            }
-            return true;
+            return d->decode_value(d->reply->str, d->reply->len, value);
         }
         return false;
     }
@@ -1456,7 +2658,10 @@ namespace Redis {
                 redis_assert(d->reply->element[i]->type == REDIS_REPLY_STRING);
                 redis_assert(d->reply->element[i+1]->type == REDIS_REPLY_STRING);
                 std::string k(d->reply->element[i]->str, d->reply->element[i]->len);
-                std::string v(d->reply->element[i+1]->str, d->reply->element[i+1]->len);
+                std::string v;
+                if(!d->decode_value(d->reply->element[i+1]->str, d->reply->element[i+1]->len, v)) {
+                    return false;
+                }
                 result.push_back(std::make_pair(std::move(k), std::move(v)));
             }
             return true;
@@ -1511,29 +2716,27 @@ namespace Redis {
 
     /* Set the string value of a hash field */
         bool Connection::hset(const Key& key, const Key& field, const Key& value) {
-            const Key& prefixed_key = d->add_prefix_to_key(key);
-            return d->run_command("HSET %b %b %b", prefixed_key.c_str(), prefixed_key.size(), field.c_str(), field.size(), value.c_str(), value.size());
+            bool was_created;
+            return hset(key, field, value, was_created);
         }
 
     bool Connection::hset(const Key& key, const Key& field, const Key& value, bool& was_created) {
-        const Key& prefixed_key = d->add_prefix_to_key(key);
-        if(d->run_command("HSET %b %b %b", prefixed_key.c_str(), prefixed_key.size(), field.c_str(), field.size(), value.c_str(), value.size())) {
-            redis_assert(d->reply->type == REDIS_REPLY_INTEGER);
-            was_created = d->reply->integer !=0;
-            return true;
-        }
-        return false;
+        return run_raw_hset(key, field, value.c_str(), value.size(), was_created);
     }
 
     /* Set the value of a hash field, only if the field does not exist */
     bool Connection::hsetnx(const Key& key, const Key& field, const Key& value) {
-        const Key& prefixed_key = d->add_prefix_to_key(key);
-        return d->run_command("HSETNX %b %b %b", prefixed_key.c_str(), prefixed_key.size(), field.c_str(), field.size(), value.c_str(), value.size());
+        bool was_set;
+        return hsetnx(key, field, value, was_set);
     }
 
     bool Connection::hsetnx(const Key& key, const Key& field, const Key& value, bool& was_set) {
         const Key& prefixed_key = d->add_prefix_to_key(key);
-        if(d->run_command("HSETNX %b %b %b", prefixed_key.c_str(), prefixed_key.size(), field.c_str(), field.size(), value.c_str(), value.size())) {
+        const char* value_data = value.c_str();
+        size_t value_size = value.size();
+        Key encoded_value;
+        d->encode_value(value_data, value_size, encoded_value);
+        if(d->run_command("HSETNX %b %b %b", prefixed_key.c_str(), prefixed_key.size(), field.c_str(), field.size(), value_data, value_size)) {
             redis_assert(d->reply->type == REDIS_REPLY_INTEGER);
             was_set = d->reply->integer !=0;
             return true;
@@ -1545,7 +2748,24 @@ namespace Redis {
 //        bool hvals(const Key& key);
 
     /* Incrementally iterate hash fields and associated values */
-//        bool hscan(const Key& key, VAL cursor /*, [MATCH pattern] */ /*, [COUNT count] */);
+    bool Connection::hscan(const Key& key, unsigned long long& cursor, PairHolder<std::string, std::string>&& result, const Key& pattern, long count) {
+        if(d->collection_scan("HSCAN", key, cursor, pattern, count)) {
+            const redisReply* elements = d->reply->element[1];
+            redis_assert(elements->elements % 2 == 0);
+            for(size_t i=0; i < elements->elements; i+=2) {
+                redis_assert(elements->element[i]->type == REDIS_REPLY_STRING);
+                redis_assert(elements->element[i+1]->type == REDIS_REPLY_STRING);
+                std::string k(elements->element[i]->str, elements->element[i]->len);
+                std::string v;
+                if(!d->decode_value(elements->element[i+1]->str, elements->element[i+1]->len, v)) {
+                    return false;
+                }
+                result.push_back(std::make_pair(std::move(k), std::move(v)));
+            }
+            return true;
+        }
+        return false;
+    }
 
 
     /*********************** pubsub commands ***********************/
@@ -1693,7 +2913,17 @@ namespace Redis {
     }
 
     /* Incrementally iterate Set elements */
-//        bool sscan(const Key& key, VAL cursor /*, [MATCH pattern] */ /*, [COUNT count] */);
+    bool Connection::sscan(const Key& key, unsigned long long& cursor, StringValueHolder&& result, const Key& pattern, long count) {
+        if(d->collection_scan("SSCAN", key, cursor, pattern, count)) {
+            const redisReply* elements = d->reply->element[1];
+            for(size_t i=0; i < elements->elements; i++) {
+                redis_assert(elements->element[i]->type == REDIS_REPLY_STRING);
+                result.push_back(std::string(elements->element[i]->str, elements->element[i]->len));
+            }
+            return true;
+        }
+        return false;
+    }
 
 
     /*********************** sorted_set commands ***********************/
@@ -1857,7 +3087,277 @@ namespace Redis {
 //        bool zunionstore(VAL destination, VAL numkeys, const KeyVec& keys /*, [WEIGHTS weight [weight ...]] */ /*, [AGGREGATE SUM|MIN|MAX] */);
 
     /* Incrementally iterate sorted sets elements and associated scores */
-//        bool zscan(const Key& key, VAL cursor /*, [MATCH pattern] */ /*, [COUNT count] */);
+    bool Connection::zscan(const Key& key, unsigned long long& cursor, PairHolder<std::string, double>&& result, const Key& pattern, long count) {
+        if(d->collection_scan("ZSCAN", key, cursor, pattern, count)) {
+            const redisReply* elements = d->reply->element[1];
+            redis_assert(elements->elements % 2 == 0);
+            for(size_t i=0; i < elements->elements; i+=2) {
+                redis_assert(elements->element[i]->type == REDIS_REPLY_STRING);
+                redis_assert(elements->element[i+1]->type == REDIS_REPLY_STRING);
+                result.push_back(std::make_pair(std::string(elements->element[i]->str, elements->element[i]->len), std::stod(elements->element[i+1]->str)));
+            }
+            return true;
+        }
+        return false;
+    }
+
+
+    /*********************** hyperloglog commands ***********************/
+    /* Adds the specified element to the specified HyperLogLog */
+    bool Connection::pfadd(const Key& key, const Key& element) {
+        bool altered;
+        return pfadd(key, element, altered);
+    }
+
+    bool Connection::pfadd(const Key& key, const Key& element, bool& altered) {
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        if(d->run_command("PFADD %b %b", prefixed_key.c_str(), prefixed_key.size(), element.c_str(), element.size())) {
+            altered = d->reply->integer == 1;
+            return true;
+        }
+        return false;
+    }
+
+    /* Adds the specified elements to the specified HyperLogLog */
+    bool Connection::pfadd(const Key& key, const StringKeyHolder& elements) {
+        bool altered;
+        return pfadd(key, elements, altered);
+    }
+
+    bool Connection::pfadd(const Key& key, const StringKeyHolder& elements, bool& altered) {
+        altered = false;
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        const size_t parts = elements.size() == 0 ? 1 : (elements.size() + max_elements_per_pfadd - 1) / max_elements_per_pfadd;
+        std::vector<const char*> commands;
+        std::vector<size_t> sizes;
+        for(size_t part = 0; part < parts; part++) {
+            commands.assign({"PFADD", prefixed_key.c_str()});
+            sizes.assign({5, prefixed_key.size()});
+            const size_t end = std::min(elements.size(), (part + 1) * max_elements_per_pfadd);
+            for(size_t i = part * max_elements_per_pfadd; i < end; i++) {
+                commands.push_back(elements[i].c_str());
+                sizes.push_back(elements[i].size());
+            }
+            if(parts == 1) {
+                if(d->run_command(commands, sizes)) {
+                    altered = d->reply->integer == 1;
+                    return true;
+                }
+                return false;
+            }
+            if(!d->append_command(commands, sizes)) {
+                if(part != 0) {
+                    abandon();
+                }
+                return false;
+            }
+        }
+        if(!d->flush_commands()) {
+            return false;
+        }
+        bool ok = true;
+        for(size_t part = 0; part < parts; part++) {
+            if(!d->fetch_reply()) {
+                if(get_errno() != Error::REPLY_ERR) {
+                    return false;
+                }
+                ok = false;
+                continue;
+            }
+            altered = altered || d->reply->integer == 1;
+        }
+        return ok;
+    }
+
+    /* Return the approximated cardinality of the set observed by the HyperLogLog at key */
+    bool Connection::pfcount(const Key& key, long long& result) {
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        if(d->run_command("PFCOUNT %b", prefixed_key.c_str(), prefixed_key.size())) {
+            result = d->reply->integer;
+            return true;
+        }
+        return false;
+    }
+
+    /* Return the approximated cardinality of the union of HyperLogLogs */
+    bool Connection::pfcount(const StringKeyHolder& keys, long long& result) {
+        std::vector<size_t> sizes(1);
+        std::vector<const char*> command_parts_c_strings(1);
+        command_parts_c_strings[0] = "PFCOUNT";
+        sizes[0] = 7;
+        KeyVec prefixed_keys;
+        d->append_c_strings_with_prefixes_and_sizes(keys, prefixed_keys, command_parts_c_strings, sizes);
+        if(d->run_command(command_parts_c_strings, sizes)) {
+            result = d->reply->integer;
+            return true;
+        }
+        return false;
+    }
+
+    /* Merge N different HyperLogLogs into a single one */
+    bool Connection::pfmerge(const Key& destkey, const StringKeyHolder& sourcekeys) {
+        const Key& prefixed_destkey = d->add_prefix_to_key(destkey);
+        std::vector<size_t> sizes(2);
+        std::vector<const char*> command_parts_c_strings(2);
+        command_parts_c_strings[0] = "PFMERGE";
+        sizes[0] = 7;
+        command_parts_c_strings[1] = prefixed_destkey.c_str();
+        sizes[1] = prefixed_destkey.size();
+        KeyVec prefixed_keys;
+        d->append_c_strings_with_prefixes_and_sizes(sourcekeys, prefixed_keys, command_parts_c_strings, sizes);
+        return d->run_command(command_parts_c_strings, sizes);
+    }
+
+
+    /*********************** stream commands ***********************/
+    /* Appends a new entry to a stream */
+    bool Connection::xadd(const Key& key, const StreamFields& fields, Key& id, unsigned long long maxlen, bool approximate) {
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        std::vector<const char*> commands;
+        std::vector<size_t> sizes;
+        Implementation::make_xadd(prefixed_key, fields, maxlen == 0 ? std::string() : std::to_string(maxlen), approximate, commands, sizes);
+        if(d->run_command(commands, sizes)) {
+            id.assign(d->reply->str, d->reply->len);
+            return true;
+        }
+        return false;
+    }
+
+    /* Appends new entries to a stream in one pipeline */
+    bool Connection::xadd(const Key& key, const std::vector<StreamFields>& entries, KeyVec& ids, unsigned long long maxlen, bool approximate) {
+        ids.clear();
+        if(entries.empty()) {
+            return true;
+        }
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        const std::string maxlen_str = maxlen == 0 ? std::string() : std::to_string(maxlen);
+        std::vector<const char*> commands;
+        std::vector<size_t> sizes;
+        for(size_t i = 0; i < entries.size(); i++) {
+            Implementation::make_xadd(prefixed_key, entries[i], maxlen_str, approximate, commands, sizes);
+            if(!d->append_command(commands, sizes)) {
+                if(i != 0) {
+                    abandon();
+                }
+                return false;
+            }
+        }
+        if(!d->flush_commands()) {
+            return false;
+        }
+        ids.reserve(entries.size());
+        bool ok = true;
+        for(size_t i = 0; i < entries.size(); i++) {
+            if(!d->fetch_reply()) {
+                if(get_errno() != Error::REPLY_ERR) {
+                    return false;
+                }
+                ids.push_back(Key());
+                ok = false;
+                continue;
+            }
+            ids.push_back(Key(d->reply->str, d->reply->len));
+        }
+        return ok;
+    }
+
+    /* Return the number of entries in a stream */
+    bool Connection::xlen(const Key& key, long long& result) {
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        if(d->run_command("XLEN %b", prefixed_key.c_str(), prefixed_key.size())) {
+            result = d->reply->integer;
+            return true;
+        }
+        return false;
+    }
+
+    /* Return a range of entries in a stream */
+    bool Connection::xrange(const Key& key, const Key& start, const Key& end, size_t count, std::vector<StreamEntry>& entries) {
+        entries.clear();
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        const std::string count_str = std::to_string(count);
+        std::vector<const char*> commands = {"XRANGE", prefixed_key.c_str(), start.c_str(), end.c_str()};
+        std::vector<size_t> sizes = {6, prefixed_key.size(), start.size(), end.size()};
+        if(count != 0) {
+            commands.insert(commands.end(), {"COUNT", count_str.c_str()});
+            sizes.insert(sizes.end(), {5, count_str.size()});
+        }
+        if(d->run_command(commands, sizes)) {
+            Implementation::parse_stream_entries(d->reply.get(), entries);
+            return true;
+        }
+        return false;
+    }
+
+    /* Create a consumer group */
+    bool Connection::xgroup_create(const Key& key, const Key& group, const Key& id, bool& created, bool mkstream) {
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        std::vector<const char*> commands = {"XGROUP", "CREATE", prefixed_key.c_str(), group.c_str(), id.c_str()};
+        std::vector<size_t> sizes = {6, 6, prefixed_key.size(), group.size(), id.size()};
+        if(mkstream) {
+            commands.push_back("MKSTREAM");
+            sizes.push_back(8);
+        }
+        //Existing group is reported without throwing
+        bool old_throw_on_error = d->connection_param.throw_on_error;
+        d->connection_param.throw_on_error = false;
+        bool ok = d->run_command(commands, sizes);
+        d->connection_param.throw_on_error = old_throw_on_error;
+        created = ok;
+        if(ok) {
+            return true;
+        }
+        if(d->err == Error::REPLY_ERR && d->reply != nullptr && d->reply->len >= 9 && std::strncmp(d->reply->str, "BUSYGROUP", 9) == 0) {
+            return true;
+        }
+        if(old_throw_on_error) {
+            throw Redis::Exception(get_error());
+        }
+        return false;
+    }
+
+    /* Read entries of a stream as a consumer of a group */
+    bool Connection::xreadgroup(const Key& group, const Key& consumer, const Key& key, const Key& id, size_t count, long long block_ms, std::vector<StreamEntry>& entries, bool noack) {
+        return d->xreadgroup(group, consumer, key, id, count, block_ms, noack, entries);
+    }
+
+    /* Marks pending entries as correctly processed */
+    bool Connection::xack(const Key& key, const Key& group, const StringKeyHolder& ids, long long& acknowledged) {
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        std::vector<const char*> commands = {"XACK", prefixed_key.c_str(), group.c_str()};
+        std::vector<size_t> sizes = {4, prefixed_key.size(), group.size()};
+        commands.reserve(ids.size() + 3);
+        sizes.reserve(ids.size() + 3);
+        for(size_t i = 0; i < ids.size(); i++) {
+            commands.push_back(ids[i].c_str());
+            sizes.push_back(ids[i].size());
+        }
+        if(d->run_command(commands, sizes)) {
+            acknowledged = d->reply->integer;
+            return true;
+        }
+        return false;
+    }
 
+    /* Changes ownership of entries pending longer than min_idle_ms to consumer */
+    bool Connection::xautoclaim(const Key& key, const Key& group, const Key& consumer, long long min_idle_ms, Key& start, size_t count, std::vector<StreamEntry>& entries) {
+        entries.clear();
+        const Key& prefixed_key = d->add_prefix_to_key(key);
+        const std::string min_idle_str = std::to_string(min_idle_ms);
+        const std::string count_str = std::to_string(count);
+        std::vector<const char*> commands = {"XAUTOCLAIM", prefixed_key.c_str(), group.c_str(), consumer.c_str(), min_idle_str.c_str(), start.c_str(), "COUNT", count_str.c_str()};
+        std::vector<size_t> sizes = {10, prefixed_key.size(), group.size(), consumer.size(), min_idle_str.size(), start.size(), 5, count_str.size()};
+        if(d->run_command(commands, sizes)) {
+            redis_assert(d->reply->type == REDIS_REPLY_ARRAY && d->reply->elements >= 2);
+            Implementation::parse_stream_entries(d->reply->element[1], entries);
+            start.assign(d->reply->element[0]->str, d->reply->element[0]->len);
+            return true;
+        }
+        return false;
+    }
 
+    std::shared_ptr<const redisReply> Connection::take_reply() {
+        return std::shared_ptr<const redisReply>(d->reply.release(), ReplyDeleter());
+    }
 }
+
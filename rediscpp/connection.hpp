@@ -6,6 +6,11 @@
 #include "macro.hpp"
 #include "connection_param.hpp"
 #include "holders.hpp"
+#include "type_codec.hpp"
+#include "capabilities.hpp"
+#include "bitfield.hpp"
+#include "stream.hpp"
+struct redisReply;
 namespace Redis {
 
     class Connection {
@@ -13,6 +18,10 @@ namespace Redis {
         //Some empiric value after which library will reject commands
         static constexpr size_t max_key_count_per_command = 1000000; //Actual limit in redis is 1048576
         static constexpr long default_scan_count = 10; //defaulted by redis (2.8 at least)
+        //Larger PFADD batches are split into pipelined commands, so a single command doesn't block server for long
+        static constexpr size_t max_elements_per_pfadd = 1000;
+        //The same for LPUSH/RPUSH batches
+        static constexpr size_t max_elements_per_push = 1000;
         typedef std::string Key;
         typedef std::vector<Key> KeyVec;
         typedef std::vector<std::reference_wrapper<const Key>> KeyRefVec;
@@ -36,7 +45,10 @@ namespace Redis {
             COMMAND_UNSUPPORTED,
             UNEXPECTED_INFO_RESULT,
             REPLY_ERR,
-            TOO_LONG_COMMAND
+            TOO_LONG_COMMAND,
+            CODEC_ERROR,
+            DEADLINE_EXCEEDED,
+            ADMISSION_REJECTED
         };
         enum class KeyType {NONE, STRING, LIST, SET, ZSET, HASH};
         enum class BitOperation { AND, OR, XOR, NOT };
@@ -44,8 +56,18 @@ namespace Redis {
         enum class ExpireType { NONE, SEC, MSEC };
         enum class SetType { ALWAYS, IF_EXIST, IF_NOT_EXIST };
         enum class ListInsertType { AFTER, BEFORE };
+        enum class ListDirection { LEFT, RIGHT };
         enum class Order { ASC, DESC };
 
+        /* Effective socket options as reported by the kernel. Buffer sizes are doubled by linux for bookkeeping overhead */
+        struct SocketInfo {
+            bool is_unix_socket;
+            bool tcp_nodelay;
+            bool tcp_keepalive;
+            int send_buffer_size;
+            int recv_buffer_size;
+            int busy_poll_us;
+        };
 
         Connection &operator=(const Connection &other) = delete;
         Connection(const Connection &other) = delete;
@@ -69,12 +91,28 @@ namespace Redis {
         );
         ~Connection();
         bool is_available();
+
+        /* Connects now instead of on the first command. Returns false if connection could not be established */
+        bool connect();
+
+        /* Capabilities of the server, shared by connections to the same endpoint. nullptr if not connected */
+        std::shared_ptr<const Capabilities> get_capabilities();
+
+        /* If server supports command. Command list is fetched with COMMAND once per endpoint */
+        bool has_command(const Key& name, bool& supported);
+
         std::string get_error();
         Error get_errno();
         unsigned int get_version();
         Id get_id();
         static size_t get_connection_count();
 
+        /* Read back socket options of current connection. Returns false if connection is not established */
+        bool get_socket_info(SocketInfo& info);
+
+        /* Prefix which is added to all keys passed to commands */
+        const Key& get_prefix();
+
         //Redis commands
 
         /***************************************************************/
@@ -146,6 +184,15 @@ namespace Redis {
         /* Find first bit set or clear in a string */
         bool bitpos(const Key& key, Bit bit, long long& result);
 
+        /* Perform arbitrary bitfield integer operations on strings. Result of an INCRBY or SET which failed with OVERFLOW FAIL is 0 */
+        bool bitfield(const Key& key, const BitField& operations, std::vector<long long>& results);
+
+        /*
+        * Perform arbitrary bitfield integer operations on strings. failed[i] is set if i-th operation was not done because of OVERFLOW FAIL,
+        * or if the split command holding it got an error reply. Then false is returned, but results of other commands are kept
+        */
+        bool bitfield(const Key& key, const BitField& operations, std::vector<long long>& results, std::vector<bool>& failed);
+
         /* Decrement the integer value of a key by one */
         bool decr(const Key& key, long long& result_value);
 
@@ -167,6 +214,19 @@ namespace Redis {
         /* Get the value of a bunch of keys */
         bool get(StringKVHolder&& vals);
 
+        /*
+        * Get typed value of a key, see Codec. Missing key gives value initialized result.
+        * Returns false with Error::CODEC_ERROR if stored value can't be decoded.
+        */
+        template <class T, class = typename std::enable_if<Codec<T>::defined>::type>
+        bool get(const Key& key, T& result);
+        template <class T, class = typename std::enable_if<Codec<T>::defined>::type>
+        bool get(const Key& key, T& result, bool& found);
+
+        /* Get typed values of a bunch of keys */
+        template <class T, class = typename std::enable_if<Codec<T>::defined>::type>
+        bool mget(const StringKeyHolder& keys, ValueHolder<T>&& results);
+
         /* Returns the bit value at offset in the string value stored at key */
         bool getbit(const Key& key, long long offset, Bit& result);
 
@@ -209,6 +269,12 @@ namespace Redis {
         bool set(const Key& key, const Key& value, SetType set_type = SetType::ALWAYS, long long expire = 0, ExpireType expire_type = ExpireType::NONE);
         bool set(const Key& key, const Key& value,  SetType set_type, bool& was_set, long long expire = 0, ExpireType expire_type = ExpireType::NONE);
 
+        /* Set typed value of a key, see Codec */
+        template <class T, class = typename std::enable_if<Codec<T>::defined>::type>
+        bool set(const Key& key, const T& value, SetType set_type = SetType::ALWAYS, long long expire = 0, ExpireType expire_type = ExpireType::NONE);
+        template <class T, class = typename std::enable_if<Codec<T>::defined>::type>
+        bool set(const Key& key, const T& value, SetType set_type, bool& was_set, long long expire = 0, ExpireType expire_type = ExpireType::NONE);
+
         /* Sets or clears the bit at offset in the string value stored at key */
         bool set_bit(const Key& key,long long offset, Bit value, Bit& original_bit);
 
@@ -314,6 +380,10 @@ namespace Redis {
         /*******************************************************************/
         /*******************************************************************/
 
+        /* Blocking list commands. timeout is in seconds, 0 blocks forever. On timeout they succeed with empty chosen_key/result.
+        *  Socket timeout is extended by timeout, so they don't fail on operation_timeout_ms. Timeout is capped by Deadline of the thread
+        * */
+
         /* Remove and get the first element in a list, or block until one is available */
         bool blpop(const StringKeyHolder& keys, long long timeout, Key& chosen_key, Key& value);
 
@@ -338,7 +408,7 @@ namespace Redis {
         /* Get the length of a list */
         bool llen(const Key& key, long long& length);
 
-        /* Remove and get the first element in a list */
+        /* Remove and get the first element in a list. value is empty if list is empty */
         bool lpop(const Key& key, Key& value);
 
         /* Remove and get the first element in a list */
@@ -350,7 +420,7 @@ namespace Redis {
         /* Prepend one or multiple values to a list */
         bool lpush(const Key& key, const Key& value);
 
-        /* Prepend one or multiple values to a list */
+        /* Prepend one or multiple values to a list. More than max_elements_per_push values are sent as several pipelined commands */
         bool lpush(const Key& key, const StringKeyHolder& values, long long& list_length);
 
         /* Prepend one or multiple values to a list */
@@ -362,26 +432,58 @@ namespace Redis {
         /* Prepend a value to a list, only if the list exists */
         bool lpushx(const Key& key, const Key& value);
 
+        /* Remove and get up to count first elements of a list. Servers before 6.2 pop with a script, before 2.6 with at most max_elements_per_push pipelined LPOPs */
+        bool lpop(const Key& key, size_t count, KeyVec& values);
+
+        /* Pop up to count elements from the first non empty list of keys. chosen_key is empty if all of them are empty. Needs redis 7.0 */
+        bool lmpop(const StringKeyHolder& keys, ListDirection from, size_t count, Key& chosen_key, KeyVec& values);
+
+        /* Atomically move an element from one end of a list to an end of another list. result is empty if source is empty.
+        *  Servers before 6.2 support only RIGHT to LEFT move, done with RPOPLPUSH
+        * */
+        bool lmove(const Key& source, const Key& destination, ListDirection from, ListDirection to, Key& result);
+
+        /* Blocking lmove. timeout is in seconds, as for other blocking list commands. BRPOPLPUSH is used before 6.2 */
+        bool blmove(const Key& source, const Key& destination, ListDirection from, ListDirection to, long long timeout, Key& result);
+
         /* Get a range of elements from a list */
-//        bool lrange(const Key& key, VAL start, VAL stop);
+        bool lrange(const Key& key, long long start, long long stop, KeyVec& values);
+
+        /* Remove count occurrences of value from a list, from head if count is positive, from tail if negative and all if 0 */
+        bool lrem(const Key& key, long long count, const Key& value, long long& removed);
 
         /* Remove elements from a list */
-//        bool lrem(const Key& key, VAL count, VAL value);
+        bool lrem(const Key& key, long long count, const Key& value);
 
         /* Set the value of an element in a list by its index */
 //        bool lset(const Key& key, VAL index, VAL value);
 
         /* Trim a list to the specified range */
-//        bool ltrim(const Key& key, VAL start, VAL stop);
+        bool ltrim(const Key& key, long long start, long long stop);
+
+        /* Remove and get the last element in a list. value is empty if list is empty */
+        bool rpop(const Key& key, Key& value);
 
         /* Remove and get the last element in a list */
-//        bool rpop(const Key& key);
+        bool rpop(const Key& key);
+
+        /* Remove and get up to count last elements of a list. Servers before 6.2 pop with a script, before 2.6 with at most max_elements_per_push pipelined RPOPs */
+        bool rpop(const Key& key, size_t count, KeyVec& values);
 
         /* Remove the last element in a list, append it to another list and return it */
-//        bool rpoplpush(VAL source, VAL destination);
+        bool rpoplpush(const Key& source, const Key& destination, Key& result);
+
+        /* Append one or multiple values to a list */
+        bool rpush(const Key& key, const Key& value, long long& list_length);
 
         /* Append one or multiple values to a list */
-//        bool rpush(const Key& key, VAL value [value ...]);
+        bool rpush(const Key& key, const Key& value);
+
+        /* Append one or multiple values to a list. More than max_elements_per_push values are sent as several pipelined commands */
+        bool rpush(const Key& key, const StringKeyHolder& values, long long& list_length);
+
+        /* Append one or multiple values to a list */
+        bool rpush(const Key& key, const StringKeyHolder& values);
 
         /* Append a value to a list, only if the list exists */
 //        bool rpushx(const Key& key, VAL value);
@@ -524,6 +626,10 @@ namespace Redis {
         /* Get the value of a hash field */
         bool hget(const Key& key, const Key& field, Key& value);
 
+        /* Get typed value of a hash field, see Codec. Missing field gives value initialized result */
+        template <class T, class = typename std::enable_if<Codec<T>::defined>::type>
+        bool hget(const Key& key, const Key& field, T& value);
+
         /* Get all the fields and values in a hash */
         bool hgetall(const Key& key, PairHolder<std::string, std::string>&& result);
 
@@ -552,6 +658,12 @@ namespace Redis {
         bool hset(const Key& key, const Key& field, const Key& value);
         bool hset(const Key& key, const Key& field, const Key& value, bool& was_created);
 
+        /* Set typed value of a hash field, see Codec */
+        template <class T, class = typename std::enable_if<Codec<T>::defined>::type>
+        bool hset(const Key& key, const Key& field, const T& value);
+        template <class T, class = typename std::enable_if<Codec<T>::defined>::type>
+        bool hset(const Key& key, const Key& field, const T& value, bool& was_created);
+
         /* Set the value of a hash field, only if the field does not exist */
         bool hsetnx(const Key& key, const Key& field, const Key& value);
         bool hsetnx(const Key& key, const Key& field, const Key& value, bool& was_set);
@@ -559,8 +671,8 @@ namespace Redis {
         /* Get all the values in a hash */
 //        bool hvals(const Key& key);
 
-        /* Incrementally iterate hash fields and associated values */
-//        bool hscan(const Key& key, VAL cursor /*, [MATCH pattern] */ /*, [COUNT count] */);
+        /* Incrementally iterate hash fields and associated values. For walking huge hashes see HashScanner */
+        bool hscan(const Key& key, unsigned long long& cursor, PairHolder<std::string, std::string>&& result, const Key& pattern = "*", long count = default_scan_count);
 
 
         /*******************************************************************/
@@ -648,8 +760,8 @@ namespace Redis {
         bool sunionstore(const Key& destination, const KeyVec& keys);
         bool sunionstore(const Key& destination, const KeyVec& keys, long long& number_of_elements);
 
-        /* Incrementally iterate Set elements */
-//        bool sscan(const Key& key, VAL cursor /*, [MATCH pattern] */ /*, [COUNT count] */);
+        /* Incrementally iterate Set elements. For walking huge sets see SetScanner */
+        bool sscan(const Key& key, unsigned long long& cursor, StringValueHolder&& result, const Key& pattern = "*", long count = default_scan_count);
 
 
         /*******************************************************************/
@@ -712,8 +824,70 @@ namespace Redis {
         /* Add multiple sorted sets and store the resulting sorted set in a new key */
         //bool zunionstore(VAL destination, VAL numkeys, const KeyVec& keys /*, [WEIGHTS weight [weight ...]] */ /*, [AGGREGATE SUM|MIN|MAX] */);
 
-        /* Incrementally iterate sorted sets elements and associated scores */
-        //bool zscan(const Key& key, VAL cursor /*, [MATCH pattern] */ /*, [COUNT count] */);
+        /* Incrementally iterate sorted sets elements and associated scores. For walking huge sorted sets see SortedSetScanner */
+        bool zscan(const Key& key, unsigned long long& cursor, PairHolder<std::string, double>&& result, const Key& pattern = "*", long count = default_scan_count);
+
+
+        /*******************************************************************/
+        /*******************************************************************/
+        /*********************** hyperloglog commands **********************/
+        /*******************************************************************/
+        /*******************************************************************/
+
+        /* Adds the specified element to the specified HyperLogLog */
+        bool pfadd(const Key& key, const Key& element);
+        bool pfadd(const Key& key, const Key& element, bool& altered);
+
+        /* Adds the specified elements to the specified HyperLogLog. More than max_elements_per_pfadd are sent as several pipelined commands */
+        bool pfadd(const Key& key, const StringKeyHolder& elements);
+        bool pfadd(const Key& key, const StringKeyHolder& elements, bool& altered);
+
+        /* Return the approximated cardinality of the set observed by the HyperLogLog at key */
+        bool pfcount(const Key& key, long long& result);
+
+        /* Return the approximated cardinality of the union of HyperLogLogs. For keys on different shards see ShardedHyperLogLog */
+        bool pfcount(const StringKeyHolder& keys, long long& result);
+
+        /* Merge N different HyperLogLogs into a single one */
+        bool pfmerge(const Key& destkey, const StringKeyHolder& sourcekeys);
+
+
+        /*******************************************************************/
+        /*******************************************************************/
+        /************************* stream commands *************************/
+        /*******************************************************************/
+        /*******************************************************************/
+
+        /* Appends a new entry to a stream, id receives id assigned by server. Non zero maxlen trims the stream, approximately by default */
+        bool xadd(const Key& key, const StreamFields& fields, Key& id, unsigned long long maxlen = 0, bool approximate = true);
+
+        /* Appends new entries to a stream in one pipeline. Ids of failed entries are empty */
+        bool xadd(const Key& key, const std::vector<StreamFields>& entries, KeyVec& ids, unsigned long long maxlen = 0, bool approximate = true);
+
+        /* Return the number of entries in a stream */
+        bool xlen(const Key& key, long long& result);
+
+        /* Return a range of entries in a stream. count 0 returns all of them. Entries are valid until the next command */
+        bool xrange(const Key& key, const Key& start, const Key& end, size_t count, std::vector<StreamEntry>& entries);
+
+        /* Create a consumer group starting after id ("$" - only new entries, "0" - whole stream). Existing group is not an error, created is false then */
+        bool xgroup_create(const Key& key, const Key& group, const Key& id, bool& created, bool mkstream = true);
+
+        /*
+        * Read entries of a stream as a consumer of a group. Id ">" reads new entries, other id reads entries after it
+        * which were delivered to the consumer and are not acknowledged yet.
+        * Negative block_ms doesn't block, 0 blocks until entries arrive or deadline of the thread expires. Entries are valid until the next command
+        */
+        bool xreadgroup(const Key& group, const Key& consumer, const Key& key, const Key& id, size_t count, long long block_ms, std::vector<StreamEntry>& entries, bool noack = false);
+
+        /* Marks pending entries as correctly processed */
+        bool xack(const Key& key, const Key& group, const StringKeyHolder& ids, long long& acknowledged);
+
+        /*
+        * Changes ownership of entries pending longer than min_idle_ms to consumer and returns them. start is a cursor:
+        * "0-0" at first, then it is updated and is "0-0" again when whole pending list is scanned. Needs redis 6.2
+        */
+        bool xautoclaim(const Key& key, const Key& group, const Key& consumer, long long min_idle_ms, Key& start, size_t count, std::vector<StreamEntry>& entries);
     private:
         //Pimpl
         class Implementation;
@@ -721,5 +895,145 @@ namespace Redis {
 
         //Only methods used by template public functions
         bool fetch_get_result(Key& result, size_t index);
+
+        //Typed values. data points to reply or to decoded value of ValueCodec and is valid until the next command
+        bool run_raw_set(const Key& key, const char* value, size_t value_size, SetType set_type, bool& was_set, long long expire, ExpireType expire_type);
+        bool run_raw_hset(const Key& key, const Key& field, const char* value, size_t value_size, bool& was_created);
+        bool run_raw_get(const Key& key, const char*& data, size_t& size, bool& found);
+        bool run_raw_hget(const Key& key, const Key& field, const char*& data, size_t& size, bool& found);
+        bool run_raw_mget(const StringKeyHolder& keys, size_t& count);
+        bool fetch_raw_mget_result(size_t index, const char*& data, size_t& size, bool& found);
+        bool set_codec_error();
+
+        template <class T, class Callback>
+        bool with_encoded(const T& value, const Callback& callback);
+        template <class T>
+        bool decode_typed(const char* data, size_t size, bool found, T& result);
+
+        //Applies client side settings of a pool lease
+        void reconfigure(const ConnectionParam& lease_param);
+
+        //Ownership of the last reply, so views into it outlive the next command
+        std::shared_ptr<const redisReply> take_reply();
+
+        //Low level pipelining used by helpers built on top of connection. Connection should not be used for other commands while replies are pending
+        friend class Scanner;
+        friend class HedgedReader;
+        friend class AutoBatcher;
+        friend class MultiplexedConnection;
+        friend class Script;
+        friend class Lock;
+        friend class RateLimiter;
+        friend class BloomFilter;
+        friend class ShardedHyperLogLog;
+        friend class StreamConsumer;
+        friend class ListQueue;
+        bool append_command(const std::vector<const char*>& commands, const std::vector<size_t>& sizes);
+        bool flush_commands();
+        bool fetch_reply();
+        const redisReply* get_reply();
+        //Socket descriptor to wait for pending replies. -1 if not connected
+        int get_fd();
+        //Drop connection with unread replies instead of waiting for them. Next command reconnects
+        void abandon();
+        //Parse reply fetched with fetch_reply, the same way as GET/HGET and MGET do
+        bool read_string_reply(Key& result);
+        bool read_string_array_reply(StringValueHolder&& result);
+        bool read_integer_reply(long long& result);
+        //Establish new connection, even if current one is fine
+        bool force_reconnect();
+        //Report errors only by return value while replies are handled by the helper, f.e. NOSCRIPT fallback. Returns previous setting
+        bool set_throw_on_error(bool throw_on_error);
     };
-}
\ No newline at end of file
+
+    template <class T, class Callback>
+    bool Connection::with_encoded(const T& value, const Callback& callback) {
+        //Small values are encoded on stack, so no allocation happens at all
+        static constexpr size_t stack_buffer_size = 64;
+        size_t max_size = Codec<T>::max_size(value);
+        if(max_size <= stack_buffer_size) {
+            char buffer[stack_buffer_size];
+            return callback(buffer, Codec<T>::encode(value, buffer));
+        }
+        std::string buffer(max_size, '\0');
+        return callback(&buffer[0], Codec<T>::encode(value, &buffer[0]));
+    }
+
+    template <class T>
+    bool Connection::decode_typed(const char* data, size_t size, bool found, T& result) {
+        if(!found) {
+            result = T();
+            return true;
+        }
+        if(!Codec<T>::decode(data, size, result)) {
+            return set_codec_error();
+        }
+        return true;
+    }
+
+    template <class T, class>
+    bool Connection::get(const Key& key, T& result) {
+        bool found;
+        return get(key, result, found);
+    }
+
+    template <class T, class>
+    bool Connection::get(const Key& key, T& result, bool& found) {
+        const char* data;
+        size_t size;
+        return run_raw_get(key, data, size, found) && decode_typed(data, size, found, result);
+    }
+
+    template <class T, class>
+    bool Connection::mget(const StringKeyHolder& keys, ValueHolder<T>&& results) {
+        size_t count;
+        if(!run_raw_mget(keys, count)) {
+            return false;
+        }
+        const char* data;
+        size_t size;
+        bool found;
+        for(size_t i = 0; i < count; i++) {
+            T result;
+            if(!fetch_raw_mget_result(i, data, size, found) || !decode_typed(data, size, found, result)) {
+                return false;
+            }
+            results.push_back(std::move(result));
+        }
+        return true;
+    }
+
+    template <class T, class>
+    bool Connection::set(const Key& key, const T& value, SetType set_type, long long expire, ExpireType expire_type) {
+        bool was_set;
+        return set(key, value, set_type, was_set, expire, expire_type);
+    }
+
+    template <class T, class>
+    bool Connection::set(const Key& key, const T& value, SetType set_type, bool& was_set, long long expire, ExpireType expire_type) {
+        return with_encoded(value, [&](const char* data, size_t size) {
+            return run_raw_set(key, data, size, set_type, was_set, expire, expire_type);
+        });
+    }
+
+    template <class T, class>
+    bool Connection::hget(const Key& key, const Key& field, T& value) {
+        const char* data;
+        size_t size;
+        bool found;
+        return run_raw_hget(key, field, data, size, found) && decode_typed(data, size, found, value);
+    }
+
+    template <class T, class>
+    bool Connection::hset(const Key& key, const Key& field, const T& value) {
+        bool was_created;
+        return hset(key, field, value, was_created);
+    }
+
+    template <class T, class>
+    bool Connection::hset(const Key& key, const Key& field, const T& value, bool& was_created) {
+        return with_encoded(value, [&](const char* data, size_t size) {
+            return run_raw_hset(key, field, data, size, was_created);
+        });
+    }
+}
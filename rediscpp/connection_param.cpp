@@ -1,7 +1,7 @@
 #include "connection_param.hpp"
 namespace Redis {
     static std::hash<std::string> hash_fn;
-    ConnectionParam ConnectionParam::default_connection_param = {"127.0.0.1", 6379, "", 0, "", 1000, 1000, true, false, false};
+    ConnectionParam ConnectionParam::default_connection_param = {"127.0.0.1", 6379, "", 0, "", 1000, 1000, true, false, false, true, false, 0, 0, 0, nullptr};
     ConnectionParam::ConnectionParam(
             const std::string &_host,
             unsigned int _port,
@@ -12,7 +12,14 @@ namespace Redis {
             unsigned int _operation_timeout_ms,
             bool _reconnect_on_failure,
             bool _throw_on_error,
-            bool _split_long_commands
+            bool _split_long_commands,
+            bool _tcp_nodelay,
+            bool _tcp_keepalive,
+            unsigned int _send_buffer_size,
+            unsigned int _recv_buffer_size,
+            unsigned int _busy_poll_us,
+            std::shared_ptr<const ValueCodec> _codec,
+            std::shared_ptr<AdmissionControl> _admission
     ) :
             host(_host),
             port(_port),
@@ -23,12 +30,19 @@ namespace Redis {
             operation_timeout_ms(_operation_timeout_ms),
             reconnect_on_failure(_reconnect_on_failure),
             throw_on_error(_throw_on_error),
-            split_long_commands(_split_long_commands)
+            split_long_commands(_split_long_commands),
+            tcp_nodelay(_tcp_nodelay),
+            tcp_keepalive(_tcp_keepalive),
+            send_buffer_size(_send_buffer_size),
+            recv_buffer_size(_recv_buffer_size),
+            busy_poll_us(_busy_poll_us),
+            codec(_codec),
+            admission(_admission)
     {}
     unsigned long long ConnectionParam::get_hash() const {
             return
                     hash_fn(host)                                           +   //We don't care about overflow. Only about unique values
-                    (static_cast<unsigned long>(port) << 48)                +   //64 - 16 bit
+                    (is_unix_socket() ? 0 : static_cast<unsigned long>(port) << 48) +   //64 - 16 bit
                     hash_fn(password)                                       +
                     (static_cast<unsigned long>(db_num) << 44)              +   //48 - 4  bit
                     hash_fn(prefix)                                         +
@@ -39,6 +53,19 @@ namespace Redis {
             ;
     }
 
+    ConnectionParam ConnectionParam::get_endpoint_param() const {
+        ConnectionParam endpoint(*this);
+        endpoint.prefix.clear();
+        endpoint.connect_timeout_ms = 0;
+        endpoint.operation_timeout_ms = 0;
+        endpoint.reconnect_on_failure = false;
+        endpoint.throw_on_error = false;
+        endpoint.split_long_commands = false;
+        endpoint.codec = nullptr;
+        endpoint.admission = nullptr;
+        return endpoint;
+    }
+
     ConnectionParam::ConnectionParam(ConnectionParam &&other) :
             host(std::move(other.host)),
             port(other.port),
@@ -49,7 +76,14 @@ namespace Redis {
             operation_timeout_ms(other.operation_timeout_ms),
             reconnect_on_failure(other.reconnect_on_failure),
             throw_on_error(other.throw_on_error),
-            split_long_commands(other.split_long_commands)
+            split_long_commands(other.split_long_commands),
+            tcp_nodelay(other.tcp_nodelay),
+            tcp_keepalive(other.tcp_keepalive),
+            send_buffer_size(other.send_buffer_size),
+            recv_buffer_size(other.recv_buffer_size),
+            busy_poll_us(other.busy_poll_us),
+            codec(std::move(other.codec)),
+            admission(std::move(other.admission))
     {
     }
 }
\ No newline at end of file
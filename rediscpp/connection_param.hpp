@@ -1,5 +1,8 @@
 #pragma once
 #include <string>
+#include <memory>
+#include "codec.hpp"
+#include "admission.hpp"
 namespace Redis {
     class ConnectionParam {
     private:
@@ -17,10 +20,36 @@ namespace Redis {
         bool throw_on_error;
         bool split_long_commands;
 
+        //Socket options. They are applied on every (re)connect. Zero sizes keep OS defaults.
+        bool tcp_nodelay;
+        bool tcp_keepalive;
+        unsigned int send_buffer_size;
+        unsigned int recv_buffer_size;
+        //SO_BUSY_POLL in microseconds. Linux only, requires CAP_NET_ADMIN to raise above net.core.busy_read
+        unsigned int busy_poll_us;
+
+        //Transforms values of string and hash commands, f.e. CompressionCodec. nullptr sends values as is
+        std::shared_ptr<const ValueCodec> codec;
+
+        //Limits rate and concurrency of requests to endpoint. Connections sharing the object share limits. nullptr disables admission control
+        std::shared_ptr<AdmissionControl> admission;
+
+        //host with this prefix is treated as path to unix domain socket, f.e. "unix:/var/run/redis.sock". Port is ignored for such hosts
+        static constexpr const char* unix_socket_prefix = "unix:";
+        static constexpr size_t unix_socket_prefix_size = 5;
+
+        bool is_unix_socket() const {
+            return host.compare(0, unix_socket_prefix_size, unix_socket_prefix) == 0;
+        }
+
+        std::string get_unix_socket_path() const {
+            return host.substr(unix_socket_prefix_size);
+        }
+
         bool operator==(const ConnectionParam& other) const {
             return
                     host == other.host &&
-                    port == other.port &&
+                    (port == other.port || is_unix_socket()) &&
                     password == other.password &&
                     db_num == other.db_num &&
                     prefix == other.prefix &&
@@ -28,7 +57,14 @@ namespace Redis {
                     operation_timeout_ms == other.operation_timeout_ms &&
                     reconnect_on_failure == other.reconnect_on_failure &&
                     throw_on_error == other.throw_on_error &&
-                    split_long_commands == other.split_long_commands;
+                    split_long_commands == other.split_long_commands &&
+                    tcp_nodelay == other.tcp_nodelay &&
+                    tcp_keepalive == other.tcp_keepalive &&
+                    send_buffer_size == other.send_buffer_size &&
+                    recv_buffer_size == other.recv_buffer_size &&
+                    busy_poll_us == other.busy_poll_us &&
+                    codec == other.codec &&
+                    admission == other.admission;
         }
         bool operator!=(const ConnectionParam& other) const {
             return !operator==(other);
@@ -76,6 +112,31 @@ namespace Redis {
         inline static void set_split_long_commands(bool split_long_commands) {
             default_connection_param.split_long_commands = split_long_commands;
         }
+        inline static void set_default_tcp_nodelay(bool tcp_nodelay) {
+            default_connection_param.tcp_nodelay = tcp_nodelay;
+        }
+
+        inline static void set_default_tcp_keepalive(bool tcp_keepalive) {
+            default_connection_param.tcp_keepalive = tcp_keepalive;
+        }
+
+        inline static void set_default_send_buffer_size(unsigned int send_buffer_size) {
+            default_connection_param.send_buffer_size = send_buffer_size;
+        }
+
+        inline static void set_default_recv_buffer_size(unsigned int recv_buffer_size) {
+            default_connection_param.recv_buffer_size = recv_buffer_size;
+        }
+
+        inline static void set_default_busy_poll_us(unsigned int busy_poll_us) {
+            default_connection_param.busy_poll_us = busy_poll_us;
+        }
+
+        //TODO: thread safety. This one is not thread safe. It cannot be used while other operations with library are in progress
+        inline static void set_default_codec(std::shared_ptr<const ValueCodec> codec) {
+            default_connection_param.codec = codec;
+        }
+
         inline static const ConnectionParam &get_default_connection_param() {
             return default_connection_param;
         }
@@ -90,11 +151,23 @@ namespace Redis {
                 unsigned int operation_timeout_ms = default_connection_param.operation_timeout_ms,
                 bool try_reconnect_on_failure = default_connection_param.reconnect_on_failure,
                 bool throw_on_error = default_connection_param.throw_on_error,
-                bool split_long_commands = default_connection_param.split_long_commands
+                bool split_long_commands = default_connection_param.split_long_commands,
+                bool tcp_nodelay = default_connection_param.tcp_nodelay,
+                bool tcp_keepalive = default_connection_param.tcp_keepalive,
+                unsigned int send_buffer_size = default_connection_param.send_buffer_size,
+                unsigned int recv_buffer_size = default_connection_param.recv_buffer_size,
+                unsigned int busy_poll_us = default_connection_param.busy_poll_us,
+                std::shared_ptr<const ValueCodec> codec = default_connection_param.codec,
+                std::shared_ptr<AdmissionControl> admission = nullptr
         );
         ConnectionParam(ConnectionParam &&other);
         ConnectionParam(const ConnectionParam &) = default;
         ConnectionParam &operator=(const ConnectionParam &) = default;
         unsigned long long get_hash() const;
+
+        /* Copy with only the fields which define physical connection: endpoint, auth, db and socket options.
+        *  Client side settings (prefix, timeouts, error policy, codec, admission) are reset, so Pool can share sockets between params which differ only in them
+        * */
+        ConnectionParam get_endpoint_param() const;
     };
 }
\ No newline at end of file
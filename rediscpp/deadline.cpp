@@ -0,0 +1,46 @@
+#include "deadline.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace Redis {
+    static thread_local const Deadline* current_deadline = nullptr;
+
+    Deadline::Deadline(unsigned int timeout_ms) :
+        time_point(Clock::now() + std::chrono::milliseconds(timeout_ms))
+    {}
+
+    Deadline::Deadline(Clock::time_point _time_point) :
+        time_point(_time_point)
+    {}
+
+    Deadline::Clock::time_point Deadline::get_time_point() const {
+        return time_point;
+    }
+
+    bool Deadline::is_expired() const {
+        return Clock::now() >= time_point;
+    }
+
+    unsigned int Deadline::get_remaining_ms() const {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(time_point - Clock::now()).count();
+        if(remaining <= 0) {
+            return 0;
+        }
+        return static_cast<unsigned int>(std::min<long long>(remaining, std::numeric_limits<unsigned int>::max()));
+    }
+
+    const Deadline* Deadline::current() {
+        return current_deadline;
+    }
+
+    DeadlineScope::DeadlineScope(const Deadline& deadline) :
+        effective(current_deadline != nullptr ? std::min(deadline.time_point, current_deadline->time_point) : deadline.time_point),
+        previous(current_deadline)
+    {
+        current_deadline = &effective;
+    }
+
+    DeadlineScope::~DeadlineScope() {
+        current_deadline = previous;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+#include <chrono>
+namespace Redis {
+    /**
+    * Point in time by which a request has to be done.
+    * While DeadlineScope is alive, commands of the thread get socket timeout of min(operation_timeout_ms, remaining time),
+    * and fail with Connection::Error::DEADLINE_EXCEEDED without sending anything once the deadline has passed.
+    * Server side timeout of blocking commands (BLPOP, BRPOP, BRPOPLPUSH) is capped by the deadline, their socket timeout is extended to cover it.
+    * Scopes nest, the earliest deadline wins.
+    *
+    *  F.e. :
+    *  Redis::DeadlineScope scope(Redis::Deadline(50));
+    *  conn.get("key", value);
+    * */
+    class Deadline {
+    public:
+        typedef std::chrono::steady_clock Clock;
+
+        /* timeout_ms from now */
+        explicit Deadline(unsigned int timeout_ms);
+        explicit Deadline(Clock::time_point time_point);
+
+        Clock::time_point get_time_point() const;
+        bool is_expired() const;
+        /* 0 if expired */
+        unsigned int get_remaining_ms() const;
+
+        /* Innermost deadline of the calling thread, nullptr if there is no scope */
+        static const Deadline* current();
+
+    private:
+        friend class DeadlineScope;
+        Clock::time_point time_point;
+    };
+
+    /* Sets deadline for the calling thread. Scopes must be destroyed in reverse order of creation, which is natural for stack objects */
+    class DeadlineScope {
+    public:
+        explicit DeadlineScope(const Deadline& deadline);
+        ~DeadlineScope();
+        DeadlineScope(const DeadlineScope& other) = delete;
+        DeadlineScope& operator=(const DeadlineScope& other) = delete;
+    private:
+        Deadline effective;
+        const Deadline* previous;
+    };
+}
\ No newline at end of file
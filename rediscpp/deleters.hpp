@@ -0,0 +1,19 @@
+#pragma once
+#include <hiredis/hiredis.h>
+namespace Redis {
+    struct ReplyDeleter {
+        void operator()(redisReply* r) {
+            if(r != nullptr) {
+                freeReplyObject(r);
+            }
+        }
+    };
+
+    struct ContextDeleter {
+        void operator()(redisContext* c) {
+            if (c != nullptr) {
+                redisFree(c);
+            }
+        }
+    };
+}
@@ -0,0 +1,274 @@
+#include "hedged_reader.hpp"
+#include "pool.hpp"
+#include "exception.hpp"
+#include "log.hpp"
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <functional>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+
+namespace Redis {
+    class HedgedReader::Impl {
+        friend class HedgedReader;
+        typedef std::function<bool(Connection&)> ReplyReader;
+        static constexpr size_t latency_window = 1024;
+        static constexpr size_t recalc_interval = 64;
+        //Hedges allowed regardless of budget, so hedging works right after start
+        static constexpr double budget_burst = 10;
+
+        std::vector<ConnectionParam> replicas;
+        Options options;
+        std::atomic<unsigned long long> request_count;
+        std::atomic<unsigned long long> hedge_count;
+        std::atomic<unsigned long long> hedge_win_count;
+        std::atomic<unsigned long long> next_replica;
+        std::atomic<unsigned int> delay_us;
+        std::mutex lock;
+        std::vector<double> latencies;
+        size_t latency_pos;
+        size_t samples_since_recalc;
+        std::string err;
+
+        Impl(const std::vector<ConnectionParam>& _replicas, const Options& _options) :
+            replicas(_replicas),
+            options(_options),
+            request_count(0),
+            hedge_count(0),
+            hedge_win_count(0),
+            next_replica(0),
+            delay_us(_options.max_delay_us),
+            lock(),
+            latencies(),
+            latency_pos(0),
+            samples_since_recalc(0),
+            err()
+        {
+            if(replicas.empty()) {
+                throw Redis::Exception("No replicas passed to Redis::HedgedReader");
+            }
+            latencies.reserve(latency_window);
+        }
+
+        void set_error(const std::string& error) {
+            rediscpp_debug(LL::WARNING, "HedgedReader: " << error);
+            std::lock_guard<std::mutex> guard(lock);
+            err = error;
+        }
+
+        void add_latency(double latency_us) {
+            std::lock_guard<std::mutex> guard(lock);
+            if(latencies.size() < latency_window) {
+                latencies.push_back(latency_us);
+            }
+            else {
+                latencies[latency_pos] = latency_us;
+                latency_pos = (latency_pos + 1) % latency_window;
+            }
+            if(++samples_since_recalc < recalc_interval) {
+                return;
+            }
+            samples_since_recalc = 0;
+            std::vector<double> sorted(latencies);
+            size_t index = static_cast<size_t>(options.percentile * static_cast<double>(sorted.size() - 1));
+            std::nth_element(sorted.begin(), sorted.begin() + static_cast<long>(index), sorted.end());
+            double delay = std::min(std::max(sorted[index], static_cast<double>(options.min_delay_us)), static_cast<double>(options.max_delay_us));
+            delay_us.store(static_cast<unsigned int>(delay), std::memory_order_relaxed);
+        }
+
+        bool may_hedge() {
+            if(replicas.size() < 2) {
+                return false;
+            }
+            double allowed = options.budget * static_cast<double>(request_count.load(std::memory_order_relaxed)) + budget_burst;
+            return static_cast<double>(hedge_count.load(std::memory_order_relaxed)) < allowed;
+        }
+
+        /* args[1..key_count] are keys and get prefix of the connection */
+        static bool send(Connection& conn, const std::vector<std::string>& args, size_t key_count) {
+            std::vector<std::string> prefixed_keys;
+            std::vector<const char*> commands;
+            std::vector<size_t> sizes;
+            prefixed_keys.reserve(key_count);
+            for(size_t i = 0; i < args.size(); i++) {
+                if(i >= 1 && i <= key_count && !conn.get_prefix().empty()) {
+                    prefixed_keys.push_back(conn.get_prefix() + args[i]);
+                    commands.push_back(prefixed_keys.back().c_str());
+                    sizes.push_back(prefixed_keys.back().size());
+                }
+                else {
+                    commands.push_back(args[i].c_str());
+                    sizes.push_back(args[i].size());
+                }
+            }
+            return conn.append_command(commands, sizes) && conn.flush_commands();
+        }
+
+        bool read(const std::vector<std::string>& args, size_t key_count, const ReplyReader& reader) {
+            request_count++;
+            const size_t first = static_cast<size_t>(next_replica++ % replicas.size());
+            const unsigned int timeout_ms = replicas[first].operation_timeout_ms;
+            //Entries are erased when replica fails, so each keeps its send time and whether it is the hedge
+            std::vector<PoolWrapper> in_flight;
+            std::vector<double> sent_at;
+            std::vector<bool> is_hedge;
+            size_t attempts = 0;
+            //Sends request to the next replica which accepts it
+            auto launch = [&](bool hedge) {
+                while(attempts < replicas.size()) {
+                    const ConnectionParam& replica = replicas[(first + attempts++) % replicas.size()];
+                    PoolWrapper conn = Pool::instance().get(replica);
+                    if(send(*conn, args, key_count)) {
+                        in_flight.push_back(std::move(conn));
+                        sent_at.push_back(microtime());
+                        is_hedge.push_back(hedge);
+                        return true;
+                    }
+                    set_error("Could not send request to " + replica.host + ":" + std::to_string(replica.port) + ": " + conn->get_error());
+                }
+                return false;
+            };
+            if(!launch(false)) {
+                return false;
+            }
+            const double start = sent_at[0];
+            bool hedged = false;
+            std::vector<struct pollfd> fds;
+            while(true) {
+                double elapsed_ms = (microtime() - start) * 1000;
+                if(elapsed_ms >= timeout_ms) {
+                    for(size_t i = 0; i < in_flight.size(); i++) {
+                        in_flight[i]->abandon();
+                    }
+                    set_error("Timeout waiting for replicas");
+                    return false;
+                }
+                int wait_ms = static_cast<int>(timeout_ms - elapsed_ms) + 1;
+                if(!hedged && may_hedge()) {
+                    double hedge_at_ms = delay_us.load(std::memory_order_relaxed) / 1000.0;
+                    wait_ms = hedge_at_ms > elapsed_ms ? static_cast<int>(hedge_at_ms - elapsed_ms) : 0;
+                }
+                fds.resize(in_flight.size());
+                for(size_t i = 0; i < in_flight.size(); i++) {
+                    fds[i].fd = in_flight[i]->get_fd();
+                    fds[i].events = POLLIN;
+                    fds[i].revents = 0;
+                }
+                int ret = poll(fds.data(), static_cast<nfds_t>(fds.size()), wait_ms);
+                if(ret < 0 && errno != EINTR) {
+                    set_error(std::string("poll failed: ") + std::strerror(errno));
+                    for(size_t i = 0; i < in_flight.size(); i++) {
+                        in_flight[i]->abandon();
+                    }
+                    return false;
+                }
+                if(ret < 0) {
+                    //Interrupted by signal, wait is recomputed
+                    continue;
+                }
+                if(ret == 0) {
+                    if(!hedged && may_hedge()) {
+                        hedged = true;
+                        hedge_count++;
+                        //If there is no replica to hedge to, just keep waiting for the first one
+                        launch(true);
+                    }
+                    continue;
+                }
+                for(size_t i = 0; i < fds.size(); i++) {
+                    if(fds[i].revents == 0) {
+                        continue;
+                    }
+                    Connection& conn = *in_flight[i];
+                    bool fetched = conn.fetch_reply();
+                    if(!fetched && conn.get_errno() != Connection::Error::REPLY_ERR) {
+                        //Replica failed. Keep waiting for others or fail over to the next one
+                        set_error("Replica failed: " + conn.get_error());
+                        in_flight.erase(in_flight.begin() + static_cast<long>(i));
+                        sent_at.erase(sent_at.begin() + static_cast<long>(i));
+                        is_hedge.erase(is_hedge.begin() + static_cast<long>(i));
+                        if(in_flight.empty() && !launch(false)) {
+                            return false;
+                        }
+                        break;
+                    }
+                    //Slow replica's latency is at least elapsed time, which keeps percentile honest while hedging
+                    add_latency((microtime() - (is_hedge[i] ? start : sent_at[i])) * 1000000);
+                    if(is_hedge[i]) {
+                        hedge_win_count++;
+                    }
+                    for(size_t j = 0; j < in_flight.size(); j++) {
+                        if(j != i) {
+                            in_flight[j]->abandon();
+                        }
+                    }
+                    if(!fetched) {
+                        set_error(conn.get_error());
+                        return false;
+                    }
+                    return reader(conn);
+                }
+            }
+        }
+    };
+    constexpr size_t HedgedReader::Impl::latency_window;
+    constexpr size_t HedgedReader::Impl::recalc_interval;
+    constexpr double HedgedReader::Impl::budget_burst;
+
+    HedgedReader::HedgedReader(const std::vector<ConnectionParam>& replicas, const Options& options) :
+        d(new HedgedReader::Impl(replicas, options))
+    {}
+
+    HedgedReader::~HedgedReader() {
+        if(d != nullptr) {
+            delete d;
+        }
+    }
+
+    bool HedgedReader::get(const std::string& key, std::string& result) {
+        return d->read({"GET", key}, 1, [&](Connection& conn) {
+            return conn.read_string_reply(result);
+        });
+    }
+
+    bool HedgedReader::get(const StringKeyHolder& keys, StringValueHolder&& result) {
+        std::vector<std::string> args;
+        args.reserve(keys.size() + 1);
+        args.push_back("MGET");
+        for(size_t i = 0; i < keys.size(); i++) {
+            args.push_back(keys[i]);
+        }
+        return d->read(args, keys.size(), [&](Connection& conn) {
+            return conn.read_string_array_reply(std::move(result));
+        });
+    }
+
+    bool HedgedReader::hget(const std::string& key, const std::string& field, std::string& value) {
+        return d->read({"HGET", key, field}, 1, [&](Connection& conn) {
+            return conn.read_string_reply(value);
+        });
+    }
+
+    unsigned int HedgedReader::get_delay_us() {
+        return d->delay_us.load();
+    }
+
+    unsigned long long HedgedReader::get_request_count() {
+        return d->request_count.load();
+    }
+
+    unsigned long long HedgedReader::get_hedge_count() {
+        return d->hedge_count.load();
+    }
+
+    unsigned long long HedgedReader::get_hedge_win_count() {
+        return d->hedge_win_count.load();
+    }
+
+    std::string HedgedReader::get_error() {
+        std::lock_guard<std::mutex> guard(d->lock);
+        return d->err;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "connection.hpp"
+namespace Redis {
+    /**
+    * Reads from a group of replicas holding the same data with hedging:
+    * if the chosen replica doesn't answer within adaptive delay, the same read is sent to the next replica and the first answer wins.
+    * Delay follows given percentile of recently observed latencies, so only the slow tail is hedged.
+    * Number of hedges is limited by budget - a fraction of all requests, so a slow cluster is not flooded with duplicates.
+    * Connections are leased from Pool::instance(). Connection which lost the race is dropped and reconnected on next use,
+    * so replicas should have reconnect_on_failure enabled.
+    * Thread safe.
+    *
+    *  F.e. :
+    *  Redis::HedgedReader reader({Redis::ConnectionParam("10.0.0.1"), Redis::ConnectionParam("10.0.0.2")});
+    *  reader.get("key", value);
+    * */
+    class HedgedReader {
+    public:
+        struct Options {
+            //Latency percentile after which the read is hedged
+            double percentile;
+            //Bounds of hedge delay. Delay starts at max until enough latencies are observed
+            unsigned int min_delay_us;
+            unsigned int max_delay_us;
+            //Max share of requests which can be hedged
+            double budget;
+            Options() : percentile(0.95), min_delay_us(200), max_delay_us(20000), budget(0.05) {}
+        };
+
+        HedgedReader(const std::vector<ConnectionParam>& replicas, const Options& options = Options());
+        ~HedgedReader();
+        HedgedReader(const HedgedReader& other) = delete;
+        HedgedReader& operator=(const HedgedReader& other) = delete;
+
+        /* Get the value of a key */
+        bool get(const std::string& key, std::string& result);
+
+        /* Get the value of a bunch of keys */
+        bool get(const StringKeyHolder& keys, StringValueHolder&& result);
+
+        /* Get the value of a hash field */
+        bool hget(const std::string& key, const std::string& field, std::string& value);
+
+        /* Current hedge delay */
+        unsigned int get_delay_us();
+        unsigned long long get_request_count();
+        unsigned long long get_hedge_count();
+        /* Hedged requests which were answered by the second replica first */
+        unsigned long long get_hedge_win_count();
+
+        /* Error of the last failed read */
+        std::string get_error();
+
+    private:
+        class Impl;
+        Impl* d;
+    };
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <cwchar>
+#include <type_traits>
 namespace Redis {
 
     /* A some kind of Adapter class which can proxy element fetching from different container types.
@@ -41,7 +42,8 @@ namespace Redis {
         KeyHolder(const std::pair<Iter, Iter>& iter_pair) : data(iter_pair.first, iter_pair.second), type(DataType::REFS) {
             redis_assert(!data.vector_of_ref.empty());
         }
-        template <class Container>
+        //Single keys are excluded, so overloads taking a key and a KeyHolder are not ambiguous for string literals
+        template <class Container, class = typename std::enable_if<!std::is_convertible<const Container&, Key>::value>::type>
         KeyHolder(const Container& keys) : data(keys.begin(), keys.end()), type(DataType::REFS) {
             redis_assert(!keys.empty());
         }
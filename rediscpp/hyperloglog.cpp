@@ -0,0 +1,262 @@
+#include "hyperloglog.hpp"
+#include "named_pool.hpp"
+#include "log.hpp"
+#include <hiredis/hiredis.h>
+#include <mutex>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstring>
+
+namespace Redis {
+    namespace {
+        //Layout of redis hyperloglog.c
+        const size_t header_size = 16;
+        const size_t register_bits = 6;
+        const size_t dense_size = header_size + (HyperLogLog::register_count * register_bits + 7) / 8;
+        const int q = 64 - 14;
+        const double alpha_inf = 0.721347520444481703680;
+
+        double sigma(double x) {
+            if(x == 1.0) {
+                return std::numeric_limits<double>::infinity();
+            }
+            double previous, y = 1.0, z = x;
+            do {
+                x *= x;
+                previous = z;
+                z += x * y;
+                y += y;
+            } while(previous != z);
+            return z;
+        }
+
+        double tau(double x) {
+            if(x == 0.0 || x == 1.0) {
+                return 0.0;
+            }
+            double previous, y = 1.0, z = 1 - x;
+            do {
+                x = std::sqrt(x);
+                previous = z;
+                y *= 0.5;
+                z -= std::pow(1 - x, 2) * y;
+            } while(previous != z);
+            return z / 3;
+        }
+    }
+
+    constexpr size_t HyperLogLog::register_count;
+
+    HyperLogLog::HyperLogLog() :
+        registers(register_count, 0)
+    {}
+
+    bool HyperLogLog::load(const char* data, size_t size) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+        if(size < header_size || std::memcmp(data, "HYLL", 4) != 0) {
+            return false;
+        }
+        std::vector<unsigned char> loaded(register_count, 0);
+        if(bytes[4] == 0) {
+            //Dense: 6 bit registers, least significant bits first
+            if(size != dense_size) {
+                return false;
+            }
+            const unsigned char* dense = bytes + header_size;
+            for(size_t i = 0; i < register_count; i++) {
+                size_t byte = i * register_bits / 8;
+                unsigned int shift = static_cast<unsigned int>(i * register_bits % 8);
+                unsigned int value = static_cast<unsigned int>(dense[byte]) >> shift;
+                if(byte + 1 < dense_size - header_size) {
+                    value |= static_cast<unsigned int>(dense[byte + 1]) << (8 - shift);
+                }
+                loaded[i] = static_cast<unsigned char>(value & 63);
+            }
+        }
+        else if(bytes[4] == 1) {
+            //Sparse: runs of ZERO (00xxxxxx), XZERO (01xxxxxx yyyyyyyy) and VAL (1vvvvvxx)
+            size_t index = 0;
+            for(size_t i = header_size; i < size; i++) {
+                size_t run;
+                unsigned char value = 0;
+                if((bytes[i] & 0xC0) == 0) {
+                    run = (bytes[i] & 0x3F) + 1u;
+                }
+                else if((bytes[i] & 0xC0) == 0x40) {
+                    if(++i == size) {
+                        return false;
+                    }
+                    run = (static_cast<size_t>(bytes[i - 1] & 0x3F) << 8 | bytes[i]) + 1;
+                }
+                else {
+                    value = static_cast<unsigned char>(((bytes[i] >> 2) & 0x1F) + 1);
+                    run = (bytes[i] & 0x3u) + 1;
+                }
+                if(index + run > register_count) {
+                    return false;
+                }
+                std::fill(loaded.begin() + static_cast<long>(index), loaded.begin() + static_cast<long>(index + run), value);
+                index += run;
+            }
+            if(index != register_count) {
+                return false;
+            }
+        }
+        else {
+            return false;
+        }
+        registers.swap(loaded);
+        return true;
+    }
+
+    void HyperLogLog::merge(const HyperLogLog& other) {
+        for(size_t i = 0; i < register_count; i++) {
+            registers[i] = std::max(registers[i], other.registers[i]);
+        }
+    }
+
+    long long HyperLogLog::count() const {
+        //Estimator of Otmar Ertl, as in redis 5+
+        const double m = static_cast<double>(register_count);
+        double histogram[64] = {0};
+        for(size_t i = 0; i < register_count; i++) {
+            histogram[registers[i] & 63]++;
+        }
+        double z = m * tau((m - histogram[q + 1]) / m);
+        for(int j = q; j >= 1; j--) {
+            z += histogram[j];
+            z *= 0.5;
+        }
+        z += m * sigma(histogram[0] / m);
+        return std::llround(alpha_inf * m * m / z);
+    }
+
+    const std::vector<unsigned char>& HyperLogLog::get_registers() const {
+        return registers;
+    }
+
+    class ShardedHyperLogLog::Impl {
+        friend class ShardedHyperLogLog;
+
+        NamedPool& pool;
+        std::mutex lock;
+        std::string err;
+
+        explicit Impl(const std::string& pool_name) :
+            pool(NamedPool::get_pool(pool_name)),
+            lock(),
+            err()
+        {}
+
+        void set_error(const std::string& error) {
+            rediscpp_debug(LL::WARNING, "ShardedHyperLogLog: " << error);
+            std::lock_guard<std::mutex> guard(lock);
+            err = error;
+        }
+
+        static bool send(Connection& conn, const std::vector<std::string>& keys, const std::vector<size_t>& indices) {
+            for(size_t i = 0; i < indices.size(); i++) {
+                std::string key = conn.get_prefix() + keys[indices[i]];
+                if(!conn.append_command({"GET", key.c_str()}, {3, key.size()})) {
+                    if(i != 0) {
+                        conn.abandon();
+                    }
+                    return false;
+                }
+            }
+            return conn.flush_commands();
+        }
+
+        bool receive(Connection& conn, const std::vector<std::string>& keys, const std::vector<size_t>& indices, HyperLogLog& result) {
+            HyperLogLog value;
+            for(size_t i = 0; i < indices.size(); i++) {
+                if(!conn.fetch_reply()) {
+                    set_error(conn.get_error());
+                    if(conn.get_errno() != Connection::Error::REPLY_ERR) {
+                        return false;
+                    }
+                    //Rest of replies are still read to keep connection in sync
+                    for(size_t j = i + 1; j < indices.size(); j++) {
+                        conn.fetch_reply();
+                    }
+                    return false;
+                }
+                const redisReply* reply = conn.get_reply();
+                if(reply->type == REDIS_REPLY_NIL) {
+                    continue;
+                }
+                if(reply->type != REDIS_REPLY_STRING || !value.load(reply->str, reply->len)) {
+                    set_error("Key " + keys[indices[i]] + " is not a valid HyperLogLog");
+                    for(size_t j = i + 1; j < indices.size(); j++) {
+                        conn.fetch_reply();
+                    }
+                    return false;
+                }
+                result.merge(value);
+            }
+            return true;
+        }
+
+        bool merge(const std::vector<std::string>& keys, HyperLogLog& result) {
+            result = HyperLogLog();
+            std::vector<const ConnectionParam*> params;
+            std::vector<std::vector<size_t>> groups;
+            for(size_t i = 0; i < keys.size(); i++) {
+                const ConnectionParam* param = &pool.get_connection_param(keys[i]);
+                size_t group = static_cast<size_t>(std::find(params.begin(), params.end(), param) - params.begin());
+                if(group == params.size()) {
+                    params.push_back(param);
+                    groups.push_back(std::vector<size_t>());
+                }
+                groups[group].push_back(i);
+            }
+            bool ok = true;
+            std::vector<PoolWrapper> conns;
+            std::vector<bool> sent;
+            conns.reserve(groups.size());
+            for(size_t i = 0; i < groups.size(); i++) {
+                conns.push_back(pool.get(keys[groups[i][0]]));
+                sent.push_back(send(*conns[i], keys, groups[i]));
+                if(!sent[i]) {
+                    set_error(conns[i]->get_error());
+                    ok = false;
+                }
+            }
+            for(size_t i = 0; i < groups.size(); i++) {
+                if(sent[i]) {
+                    ok = receive(*conns[i], keys, groups[i], result) && ok;
+                }
+            }
+            return ok;
+        }
+    };
+
+    ShardedHyperLogLog::ShardedHyperLogLog(const std::string& pool_name) :
+        d(new ShardedHyperLogLog::Impl(pool_name))
+    {}
+
+    ShardedHyperLogLog::~ShardedHyperLogLog() {
+        if(d != nullptr) {
+            delete d;
+        }
+    }
+
+    bool ShardedHyperLogLog::merge(const std::vector<std::string>& keys, HyperLogLog& result) {
+        return d->merge(keys, result);
+    }
+
+    bool ShardedHyperLogLog::count(const std::vector<std::string>& keys, long long& result) {
+        HyperLogLog merged;
+        if(!merge(keys, merged)) {
+            return false;
+        }
+        result = merged.count();
+        return true;
+    }
+
+    std::string ShardedHyperLogLog::get_error() {
+        std::lock_guard<std::mutex> guard(d->lock);
+        return d->err;
+    }
+}
\ No newline at end of file
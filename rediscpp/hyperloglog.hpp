@@ -0,0 +1,65 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "connection.hpp"
+namespace Redis {
+    /**
+    * Registers of redis HyperLogLog, decoded from the value PFADD stores (both sparse and dense encodings).
+    * Merge takes maximum of registers and count uses the same estimator as redis, so merging values locally
+    * gives exactly what PFMERGE or PFCOUNT of several keys would give on a single server.
+    * */
+    class HyperLogLog {
+    public:
+        static constexpr size_t register_count = 16384;
+
+        /* Empty set */
+        HyperLogLog();
+
+        /* Parses value of a HyperLogLog key. Returns false if it is not a valid HyperLogLog */
+        bool load(const char* data, size_t size);
+
+        /* Union with other set */
+        void merge(const HyperLogLog& other);
+
+        /* Approximated cardinality */
+        long long count() const;
+
+        const std::vector<unsigned char>& get_registers() const;
+
+    private:
+        std::vector<unsigned char> registers;
+    };
+
+    /**
+    * Cardinality of union of HyperLogLogs spread over shards of NamedPool, without cross-shard PFMERGE.
+    * Raw values are fetched with GET, one pipeline per shard with all shards in flight at once, and merged locally.
+    * Values are read as stored, so pool shouldn't have ValueCodec which transforms them.
+    * Thread safe.
+    *
+    *  F.e. unique visitors of all pages :
+    *  Redis::ShardedHyperLogLog visitors("pages");
+    *  long long unique;
+    *  visitors.count(page_keys, unique);
+    * */
+    class ShardedHyperLogLog {
+    public:
+        /* NamedPool must be created before */
+        explicit ShardedHyperLogLog(const std::string& pool_name);
+        ~ShardedHyperLogLog();
+        ShardedHyperLogLog(const ShardedHyperLogLog& other) = delete;
+        ShardedHyperLogLog& operator=(const ShardedHyperLogLog& other) = delete;
+
+        /* Union of keys. Missing keys are empty sets */
+        bool merge(const std::vector<std::string>& keys, HyperLogLog& result);
+
+        /* Approximated cardinality of union of keys */
+        bool count(const std::vector<std::string>& keys, long long& result);
+
+        /* Error of the last failed call */
+        std::string get_error();
+
+    private:
+        class Impl;
+        Impl* d;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,209 @@
+#include "list_queue.hpp"
+#include "script.hpp"
+#include "pool.hpp"
+#include "log.hpp"
+#include <hiredis/hiredis.h>
+#include <memory>
+
+namespace Redis {
+    class ListQueue::Impl {
+        friend class ListQueue;
+        static const Script move_script;
+        std::string name;
+        ConnectionParam param;
+        Options options;
+        //Owned by the queue, so blocking waits don't hold pooled connections
+        std::unique_ptr<Connection> consumer_connection;
+        std::string err;
+
+        Impl(const std::string& _name, const ConnectionParam& _param, const Options& _options) :
+            name(_name),
+            param(_param),
+            options(_options),
+            consumer_connection(),
+            err()
+        {
+            if(options.recover_batch_size == 0) {
+                options.recover_batch_size = 1;
+            }
+        }
+
+        bool set_error(const std::string& error) {
+            rediscpp_debug(LL::WARNING, "ListQueue " << name << ": " << error);
+            err = error;
+            return false;
+        }
+
+        Connection& get_consumer_connection() {
+            if(consumer_connection == nullptr) {
+                consumer_connection.reset(new Connection(param));
+            }
+            return *consumer_connection;
+        }
+
+        /* Moves up to count items in one round trip, stops at empty source. moved receives items which were moved */
+        bool move(Connection& conn, const std::string& source, const std::string& destination, size_t count, Connection::KeyVec& moved) {
+            Connection::KeyVec items;
+            if(!move_script.run(conn, {source, destination}, {std::to_string(count)}, items)) {
+                return set_error("RPOPLPUSH failed: " + conn.get_error());
+            }
+            moved.insert(moved.end(), items.begin(), items.end());
+            return true;
+        }
+
+        bool pop_reliable(size_t max_count, long long timeout, Connection::KeyVec& items) {
+            Connection& conn = get_consumer_connection();
+            if(!move(conn, name, options.processing_list, max_count, items)) {
+                return false;
+            }
+            if(!items.empty() || timeout < 0) {
+                return true;
+            }
+            std::string item;
+            if(!conn.blmove(name, options.processing_list, Connection::ListDirection::RIGHT, Connection::ListDirection::LEFT, timeout, item)) {
+                return set_error("BLMOVE failed: " + conn.get_error());
+            }
+            if(!item.empty()) {
+                items.push_back(item);
+            }
+            return true;
+        }
+
+        bool pop(size_t max_count, long long timeout, Connection::KeyVec& items) {
+            Connection& conn = get_consumer_connection();
+            if(!conn.rpop(name, max_count, items)) {
+                return set_error("RPOP failed: " + conn.get_error());
+            }
+            if(!items.empty() || timeout < 0) {
+                return true;
+            }
+            std::string chosen_key, item;
+            if(!conn.brpop(std::vector<std::string>{name}, timeout, chosen_key, item)) {
+                return set_error("BRPOP failed: " + conn.get_error());
+            }
+            if(!chosen_key.empty()) {
+                items.push_back(item);
+            }
+            return true;
+        }
+    };
+
+    const Script ListQueue::Impl::move_script(
+        "local moved = {} "
+        "for i = 1, tonumber(ARGV[1]) do "
+            "local item = redis.call('RPOPLPUSH', KEYS[1], KEYS[2]) "
+            "if not item then break end "
+            "moved[i] = item "
+        "end "
+        "return moved"
+    );
+
+    ListQueue::ListQueue(const std::string& name, const ConnectionParam& param, const Options& options) :
+        d(new ListQueue::Impl(name, param, options))
+    {}
+
+    ListQueue::~ListQueue() {
+        if(d != nullptr) {
+            delete d;
+        }
+    }
+
+    bool ListQueue::push(const std::string& item) {
+        PoolWrapper conn = Pool::instance().get(d->param);
+        return conn->lpush(d->name, item) || d->set_error("LPUSH failed: " + conn->get_error());
+    }
+
+    bool ListQueue::push(const StringKeyHolder& items) {
+        if(items.size() == 0) {
+            return true;
+        }
+        //LPUSH of a b c leaves c at the head, so items keep their order towards the tail
+        PoolWrapper conn = Pool::instance().get(d->param);
+        return conn->lpush(d->name, items) || d->set_error("LPUSH failed: " + conn->get_error());
+    }
+
+    bool ListQueue::pop(size_t max_count, long long timeout, Connection::KeyVec& items) {
+        items.clear();
+        if(max_count == 0) {
+            return true;
+        }
+        return d->options.processing_list.empty() ? d->pop(max_count, timeout, items) : d->pop_reliable(max_count, timeout, items);
+    }
+
+    bool ListQueue::ack(const StringKeyHolder& items, size_t& acknowledged) {
+        acknowledged = 0;
+        if(d->options.processing_list.empty() || items.size() == 0) {
+            return true;
+        }
+        PoolWrapper conn = Pool::instance().get(d->param);
+        const std::string prefixed_list = conn->get_prefix() + d->options.processing_list;
+        std::vector<const char*> commands = {"LREM", prefixed_list.c_str(), "1", nullptr};
+        std::vector<size_t> sizes = {4, prefixed_list.size(), 1, 0};
+        for(size_t i = 0; i < items.size(); i++) {
+            commands[3] = items[i].c_str();
+            sizes[3] = items[i].size();
+            if(!conn->append_command(commands, sizes)) {
+                if(i != 0) {
+                    conn->abandon();
+                }
+                return d->set_error("LREM failed: " + conn->get_error());
+            }
+        }
+        if(!conn->flush_commands()) {
+            return d->set_error("LREM failed: " + conn->get_error());
+        }
+        bool ok = true;
+        for(size_t i = 0; i < items.size(); i++) {
+            if(!conn->fetch_reply()) {
+                if(conn->get_errno() != Connection::Error::REPLY_ERR) {
+                    return d->set_error("LREM failed: " + conn->get_error());
+                }
+                ok = d->set_error("LREM failed: " + conn->get_error());
+                continue;
+            }
+            acknowledged += static_cast<size_t>(conn->get_reply()->integer);
+        }
+        return ok;
+    }
+
+    bool ListQueue::ack(const StringKeyHolder& items) {
+        size_t acknowledged;
+        return ack(items, acknowledged);
+    }
+
+    bool ListQueue::recover(size_t& recovered) {
+        recovered = 0;
+        if(d->options.processing_list.empty()) {
+            return true;
+        }
+        return recover(d->options.processing_list, recovered);
+    }
+
+    bool ListQueue::recover(const std::string& processing_list, size_t& recovered) {
+        recovered = 0;
+        PoolWrapper conn = Pool::instance().get(d->param);
+        Connection::KeyVec moved;
+        //Oldest items are moved first, recovered items are popped after those already waiting
+        do {
+            moved.clear();
+            if(!d->move(*conn, processing_list, d->name, d->options.recover_batch_size, moved)) {
+                return false;
+            }
+            recovered += moved.size();
+        } while(moved.size() == d->options.recover_batch_size);
+        return true;
+    }
+
+    bool ListQueue::size(long long& length) {
+        PoolWrapper conn = Pool::instance().get(d->param);
+        return conn->llen(d->name, length) || d->set_error("LLEN failed: " + conn->get_error());
+    }
+
+    const std::string& ListQueue::get_name() const {
+        return d->name;
+    }
+
+    std::string ListQueue::get_error() {
+        return d->err;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+#include <string>
+#include "connection.hpp"
+namespace Redis {
+    /**
+    * FIFO queue of items in a redis list. Producers prepend batches with LPUSH, split into pipelined commands of
+    * Connection::max_elements_per_push items. Consumers take up to max_count items from the tail in one round trip,
+    * with RPOP count, or with a script looping RPOPLPUSH until the queue is empty in reliable mode.
+    *
+    * In reliable mode popped items are moved atomically to processing_list and stay there until acknowledged,
+    * acknowledgements of a batch are sent as pipelined LREMs in one round trip. Items of a consumer which died are returned to
+    * the queue by recover() of its processing list, so each consumer should have own processing list, f.e. with host name in it.
+    * Delivery is at least once then: item processed but not acknowledged before crash is delivered again.
+    * Empty string items are not supported, empty item means there was nothing to pop.
+    *
+    * When queue is empty, pop waits for the first item with BRPOP or BLMOVE (BRPOPLPUSH before 6.2) on a connection owned by the queue,
+    * so blocked consumers don't hold connections of Pool::instance(). Push, ack and recover use pooled connections.
+    *
+    * Object is not thread safe, use one per thread.
+    *
+    *  F.e. :
+    *  Redis::ListQueue::Options options;
+    *  options.processing_list = "jobs:processing:" + host_name;
+    *  Redis::ListQueue queue("jobs", Redis::ConnectionParam(), options);
+    *  queue.recover(recovered);
+    *  while(queue.pop(100, 1, jobs)) {
+    *      ...
+    *      queue.ack(jobs);
+    *  }
+    * */
+    class ListQueue {
+    public:
+        struct Options {
+            //List where popped items wait for acknowledgement. Empty disables reliable mode
+            std::string processing_list;
+            //Items moved back by one round trip of recover()
+            size_t recover_batch_size;
+            Options() : processing_list(), recover_batch_size(100) {}
+        };
+
+        explicit ListQueue(const std::string& name, const ConnectionParam& param = ConnectionParam(), const Options& options = Options());
+        ~ListQueue();
+        ListQueue(const ListQueue& other) = delete;
+        ListQueue& operator=(const ListQueue& other) = delete;
+
+        /* Appends item to the queue */
+        bool push(const std::string& item);
+
+        /* Appends items to the queue, they are popped in the same order */
+        bool push(const StringKeyHolder& items);
+
+        /*
+        * Pops up to max_count oldest items. If queue is empty waits up to timeout seconds for an item,
+        * 0 waits without limit as blocking list commands do, negative doesn't wait. items are empty on timeout.
+        * Wait is capped by Deadline of the thread
+        */
+        bool pop(size_t max_count, long long timeout, Connection::KeyVec& items);
+
+        /* Removes processed items from processing list. acknowledged - items which were found there */
+        bool ack(const StringKeyHolder& items, size_t& acknowledged);
+        bool ack(const StringKeyHolder& items);
+
+        /* Returns items left in own processing list to the queue */
+        bool recover(size_t& recovered);
+
+        /* Returns items left in processing list of other consumer to the queue. Consumer must not be running */
+        bool recover(const std::string& processing_list, size_t& recovered);
+
+        /* Number of items waiting in the queue */
+        bool size(long long& length);
+
+        const std::string& get_name() const;
+
+        std::string get_error();
+
+    private:
+        class Impl;
+        Impl* d;
+    };
+}
\ No newline at end of file
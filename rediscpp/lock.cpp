@@ -0,0 +1,594 @@
+#include "lock.hpp"
+#include "script.hpp"
+#include "pool.hpp"
+#include "deadline.hpp"
+#include "exception.hpp"
+#include "log.hpp"
+#include <hiredis/hiredis.h>
+#include <set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <random>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+
+namespace Redis {
+    class Lock::Impl {
+        friend class Lock;
+        typedef std::chrono::steady_clock Clock;
+
+        static const Script acquire_fenced_script;
+        static const Script release_script;
+        static const Script extend_script;
+
+        /* Shared with renewal thread */
+        struct State {
+            std::string name;
+            std::string fencing_key;
+            std::string wake_key;
+            std::vector<ConnectionParam> instances;
+            Options options;
+            std::mutex lock;
+            bool held;
+            std::string token;
+            unsigned long long fencing_token;
+            Clock::time_point valid_until;
+            Clock::time_point renew_at;
+
+            State(const std::string& _name, const std::vector<ConnectionParam>& _instances, const Options& _options) :
+                name(_name),
+                fencing_key(_name + ":fencing"),
+                wake_key(_name + ":wake"),
+                instances(_instances),
+                options(_options),
+                lock(),
+                held(false),
+                token(),
+                fencing_token(0),
+                valid_until(),
+                renew_at()
+            {}
+
+            size_t get_quorum() const {
+                return instances.size() / 2 + 1;
+            }
+
+            std::chrono::milliseconds get_drift() const {
+                return std::chrono::milliseconds(static_cast<long long>(options.ttl_ms * options.clock_drift_factor) + 2);
+            }
+        };
+
+        /* Request to one instance. Without script it's SET NX PX */
+        struct Call {
+            const ConnectionParam* instance;
+            const Script* script;
+            std::vector<std::string> keys;
+            std::vector<std::string> args;
+            bool ok;
+            long long result;
+            std::string error;
+
+            Call(const ConnectionParam* _instance, const Script* _script, std::vector<std::string>&& _keys, std::vector<std::string>&& _args) :
+                instance(_instance), script(_script), keys(std::move(_keys)), args(std::move(_args)), ok(false), result(0), error() {}
+            Call(const Call& other) = default;
+            Call& operator=(const Call& other) = default;
+        };
+
+        /* Outcome of the same request to all instances of a lock */
+        struct Votes {
+            size_t granted;
+            size_t answered;
+            unsigned long long max_result;
+            std::string error;
+        };
+
+        /* Extends leases of auto renewed locks in background */
+        class Renewer {
+        public:
+            static Renewer& instance() {
+                static Renewer renewer;
+                return renewer;
+            }
+
+            Renewer() : lock(), wake(), stopping(false), states(), thread() {
+                thread = std::thread(&Renewer::run, this);
+            }
+
+            ~Renewer() {
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    stopping = true;
+                }
+                wake.notify_all();
+                thread.join();
+            }
+
+            Renewer(const Renewer& other) = delete;
+            Renewer& operator=(const Renewer& other) = delete;
+
+            void add(const std::shared_ptr<State>& state) {
+                std::lock_guard<std::mutex> guard(lock);
+                states.insert(state);
+                wake.notify_all();
+            }
+
+            void remove(const std::shared_ptr<State>& state) {
+                std::lock_guard<std::mutex> guard(lock);
+                states.erase(state);
+            }
+
+        private:
+            std::mutex lock;
+            std::condition_variable wake;
+            bool stopping;
+            std::set<std::shared_ptr<State>> states;
+            std::thread thread;
+
+            void run() {
+                std::unique_lock<std::mutex> guard(lock);
+                while(!stopping) {
+                    Clock::time_point now = Clock::now();
+                    Clock::time_point next = now + std::chrono::seconds(1);
+                    std::vector<std::shared_ptr<State>> due;
+                    for(const std::shared_ptr<State>& state : states) {
+                        std::lock_guard<std::mutex> state_guard(state->lock);
+                        if(!state->held) {
+                            continue;
+                        }
+                        if(state->renew_at <= now) {
+                            due.push_back(state);
+                        }
+                        else {
+                            next = std::min(next, state->renew_at);
+                        }
+                    }
+                    if(due.empty()) {
+                        wake.wait_until(guard, next);
+                        continue;
+                    }
+                    guard.unlock();
+                    //Thread must survive failures, leases which were not extended are retried or expire
+                    try {
+                        extend_all(due);
+                    }
+                    catch(const std::exception& e) {
+                        rediscpp_debug(LL::WARNING, "Lock renewal failed: " << e.what());
+                    }
+                    guard.lock();
+                }
+            }
+        };
+
+        std::shared_ptr<State> state;
+        std::string err;
+
+        Impl(const std::string& name, const std::vector<ConnectionParam>& instances, const Options& options) :
+            state(std::make_shared<State>(name, instances, options)),
+            err()
+        {
+            if(instances.empty()) {
+                throw Redis::Exception("No instances passed to Redis::Lock");
+            }
+            if(options.auto_renew) {
+                //Pool is created first, so it outlives renewal thread on exit
+                Pool::instance();
+                Renewer::instance();
+            }
+        }
+
+        ~Impl() {
+            bool held;
+            {
+                std::lock_guard<std::mutex> guard(state->lock);
+                held = state->held;
+            }
+            if(held) {
+                //Destructor must not throw, lease expires after ttl anyway
+                try {
+                    unlock();
+                }
+                catch(const std::exception& e) {
+                    rediscpp_debug(LL::WARNING, "Lock " << state->name << ": release on destruction failed: " << e.what());
+                }
+            }
+            //Lease lost by renewal is not held, but renewer still knows the state
+            if(state->options.auto_renew) {
+                Renewer::instance().remove(state);
+            }
+        }
+
+        void set_error(const std::string& error) {
+            rediscpp_debug(LL::WARNING, "Lock " << state->name << ": " << error);
+            err = error;
+        }
+
+        static std::string generate_token() {
+            static thread_local std::mt19937_64 generator{std::random_device{}() ^ std::hash<std::thread::id>{}(std::this_thread::get_id())};
+            char buffer[33];
+            unsigned long long high = generator(), low = generator();
+            std::snprintf(buffer, sizeof(buffer), "%016llx%016llx", high, low);
+            return std::string(buffer, 32);
+        }
+
+        static bool append(Connection& conn, const Call& call, bool with_source) {
+            if(call.script != nullptr) {
+                return call.script->append(conn, call.keys, call.args, with_source);
+            }
+            std::string key = conn.get_prefix() + call.keys[0];
+            return conn.append_command({"SET", key.c_str(), call.args[0].c_str(), "NX", "PX", call.args[1].c_str()},
+                    {3, key.size(), call.args[0].size(), 2, 2, call.args[1].size()});
+        }
+
+        /* Sends calls of one instance in one pipeline. On failure all of them fail */
+        static bool send(Connection& conn, std::vector<Call>& calls, const std::vector<size_t>& indices, bool with_source) {
+            bool ok = true;
+            for(size_t i = 0; i < indices.size() && ok; i++) {
+                ok = append(conn, calls[indices[i]], with_source);
+            }
+            ok = ok && conn.flush_commands();
+            if(!ok) {
+                if(indices.size() > 1) {
+                    conn.abandon();
+                }
+                for(size_t i = 0; i < indices.size(); i++) {
+                    calls[indices[i]].error = conn.get_error();
+                }
+            }
+            return ok;
+        }
+
+        /* Reads replies of pipeline. Calls of scripts unknown to server are added to noscript */
+        static void receive(Connection& conn, std::vector<Call>& calls, const std::vector<size_t>& indices, std::vector<size_t>* noscript) {
+            for(size_t i = 0; i < indices.size(); i++) {
+                Call& call = calls[indices[i]];
+                if(conn.fetch_reply()) {
+                    call.ok = true;
+                    if(call.script != nullptr) {
+                        Script::read_integer(conn, call.result);
+                    }
+                    else {
+                        call.result = conn.get_reply()->type == REDIS_REPLY_NIL ? 0 : 1;
+                    }
+                    continue;
+                }
+                if(noscript != nullptr && call.script != nullptr && Script::is_noscript(conn)) {
+                    noscript->push_back(indices[i]);
+                    continue;
+                }
+                call.error = conn.get_error();
+                if(conn.get_errno() != Connection::Error::REPLY_ERR) {
+                    //Connection failed, replies of the rest are lost
+                    for(size_t j = i + 1; j < indices.size(); j++) {
+                        calls[indices[j]].error = call.error;
+                    }
+                    return;
+                }
+            }
+        }
+
+        /* Each instance gets one pipeline with all its calls, pipelines of all instances are in flight at once */
+        static void run_calls(std::vector<Call>& calls) {
+            std::vector<const ConnectionParam*> instances;
+            std::vector<std::vector<size_t>> groups;
+            for(size_t i = 0; i < calls.size(); i++) {
+                size_t group = 0;
+                while(group < instances.size() && !(*instances[group] == *calls[i].instance)) {
+                    group++;
+                }
+                if(group == instances.size()) {
+                    instances.push_back(calls[i].instance);
+                    groups.push_back(std::vector<size_t>());
+                }
+                groups[group].push_back(i);
+            }
+            //Failures are counted per call, so pipelines must not throw on NOSCRIPT or unreachable instance
+            std::vector<PoolWrapper> conns;
+            std::vector<bool> sent;
+            std::vector<bool> throw_on_error;
+            conns.reserve(instances.size());
+            for(size_t i = 0; i < instances.size(); i++) {
+                conns.push_back(Pool::instance().get(*instances[i]));
+                throw_on_error.push_back(conns[i]->set_throw_on_error(false));
+                sent.push_back(send(*conns[i], calls, groups[i], false));
+            }
+            for(size_t i = 0; i < instances.size(); i++) {
+                if(sent[i]) {
+                    std::vector<size_t> noscript;
+                    receive(*conns[i], calls, groups[i], &noscript);
+                    if(!noscript.empty() && send(*conns[i], calls, noscript, true)) {
+                        receive(*conns[i], calls, noscript, nullptr);
+                    }
+                }
+                conns[i]->set_throw_on_error(throw_on_error[i]);
+            }
+        }
+
+        static Votes count(const std::vector<Call>& calls, size_t first, size_t size) {
+            Votes votes = {0, 0, 0, std::string()};
+            for(size_t i = first; i < first + size; i++) {
+                if(!calls[i].ok) {
+                    votes.error = calls[i].error;
+                    continue;
+                }
+                votes.answered++;
+                if(calls[i].result > 0) {
+                    votes.granted++;
+                    votes.max_result = std::max(votes.max_result, static_cast<unsigned long long>(calls[i].result));
+                }
+            }
+            return votes;
+        }
+
+        static void add_calls(std::vector<Call>& calls, const State& lock_state, const Script* script, const std::vector<std::string>& keys, const std::vector<std::string>& args) {
+            for(size_t i = 0; i < lock_state.instances.size(); i++) {
+                calls.emplace_back(&lock_state.instances[i], script, std::vector<std::string>(keys), std::vector<std::string>(args));
+            }
+        }
+
+        /* Applies result of extension sent at start. Returns false if lease was not extended */
+        static bool apply_extend(State& lock_state, Clock::time_point start, const Votes& votes) {
+            std::lock_guard<std::mutex> guard(lock_state.lock);
+            if(!lock_state.held) {
+                return false;
+            }
+            if(votes.granted >= lock_state.get_quorum()) {
+                lock_state.valid_until = start + std::chrono::milliseconds(lock_state.options.ttl_ms) - lock_state.get_drift();
+                lock_state.renew_at = start + std::chrono::milliseconds(lock_state.options.ttl_ms / 3);
+                return true;
+            }
+            size_t denied = votes.answered - votes.granted;
+            Clock::time_point now = Clock::now();
+            if(denied > lock_state.instances.size() - lock_state.get_quorum() || now >= lock_state.valid_until) {
+                lock_state.held = false;
+                lock_state.fencing_token = 0;
+            }
+            else {
+                lock_state.renew_at = now + std::chrono::milliseconds(lock_state.options.retry_delay_ms);
+            }
+            return false;
+        }
+
+        static void extend_all(const std::vector<std::shared_ptr<State>>& states) {
+            std::vector<Call> calls;
+            std::vector<State*> owners;
+            Clock::time_point start = Clock::now();
+            for(size_t i = 0; i < states.size(); i++) {
+                std::lock_guard<std::mutex> guard(states[i]->lock);
+                if(states[i]->held) {
+                    add_calls(calls, *states[i], &extend_script, {states[i]->name}, {states[i]->token, std::to_string(states[i]->options.ttl_ms)});
+                    owners.push_back(states[i].get());
+                }
+            }
+            run_calls(calls);
+            size_t first = 0;
+            for(size_t i = 0; i < owners.size(); i++) {
+                Votes votes = count(calls, first, owners[i]->instances.size());
+                if(!apply_extend(*owners[i], start, votes)) {
+                    rediscpp_debug(LL::WARNING, "Lock " << owners[i]->name << ": renewal failed " << votes.error);
+                }
+                first += owners[i]->instances.size();
+            }
+        }
+
+        void release_everywhere(const std::string& token) {
+            std::vector<Call> calls;
+            add_calls(calls, *state, &release_script, {state->name, state->wake_key}, {token, std::to_string(state->options.ttl_ms)});
+            run_calls(calls);
+        }
+
+        bool try_lock(bool& acquired) {
+            acquired = false;
+            if(is_locked()) {
+                acquired = true;
+                return true;
+            }
+            const Options& options = state->options;
+            std::string token = generate_token();
+            std::string ttl = std::to_string(options.ttl_ms);
+            std::vector<Call> calls;
+            if(options.fencing) {
+                add_calls(calls, *state, &acquire_fenced_script, {state->name, state->fencing_key}, {token, ttl});
+            }
+            else {
+                add_calls(calls, *state, nullptr, {state->name}, {token, ttl});
+            }
+            Clock::time_point start = Clock::now();
+            run_calls(calls);
+            Votes votes = count(calls, 0, calls.size());
+            Clock::time_point valid_until = start + std::chrono::milliseconds(options.ttl_ms) - state->get_drift();
+            if(votes.granted >= state->get_quorum() && Clock::now() < valid_until) {
+                {
+                    std::lock_guard<std::mutex> guard(state->lock);
+                    state->held = true;
+                    state->token = token;
+                    state->fencing_token = options.fencing ? votes.max_result : 0;
+                    state->valid_until = valid_until;
+                    state->renew_at = start + std::chrono::milliseconds(options.ttl_ms / 3);
+                }
+                if(options.auto_renew) {
+                    Renewer::instance().add(state);
+                }
+                acquired = true;
+                return true;
+            }
+            if(votes.granted != 0) {
+                //Minority or too late: give back what was granted, so others don't wait for expiration
+                release_everywhere(token);
+            }
+            if(votes.answered < state->get_quorum()) {
+                set_error("Majority of instances didn't answer: " + votes.error);
+                return false;
+            }
+            return true;
+        }
+
+        bool lock(unsigned int wait_ms, bool& acquired) {
+            //Only waiting is limited by wait_ms, so even the last attempt gets full operation timeout
+            Deadline deadline(wait_ms);
+            while(true) {
+                bool ok = try_lock(acquired);
+                if(acquired) {
+                    return true;
+                }
+                unsigned int remaining_ms = deadline.get_remaining_ms();
+                const Deadline* outer = Deadline::current();
+                if(outer != nullptr) {
+                    remaining_ms = std::min(remaining_ms, outer->get_remaining_ms());
+                }
+                if(remaining_ms == 0) {
+                    if(ok) {
+                        set_error("Timeout waiting for lock");
+                    }
+                    return false;
+                }
+                if(ok && state->instances.size() == 1) {
+                    //Released lock wakes the first waiter. Expired one is noticed when the wait runs out
+                    DeadlineScope slice{Deadline(std::min(remaining_ms, state->options.ttl_ms))};
+                    PoolWrapper conn = Pool::instance().get(state->instances[0]);
+                    std::vector<std::string> keys = {state->wake_key};
+                    std::string key, value;
+                    conn->blpop(keys, 0, key, value);
+                }
+                else {
+                    static thread_local std::mt19937 generator(std::random_device{}());
+                    unsigned int delay_ms = std::uniform_int_distribution<unsigned int>(state->options.retry_delay_ms / 2, state->options.retry_delay_ms)(generator);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(std::min(delay_ms, remaining_ms)));
+                }
+            }
+        }
+
+        bool unlock() {
+            std::string token;
+            {
+                std::lock_guard<std::mutex> guard(state->lock);
+                if(!state->held) {
+                    set_error("Lock is not held");
+                    return false;
+                }
+                token = state->token;
+                state->held = false;
+                state->fencing_token = 0;
+            }
+            if(state->options.auto_renew) {
+                Renewer::instance().remove(state);
+            }
+            std::vector<Call> calls;
+            add_calls(calls, *state, &release_script, {state->name, state->wake_key}, {token, std::to_string(state->options.ttl_ms)});
+            run_calls(calls);
+            Votes votes = count(calls, 0, calls.size());
+            if(votes.granted >= state->get_quorum()) {
+                return true;
+            }
+            set_error(votes.answered < state->get_quorum() ? "Majority of instances didn't answer: " + votes.error : std::string("Lock was lost before release"));
+            return false;
+        }
+
+        bool extend() {
+            std::string token;
+            {
+                std::lock_guard<std::mutex> guard(state->lock);
+                if(!state->held) {
+                    set_error("Lock is not held");
+                    return false;
+                }
+                token = state->token;
+            }
+            std::vector<Call> calls;
+            add_calls(calls, *state, &extend_script, {state->name}, {token, std::to_string(state->options.ttl_ms)});
+            Clock::time_point start = Clock::now();
+            run_calls(calls);
+            Votes votes = count(calls, 0, calls.size());
+            if(apply_extend(*state, start, votes)) {
+                return true;
+            }
+            set_error(is_locked() ? "Majority of instances didn't answer: " + votes.error : std::string("Lock was lost"));
+            return false;
+        }
+
+        bool is_locked() {
+            std::lock_guard<std::mutex> guard(state->lock);
+            return state->held && Clock::now() < state->valid_until;
+        }
+
+        unsigned int get_validity_ms() {
+            std::lock_guard<std::mutex> guard(state->lock);
+            Clock::time_point now = Clock::now();
+            if(!state->held || now >= state->valid_until) {
+                return 0;
+            }
+            return static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::milliseconds>(state->valid_until - now).count());
+        }
+    };
+
+    const Script Lock::Impl::acquire_fenced_script(
+        "if redis.call('SET', KEYS[1], ARGV[1], 'NX', 'PX', ARGV[2]) then return redis.call('INCR', KEYS[2]) end "
+        "return 0"
+    );
+    //Release leaves a single element in wake list for the first waiter, expiring if nobody waits
+    const Script Lock::Impl::release_script(
+        "if redis.call('GET', KEYS[1]) == ARGV[1] then "
+            "redis.call('DEL', KEYS[1], KEYS[2]) "
+            "redis.call('RPUSH', KEYS[2], '1') "
+            "redis.call('PEXPIRE', KEYS[2], ARGV[2]) "
+            "return 1 "
+        "end "
+        "return 0"
+    );
+    const Script Lock::Impl::extend_script(
+        "if redis.call('GET', KEYS[1]) == ARGV[1] then return redis.call('PEXPIRE', KEYS[1], ARGV[2]) end "
+        "return 0"
+    );
+
+    Lock::Lock(const std::string& name, const ConnectionParam& param, const Options& options) :
+        d(new Lock::Impl(name, {param}, options))
+    {}
+
+    Lock::Lock(const std::string& name, const std::vector<ConnectionParam>& instances, const Options& options) :
+        d(new Lock::Impl(name, instances, options))
+    {}
+
+    Lock::~Lock() {
+        if(d != nullptr) {
+            delete d;
+        }
+    }
+
+    bool Lock::try_lock(bool& acquired) {
+        return d->try_lock(acquired);
+    }
+
+    bool Lock::lock(unsigned int wait_ms, bool& acquired) {
+        return d->lock(wait_ms, acquired);
+    }
+
+    bool Lock::unlock() {
+        return d->unlock();
+    }
+
+    bool Lock::extend() {
+        return d->extend();
+    }
+
+    bool Lock::is_locked() {
+        return d->is_locked();
+    }
+
+    unsigned int Lock::get_validity_ms() {
+        return d->get_validity_ms();
+    }
+
+    unsigned long long Lock::get_fencing_token() {
+        std::lock_guard<std::mutex> guard(d->state->lock);
+        return d->state->held ? d->state->fencing_token : 0;
+    }
+
+    const std::string& Lock::get_name() const {
+        return d->state->name;
+    }
+
+    std::string Lock::get_error() {
+        return d->err;
+    }
+}
\ No newline at end of file
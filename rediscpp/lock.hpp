@@ -0,0 +1,86 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "connection.hpp"
+namespace Redis {
+    /**
+    * Distributed lock leased for ttl_ms. Acquired with SET NX PX of random token, released and extended with cached Lua scripts
+    * which check the token, so a lock which expired and was taken by someone else is never released or extended by mistake.
+    * Connections are leased from Pool::instance().
+    *
+    * With auto_renew the lease is extended in background at a third of ttl while the lock is held. Renewal of all locks held
+    * on a server is done by one thread in one pipelined round trip, so thousands of held locks cost a few requests per ttl.
+    * Renewal which fails for longer than ttl loses the lock, is_locked() tells whether the lease is still valid.
+    *
+    * Release wakes one waiter of lock() blocked on BLPOP of a wake list, so lock is handed off within a round trip instead of a polling interval.
+    * Lock which expired without release is noticed by waiters after at most ttl_ms.
+    *
+    * Fencing token is a counter incremented on each acquisition, to be passed to storage which rejects writes with tokens older than it has seen.
+    *
+    * Given several independent instances, lock follows Redlock: it is acquired on all of them in parallel and is held if majority granted it
+    * within validity time. Fencing tokens of Redlock are the largest of per instance counters, which is monotonic only while majority of instances keep their data.
+    * Waiters of Redlock poll with retry_delay_ms instead of waiting on wake list.
+    *
+    * Object is not thread safe, use one per thread.
+    *
+    *  F.e. :
+    *  Redis::Lock lock("lock:orders");
+    *  bool acquired;
+    *  if(lock.lock(1000, acquired) && acquired) {
+    *      ...
+    *      lock.unlock();
+    *  }
+    * */
+    class Lock {
+    public:
+        struct Options {
+            unsigned int ttl_ms;
+            bool auto_renew;
+            bool fencing;
+            //Delay between attempts of Redlock, and longest wait on wake list before retrying on a single instance
+            unsigned int retry_delay_ms;
+            //Share of ttl subtracted from validity for clock drift between client and servers
+            double clock_drift_factor;
+            Options() : ttl_ms(10000), auto_renew(false), fencing(false), retry_delay_ms(50), clock_drift_factor(0.01) {}
+        };
+
+        explicit Lock(const std::string& name, const ConnectionParam& param = ConnectionParam(), const Options& options = Options());
+
+        /* Redlock over independent instances */
+        Lock(const std::string& name, const std::vector<ConnectionParam>& instances, const Options& options = Options());
+
+        /* Releases lock if held */
+        ~Lock();
+        Lock(const Lock& other) = delete;
+        Lock& operator=(const Lock& other) = delete;
+
+        /* Single attempt. Returns false on error, acquired tells whether the lock is held now */
+        bool try_lock(bool& acquired);
+
+        /* Waits up to wait_ms for the lock, and not longer than Deadline of the thread */
+        bool lock(unsigned int wait_ms, bool& acquired);
+
+        /* Returns false if lock was not held anymore or on error. Lease expires anyway after ttl */
+        bool unlock();
+
+        /* Extends lease to ttl_ms from now. Returns false if lock was lost or on error */
+        bool extend();
+
+        /* Held and lease is still valid */
+        bool is_locked();
+
+        /* Time left of the lease as seen by client, 0 if not held */
+        unsigned int get_validity_ms();
+
+        /* Token of current acquisition, 0 if fencing is disabled or lock is not held */
+        unsigned long long get_fencing_token();
+
+        const std::string& get_name() const;
+
+        std::string get_error();
+
+    private:
+        class Impl;
+        Impl* d;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,546 @@
+#include "multiplexed_connection.hpp"
+#include "exception.hpp"
+#include "log.hpp"
+#include <hiredis/hiredis.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <deque>
+#include <set>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <climits>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+namespace Redis {
+    static thread_local std::string last_error;
+
+    class MultiplexedConnection::Impl {
+        friend class MultiplexedConnection;
+        //Max commands sent with one writev
+        static constexpr size_t max_coalesce = 256;
+        static constexpr int poll_interval_ms = 100;
+
+        struct Request {
+            std::atomic<Request*> next;
+            std::string encoded;
+            std::promise<Reply> promise;
+            Request() : next(nullptr), encoded(), promise() {}
+        };
+
+        /* Intrusive multi producer single consumer queue (Dmitry Vyukov's). Push is wait free, pop is done by writer thread only */
+        class SubmissionQueue {
+            std::atomic<Request*> head;
+            Request* tail;
+            Request stub;
+        public:
+            SubmissionQueue() : head(&stub), tail(&stub), stub() {}
+            SubmissionQueue(const SubmissionQueue& other) = delete;
+            SubmissionQueue& operator=(const SubmissionQueue& other) = delete;
+
+            void push(Request* request) {
+                request->next.store(nullptr, std::memory_order_relaxed);
+                Request* prev = head.exchange(request, std::memory_order_acq_rel);
+                prev->next.store(request, std::memory_order_release);
+            }
+
+            /* Returns nullptr if queue is empty or producer is in the middle of push */
+            Request* pop() {
+                Request* first = tail;
+                Request* next = first->next.load(std::memory_order_acquire);
+                if(first == &stub) {
+                    if(next == nullptr) {
+                        return nullptr;
+                    }
+                    tail = next;
+                    first = next;
+                    next = next->next.load(std::memory_order_acquire);
+                }
+                if(next != nullptr) {
+                    tail = next;
+                    return first;
+                }
+                if(first != head.load(std::memory_order_acquire)) {
+                    return nullptr;
+                }
+                push(&stub);
+                next = first->next.load(std::memory_order_acquire);
+                if(next != nullptr) {
+                    tail = next;
+                    return first;
+                }
+                return nullptr;
+            }
+        };
+
+        ConnectionParam connection_param;
+        Connection connection;
+        SubmissionQueue queue;
+        std::atomic<bool> writer_sleeping;
+        std::atomic<size_t> in_flight_count;
+        //Guards everything below
+        std::mutex lock;
+        std::condition_variable state_cv;
+        std::deque<std::promise<Reply>> in_flight;
+        int fd;
+        bool broken;
+        std::string broken_reason;
+        bool reader_parked;
+        bool stopping;
+        bool reader_stopping;
+        std::thread writer;
+        std::thread reader;
+
+        Impl(const ConnectionParam& _connection_param) :
+            connection_param(_connection_param),
+            connection(_connection_param),
+            queue(),
+            writer_sleeping(false),
+            in_flight_count(0),
+            lock(),
+            state_cv(),
+            in_flight(),
+            fd(-1),
+            broken(true),
+            broken_reason("Not connected"),
+            reader_parked(false),
+            stopping(false),
+            reader_stopping(false),
+            writer(),
+            reader()
+        {
+            //Connection is used only to establish socket (with socket options, SELECT...), all io is done here
+            if(connect(broken_reason)) {
+                fd = connection.get_fd();
+                broken = false;
+            }
+            else {
+                rediscpp_debug(LL::WARNING, "MultiplexedConnection could not connect: " << broken_reason);
+            }
+            writer = std::thread(&Impl::write_loop, this);
+            reader = std::thread(&Impl::read_loop, this);
+        }
+
+        ~Impl() {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                stopping = true;
+            }
+            state_cv.notify_all();
+            writer.join();
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                reader_stopping = true;
+            }
+            state_cv.notify_all();
+            reader.join();
+        }
+
+        /* Connection may throw with throw_on_error, but threads must not */
+        bool connect(std::string& error) {
+            try {
+                if(connection.force_reconnect()) {
+                    return true;
+                }
+                error = connection.get_error();
+            }
+            catch(const std::exception& e) {
+                error = e.what();
+            }
+            return false;
+        }
+
+        static bool is_rejected(const std::vector<std::string>& args) {
+            static const std::set<std::string> rejected = {
+                "BLPOP", "BRPOP", "BRPOPLPUSH", "BLMOVE", "BLMPOP", "BZPOPMIN", "BZPOPMAX", "BZMPOP", "WAIT", "WAITAOF",
+                "SUBSCRIBE", "PSUBSCRIBE", "SSUBSCRIBE", "MONITOR", "SYNC", "PSYNC",
+                "MULTI", "EXEC", "DISCARD", "WATCH", "UNWATCH", "SELECT", "AUTH", "HELLO", "RESET", "QUIT", "CLIENT"
+            };
+            std::string command(args[0]);
+            std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+            if(rejected.count(command) != 0) {
+                return true;
+            }
+            if(command == "XREAD" || command == "XREADGROUP") {
+                for(size_t i = 1; i < args.size(); i++) {
+                    if(strcasecmp(args[i].c_str(), "BLOCK") == 0) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        static void encode(const std::vector<std::string>& args, std::string& out) {
+            size_t size = 16;
+            for(size_t i = 0; i < args.size(); i++) {
+                size += args[i].size() + 24;
+            }
+            out.reserve(size);
+            out += '*';
+            out += std::to_string(args.size());
+            out += "\r\n";
+            for(size_t i = 0; i < args.size(); i++) {
+                out += '$';
+                out += std::to_string(args[i].size());
+                out += "\r\n";
+                out += args[i];
+                out += "\r\n";
+            }
+        }
+
+        static Reply convert(const redisReply* raw) {
+            Reply reply;
+            switch(raw->type) {
+                case REDIS_REPLY_STRING:
+                    reply.type = Reply::Type::STRING;
+                    reply.str.assign(raw->str, raw->len);
+                    break;
+                case REDIS_REPLY_STATUS:
+                    reply.type = Reply::Type::STATUS;
+                    reply.str.assign(raw->str, raw->len);
+                    break;
+                case REDIS_REPLY_ERROR:
+                    reply.type = Reply::Type::ERROR;
+                    reply.str.assign(raw->str, raw->len);
+                    break;
+                case REDIS_REPLY_INTEGER:
+                    reply.type = Reply::Type::INTEGER;
+                    reply.integer = raw->integer;
+                    break;
+                case REDIS_REPLY_ARRAY:
+                    reply.type = Reply::Type::ARRAY;
+                    reply.elements.reserve(raw->elements);
+                    for(size_t i = 0; i < raw->elements; i++) {
+                        reply.elements.push_back(convert(raw->element[i]));
+                    }
+                    break;
+                default:
+                    reply.type = Reply::Type::NIL;
+            }
+            return reply;
+        }
+
+        std::future<Reply> submit(const std::vector<std::string>& args) {
+            if(args.empty() || is_rejected(args)) {
+                std::promise<Reply> rejected;
+                rejected.set_exception(std::make_exception_ptr(Redis::Exception(
+                    args.empty() ? "Empty command" : "Command " + args[0] + " can't be used on multiplexed connection")));
+                return rejected.get_future();
+            }
+            Request* request = new Request();
+            encode(args, request->encoded);
+            std::future<Reply> future = request->promise.get_future();
+            queue.push(request);
+            //Pairs with the fence in write_loop: either writer sees the request or we see it sleeping
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(writer_sleeping.exchange(false)) {
+                std::lock_guard<std::mutex> guard(lock);
+                state_cv.notify_all();
+            }
+            return future;
+        }
+
+        /* Fails all requests in flight. Writer reconnects when it has something to send */
+        void fail(const std::string& error) {
+            std::deque<std::promise<Reply>> failed;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if(broken) {
+                    return;
+                }
+                rediscpp_debug(LL::WARNING, "MultiplexedConnection failed: " << error);
+                broken = true;
+                broken_reason = error;
+                failed.swap(in_flight);
+                in_flight_count = 0;
+                //Wakes up the other thread if it's blocked on socket
+                shutdown(fd, SHUT_RDWR);
+            }
+            state_cv.notify_all();
+            for(size_t i = 0; i < failed.size(); i++) {
+                failed[i].set_exception(std::make_exception_ptr(Redis::Exception(error)));
+            }
+        }
+
+        /* Called by writer with lock held. Reader must be parked, as socket and its parser are replaced */
+        bool restore(std::unique_lock<std::mutex>& guard) {
+            if(!connection_param.reconnect_on_failure && fd != -1) {
+                return false;
+            }
+            state_cv.wait(guard, [this]() { return reader_parked; });
+            guard.unlock();
+            std::string error;
+            bool ok = connect(error);
+            guard.lock();
+            if(!ok) {
+                broken_reason = error;
+                return false;
+            }
+            fd = connection.get_fd();
+            broken = false;
+            state_cv.notify_all();
+            return true;
+        }
+
+        bool write_all(std::vector<struct iovec>& iov) {
+            size_t offset = 0;
+            while(offset < iov.size()) {
+                ssize_t written = writev(fd, &iov[offset], static_cast<int>(std::min(iov.size() - offset, static_cast<size_t>(IOV_MAX))));
+                if(written < 0) {
+                    if(errno == EINTR) {
+                        continue;
+                    }
+                    fail(std::string("Write failed: ") + std::strerror(errno));
+                    return false;
+                }
+                size_t left = static_cast<size_t>(written);
+                while(offset < iov.size() && left >= iov[offset].iov_len) {
+                    left -= iov[offset].iov_len;
+                    offset++;
+                }
+                if(offset < iov.size()) {
+                    iov[offset].iov_base = static_cast<char*>(iov[offset].iov_base) + left;
+                    iov[offset].iov_len -= left;
+                }
+            }
+            return true;
+        }
+
+        void write_loop() {
+            std::vector<Request*> batch;
+            std::vector<struct iovec> iov;
+            batch.reserve(max_coalesce);
+            iov.reserve(max_coalesce);
+            while(true) {
+                Request* request = queue.pop();
+                if(request == nullptr) {
+                    writer_sleeping = true;
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    request = queue.pop();
+                    if(request == nullptr) {
+                        std::unique_lock<std::mutex> guard(lock);
+                        if(stopping) {
+                            return;
+                        }
+                        //Request missed by pop (even in the middle of push) is followed by submit clearing writer_sleeping and notifying
+                        state_cv.wait(guard, [this]() { return !writer_sleeping || stopping; });
+                        writer_sleeping = false;
+                        continue;
+                    }
+                    writer_sleeping = false;
+                }
+                batch.clear();
+                iov.clear();
+                do {
+                    batch.push_back(request);
+                } while(batch.size() < max_coalesce && (request = queue.pop()) != nullptr);
+
+                bool ok = true;
+                std::string error;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    if(broken && !restore(guard)) {
+                        ok = false;
+                        error = broken_reason;
+                    }
+                    else {
+                        //Registered before sending, so reader always knows whom the reply belongs to
+                        for(size_t i = 0; i < batch.size(); i++) {
+                            in_flight.push_back(std::move(batch[i]->promise));
+                        }
+                        in_flight_count += batch.size();
+                    }
+                }
+                if(ok) {
+                    for(size_t i = 0; i < batch.size(); i++) {
+                        iov.push_back({&batch[i]->encoded[0], batch[i]->encoded.size()});
+                    }
+                    write_all(iov);
+                }
+                for(size_t i = 0; i < batch.size(); i++) {
+                    if(!ok) {
+                        batch[i]->promise.set_exception(std::make_exception_ptr(Redis::Exception(error)));
+                    }
+                    delete batch[i];
+                }
+            }
+        }
+
+        bool complete(Reply&& reply) {
+            std::promise<Reply> promise;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if(in_flight.empty()) {
+                    return false;
+                }
+                promise = std::move(in_flight.front());
+                in_flight.pop_front();
+                in_flight_count--;
+            }
+            promise.set_value(std::move(reply));
+            return true;
+        }
+
+        void read_loop() {
+            struct ReaderDeleter {
+                void operator()(redisReader* parser) const { redisReaderFree(parser); }
+            };
+            std::unique_ptr<redisReader, ReaderDeleter> parser(redisReaderCreate());
+            char buffer[16 * 1024];
+            auto last_progress = std::chrono::steady_clock::now();
+            while(true) {
+                int socket = -1;
+                bool waiting = false;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    if(broken) {
+                        reader_parked = true;
+                        state_cv.notify_all();
+                        state_cv.wait(guard, [this]() { return !broken || reader_stopping; });
+                        reader_parked = false;
+                        if(broken) {
+                            return;
+                        }
+                        parser.reset(redisReaderCreate());
+                        last_progress = std::chrono::steady_clock::now();
+                    }
+                    if(reader_stopping && in_flight.empty()) {
+                        return;
+                    }
+                    socket = fd;
+                    waiting = !in_flight.empty();
+                }
+                if(!waiting) {
+                    last_progress = std::chrono::steady_clock::now();
+                }
+                struct pollfd pfd = {socket, POLLIN, 0};
+                int ret = poll(&pfd, 1, poll_interval_ms);
+                if(ret < 0 && errno != EINTR) {
+                    fail(std::string("poll failed: ") + std::strerror(errno));
+                    continue;
+                }
+                if(ret <= 0) {
+                    if(waiting && std::chrono::steady_clock::now() - last_progress > std::chrono::milliseconds(connection_param.operation_timeout_ms)) {
+                        fail("Timeout waiting for reply");
+                    }
+                    continue;
+                }
+                ssize_t size = read(socket, buffer, sizeof(buffer));
+                if(size <= 0) {
+                    if(size < 0 && (errno == EINTR || errno == EAGAIN)) {
+                        continue;
+                    }
+                    fail(size == 0 ? std::string("Connection closed by server") : std::string("Read failed: ") + std::strerror(errno));
+                    continue;
+                }
+                last_progress = std::chrono::steady_clock::now();
+                if(redisReaderFeed(parser.get(), buffer, static_cast<size_t>(size)) != REDIS_OK) {
+                    fail("Could not parse reply");
+                    continue;
+                }
+                while(true) {
+                    void* raw = nullptr;
+                    if(redisReaderGetReply(parser.get(), &raw) != REDIS_OK) {
+                        fail("Could not parse reply");
+                        break;
+                    }
+                    if(raw == nullptr) {
+                        break;
+                    }
+                    Reply reply = convert(static_cast<redisReply*>(raw));
+                    freeReplyObject(raw);
+                    if(!complete(std::move(reply))) {
+                        fail("Unexpected reply");
+                        break;
+                    }
+                }
+            }
+        }
+
+        bool wait(std::future<Reply>&& future, Reply& reply) {
+            try {
+                reply = future.get();
+            }
+            catch(const Redis::Exception& e) {
+                return set_error(e.what());
+            }
+            if(reply.type == Reply::Type::ERROR) {
+                return set_error(reply.str);
+            }
+            return true;
+        }
+
+        bool set_error(const std::string& error) {
+            last_error = error;
+            if(connection_param.throw_on_error) {
+                throw Redis::Exception(error);
+            }
+            return false;
+        }
+    };
+    constexpr size_t MultiplexedConnection::Impl::max_coalesce;
+    constexpr int MultiplexedConnection::Impl::poll_interval_ms;
+
+    MultiplexedConnection::MultiplexedConnection(const ConnectionParam& connection_param) :
+        d(new MultiplexedConnection::Impl(connection_param))
+    {}
+
+    MultiplexedConnection::~MultiplexedConnection() {
+        if(d != nullptr) {
+            delete d;
+        }
+    }
+
+    std::future<MultiplexedConnection::Reply> MultiplexedConnection::command_async(const std::vector<std::string>& args) {
+        return d->submit(args);
+    }
+
+    bool MultiplexedConnection::command(const std::vector<std::string>& args, Reply& reply) {
+        return d->wait(d->submit(args), reply);
+    }
+
+    bool MultiplexedConnection::get(const std::string& key, std::string& result) {
+        Reply reply;
+        if(!d->wait(d->submit({"GET", d->connection_param.prefix + key}), reply)) {
+            return false;
+        }
+        if(reply.type == Reply::Type::NIL) {
+            result.clear();
+            return true;
+        }
+        if(d->connection_param.codec != nullptr && !d->connection_param.codec->decode(reply.str.data(), reply.str.size(), result)) {
+            return d->set_error("Could not decode value of " + key);
+        }
+        if(d->connection_param.codec == nullptr) {
+            result = std::move(reply.str);
+        }
+        return true;
+    }
+
+    bool MultiplexedConnection::set(const std::string& key, const std::string& value) {
+        std::string encoded;
+        bool is_encoded = d->connection_param.codec != nullptr && d->connection_param.codec->encode(value.data(), value.size(), encoded);
+        Reply reply;
+        return d->wait(d->submit({"SET", d->connection_param.prefix + key, is_encoded ? encoded : value}), reply);
+    }
+
+    bool MultiplexedConnection::del(const std::string& key) {
+        Reply reply;
+        return d->wait(d->submit({"DEL", d->connection_param.prefix + key}), reply);
+    }
+
+    size_t MultiplexedConnection::get_in_flight_count() {
+        return d->in_flight_count.load();
+    }
+
+    std::string MultiplexedConnection::get_error() {
+        return last_error;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <future>
+#include "connection.hpp"
+namespace Redis {
+    /**
+    * Connection shared by many threads. Callers enqueue commands into lock free queue,
+    * writer thread sends everything queued with one writev and reader thread completes requests in order of replies.
+    * So one socket serves any number of threads and concurrent requests are pipelined naturally.
+    * Commands which block the connection or change its state (BLPOP, WAIT, SUBSCRIBE, MULTI, SELECT...) are rejected,
+    * use pooled Connection for them.
+    * On connection failure all requests in flight fail, next request reconnects if reconnect_on_failure is set.
+    * Thread safe.
+    *
+    *  F.e. :
+    *  Redis::MultiplexedConnection shared(Redis::ConnectionParam("10.0.0.1"));
+    *  //from any thread
+    *  shared.get("key", value);
+    * */
+    class MultiplexedConnection {
+    public:
+        struct Reply {
+            enum class Type { STRING, ARRAY, INTEGER, NIL, STATUS, ERROR };
+            Type type;
+            //Value of STRING, STATUS and ERROR replies
+            std::string str;
+            long long integer;
+            std::vector<Reply> elements;
+            Reply() : type(Type::NIL), str(), integer(0), elements() {}
+        };
+
+        MultiplexedConnection(const ConnectionParam& connection_param = ConnectionParam::get_default_connection_param());
+        /* Sends queued commands and waits for their replies */
+        ~MultiplexedConnection();
+        MultiplexedConnection(const MultiplexedConnection& other) = delete;
+        MultiplexedConnection& operator=(const MultiplexedConnection& other) = delete;
+
+        /* Sends arguments as is, without key prefix and value codec. Future throws Redis::Exception if the command was rejected or connection failed.
+        *  Error replies are returned as Reply::Type::ERROR
+        * */
+        std::future<Reply> command_async(const std::vector<std::string>& args);
+
+        /* Blocking version. Returns false on failure and on error reply */
+        bool command(const std::vector<std::string>& args, Reply& reply);
+
+        /* Get the value of a key. Prefix and codec of connection param are applied */
+        bool get(const std::string& key, std::string& result);
+
+        /* Set the string value of a key. Prefix and codec of connection param are applied */
+        bool set(const std::string& key, const std::string& value);
+
+        /* Delete a key. Prefix of connection param is applied */
+        bool del(const std::string& key);
+
+        /* Commands which were sent, but replies are not received yet */
+        size_t get_in_flight_count();
+
+        /* Error of the last failed blocking call made by the calling thread */
+        static std::string get_error();
+
+    private:
+        class Impl;
+        Impl* d;
+    };
+}
\ No newline at end of file
@@ -5,6 +5,10 @@
 #include <mutex>
 #include <array>
 #include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 #include "exception.hpp"
 static std::hash<std::string> hash_fn;
 static constexpr size_t bucket_count = 48;
@@ -13,10 +17,23 @@ namespace Redis {
         friend class NamedPool;
         Pool pool;
         std::vector<ConnectionParam> connection_params;
+        std::vector<std::unique_ptr<HedgedReader>> readers;
+        AdmissionControl::Limits admission_limits;
 
-        Implementation() : pool(), connection_params() {}
-        void assign_connection_param(const std::vector<ConnectionParam> conn_params) {
+        Implementation() : pool(), connection_params(), readers(), admission_limits() {}
+        void assign_connection_param(const std::vector<ConnectionParam> conn_params, const AdmissionControl::Limits& limits) {
             connection_params = conn_params;
+            admission_limits = limits;
+            if(limits.is_enabled()) {
+                std::map<std::string, std::shared_ptr<AdmissionControl>> endpoints;
+                for(size_t i=0; i<connection_params.size(); i++) {
+                    auto& admission = endpoints[connection_params[i].host + ":" + std::to_string(connection_params[i].port)];
+                    if(admission == nullptr) {
+                        admission = std::make_shared<AdmissionControl>(limits);
+                    }
+                    connection_params[i].admission = admission;
+                }
+            }
             for(size_t i=0; i< conn_params.size(); i++) {
                 //Preinitialization;
                 pool.get(conn_params[i]);
@@ -53,7 +70,7 @@ namespace Redis {
 
 
 
-    void NamedPool::create(const std::string& name, const std::vector<Redis::ConnectionParam> connection_params) {
+    void NamedPool::create(const std::string& name, const std::vector<Redis::ConnectionParam> connection_params, const AdmissionControl::Limits& admission_limits) {
         size_t bucket = hash_fn(name) % bucket_count;
         std::lock_guard<std::mutex> guard(Implementation::mutexes[bucket]);
 
@@ -63,11 +80,16 @@ namespace Redis {
         if(Implementation::is_created_no_lock(name)) {
             redis_assert(ptr != nullptr);
             auto& c_param = Implementation::instances[bucket][name]->d->connection_params;
-            if(c_param.size() != connection_params.size()) {
+            if(c_param.size() != connection_params.size() || Implementation::instances[bucket][name]->d->admission_limits != admission_limits) {
                 throw Redis::Exception("Trying to create named pool with different connections params");
             }
             for(size_t i=0; i<c_param.size(); i++) {
-                if(c_param[i] != connection_params[i]) {
+                //Admission control is created by the pool itself
+                ConnectionParam param = connection_params[i];
+                if(admission_limits.is_enabled()) {
+                    param.admission = c_param[i].admission;
+                }
+                if(c_param[i] != param) {
                     throw Redis::Exception("Trying to create named pool with different connections params");
                 }
             }
@@ -76,7 +98,7 @@ namespace Redis {
         else {
             redis_assert(ptr == nullptr);
             ptr = std::shared_ptr<NamedPool>(new NamedPool);
-            ptr->d->assign_connection_param(connection_params);
+            ptr->d->assign_connection_param(connection_params, admission_limits);
         }
     }
     NamedPool& NamedPool::get_pool(const std::string& name) {
@@ -91,4 +113,91 @@ namespace Redis {
         size_t index = d->pool.get_connection_index_by_key(key, d->connection_params);
         return d->pool.get(d->connection_params[index]);
     }
+    const ConnectionParam& NamedPool::get_connection_param(const std::string& key) {
+        size_t index = d->pool.get_connection_index_by_key(key, d->connection_params);
+        return d->connection_params[index];
+    }
+
+    void NamedPool::enable_hedging(const std::vector<std::vector<Redis::ConnectionParam>>& replicas, const HedgedReader::Options& options) {
+        if(replicas.size() != d->connection_params.size()) {
+            throw Redis::Exception("Replicas should be passed for each shard of named pool");
+        }
+        std::vector<std::unique_ptr<HedgedReader>> readers;
+        for(size_t i=0; i<replicas.size(); i++) {
+            std::vector<ConnectionParam> shard_replicas;
+            shard_replicas.reserve(replicas[i].size() + 1);
+            shard_replicas.push_back(d->connection_params[i]);
+            shard_replicas.insert(shard_replicas.end(), replicas[i].begin(), replicas[i].end());
+            readers.emplace_back(new HedgedReader(shard_replicas, options));
+        }
+        d->readers.swap(readers);
+    }
+    bool NamedPool::is_hedging_enabled() {
+        return !d->readers.empty();
+    }
+    HedgedReader& NamedPool::get_reader(const std::string& key) {
+        if(d->readers.empty()) {
+            throw Redis::Exception("Hedging is not enabled for named pool");
+        }
+        size_t index = d->pool.get_connection_index_by_key(key, d->connection_params);
+        return *d->readers[index];
+    }
+    NamedPool::WarmUpReport NamedPool::warm_up(size_t min_per_shard, unsigned int deadline_ms) {
+        static constexpr size_t max_threads = 64;
+        const size_t shard_count = d->connection_params.size();
+        const size_t task_count = shard_count * min_per_shard;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(deadline_ms);
+        WarmUpReport report;
+        for(size_t i=0; i<shard_count; i++) {
+            report.shards.push_back({d->connection_params[i].host, d->connection_params[i].port, 0, 0, std::string()});
+        }
+        //Leases are held till the end, so each task of a shard gets its own connection
+        std::vector<std::vector<PoolWrapper>> leases(shard_count);
+        std::mutex report_lock;
+        std::atomic<size_t> next_task(0);
+        auto worker = [&]() {
+            for(size_t task = next_task++; task < task_count; task = next_task++) {
+                size_t shard = task % shard_count;
+                const ConnectionParam& param = d->connection_params[shard];
+                if(std::chrono::steady_clock::now() >= deadline) {
+                    std::lock_guard<std::mutex> guard(report_lock);
+                    report.shards[shard].error = "Warm up deadline exceeded";
+                    continue;
+                }
+                PoolWrapper conn = d->pool.get(param);
+                double start = microtime();
+                bool ok = false;
+                std::string error;
+                try {
+                    ok = conn->connect();
+                    if(!ok) {
+                        error = conn->get_error();
+                    }
+                }
+                catch(const std::exception& e) {
+                    error = e.what();
+                }
+                double connect_ms = (microtime() - start) * 1000;
+                std::lock_guard<std::mutex> guard(report_lock);
+                ShardWarmUp& shard_report = report.shards[shard];
+                shard_report.max_connect_ms = std::max(shard_report.max_connect_ms, connect_ms);
+                if(ok) {
+                    shard_report.connected++;
+                }
+                else {
+                    shard_report.error = error;
+                    rediscpp_debug(LL::WARNING, "Warm up of " << param.host << ":" << param.port << " failed: " << error);
+                }
+                leases[shard].push_back(std::move(conn));
+            }
+        };
+        std::vector<std::thread> threads;
+        for(size_t i=0; i<std::min(task_count, max_threads); i++) {
+            threads.emplace_back(worker);
+        }
+        for(size_t i=0; i<threads.size(); i++) {
+            threads[i].join();
+        }
+        return report;
+    }
 }
\ No newline at end of file
@@ -1,14 +1,56 @@
 #include "connection_param.hpp"
 #include "pool_wrapper.hpp"
+#include "hedged_reader.hpp"
 #pragma once
 namespace Redis {
     class NamedPool {
     public:
         class Implementation;
+        struct ShardWarmUp {
+            std::string host;
+            unsigned int port;
+            //Connections which are established and ready in pool
+            size_t connected;
+            //Slowest connect of the shard
+            double max_connect_ms;
+            //Error of the last failed connect, empty if all connects succeeded
+            std::string error;
+        };
+        struct WarmUpReport {
+            std::vector<ShardWarmUp> shards;
+            WarmUpReport() : shards() {}
+            bool is_ok(size_t min_per_shard) const {
+                for(size_t i=0; i<shards.size(); i++) {
+                    if(shards[i].connected < min_per_shard) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        };
         static bool is_created(const std::string& name);
-        static void create(const std::string& name, const std::vector<Redis::ConnectionParam> connection_params);
+        /* admission_limits are applied to each endpoint of the pool separately. Shards on the same endpoint share limits.
+        *  Over-limit commands fail with Connection::Error::ADMISSION_REJECTED, see AdmissionControl
+        * */
+        static void create(const std::string& name, const std::vector<Redis::ConnectionParam> connection_params, const AdmissionControl::Limits& admission_limits = AdmissionControl::Limits());
         static NamedPool& get_pool(const std::string& name);
         PoolWrapper get(const std::string& key);
+
+        /* Connects min_per_shard connections to every shard in parallel, so the first requests don't pay for connect.
+        *  Connects which are not started before deadline_ms are reported as failed.
+        *  Connect itself is bounded by connect_timeout_ms of shard, so call may last up to deadline_ms + connect_timeout_ms
+        * */
+        WarmUpReport warm_up(size_t min_per_shard = 1, unsigned int deadline_ms = 5000);
+        const ConnectionParam& get_connection_param(const std::string& key);
+
+        /* Enables hedged reads. replicas[i] are replicas of i-th shard, they are hedged together with the shard itself.
+        *  Should be called once right after create, before the pool is used for reads.
+        * */
+        void enable_hedging(const std::vector<std::vector<Redis::ConnectionParam>>& replicas, const HedgedReader::Options& options = HedgedReader::Options());
+        bool is_hedging_enabled();
+
+        /* Hedged reader of the shard holding the key. Throws if hedging is not enabled */
+        HedgedReader& get_reader(const std::string& key);
         ~NamedPool();
         NamedPool(const NamedPool& other) = delete;
         NamedPool& operator=(const NamedPool& other) = delete;
@@ -53,12 +53,15 @@ namespace Redis {
     }
 
     PoolWrapper Pool::get(const ConnectionParam &connection_param) {
-        size_t bucket = connection_param.get_hash() % d->bucket_count;
+        //Sockets are shared by params which differ only in client side settings. They are applied on each lease
+        ConnectionParam endpoint = connection_param.get_endpoint_param();
+        size_t bucket = endpoint.get_hash() % d->bucket_count;
         std::lock_guard<std::mutex> guard(d->locks[bucket]);
-        Impl::ConnectionVector &vec = d->instances[bucket][connection_param];
+        Impl::ConnectionVector &vec = d->instances[bucket][endpoint];
         for (size_t i = 0; vec.size() > i; i++) {
             if (!vec[i]->second) {
                 vec[i]->second = true;
+                vec[i]->first.reconfigure(connection_param);
                 return PoolWrapper(vec[i]->first, vec[i]->second);
             }
         }
@@ -68,6 +71,32 @@ namespace Redis {
         return PoolWrapper(vec.back()->first, vec.back()->second);
     }
 
+    size_t Pool::drain(const ConnectionParam &connection_param) {
+        ConnectionParam endpoint = connection_param.get_endpoint_param();
+        size_t bucket = endpoint.get_hash() % d->bucket_count;
+        std::lock_guard<std::mutex> guard(d->locks[bucket]);
+        auto it = d->instances[bucket].find(endpoint);
+        if(it == d->instances[bucket].end()) {
+            return 0;
+        }
+        Impl::ConnectionVector &vec = it->second;
+        Impl::ConnectionVector still_used;
+        for (size_t i = 0; vec.size() > i; i++) {
+            if (vec[i]->second) {
+                still_used.push_back(std::move(vec[i]));
+            }
+        }
+        rediscpp_debug(LL::NOTICE, "Drained " << vec.size() - still_used.size() << " connections to " << connection_param.host << ":" << connection_param.port << ", still in use: " << still_used.size());
+        size_t used_cnt = still_used.size();
+        if(still_used.empty()) {
+            d->instances[bucket].erase(it);
+        }
+        else {
+            vec.swap(still_used);
+        }
+        return used_cnt;
+    }
+
     PoolWrapper Pool::get(const std::string& host,
             unsigned int port,
             const std::string& password,
@@ -26,8 +26,14 @@ namespace Redis {
                 bool reconnect_on_failure = ConnectionParam::get_default_connection_param().reconnect_on_failure,
                 bool throw_on_error = ConnectionParam::get_default_connection_param().throw_on_error
         );
+        /* Connections are shared by params which differ only in client side settings (prefix, timeouts, error policy, codec, admission), see ConnectionParam::get_endpoint_param.
+        *  Settings of connection_param are applied to the connection for the time of lease
+        * */
         PoolWrapper get(const ConnectionParam &connection_param);
 
+        /* Destroys all idle connections to endpoint of connection_param. Returns number of connections which are still in use and were left untouched */
+        size_t drain(const ConnectionParam &connection_param);
+
     private:
         Pool();
         ~Pool();
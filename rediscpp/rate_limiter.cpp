@@ -0,0 +1,377 @@
+#include "rate_limiter.hpp"
+#include "script.hpp"
+#include "pool.hpp"
+#include "named_pool.hpp"
+#include "exception.hpp"
+#include "macro.hpp"
+#include "log.hpp"
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace Redis {
+    class RateLimiter::Impl {
+        friend class RateLimiter;
+        typedef std::chrono::steady_clock Clock;
+
+        static const Script gcra_script;
+        static const Script sliding_window_script;
+        static const Script fixed_window_script;
+
+        /* Requests of cost and more are denied locally until the time */
+        struct Denial {
+            Clock::time_point until;
+            unsigned int cost;
+            Denial() : until(), cost(0) {}
+        };
+
+        /* Decision of one key in batch */
+        struct Call {
+            size_t index;
+            std::vector<std::string> args;
+            Call(size_t _index, std::vector<std::string>&& _args) : index(_index), args(std::move(_args)) {}
+        };
+
+        Limit limit;
+        Options options;
+        ConnectionParam param;
+        NamedPool* named_pool;
+        const Script* script;
+        std::mutex lock;
+        std::unordered_map<std::string, Denial> denied;
+        std::string err;
+
+        Impl(const Limit& _limit, const ConnectionParam& _param, NamedPool* _named_pool, const Options& _options) :
+            limit(_limit),
+            options(_options),
+            param(_param),
+            named_pool(_named_pool),
+            script(nullptr),
+            lock(),
+            denied(),
+            err()
+        {
+            if(limit.limit == 0 || limit.period_ms == 0) {
+                throw Redis::Exception("Invalid limit passed to Redis::RateLimiter");
+            }
+            if(limit.burst == 0) {
+                limit.burst = limit.limit;
+            }
+            switch(limit.algorithm) {
+                case Algorithm::GCRA:
+                    script = &gcra_script;
+                    break;
+                case Algorithm::SLIDING_WINDOW:
+                    script = &sliding_window_script;
+                    break;
+                case Algorithm::FIXED_WINDOW:
+                    script = &fixed_window_script;
+                    break;
+            }
+        }
+
+        Impl(const Impl& other) = delete;
+        Impl& operator=(const Impl& other) = delete;
+
+        void set_error(const std::string& error) {
+            rediscpp_debug(LL::WARNING, "RateLimiter: " << error);
+            std::lock_guard<std::mutex> guard(lock);
+            err = error;
+        }
+
+        PoolWrapper lease(const std::string& key) {
+            return named_pool != nullptr ? named_pool->get(key) : Pool::instance().get(param);
+        }
+
+        const ConnectionParam* get_param(const std::string& key) {
+            return named_pool != nullptr ? &named_pool->get_connection_param(key) : &param;
+        }
+
+        /* Unique prefix of sorted set members added by one request */
+        static std::string generate_member() {
+            static thread_local std::mt19937_64 generator{std::random_device{}() ^ std::hash<std::thread::id>{}(std::this_thread::get_id())};
+            char buffer[18];
+            unsigned long long value = generator();
+            std::snprintf(buffer, sizeof(buffer), "%016llx:", value);
+            return std::string(buffer, 17);
+        }
+
+        std::vector<std::string> make_args(unsigned int cost) const {
+            switch(limit.algorithm) {
+                case Algorithm::GCRA: {
+                    double interval_us = limit.period_ms * 1000.0 / static_cast<double>(limit.limit);
+                    return {std::to_string(interval_us), std::to_string(interval_us * static_cast<double>(limit.burst)), std::to_string(cost)};
+                }
+                case Algorithm::SLIDING_WINDOW:
+                    return {std::to_string(limit.period_ms * 1000ULL), std::to_string(limit.limit), std::to_string(cost), generate_member()};
+                case Algorithm::FIXED_WINDOW:
+                    break;
+            }
+            return {std::to_string(limit.period_ms), std::to_string(limit.limit), std::to_string(cost)};
+        }
+
+        /* Returns true if decision is made without redis */
+        bool precheck(const std::string& key, unsigned int cost, Decision& decision) {
+            decision = Decision();
+            if(cost > (limit.algorithm == Algorithm::GCRA ? limit.burst : limit.limit)) {
+                decision.retry_after_ms = -1;
+                decision.local = true;
+                return true;
+            }
+            if(!options.local_precheck) {
+                return false;
+            }
+            std::lock_guard<std::mutex> guard(lock);
+            auto it = denied.find(key);
+            if(it == denied.end()) {
+                return false;
+            }
+            Clock::time_point now = Clock::now();
+            if(now >= it->second.until) {
+                denied.erase(it);
+                return false;
+            }
+            if(cost < it->second.cost) {
+                return false;
+            }
+            decision.retry_after_ms = std::chrono::duration_cast<std::chrono::milliseconds>(it->second.until - now).count() + 1;
+            decision.local = true;
+            return true;
+        }
+
+        void remember(const std::string& key, unsigned int cost, const Decision& decision) {
+            if(!options.local_precheck || decision.allowed || decision.retry_after_ms <= 0) {
+                return;
+            }
+            Clock::time_point now = Clock::now();
+            std::lock_guard<std::mutex> guard(lock);
+            if(denied.size() >= options.local_cache_size) {
+                for(auto it = denied.begin(); it != denied.end();) {
+                    it = now >= it->second.until ? denied.erase(it) : std::next(it);
+                }
+                if(denied.size() >= options.local_cache_size) {
+                    denied.clear();
+                }
+            }
+            Denial& denial = denied[key];
+            denial.until = now + std::chrono::milliseconds(decision.retry_after_ms);
+            denial.cost = cost;
+        }
+
+        /* Script replies {allowed, remaining, retry_after_ms} */
+        static void fill(const std::vector<long long>& reply, Decision& decision) {
+            redis_assert(reply.size() == 3);
+            decision.allowed = reply[0] == 1;
+            decision.remaining = std::max(reply[1], 0LL);
+            decision.retry_after_ms = decision.allowed ? 0 : std::max(reply[2], 0LL);
+            decision.local = false;
+        }
+
+        bool allow(Connection& conn, const std::string& key, Decision& decision, unsigned int cost) {
+            if(precheck(key, cost, decision)) {
+                return true;
+            }
+            std::vector<long long> reply;
+            if(!script->run(conn, {key}, make_args(cost), reply)) {
+                set_error(conn.get_error());
+                return false;
+            }
+            fill(reply, decision);
+            remember(key, cost, decision);
+            return true;
+        }
+
+        /* Sends calls in one pipeline. With source the first call carries the script, so the rest can use EVALSHA */
+        bool send(Connection& conn, const std::vector<std::string>& keys, const std::vector<Call>& calls, const std::vector<size_t>& indices, bool with_source) {
+            bool ok = true;
+            for(size_t i = 0; i < indices.size() && ok; i++) {
+                const Call& call = calls[indices[i]];
+                ok = script->append(conn, {keys[call.index]}, call.args, with_source && i == 0);
+            }
+            ok = ok && conn.flush_commands();
+            if(!ok) {
+                if(indices.size() > 1) {
+                    conn.abandon();
+                }
+                set_error(conn.get_error());
+            }
+            return ok;
+        }
+
+        /* Reads replies of pipeline. Returns false if any failed. Calls of script unknown to server are added to noscript */
+        bool receive(Connection& conn, const std::vector<std::string>& keys, std::vector<Decision>& decisions, unsigned int cost,
+                const std::vector<Call>& calls, const std::vector<size_t>& indices, std::vector<size_t>* noscript) {
+            bool ok = true;
+            std::vector<long long> reply;
+            for(size_t i = 0; i < indices.size(); i++) {
+                size_t index = calls[indices[i]].index;
+                if(conn.fetch_reply()) {
+                    Script::read_integers(conn, reply);
+                    fill(reply, decisions[index]);
+                    remember(keys[index], cost, decisions[index]);
+                    continue;
+                }
+                if(noscript != nullptr && Script::is_noscript(conn)) {
+                    noscript->push_back(indices[i]);
+                    continue;
+                }
+                set_error(conn.get_error());
+                ok = false;
+                if(conn.get_errno() != Connection::Error::REPLY_ERR) {
+                    //Connection failed, replies of the rest are lost
+                    return false;
+                }
+            }
+            return ok;
+        }
+
+        bool allow(const std::vector<std::string>& keys, std::vector<Decision>& decisions, unsigned int cost) {
+            decisions.resize(keys.size());
+            std::vector<Call> calls;
+            std::vector<const ConnectionParam*> params;
+            std::vector<std::vector<size_t>> groups;
+            for(size_t i = 0; i < keys.size(); i++) {
+                if(precheck(keys[i], cost, decisions[i])) {
+                    continue;
+                }
+                const ConnectionParam* key_param = get_param(keys[i]);
+                size_t group = static_cast<size_t>(std::find(params.begin(), params.end(), key_param) - params.begin());
+                if(group == params.size()) {
+                    params.push_back(key_param);
+                    groups.push_back(std::vector<size_t>());
+                }
+                groups[group].push_back(calls.size());
+                calls.emplace_back(i, make_args(cost));
+            }
+            //All pipelines are in flight at once
+            //Errors are reported by return value, pipelines must not throw on NOSCRIPT
+            bool ok = true;
+            std::vector<PoolWrapper> conns;
+            std::vector<bool> sent;
+            std::vector<bool> throw_on_error;
+            conns.reserve(groups.size());
+            for(size_t i = 0; i < groups.size(); i++) {
+                conns.push_back(lease(keys[calls[groups[i][0]].index]));
+                throw_on_error.push_back(conns[i]->set_throw_on_error(false));
+                sent.push_back(send(*conns[i], keys, calls, groups[i], false));
+                ok = ok && sent[i];
+            }
+            for(size_t i = 0; i < groups.size(); i++) {
+                if(sent[i]) {
+                    std::vector<size_t> noscript;
+                    ok = receive(*conns[i], keys, decisions, cost, calls, groups[i], &noscript) && ok;
+                    if(!noscript.empty()) {
+                        ok = send(*conns[i], keys, calls, noscript, true) && receive(*conns[i], keys, decisions, cost, calls, noscript, nullptr) && ok;
+                    }
+                }
+                conns[i]->set_throw_on_error(throw_on_error[i]);
+            }
+            return ok;
+        }
+    };
+
+    //Time is taken from server, replicate_commands allows writes after TIME on redis before 5.
+    //Microsecond timestamps are passed to commands with %d, as numbers are converted with %.14g and would lose precision
+    const Script RateLimiter::Impl::gcra_script(
+        "redis.replicate_commands() "
+        "local now = redis.call('TIME') "
+        "now = tonumber(now[1]) * 1000000 + tonumber(now[2]) "
+        "local interval = tonumber(ARGV[1]) "
+        "local tolerance = tonumber(ARGV[2]) "
+        "local tat = tonumber(redis.call('GET', KEYS[1])) or now "
+        "if tat < now then tat = now end "
+        "local new_tat = tat + interval * tonumber(ARGV[3]) "
+        "local allow_at = new_tat - tolerance "
+        "if allow_at > now then "
+            "return {0, math.floor((tolerance - (tat - now)) / interval), math.ceil((allow_at - now) / 1000)} "
+        "end "
+        "redis.call('SET', KEYS[1], string.format('%d', new_tat), 'PX', math.ceil((new_tat - now) / 1000)) "
+        "return {1, math.floor((tolerance - (new_tat - now)) / interval), 0}"
+    );
+    const Script RateLimiter::Impl::sliding_window_script(
+        "redis.replicate_commands() "
+        "local now = redis.call('TIME') "
+        "now = tonumber(now[1]) * 1000000 + tonumber(now[2]) "
+        "local window = tonumber(ARGV[1]) "
+        "local limit = tonumber(ARGV[2]) "
+        "local cost = tonumber(ARGV[3]) "
+        "redis.call('ZREMRANGEBYSCORE', KEYS[1], '-inf', string.format('%d', now - window)) "
+        "local count = redis.call('ZCARD', KEYS[1]) "
+        "if count + cost > limit then "
+            //Request fits when enough of the oldest entries leave the window
+            "local retry = 0 "
+            "local oldest = redis.call('ZRANGE', KEYS[1], count + cost - limit - 1, count + cost - limit - 1, 'WITHSCORES') "
+            "if oldest[2] then retry = math.ceil((tonumber(oldest[2]) + window - now) / 1000) end "
+            "return {0, limit - count, retry} "
+        "end "
+        "local score = string.format('%d', now) "
+        "for i = 1, cost do redis.call('ZADD', KEYS[1], score, ARGV[4] .. i) end "
+        "redis.call('PEXPIRE', KEYS[1], math.ceil(window / 1000)) "
+        "return {1, limit - count - cost, 0}"
+    );
+    const Script RateLimiter::Impl::fixed_window_script(
+        "local count = tonumber(redis.call('GET', KEYS[1])) or 0 "
+        "local limit = tonumber(ARGV[2]) "
+        "local cost = tonumber(ARGV[3]) "
+        "if count + cost > limit then return {0, limit - count, redis.call('PTTL', KEYS[1])} end "
+        "count = redis.call('INCRBY', KEYS[1], cost) "
+        "if count == cost then redis.call('PEXPIRE', KEYS[1], ARGV[1]) end "
+        "return {1, limit - count, 0}"
+    );
+
+    RateLimiter::RateLimiter(const Limit& limit, const ConnectionParam& param, const Options& options) :
+        d(new RateLimiter::Impl(limit, param, nullptr, options))
+    {}
+
+    RateLimiter::RateLimiter(const Limit& limit, const std::string& pool_name, const Options& options) :
+        d(new RateLimiter::Impl(limit, ConnectionParam(), &NamedPool::get_pool(pool_name), options))
+    {}
+
+    RateLimiter::~RateLimiter() {
+        if(d != nullptr) {
+            delete d;
+        }
+    }
+
+    bool RateLimiter::allow(const std::string& key, Decision& decision, unsigned int cost) {
+        if(d->precheck(key, cost, decision)) {
+            return true;
+        }
+        return d->allow(*d->lease(key), key, decision, cost);
+    }
+
+    bool RateLimiter::allow(Connection& conn, const std::string& key, Decision& decision, unsigned int cost) {
+        return d->allow(conn, key, decision, cost);
+    }
+
+    bool RateLimiter::allow(const std::vector<std::string>& keys, std::vector<Decision>& decisions, unsigned int cost) {
+        return d->allow(keys, decisions, cost);
+    }
+
+    bool RateLimiter::reset(const std::string& key) {
+        {
+            std::lock_guard<std::mutex> guard(d->lock);
+            d->denied.erase(key);
+        }
+        PoolWrapper conn = d->lease(key);
+        if(!conn->del(key)) {
+            d->set_error(conn->get_error());
+            return false;
+        }
+        return true;
+    }
+
+    const RateLimiter::Limit& RateLimiter::get_limit() const {
+        return d->limit;
+    }
+
+    std::string RateLimiter::get_error() {
+        std::lock_guard<std::mutex> guard(d->lock);
+        return d->err;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "connection.hpp"
+namespace Redis {
+    /**
+    * Rate limiter evaluated server side by cached Lua scripts, one round trip per decision instead of INCR + EXPIRE + TTL.
+    * Algorithms:
+    *  GCRA - stores single timestamp per key. Allows burst requests at once and then one request per period / limit.
+    *  SLIDING_WINDOW - log of request times in sorted set. Exact: at most limit requests in any period, costs memory per request.
+    *  FIXED_WINDOW - counter reset every period. Cheapest, but allows up to 2 * limit requests around window border.
+    * GCRA and sliding window use server time, so clocks of clients don't matter.
+    *
+    * Keys of a NamedPool are limited on the shard holding them. Batch of keys is evaluated in one pipeline per shard.
+    *
+    * With local_precheck a denied key is remembered until its retry_after, and requests for it are denied without
+    * a network call, so clients hammering over the limit don't load redis. Such decisions have local set.
+    * Denial of a key only gets shorter when other clients' requests expire, so local decisions never deny what redis would allow
+    * except when limit of the key is reset by hand.
+    *
+    * Thread safe.
+    *
+    *  F.e. :
+    *  Redis::RateLimiter limiter(Redis::RateLimiter::Limit(100, 1000), "api_pool");
+    *  Redis::RateLimiter::Decision decision;
+    *  if(limiter.allow("user:42", decision) && !decision.allowed) {
+    *      reply_429(decision.retry_after_ms);
+    *  }
+    * */
+    class RateLimiter {
+    public:
+        enum class Algorithm {
+            GCRA,
+            SLIDING_WINDOW,
+            FIXED_WINDOW
+        };
+
+        struct Limit {
+            //Requests allowed per period
+            unsigned long long limit;
+            unsigned int period_ms;
+            Algorithm algorithm;
+            //GCRA only: requests allowed at once. 0 means limit
+            unsigned long long burst;
+            Limit(unsigned long long _limit, unsigned int _period_ms, Algorithm _algorithm = Algorithm::GCRA, unsigned long long _burst = 0) :
+                limit(_limit), period_ms(_period_ms), algorithm(_algorithm), burst(_burst) {}
+        };
+
+        struct Decision {
+            bool allowed;
+            //Requests which can be made right after this one
+            long long remaining;
+            //When the same request may be allowed. 0 if allowed, -1 if cost is above limit and it is never allowed
+            long long retry_after_ms;
+            //Decided by local pre-check without a request to redis
+            bool local;
+            Decision() : allowed(false), remaining(0), retry_after_ms(0), local(false) {}
+        };
+
+        struct Options {
+            bool local_precheck;
+            //Max number of denied keys remembered locally
+            size_t local_cache_size;
+            Options() : local_precheck(false), local_cache_size(10000) {}
+        };
+
+        /* Keys live on a single server */
+        explicit RateLimiter(const Limit& limit, const ConnectionParam& param = ConnectionParam(), const Options& options = Options());
+
+        /* Keys are sharded by NamedPool, which must be created before */
+        RateLimiter(const Limit& limit, const std::string& pool_name, const Options& options = Options());
+
+        ~RateLimiter();
+        RateLimiter(const RateLimiter& other) = delete;
+        RateLimiter& operator=(const RateLimiter& other) = delete;
+
+        /* Takes cost requests of key if allowed. Returns false on error, decision tells whether request is allowed */
+        bool allow(const std::string& key, Decision& decision, unsigned int cost = 1);
+
+        /* The same on given connection, f.e. inside of a connection already leased */
+        bool allow(Connection& conn, const std::string& key, Decision& decision, unsigned int cost = 1);
+
+        /* Decisions for many keys in one pipeline per server. Returns false if any of them failed, failed decisions are denied */
+        bool allow(const std::vector<std::string>& keys, std::vector<Decision>& decisions, unsigned int cost = 1);
+
+        /* Forgets the key in redis and locally */
+        bool reset(const std::string& key);
+
+        const Limit& get_limit() const;
+
+        /* Error of the last failed call */
+        std::string get_error();
+
+    private:
+        class Impl;
+        Impl* d;
+    };
+}
\ No newline at end of file
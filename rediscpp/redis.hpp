@@ -7,3 +7,24 @@
 #include "pool.hpp"
 #include "named_pool.hpp"
 #include "pool_wrapper.hpp"
+#include "sentinel.hpp"
+#include "string_ref.hpp"
+#include "scanner.hpp"
+#include "codec.hpp"
+#include "type_codec.hpp"
+#include "hedged_reader.hpp"
+#include "single_flight.hpp"
+#include "auto_batcher.hpp"
+#include "multiplexed_connection.hpp"
+#include "capabilities.hpp"
+#include "deadline.hpp"
+#include "admission.hpp"
+#include "script.hpp"
+#include "lock.hpp"
+#include "rate_limiter.hpp"
+#include "bloom_filter.hpp"
+#include "bitfield.hpp"
+#include "hyperloglog.hpp"
+#include "stream_consumer.hpp"
+#include "stream.hpp"
+#include "list_queue.hpp"
@@ -0,0 +1,304 @@
+#include "scanner.hpp"
+#include "exception.hpp"
+#include "log.hpp"
+#include "macro.hpp"
+#include <hiredis/hiredis.h>
+#include <vector>
+#include <cstdlib>
+
+namespace Redis {
+    constexpr long Scanner::min_count;
+    constexpr long Scanner::max_count;
+    constexpr long Scanner::default_count;
+    constexpr unsigned int Scanner::default_target_latency_us;
+
+    Scanner::Scanner(Connection& _conn, const char* _command, const std::string& _key, const std::string& _pattern, long initial_count, unsigned int _target_latency_us) :
+        conn(_conn),
+        command(_command),
+        key(_key),
+        pattern(_pattern),
+        prefix_size(_conn.get_prefix().size()),
+        cursor(0),
+        count(initial_count < min_count ? min_count : (initial_count > max_count ? max_count : initial_count)),
+        target_latency_us(_target_latency_us),
+        sent_at(0),
+        started(false),
+        in_flight(false),
+        finished(false),
+        failed(false),
+        page_count(0),
+        page(nullptr),
+        index(0)
+    {}
+
+    Scanner::~Scanner() {
+        //Read prefetched page, so connection can be used right after scanner
+        if(in_flight) {
+            conn.fetch_reply();
+        }
+    }
+
+    bool Scanner::send_request() {
+        std::vector<const char*> args;
+        std::vector<size_t> sizes;
+        const std::string cursor_str = std::to_string(cursor);
+        const std::string count_str = std::to_string(count);
+        args.push_back(command.c_str());
+        sizes.push_back(command.size());
+        if(!key.empty()) {
+            args.push_back(key.c_str());
+            sizes.push_back(key.size());
+        }
+        args.push_back(cursor_str.c_str());
+        sizes.push_back(cursor_str.size());
+        if(pattern != "*") {
+            args.push_back("MATCH");
+            sizes.push_back(5);
+            args.push_back(pattern.c_str());
+            sizes.push_back(pattern.size());
+        }
+        args.push_back("COUNT");
+        sizes.push_back(5);
+        args.push_back(count_str.c_str());
+        sizes.push_back(count_str.size());
+        if(!conn.append_command(args, sizes) || !conn.flush_commands()) {
+            failed = true;
+            return false;
+        }
+        sent_at = microtime();
+        in_flight = true;
+        page_count++;
+        return true;
+    }
+
+    bool Scanner::next_page() {
+        page = nullptr;
+        index = 0;
+        if(!in_flight) {
+            return false;
+        }
+        double wait_start = microtime();
+        in_flight = false;
+        if(!conn.fetch_reply()) {
+            failed = true;
+            return false;
+        }
+        double now = microtime();
+        const redisReply* reply = conn.get_reply();
+        if(reply->type != REDIS_REPLY_ARRAY || reply->elements != 2 ||
+           reply->element[0]->type != REDIS_REPLY_STRING || reply->element[1]->type != REDIS_REPLY_ARRAY) {
+            rediscpp_debug(LL::WARNING, command << ": unexpected reply format");
+            failed = true;
+            return false;
+        }
+        cursor = std::stoull(std::string(reply->element[0]->str, static_cast<size_t>(reply->element[0]->len)));
+        page = reply->element[1];
+        if(cursor == 0) {
+            finished = true;
+            return true;
+        }
+        //Latency includes time spent by the caller on the previous page, so it's trusted as too high only when we actually waited for reply
+        double latency_us = (now - sent_at) * 1000000;
+        bool waited = (now - wait_start) * 1000000 > latency_us / 2;
+        if(latency_us < target_latency_us / 2.0 && count < max_count) {
+            count = count * 2 > max_count ? max_count : count * 2;
+        }
+        else if(waited && latency_us > target_latency_us && count > min_count) {
+            count = count / 2 < min_count ? min_count : count / 2;
+        }
+        //Next page is requested before the caller processes the current one. Reply buffer of the current page stays untouched until fetch.
+        //If request fails current page is still delivered, failure is reported after it.
+        send_request();
+        return true;
+    }
+
+    bool Scanner::advance(size_t step) {
+        if(!started) {
+            started = true;
+            if(!send_request()) {
+                return false;
+            }
+        }
+        else {
+            index += step;
+        }
+        while(page == nullptr || index >= page->elements) {
+            //Nothing requested means either the last page is over or request failed
+            if(!in_flight || !next_page()) {
+                page = nullptr;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    StringRef Scanner::element(size_t offset) const {
+        redis_assert(page != nullptr && index + offset < page->elements);
+        const redisReply* item = page->element[index + offset];
+        return StringRef(item->str, static_cast<size_t>(item->len));
+    }
+
+    StringRef Scanner::key_element(size_t offset) const {
+        StringRef item = element(offset);
+        redis_assert(item.size() >= prefix_size);
+        return item.substr(prefix_size);
+    }
+
+    bool Scanner::has_element(size_t offset) const {
+        return page != nullptr && index + offset < page->elements;
+    }
+
+    KeyScanner::KeyScanner(Connection& _conn, const std::string& _pattern, long initial_count, unsigned int _target_latency_us) :
+        Scanner(_conn, "SCAN", "", _conn.get_prefix() + _pattern, initial_count, _target_latency_us),
+        current()
+    {}
+
+    KeyScanner::Iterator KeyScanner::begin() {
+        return next() ? Iterator(this) : end();
+    }
+
+    bool KeyScanner::next() {
+        if(!advance(1)) {
+            return false;
+        }
+        current = key_element(0);
+        return true;
+    }
+
+    bool KeyScanner::next(StringRef& result) {
+        if(!next()) {
+            return false;
+        }
+        result = current;
+        return true;
+    }
+
+    bool KeyScanner::next_batch(StringValueHolder&& result) {
+        if(!next()) {
+            return false;
+        }
+        result.push_back(current.str());
+        while(has_element(1) && next()) {
+            result.push_back(current.str());
+        }
+        return true;
+    }
+
+    bool KeyScanner::for_each(const Callback& callback) {
+        while(next()) {
+            if(!callback(current)) {
+                break;
+            }
+        }
+        return is_ok();
+    }
+
+    HashScanner::HashScanner(Connection& _conn, const std::string& _key, const std::string& _pattern, long initial_count, unsigned int _target_latency_us) :
+        Scanner(_conn, "HSCAN", _conn.get_prefix() + _key, _pattern, initial_count, _target_latency_us)
+    {}
+
+    bool HashScanner::next(StringRef& field, StringRef& value) {
+        if(!advance(2)) {
+            return false;
+        }
+        redis_assert(has_element(1));
+        field = element(0);
+        value = element(1);
+        return true;
+    }
+
+    bool HashScanner::next_batch(PairHolder<std::string, std::string>&& result) {
+        StringRef field, value;
+        if(!next(field, value)) {
+            return false;
+        }
+        result.push_back(std::make_pair(field.str(), value.str()));
+        while(has_element(2) && next(field, value)) {
+            result.push_back(std::make_pair(field.str(), value.str()));
+        }
+        return true;
+    }
+
+    bool HashScanner::for_each(const Callback& callback) {
+        StringRef field, value;
+        while(next(field, value)) {
+            if(!callback(field, value)) {
+                break;
+            }
+        }
+        return is_ok();
+    }
+
+    SetScanner::SetScanner(Connection& _conn, const std::string& _key, const std::string& _pattern, long initial_count, unsigned int _target_latency_us) :
+        Scanner(_conn, "SSCAN", _conn.get_prefix() + _key, _pattern, initial_count, _target_latency_us)
+    {}
+
+    bool SetScanner::next(StringRef& member) {
+        if(!advance(1)) {
+            return false;
+        }
+        member = element(0);
+        return true;
+    }
+
+    bool SetScanner::next_batch(StringValueHolder&& result) {
+        StringRef member;
+        if(!next(member)) {
+            return false;
+        }
+        result.push_back(member.str());
+        while(has_element(1) && next(member)) {
+            result.push_back(member.str());
+        }
+        return true;
+    }
+
+    bool SetScanner::for_each(const Callback& callback) {
+        StringRef member;
+        while(next(member)) {
+            if(!callback(member)) {
+                break;
+            }
+        }
+        return is_ok();
+    }
+
+    SortedSetScanner::SortedSetScanner(Connection& _conn, const std::string& _key, const std::string& _pattern, long initial_count, unsigned int _target_latency_us) :
+        Scanner(_conn, "ZSCAN", _conn.get_prefix() + _key, _pattern, initial_count, _target_latency_us)
+    {}
+
+    bool SortedSetScanner::next(StringRef& member, double& score) {
+        if(!advance(2)) {
+            return false;
+        }
+        redis_assert(has_element(1));
+        member = element(0);
+        //reply strings are null terminated by hiredis
+        score = std::strtod(element(1).data(), nullptr);
+        return true;
+    }
+
+    bool SortedSetScanner::next_batch(PairHolder<std::string, double>&& result) {
+        StringRef member;
+        double score;
+        if(!next(member, score)) {
+            return false;
+        }
+        result.push_back(std::make_pair(member.str(), score));
+        while(has_element(2) && next(member, score)) {
+            result.push_back(std::make_pair(member.str(), score));
+        }
+        return true;
+    }
+
+    bool SortedSetScanner::for_each(const Callback& callback) {
+        StringRef member;
+        double score;
+        while(next(member, score)) {
+            if(!callback(member, score)) {
+                break;
+            }
+        }
+        return is_ok();
+    }
+}
@@ -0,0 +1,194 @@
+#pragma once
+#include <string>
+#include <iterator>
+#include <functional>
+#include "connection.hpp"
+#include "string_ref.hpp"
+namespace Redis {
+
+    /**
+    * Base for cursor based iteration (SCAN, HSCAN, SSCAN, ZSCAN).
+    * Next page is requested right after the current one is received, so network round trip overlaps with processing of the current page.
+    * COUNT is adapted after each page: it's doubled while page round trip is below half of target latency
+    * and halved when it's above target. This keeps each call cheap for the server without too many round trips.
+    *
+    * Connection must not be used for other commands while scanner is alive - this would drop prefetched page.
+    * Elements are views into the reply buffer and are valid only until the scanner moves to the next page.
+    */
+    class Scanner {
+    public:
+        static constexpr long min_count = 10;
+        static constexpr long max_count = 10000;
+        static constexpr long default_count = 100;
+        static constexpr unsigned int default_target_latency_us = 1000;
+
+        Scanner(const Scanner& other) = delete;
+        Scanner& operator=(const Scanner& other) = delete;
+        ~Scanner();
+
+        /* false if iteration was interrupted by error. Error itself can be obtained from connection */
+        bool is_ok() const { return !failed; }
+
+        /* COUNT which will be used for the next request */
+        long get_count() const { return count; }
+
+        /* Number of requests sent so far */
+        size_t get_page_count() const { return page_count; }
+
+    protected:
+        /*
+        * command - SCAN, HSCAN, SSCAN or ZSCAN
+        * key - already prefixed key to iterate over, empty for SCAN
+        * pattern - MATCH argument as is, omitted if it's "*"
+        */
+        Scanner(Connection& conn, const char* command, const std::string& key, const std::string& pattern, long initial_count, unsigned int target_latency_us);
+
+        /* Move current position by step elements. First call starts iteration. Returns false when elements are over or on error */
+        bool advance(size_t step);
+
+        /* Element of current page at current position + offset */
+        StringRef element(size_t offset) const;
+
+        /* Element of current page at current position + offset with connection prefix removed */
+        StringRef key_element(size_t offset) const;
+
+        /* Whether current page has element at current position + offset */
+        bool has_element(size_t offset) const;
+
+    private:
+        bool send_request();
+        bool next_page();
+
+        Connection& conn;
+        std::string command;
+        std::string key;
+        std::string pattern;
+        size_t prefix_size;
+        unsigned long long cursor;
+        long count;
+        unsigned int target_latency_us;
+        double sent_at;
+        bool started;
+        bool in_flight;
+        bool finished;
+        bool failed;
+        size_t page_count;
+        const redisReply* page;
+        size_t index;
+    };
+
+    /**
+    * Iterates over keyspace with SCAN. Usable in range-for:
+    *
+    *  Redis::KeyScanner scanner(connection, "user:*");
+    *  for(const Redis::StringRef& key : scanner) {
+    *      ...
+    *  }
+    *  if(!scanner.is_ok()) {...}
+    *
+    * Keys are returned without connection prefix. Scanner can be iterated only once.
+    */
+    class KeyScanner : public Scanner {
+    public:
+        class Iterator : public std::iterator<std::input_iterator_tag, StringRef> {
+            KeyScanner* scanner;
+        public:
+            explicit Iterator(KeyScanner* _scanner) : scanner(_scanner) {}
+            const StringRef& operator*() const { return scanner->current; }
+            const StringRef* operator->() const { return &scanner->current; }
+            Iterator& operator++() {
+                if(!scanner->next()) {
+                    scanner = nullptr;
+                }
+                return *this;
+            }
+            bool operator==(const Iterator& other) const { return scanner == other.scanner; }
+            bool operator!=(const Iterator& other) const { return scanner != other.scanner; }
+        };
+
+        typedef std::function<bool(const StringRef& key)> Callback;
+
+        KeyScanner(Connection& conn, const std::string& pattern = "*", long initial_count = default_count, unsigned int target_latency_us = default_target_latency_us);
+
+        Iterator begin();
+        Iterator end() { return Iterator(nullptr); }
+
+        /* Fetch next key. Alternative to range-for */
+        bool next(StringRef& key);
+
+        /* Copy the rest of the current page to result. Returns false when keys are over */
+        bool next_batch(StringValueHolder&& result);
+
+        /* Call callback for each key until it returns false. Returns false on error */
+        bool for_each(const Callback& callback);
+
+    private:
+        bool next();
+        StringRef current;
+    };
+
+    /**
+    * Iterates over fields and values of a hash with HSCAN.
+    * Memory used is bounded by a single page, so it's suitable for hashes which are too big for HGETALL.
+    *
+    *  Redis::HashScanner scanner(connection, "user:1:sessions");
+    *  scanner.for_each([](const Redis::StringRef& field, const Redis::StringRef& value) {
+    *      ...
+    *      return true;
+    *  });
+    * */
+    class HashScanner : public Scanner {
+    public:
+        typedef std::function<bool(const StringRef& field, const StringRef& value)> Callback;
+
+        /* pattern is matched against fields */
+        HashScanner(Connection& conn, const std::string& key, const std::string& pattern = "*", long initial_count = default_count, unsigned int target_latency_us = default_target_latency_us);
+
+        bool next(StringRef& field, StringRef& value);
+
+        /* Copy the rest of the current page to result. Returns false when fields are over */
+        bool next_batch(PairHolder<std::string, std::string>&& result);
+
+        /* Call callback for each field until it returns false. Returns false on error */
+        bool for_each(const Callback& callback);
+    };
+
+    /**
+    * Iterates over members of a set with SSCAN. Memory used is bounded by a single page.
+    * */
+    class SetScanner : public Scanner {
+    public:
+        typedef std::function<bool(const StringRef& member)> Callback;
+
+        /* pattern is matched against members */
+        SetScanner(Connection& conn, const std::string& key, const std::string& pattern = "*", long initial_count = default_count, unsigned int target_latency_us = default_target_latency_us);
+
+        bool next(StringRef& member);
+
+        /* Copy the rest of the current page to result. Returns false when members are over */
+        bool next_batch(StringValueHolder&& result);
+
+        /* Call callback for each member until it returns false. Returns false on error */
+        bool for_each(const Callback& callback);
+    };
+
+    /**
+    * Iterates over members and scores of a sorted set with ZSCAN. Memory used is bounded by a single page.
+    * Members are returned in no particular order.
+    * */
+    class SortedSetScanner : public Scanner {
+    public:
+        typedef std::function<bool(const StringRef& member, double score)> Callback;
+
+        /* pattern is matched against members */
+        SortedSetScanner(Connection& conn, const std::string& key, const std::string& pattern = "*", long initial_count = default_count, unsigned int target_latency_us = default_target_latency_us);
+
+        bool next(StringRef& member, double& score);
+
+        /* Copy the rest of the current page to result. Returns false when members are over */
+        bool next_batch(PairHolder<std::string, double>&& result);
+
+        /* Call callback for each member until it returns false. Returns false on error */
+        bool for_each(const Callback& callback);
+    };
+}
@@ -0,0 +1,215 @@
+#include "script.hpp"
+#include "macro.hpp"
+#include "exception.hpp"
+#include <hiredis/hiredis.h>
+#include <cstdint>
+#include <cstring>
+
+namespace Redis {
+    namespace {
+        inline uint32_t rotate_left(uint32_t value, int bits) {
+            return static_cast<uint32_t>((value << bits) | (value >> (32 - bits)));
+        }
+
+        void sha1_block(uint32_t state[5], const unsigned char* block) {
+            uint32_t w[80];
+            for(int i = 0; i < 16; i++) {
+                w[i] = static_cast<uint32_t>(block[i * 4]) << 24 | static_cast<uint32_t>(block[i * 4 + 1]) << 16 |
+                        static_cast<uint32_t>(block[i * 4 + 2]) << 8 | static_cast<uint32_t>(block[i * 4 + 3]);
+            }
+            for(int i = 16; i < 80; i++) {
+                w[i] = rotate_left(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+            uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+            for(int i = 0; i < 80; i++) {
+                uint32_t f, k;
+                if(i < 20) {
+                    f = (b & c) | (~b & d);
+                    k = 0x5A827999;
+                }
+                else if(i < 40) {
+                    f = b ^ c ^ d;
+                    k = 0x6ED9EBA1;
+                }
+                else if(i < 60) {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8F1BBCDC;
+                }
+                else {
+                    f = b ^ c ^ d;
+                    k = 0xCA62C1D6;
+                }
+                uint32_t temp = rotate_left(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = rotate_left(b, 30);
+                b = a;
+                a = temp;
+            }
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+        }
+    }
+
+    std::string sha1_hex(const std::string& data) {
+        uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+        size_t full_blocks = data.size() / 64;
+        for(size_t i = 0; i < full_blocks; i++) {
+            sha1_block(state, bytes + i * 64);
+        }
+        //Padding: 0x80, zeros and 64 bit big endian length in bits
+        unsigned char tail[128];
+        size_t rest = data.size() - full_blocks * 64;
+        std::memset(tail, 0, sizeof(tail));
+        std::memcpy(tail, bytes + full_blocks * 64, rest);
+        tail[rest] = 0x80;
+        size_t tail_size = rest + 9 <= 64 ? 64 : 128;
+        unsigned long long bits = static_cast<unsigned long long>(data.size()) * 8;
+        for(size_t i = 0; i < 8; i++) {
+            tail[tail_size - 1 - i] = static_cast<unsigned char>(bits >> (i * 8));
+        }
+        for(size_t i = 0; i < tail_size; i += 64) {
+            sha1_block(state, tail + i);
+        }
+        static const char digits[] = "0123456789abcdef";
+        std::string result;
+        result.reserve(40);
+        for(size_t i = 0; i < 5; i++) {
+            for(int shift = 28; shift >= 0; shift -= 4) {
+                result.push_back(digits[(state[i] >> shift) & 0xF]);
+            }
+        }
+        return result;
+    }
+
+    Script::Script(const std::string& _source) :
+        source(_source),
+        sha(sha1_hex(_source))
+    {}
+
+    const std::string& Script::get_source() const {
+        return source;
+    }
+
+    const std::string& Script::get_sha() const {
+        return sha;
+    }
+
+    bool Script::append(Connection& conn, const std::vector<std::string>& keys, const std::vector<std::string>& args, bool with_source) const {
+        const std::string& prefix = conn.get_prefix();
+        std::string key_count = std::to_string(keys.size());
+        std::vector<std::string> prefixed_keys;
+        std::vector<const char*> commands;
+        std::vector<size_t> sizes;
+        prefixed_keys.reserve(keys.size());
+        commands.reserve(keys.size() + args.size() + 3);
+        sizes.reserve(keys.size() + args.size() + 3);
+        commands.push_back(with_source ? "EVAL" : "EVALSHA");
+        sizes.push_back(with_source ? 4 : 7);
+        const std::string& script = with_source ? source : sha;
+        commands.push_back(script.c_str());
+        sizes.push_back(script.size());
+        commands.push_back(key_count.c_str());
+        sizes.push_back(key_count.size());
+        for(size_t i = 0; i < keys.size(); i++) {
+            prefixed_keys.push_back(prefix + keys[i]);
+            commands.push_back(prefixed_keys.back().c_str());
+            sizes.push_back(prefixed_keys.back().size());
+        }
+        for(size_t i = 0; i < args.size(); i++) {
+            commands.push_back(args[i].c_str());
+            sizes.push_back(args[i].size());
+        }
+        return conn.append_command(commands, sizes);
+    }
+
+    bool Script::is_noscript(Connection& conn) {
+        const redisReply* reply = conn.get_reply();
+        return conn.get_errno() == Connection::Error::REPLY_ERR && reply != nullptr && reply->type == REDIS_REPLY_ERROR &&
+                reply->len >= 8 && std::strncmp(reply->str, "NOSCRIPT", 8) == 0;
+    }
+
+    bool Script::read_integer(Connection& conn, long long& result) {
+        const redisReply* reply = conn.get_reply();
+        if(reply->type == REDIS_REPLY_NIL) {
+            result = 0;
+            return true;
+        }
+        redis_assert(reply->type == REDIS_REPLY_INTEGER);
+        result = reply->integer;
+        return true;
+    }
+
+    bool Script::execute(Connection& conn, const std::vector<std::string>& keys, const std::vector<std::string>& args) const {
+        //NOSCRIPT must not throw, other errors are thrown after fallback
+        bool throw_on_error = conn.set_throw_on_error(false);
+        bool ok = append(conn, keys, args) && conn.flush_commands() && conn.fetch_reply();
+        if(!ok && is_noscript(conn)) {
+            ok = append(conn, keys, args, true) && conn.flush_commands() && conn.fetch_reply();
+        }
+        conn.set_throw_on_error(throw_on_error);
+        if(!ok && throw_on_error) {
+            throw Redis::Exception(conn.get_error());
+        }
+        return ok;
+    }
+
+    bool Script::run(Connection& conn, const std::vector<std::string>& keys, const std::vector<std::string>& args, long long& result) const {
+        return execute(conn, keys, args) && read_integer(conn, result);
+    }
+
+    bool Script::run(Connection& conn, const std::vector<std::string>& keys, const std::vector<std::string>& args, std::string& result) const {
+        if(!execute(conn, keys, args)) {
+            return false;
+        }
+        const redisReply* reply = conn.get_reply();
+        if(reply->type == REDIS_REPLY_NIL) {
+            result.clear();
+            return true;
+        }
+        redis_assert(reply->type == REDIS_REPLY_STRING || reply->type == REDIS_REPLY_STATUS);
+        result.assign(reply->str, reply->len);
+        return true;
+    }
+
+    bool Script::read_integers(Connection& conn, std::vector<long long>& result) {
+        const redisReply* reply = conn.get_reply();
+        result.clear();
+        if(reply->type == REDIS_REPLY_NIL) {
+            return true;
+        }
+        redis_assert(reply->type == REDIS_REPLY_ARRAY);
+        result.reserve(reply->elements);
+        for(size_t i = 0; i < reply->elements; i++) {
+            redis_assert(reply->element[i]->type == REDIS_REPLY_INTEGER || reply->element[i]->type == REDIS_REPLY_NIL);
+            result.push_back(reply->element[i]->type == REDIS_REPLY_INTEGER ? reply->element[i]->integer : 0);
+        }
+        return true;
+    }
+
+    bool Script::run(Connection& conn, const std::vector<std::string>& keys, const std::vector<std::string>& args, std::vector<long long>& result) const {
+        return execute(conn, keys, args) && read_integers(conn, result);
+    }
+
+    bool Script::run(Connection& conn, const std::vector<std::string>& keys, const std::vector<std::string>& args, std::vector<std::string>& result) const {
+        if(!execute(conn, keys, args)) {
+            return false;
+        }
+        const redisReply* reply = conn.get_reply();
+        result.clear();
+        if(reply->type == REDIS_REPLY_NIL) {
+            return true;
+        }
+        redis_assert(reply->type == REDIS_REPLY_ARRAY);
+        result.reserve(reply->elements);
+        for(size_t i = 0; i < reply->elements; i++) {
+            redis_assert(reply->element[i]->type == REDIS_REPLY_STRING);
+            result.push_back(std::string(reply->element[i]->str, reply->element[i]->len));
+        }
+        return true;
+    }
+}
\ No newline at end of file
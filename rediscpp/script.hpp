@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "connection.hpp"
+namespace Redis {
+    /**
+    * Lua script run with EVALSHA. SHA1 is computed once on construction, so the script is never loaded with a separate round trip:
+    * if server doesn't know it yet (new server, restart, SCRIPT FLUSH) NOSCRIPT is answered and the script is sent with EVAL, which caches it.
+    * Keys get prefix of the connection. Immutable, so a single Script can be shared by all threads and connections.
+    *
+    *  F.e. :
+    *  static const Redis::Script compare_and_delete("if redis.call('GET', KEYS[1]) == ARGV[1] then return redis.call('DEL', KEYS[1]) end return 0");
+    *  long long deleted;
+    *  compare_and_delete.run(conn, {"key"}, {"expected"}, deleted);
+    * */
+    class Script {
+    public:
+        explicit Script(const std::string& source);
+
+        const std::string& get_source() const;
+
+        /* Lowercase hex SHA1 of source, as returned by SCRIPT LOAD */
+        const std::string& get_sha() const;
+
+        /* Runs script which returns integer. Nil (Lua false) is returned as 0 */
+        bool run(Connection& conn, const std::vector<std::string>& keys, const std::vector<std::string>& args, long long& result) const;
+
+        /* Runs script which returns string. Nil is returned as empty string */
+        bool run(Connection& conn, const std::vector<std::string>& keys, const std::vector<std::string>& args, std::string& result) const;
+
+        /* Runs script which returns array of integers, f.e. {allowed, remaining, retry_after} */
+        bool run(Connection& conn, const std::vector<std::string>& keys, const std::vector<std::string>& args, std::vector<long long>& result) const;
+
+        /* Runs script which returns array of strings. Nil is returned as empty array */
+        bool run(Connection& conn, const std::vector<std::string>& keys, const std::vector<std::string>& args, std::vector<std::string>& result) const;
+
+    private:
+        //Pipelining of many scripts, f.e. renewal of all locks held on a server in one round trip
+        friend class Lock;
+        friend class RateLimiter;
+        std::string source;
+        std::string sha;
+
+        /* Appends EVALSHA, or EVAL with with_source, to pipeline of connection. Reply is fetched with Connection::fetch_reply */
+        bool append(Connection& conn, const std::vector<std::string>& keys, const std::vector<std::string>& args, bool with_source = false) const;
+
+        /* Whether failed reply of the connection means the script should be sent again with source */
+        static bool is_noscript(Connection& conn);
+
+        /* Integer reply of the script fetched from pipeline. Nil is returned as 0 */
+        static bool read_integer(Connection& conn, long long& result);
+
+        /* Array of integers reply of the script fetched from pipeline. Nil is returned as empty array */
+        static bool read_integers(Connection& conn, std::vector<long long>& result);
+
+        /* Sends script and fetches reply, falling back to EVAL on NOSCRIPT */
+        bool execute(Connection& conn, const std::vector<std::string>& keys, const std::vector<std::string>& args) const;
+    };
+
+    /* Lowercase hex SHA1 of data */
+    std::string sha1_hex(const std::string& data);
+}
\ No newline at end of file
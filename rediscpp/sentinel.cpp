@@ -0,0 +1,342 @@
+#include "sentinel.hpp"
+#include "pool.hpp"
+#include "deleters.hpp"
+#include "exception.hpp"
+#include "log.hpp"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+#include <poll.h>
+
+namespace Redis {
+    class Sentinel::Impl {
+        friend class Sentinel;
+        typedef std::unique_ptr<redisReply, ReplyDeleter> Reply;
+        typedef std::unique_ptr<redisContext, ContextDeleter> Context;
+
+        std::string master_name;
+        std::vector<ConnectionParam> sentinels;
+        ConnectionParam master_param;
+        bool resolved;
+        //Params of old masters which still had leased connections during drain
+        std::vector<ConnectionParam> retired_params;
+        std::mutex lock;
+        std::thread watcher;
+        std::atomic<bool> stopping;
+        std::atomic<unsigned long long> failover_count;
+        std::string err;
+
+        Impl(const std::string& _master_name, const std::vector<ConnectionParam>& _sentinels, const ConnectionParam& _master_param) :
+            master_name(_master_name),
+            sentinels(_sentinels),
+            master_param(_master_param),
+            resolved(false),
+            retired_params(),
+            lock(),
+            watcher(),
+            stopping(false),
+            failover_count(0),
+            err()
+        {
+            if(sentinels.empty()) {
+                throw Redis::Exception("No sentinels passed to Redis::Sentinel");
+            }
+        }
+
+        static struct timeval to_timeval(unsigned int ms) {
+            struct timeval timeout;
+            timeout.tv_sec = static_cast<time_t>(ms / 1000);
+            timeout.tv_usec = static_cast<suseconds_t>((ms % 1000) * 1000);
+            return timeout;
+        }
+
+        Context connect(const ConnectionParam& sentinel) {
+            Context context(redisConnectWithTimeout(sentinel.host.c_str(), static_cast<int>(sentinel.port), to_timeval(sentinel.connect_timeout_ms)));
+            if(context == nullptr) {
+                set_error("Could not allocate context for sentinel " + sentinel.host + ":" + std::to_string(sentinel.port));
+                return Context();
+            }
+            if(context->err) {
+                set_error("Could not connect to sentinel " + sentinel.host + ":" + std::to_string(sentinel.port) + ": " + context->errstr);
+                return Context();
+            }
+            redisSetTimeout(context.get(), to_timeval(sentinel.operation_timeout_ms));
+            if(!sentinel.password.empty()) {
+                Reply reply(static_cast<redisReply*>(redisCommand(context.get(), "AUTH %b", sentinel.password.c_str(), sentinel.password.size())));
+                if(reply == nullptr || reply->type == REDIS_REPLY_ERROR) {
+                    set_error("Could not authenticate on sentinel " + sentinel.host + ":" + std::to_string(sentinel.port) + ": " +
+                            (reply == nullptr ? std::string(context->errstr) : std::string(reply->str, reply->len)));
+                    return Context();
+                }
+            }
+            return context;
+        }
+
+        void set_error(const std::string& error) {
+            rediscpp_debug(LL::WARNING, "Sentinel " << master_name << ": " << error);
+            std::lock_guard<std::mutex> guard(lock);
+            err = error;
+        }
+
+        static bool parse_port(const char* str, size_t len, unsigned int& port) {
+            if(str == nullptr || len == 0 || len > 5) {
+                return false;
+            }
+            unsigned int result = 0;
+            for(size_t i = 0; i < len; i++) {
+                if(str[i] < '0' || str[i] > '9') {
+                    return false;
+                }
+                result = result * 10 + static_cast<unsigned int>(str[i] - '0');
+            }
+            if(result == 0 || result > 65535) {
+                return false;
+            }
+            port = result;
+            return true;
+        }
+
+        bool query_master(const ConnectionParam& sentinel, std::string& host, unsigned int& port) {
+            Context context = connect(sentinel);
+            if(context == nullptr) {
+                return false;
+            }
+            Reply reply(static_cast<redisReply*>(redisCommand(context.get(), "SENTINEL get-master-addr-by-name %b", master_name.c_str(), master_name.size())));
+            if(reply == nullptr) {
+                set_error("Sentinel " + sentinel.host + ":" + std::to_string(sentinel.port) + " error: " + context->errstr);
+                return false;
+            }
+            if(reply->type != REDIS_REPLY_ARRAY || reply->elements != 2 || reply->element[0]->type != REDIS_REPLY_STRING || reply->element[1]->type != REDIS_REPLY_STRING) {
+                set_error("Sentinel " + sentinel.host + ":" + std::to_string(sentinel.port) + " doesn't know master " + master_name);
+                return false;
+            }
+            if(!parse_port(reply->element[1]->str, reply->element[1]->len, port)) {
+                set_error("Sentinel " + sentinel.host + ":" + std::to_string(sentinel.port) + " returned malformed port of master " + master_name);
+                return false;
+            }
+            host.assign(reply->element[0]->str, reply->element[0]->len);
+            return true;
+        }
+
+        bool resolve() {
+            std::string host;
+            unsigned int port = 0;
+            std::vector<ConnectionParam> sentinels_copy;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                sentinels_copy = sentinels;
+            }
+            for(size_t i = 0; i < sentinels_copy.size(); i++) {
+                if(query_master(sentinels_copy[i], host, port)) {
+                    //Sentinel which answered goes first next time
+                    if(i != 0) {
+                        std::lock_guard<std::mutex> guard(lock);
+                        std::swap(sentinels[0], sentinels[i]);
+                    }
+                    retarget(host, port);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void retarget(const std::string& host, unsigned int port) {
+            ConnectionParam old_param;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if(resolved && master_param.host == host && master_param.port == port) {
+                    return;
+                }
+                old_param = master_param;
+                master_param.host = host;
+                master_param.port = port;
+                //Failback: connections to the master are fine again, even those leased before it was retired
+                retired_params.erase(std::remove(retired_params.begin(), retired_params.end(), master_param), retired_params.end());
+                if(!resolved) {
+                    resolved = true;
+                    rediscpp_debug(LL::NOTICE, "Sentinel " << master_name << ": master is " << host << ":" << port);
+                    return;
+                }
+                failover_count++;
+            }
+            rediscpp_debug(LL::WARNING, "Sentinel " << master_name << ": master switched from " << old_param.host << ":" << old_param.port << " to " << host << ":" << port);
+            if(Pool::instance().drain(old_param) != 0) {
+                std::lock_guard<std::mutex> guard(lock);
+                //Master might have switched back meanwhile
+                if(old_param != master_param) {
+                    retired_params.push_back(old_param);
+                }
+            }
+        }
+
+        //Connections to old masters which were in use during failover are destroyed as soon as they are returned to the pool
+        void drain_retired() {
+            std::lock_guard<std::mutex> guard(lock);
+            for(size_t i = 0; i < retired_params.size();) {
+                if(Pool::instance().drain(retired_params[i]) == 0) {
+                    retired_params.erase(retired_params.begin() + static_cast<long>(i));
+                }
+                else {
+                    i++;
+                }
+            }
+        }
+
+        /* Message format: <master name> <old ip> <old port> <new ip> <new port> */
+        void on_switch_master(const char* data, size_t len) {
+            std::istringstream message(std::string(data, len));
+            std::string name, old_host, old_port, new_host, new_port_str;
+            unsigned int new_port = 0;
+            if(!(message >> name >> old_host >> old_port >> new_host >> new_port_str) || !parse_port(new_port_str.c_str(), new_port_str.size(), new_port)) {
+                rediscpp_debug(LL::WARNING, "Sentinel " << master_name << ": malformed +switch-master message: " << std::string(data, len));
+                return;
+            }
+            if(name != master_name) {
+                return;
+            }
+            retarget(new_host, new_port);
+        }
+
+        /* Handles one pubsub reply. Returns false if reply is not what subscription should produce */
+        bool handle_message(redisReply* reply) {
+            if(reply->type != REDIS_REPLY_ARRAY || reply->elements != 3) {
+                return false;
+            }
+            const redisReply* kind = reply->element[0];
+            if(kind->type == REDIS_REPLY_STRING && kind->len == 7 && std::memcmp(kind->str, "message", 7) == 0 && reply->element[2]->type == REDIS_REPLY_STRING) {
+                on_switch_master(reply->element[2]->str, reply->element[2]->len);
+            }
+            return true;
+        }
+
+        /* Reads messages from subscribed context until error or stop. */
+        void listen(redisContext* context) {
+            struct pollfd pfd;
+            pfd.fd = context->fd;
+            pfd.events = POLLIN;
+            while(!stopping.load(std::memory_order_relaxed)) {
+                pfd.revents = 0;
+                int ret = poll(&pfd, 1, static_cast<int>(watch_poll_interval_ms));
+                if(ret < 0 && errno != EINTR) {
+                    set_error(std::string("poll failed on sentinel subscription: ") + std::strerror(errno));
+                    return;
+                }
+                if(ret <= 0) {
+                    continue;
+                }
+                if(redisBufferRead(context) != REDIS_OK) {
+                    set_error(std::string("Sentinel subscription lost: ") + context->errstr);
+                    return;
+                }
+                void* raw_reply = nullptr;
+                do {
+                    if(redisGetReplyFromReader(context, &raw_reply) != REDIS_OK) {
+                        set_error(std::string("Sentinel subscription protocol error: ") + context->errstr);
+                        return;
+                    }
+                    Reply reply(static_cast<redisReply*>(raw_reply));
+                    if(reply != nullptr && !handle_message(reply.get())) {
+                        set_error("Unexpected reply on sentinel subscription");
+                        return;
+                    }
+                } while(raw_reply != nullptr);
+            }
+        }
+
+        void watch_loop() {
+            size_t sentinel_index = 0;
+            while(!stopping.load(std::memory_order_relaxed)) {
+                ConnectionParam sentinel;
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+                    sentinel = sentinels[sentinel_index % sentinels.size()];
+                }
+                Context context = connect(sentinel);
+                if(context != nullptr) {
+                    Reply reply(static_cast<redisReply*>(redisCommand(context.get(), "SUBSCRIBE +switch-master")));
+                    if(reply != nullptr && handle_message(reply.get())) {
+                        //Switch could happen while we were not subscribed
+                        resolve();
+                        listen(context.get());
+                    }
+                    else {
+                        set_error("Could not subscribe to +switch-master on " + sentinel.host + ":" + std::to_string(sentinel.port));
+                    }
+                }
+                sentinel_index++;
+                if(sentinel_index % sentinels.size() == 0 && !stopping.load(std::memory_order_relaxed)) {
+                    //All sentinels failed in a row. Don't hammer them.
+                    std::this_thread::sleep_for(std::chrono::milliseconds(watch_poll_interval_ms));
+                }
+            }
+        }
+    };
+
+    Sentinel::Sentinel(const std::string& master_name, const std::vector<ConnectionParam>& sentinels, const ConnectionParam& master_param) :
+        d(new Sentinel::Impl(master_name, sentinels, master_param))
+    {}
+
+    Sentinel::~Sentinel() {
+        if(d != nullptr) {
+            stop();
+            delete d;
+        }
+    }
+
+    bool Sentinel::resolve() {
+        return d->resolve();
+    }
+
+    ConnectionParam Sentinel::get_master_param() {
+        bool resolved;
+        {
+            std::lock_guard<std::mutex> guard(d->lock);
+            resolved = d->resolved;
+        }
+        if(!resolved && !d->resolve()) {
+            throw Redis::Exception("Could not resolve master " + d->master_name + ": " + get_error());
+        }
+        std::lock_guard<std::mutex> guard(d->lock);
+        return d->master_param;
+    }
+
+    PoolWrapper Sentinel::get() {
+        bool has_retired;
+        {
+            std::lock_guard<std::mutex> guard(d->lock);
+            has_retired = !d->retired_params.empty();
+        }
+        if(has_retired) {
+            d->drain_retired();
+        }
+        return Pool::instance().get(get_master_param());
+    }
+
+    void Sentinel::watch() {
+        if(d->watcher.joinable()) {
+            return;
+        }
+        d->stopping = false;
+        d->watcher = std::thread(&Sentinel::Impl::watch_loop, d);
+    }
+
+    void Sentinel::stop() {
+        d->stopping = true;
+        if(d->watcher.joinable()) {
+            d->watcher.join();
+        }
+    }
+
+    unsigned long long Sentinel::get_failover_count() {
+        return d->failover_count.load();
+    }
+
+    std::string Sentinel::get_error() {
+        std::lock_guard<std::mutex> guard(d->lock);
+        return d->err;
+    }
+}
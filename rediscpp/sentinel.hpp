@@ -0,0 +1,59 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "connection_param.hpp"
+#include "pool_wrapper.hpp"
+namespace Redis {
+    /**
+    * Endpoint which follows the current master of a group monitored by redis sentinels.
+    * Master address is resolved with SENTINEL get-master-addr-by-name, and after watch() is called
+    * it is kept up to date by subscription to +switch-master on one of the sentinels.
+    * On failover connections to the old master are drained from Pool::instance(), so the next get() leases a connection to the new master.
+    * Thread safe.
+    *
+    *  F.e. :
+    *  Redis::Sentinel sentinel("mymaster", {Redis::ConnectionParam("10.0.0.1", 26379), Redis::ConnectionParam("10.0.0.2", 26379)});
+    *  sentinel.watch();
+    *  sentinel.get()->set("key", "value");
+    * */
+    class Sentinel {
+    public:
+        //How often watching thread checks if it should stop. Doesn't affect failover latency, as switch messages are pushed by sentinel.
+        static constexpr unsigned int watch_poll_interval_ms = 100;
+
+        /*
+        * sentinels - addresses of sentinels. Timeouts and passwords from them are used for sentinel connections.
+        * master_param - everything except host and port is used for connections to master.
+        */
+        Sentinel(const std::string& master_name,
+                const std::vector<ConnectionParam>& sentinels,
+                const ConnectionParam& master_param = ConnectionParam::get_default_connection_param());
+        ~Sentinel();
+        Sentinel(const Sentinel& other) = delete;
+        Sentinel& operator=(const Sentinel& other) = delete;
+
+        /* Asks sentinels for the current master address. Returns false if none of sentinels knows it */
+        bool resolve();
+
+        /* Connection params of the current master. Resolves master on the first call */
+        ConnectionParam get_master_param();
+
+        /* Lease connection to the current master from the pool */
+        PoolWrapper get();
+
+        /* Start background thread subscribed to +switch-master. Retargets pool without application involvement */
+        void watch();
+
+        /* Stop background thread. Called from destructor */
+        void stop();
+
+        /* Number of master switches observed since creation */
+        unsigned long long get_failover_count();
+
+        std::string get_error();
+
+    private:
+        class Impl;
+        Impl* d;
+    };
+}
@@ -0,0 +1,171 @@
+#include "single_flight.hpp"
+#include "pool.hpp"
+#include "exception.hpp"
+#include "log.hpp"
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <unordered_map>
+
+namespace Redis {
+    static thread_local std::string last_error;
+
+    class SingleFlight::Impl {
+        friend class SingleFlight;
+        static constexpr size_t bucket_count = 16;
+        typedef std::function<PoolWrapper()> Lease;
+        typedef std::function<bool(Connection&, std::string&)> Read;
+
+        struct FlightKey {
+            ConnectionParam connection_param;
+            std::string command;
+            std::string key;
+            std::string field;
+
+            bool operator==(const FlightKey& other) const {
+                return key == other.key && field == other.field && command == other.command && connection_param == other.connection_param;
+            }
+        };
+        struct FlightKeyHasher {
+            size_t operator()(const FlightKey& flight_key) const {
+                static std::hash<std::string> hash_fn;
+                return static_cast<size_t>(flight_key.connection_param.get_hash()) +
+                    hash_fn(flight_key.command) * 31 +
+                    hash_fn(flight_key.key) * 17 +
+                    hash_fn(flight_key.field);
+            }
+        };
+        struct Flight {
+            std::mutex lock;
+            std::condition_variable done_cv;
+            bool done;
+            bool ok;
+            std::string result;
+            std::string error;
+            Flight() : lock(), done_cv(), done(false), ok(false), result(), error() {}
+        };
+        typedef std::unordered_map<FlightKey, std::shared_ptr<Flight>, FlightKeyHasher> FlightMap;
+
+        std::array<std::mutex, bucket_count> locks;
+        std::array<FlightMap, bucket_count> flights;
+        std::atomic<unsigned long long> coalesced_count;
+
+        Impl() : locks(), flights(), coalesced_count(0) {}
+
+        void finish(size_t bucket, const FlightKey& flight_key, Flight& flight, bool ok, std::string&& result, std::string&& error) {
+            {
+                //Removed before publishing, so reads started from now on send a new request
+                std::lock_guard<std::mutex> guard(locks[bucket]);
+                flights[bucket].erase(flight_key);
+            }
+            std::lock_guard<std::mutex> guard(flight.lock);
+            flight.ok = ok;
+            flight.result = std::move(result);
+            flight.error = std::move(error);
+            flight.done = true;
+            flight.done_cv.notify_all();
+        }
+
+        bool run(FlightKey&& flight_key, const Lease& lease, const Read& read, std::string& result) {
+            size_t bucket = FlightKeyHasher()(flight_key) % bucket_count;
+            std::shared_ptr<Flight> flight;
+            bool leader = false;
+            {
+                std::lock_guard<std::mutex> guard(locks[bucket]);
+                std::shared_ptr<Flight>& slot = flights[bucket][flight_key];
+                if(slot == nullptr) {
+                    slot = std::make_shared<Flight>();
+                    leader = true;
+                }
+                flight = slot;
+            }
+            if(!leader) {
+                coalesced_count++;
+                std::unique_lock<std::mutex> guard(flight->lock);
+                flight->done_cv.wait(guard, [&flight]() { return flight->done; });
+                if(!flight->ok) {
+                    last_error = flight->error;
+                    if(flight_key.connection_param.throw_on_error) {
+                        throw Redis::Exception(flight->error);
+                    }
+                    return false;
+                }
+                result = flight->result;
+                return true;
+            }
+            std::string value;
+            bool ok = false;
+            try {
+                PoolWrapper conn = lease();
+                ok = read(*conn, value);
+                if(!ok) {
+                    last_error = conn->get_error();
+                }
+            }
+            catch(const std::exception& e) {
+                //Waiters must not hang if the leader throws
+                finish(bucket, flight_key, *flight, false, std::string(), e.what());
+                throw;
+            }
+            if(ok) {
+                result = value;
+            }
+            finish(bucket, flight_key, *flight, ok, std::move(value), ok ? std::string() : std::string(last_error));
+            return ok;
+        }
+    };
+    constexpr size_t SingleFlight::Impl::bucket_count;
+
+    SingleFlight& SingleFlight::instance() {
+        static SingleFlight inst;
+        return inst;
+    }
+
+    SingleFlight::SingleFlight() :
+        d(new SingleFlight::Impl())
+    {}
+
+    SingleFlight::~SingleFlight() {
+        if(d != nullptr) {
+            delete d;
+        }
+    }
+
+    bool SingleFlight::get(const ConnectionParam& connection_param, const std::string& key, std::string& result) {
+        return d->run({connection_param, "GET", key, std::string()},
+            [&connection_param]() { return Pool::instance().get(connection_param); },
+            [&key](Connection& conn, std::string& value) { return conn.get(key, value); },
+            result);
+    }
+
+    bool SingleFlight::hget(const ConnectionParam& connection_param, const std::string& key, const std::string& field, std::string& result) {
+        return d->run({connection_param, "HGET", key, field},
+            [&connection_param]() { return Pool::instance().get(connection_param); },
+            [&key, &field](Connection& conn, std::string& value) { return conn.hget(key, field, value); },
+            result);
+    }
+
+    bool SingleFlight::get(NamedPool& pool, const std::string& key, std::string& result) {
+        return d->run({pool.get_connection_param(key), "GET", key, std::string()},
+            [&pool, &key]() { return pool.get(key); },
+            [&key](Connection& conn, std::string& value) { return conn.get(key, value); },
+            result);
+    }
+
+    bool SingleFlight::hget(NamedPool& pool, const std::string& key, const std::string& field, std::string& result) {
+        return d->run({pool.get_connection_param(key), "HGET", key, field},
+            [&pool, &key]() { return pool.get(key); },
+            [&key, &field](Connection& conn, std::string& value) { return conn.hget(key, field, value); },
+            result);
+    }
+
+    unsigned long long SingleFlight::get_coalesced_count() {
+        return d->coalesced_count.load();
+    }
+
+    std::string SingleFlight::get_error() {
+        return last_error;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+#include <string>
+#include "connection.hpp"
+#include "named_pool.hpp"
+namespace Redis {
+    /**
+    * Coalesces identical concurrent reads: while a read of the same key from the same endpoint is in flight,
+    * other threads don't send their own request but wait for it and get its result.
+    * Only one pooled connection is leased per flight, so stampedes on a hot key don't grow the pool.
+    * Nothing is cached: a read started after the flight completed sends a new request.
+    * Thread safe.
+    *
+    *  F.e. :
+    *  std::string value;
+    *  Redis::SingleFlight::instance().get(Redis::ConnectionParam("10.0.0.1"), "hot_key", value);
+    * */
+    class SingleFlight {
+    public:
+        /* Shared by all users of the process. Separate instances don't coalesce reads with each other */
+        static SingleFlight& instance();
+
+        SingleFlight();
+        ~SingleFlight();
+        SingleFlight(const SingleFlight& other) = delete;
+        SingleFlight& operator=(const SingleFlight& other) = delete;
+
+        /* Get the value of a key through Pool::instance() */
+        bool get(const ConnectionParam& connection_param, const std::string& key, std::string& result);
+
+        /* Get the value of a hash field through Pool::instance() */
+        bool hget(const ConnectionParam& connection_param, const std::string& key, const std::string& field, std::string& result);
+
+        /* Get the value of a key from the shard of named pool */
+        bool get(NamedPool& pool, const std::string& key, std::string& result);
+
+        /* Get the value of a hash field from the shard of named pool */
+        bool hget(NamedPool& pool, const std::string& key, const std::string& field, std::string& result);
+
+        /* Number of reads which were served by other thread's request */
+        unsigned long long get_coalesced_count();
+
+        /* Error of the last failed read made by the calling thread */
+        static std::string get_error();
+
+    private:
+        class Impl;
+        Impl* d;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include "string_ref.hpp"
+namespace Redis {
+    /* Field/value pairs of an entry appended to a stream */
+    typedef std::vector<std::pair<std::string, std::string>> StreamFields;
+
+    /**
+    * Entry read from a stream. Id and fields point into the reply without copying,
+    * so they are valid only until the next command on the connection which read them.
+    * Entry deleted from the stream while pending in a group is delivered without fields.
+    * */
+    struct StreamEntry {
+        StringRef id;
+        std::vector<std::pair<StringRef, StringRef>> fields;
+
+        StreamEntry() : id(), fields() {}
+
+        /* Value of the first field with given name, empty if there is no such field */
+        StringRef get(const StringRef& field) const {
+            for(size_t i = 0; i < fields.size(); i++) {
+                if(fields[i].first == field) {
+                    return fields[i].second;
+                }
+            }
+            return StringRef();
+        }
+    };
+}
\ No newline at end of file
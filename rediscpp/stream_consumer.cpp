@@ -0,0 +1,299 @@
+#include "stream_consumer.hpp"
+#include "pool.hpp"
+#include "log.hpp"
+#include <hiredis/hiredis.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <memory>
+#include <chrono>
+
+namespace Redis {
+    class StreamConsumer::Impl {
+        friend class StreamConsumer;
+        typedef std::chrono::steady_clock Clock;
+        //Pause after failed read, so unavailable server is not hammered
+        static constexpr unsigned int retry_delay_ms = 100;
+
+        /* Entry with the reply it points into */
+        struct WorkItem {
+            std::shared_ptr<const redisReply> reply;
+            StreamEntry entry;
+        };
+
+        std::string stream;
+        std::string group;
+        std::string consumer;
+        Handler handler;
+        ConnectionParam param;
+        Options options;
+        std::mutex lock;
+        //Workers wait for entries, reader waits for room in the queue
+        std::condition_variable has_work;
+        std::condition_variable has_room;
+        std::deque<WorkItem> queue;
+        bool stopping;
+        bool reading_done;
+        std::atomic<bool> running;
+        std::thread reader;
+        std::vector<std::thread> workers;
+        std::atomic<unsigned long long> processed_count;
+        std::atomic<unsigned long long> acked_count;
+        std::atomic<unsigned long long> failed_count;
+        std::atomic<unsigned long long> claimed_count;
+        std::string err;
+
+        Impl(const std::string& _stream, const std::string& _group, const std::string& _consumer, const Handler& _handler,
+                const ConnectionParam& _param, const Options& _options) :
+            stream(_stream),
+            group(_group),
+            consumer(_consumer),
+            handler(_handler),
+            param(_param),
+            options(_options),
+            lock(),
+            has_work(),
+            has_room(),
+            queue(),
+            stopping(false),
+            reading_done(false),
+            running(false),
+            reader(),
+            workers(),
+            processed_count(0),
+            acked_count(0),
+            failed_count(0),
+            claimed_count(0),
+            err()
+        {
+            if(options.batch_size == 0) {
+                options.batch_size = 1;
+            }
+            if(options.worker_count == 0) {
+                options.worker_count = 1;
+            }
+            if(options.ack_batch_size == 0) {
+                options.ack_batch_size = 1;
+            }
+        }
+
+        void set_error(const std::string& error) {
+            rediscpp_debug(LL::WARNING, "StreamConsumer " << stream << "/" << group << "/" << consumer << ": " << error);
+            std::lock_guard<std::mutex> guard(lock);
+            err = error;
+        }
+
+        void enqueue(std::shared_ptr<const redisReply> reply, const std::vector<StreamEntry>& entries) {
+            if(entries.empty()) {
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                for(size_t i = 0; i < entries.size(); i++) {
+                    queue.push_back(WorkItem{reply, entries[i]});
+                }
+            }
+            has_work.notify_all();
+        }
+
+        /* Returns false if stopping */
+        bool pause(unsigned int delay_ms) {
+            std::unique_lock<std::mutex> guard(lock);
+            has_room.wait_for(guard, std::chrono::milliseconds(delay_ms), [this]() { return stopping; });
+            return !stopping;
+        }
+
+        void read_loop() {
+            Connection conn(param);
+            //Entries delivered to this consumer before restart are read first, from id 0 on
+            std::string read_id = "0";
+            Connection::Key claim_start = "0-0";
+            Clock::time_point next_claim = Clock::now() + std::chrono::milliseconds(options.claim_interval_ms);
+            std::vector<StreamEntry> entries;
+            while(true) {
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    has_room.wait(guard, [this]() { return stopping || queue.size() < options.batch_size; });
+                    if(stopping) {
+                        break;
+                    }
+                }
+                try {
+                    if(options.claim_idle_ms != 0 && Clock::now() >= next_claim) {
+                        next_claim = Clock::now() + std::chrono::milliseconds(options.claim_interval_ms);
+                        if(conn.xautoclaim(stream, group, consumer, options.claim_idle_ms, claim_start, options.batch_size, entries)) {
+                            claimed_count += entries.size();
+                            enqueue(conn.take_reply(), entries);
+                        }
+                        else {
+                            set_error("XAUTOCLAIM failed: " + conn.get_error());
+                        }
+                        continue;
+                    }
+                    const bool pending = read_id != ">";
+                    if(!conn.xreadgroup(group, consumer, stream, read_id, options.batch_size, pending ? -1 : options.block_ms, entries)) {
+                        set_error("XREADGROUP failed: " + conn.get_error());
+                        if(!pause(retry_delay_ms)) {
+                            break;
+                        }
+                        continue;
+                    }
+                    if(pending) {
+                        read_id = entries.empty() ? ">" : entries.back().id.str();
+                    }
+                    enqueue(conn.take_reply(), entries);
+                }
+                catch(const std::exception& e) {
+                    set_error(std::string("Read failed: ") + e.what());
+                    if(!pause(retry_delay_ms)) {
+                        break;
+                    }
+                }
+            }
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                reading_done = true;
+            }
+            has_work.notify_all();
+        }
+
+        void flush_acks(std::vector<std::string>& acks) {
+            try {
+                PoolWrapper conn = Pool::instance().get(param);
+                long long acknowledged = 0;
+                if(conn->xack(stream, group, acks, acknowledged)) {
+                    acked_count += static_cast<unsigned long long>(acknowledged);
+                }
+                else {
+                    set_error("XACK failed: " + conn->get_error());
+                }
+            }
+            catch(const std::exception& e) {
+                set_error(std::string("XACK failed: ") + e.what());
+            }
+            //Entries which were not acknowledged stay pending and are claimed again
+            acks.clear();
+        }
+
+        void work_loop() {
+            std::vector<std::string> acks;
+            acks.reserve(options.ack_batch_size);
+            while(true) {
+                std::unique_lock<std::mutex> guard(lock);
+                //Acknowledge what is handled before waiting, so acks are not delayed by a quiet stream
+                if(queue.empty() && !acks.empty()) {
+                    guard.unlock();
+                    flush_acks(acks);
+                    continue;
+                }
+                has_work.wait(guard, [this]() { return !queue.empty() || reading_done; });
+                if(queue.empty()) {
+                    break;
+                }
+                WorkItem item = std::move(queue.front());
+                queue.pop_front();
+                guard.unlock();
+                has_room.notify_one();
+                bool handled = false;
+                try {
+                    handled = handler(item.entry);
+                }
+                catch(const std::exception& e) {
+                    set_error("Handler of " + item.entry.id.str() + " threw: " + e.what());
+                }
+                processed_count++;
+                if(!handled) {
+                    failed_count++;
+                    continue;
+                }
+                acks.push_back(item.entry.id.str());
+                if(acks.size() >= options.ack_batch_size) {
+                    flush_acks(acks);
+                }
+            }
+        }
+    };
+    constexpr unsigned int StreamConsumer::Impl::retry_delay_ms;
+
+    StreamConsumer::StreamConsumer(const std::string& stream, const std::string& group, const std::string& consumer, const Handler& handler,
+            const ConnectionParam& param, const Options& options) :
+        d(new StreamConsumer::Impl(stream, group, consumer, handler, param, options))
+    {}
+
+    StreamConsumer::~StreamConsumer() {
+        if(d != nullptr) {
+            stop();
+            delete d;
+        }
+    }
+
+    bool StreamConsumer::start() {
+        if(d->running) {
+            return true;
+        }
+        if(d->options.create_group) {
+            PoolWrapper conn = Pool::instance().get(d->param);
+            bool created = false;
+            if(!conn->xgroup_create(d->stream, d->group, d->options.start_id, created)) {
+                d->set_error("Could not create group: " + conn->get_error());
+                return false;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> guard(d->lock);
+            d->stopping = false;
+            d->reading_done = false;
+        }
+        d->running = true;
+        d->reader = std::thread(&Impl::read_loop, d);
+        for(size_t i = 0; i < d->options.worker_count; i++) {
+            d->workers.push_back(std::thread(&Impl::work_loop, d));
+        }
+        return true;
+    }
+
+    void StreamConsumer::stop() {
+        if(!d->running) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> guard(d->lock);
+            d->stopping = true;
+        }
+        d->has_room.notify_all();
+        //Reader finishes current read, then workers drain the queue
+        d->reader.join();
+        for(size_t i = 0; i < d->workers.size(); i++) {
+            d->workers[i].join();
+        }
+        d->workers.clear();
+        d->running = false;
+    }
+
+    bool StreamConsumer::is_running() {
+        return d->running;
+    }
+
+    unsigned long long StreamConsumer::get_processed_count() {
+        return d->processed_count.load();
+    }
+
+    unsigned long long StreamConsumer::get_acked_count() {
+        return d->acked_count.load();
+    }
+
+    unsigned long long StreamConsumer::get_failed_count() {
+        return d->failed_count.load();
+    }
+
+    unsigned long long StreamConsumer::get_claimed_count() {
+        return d->claimed_count.load();
+    }
+
+    std::string StreamConsumer::get_error() {
+        std::lock_guard<std::mutex> guard(d->lock);
+        return d->err;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+#include <string>
+#include <functional>
+#include "connection.hpp"
+namespace Redis {
+    /**
+    * Member of a stream consumer group which processes entries on a pool of worker threads.
+    * Reader thread owns a dedicated connection: it first re-reads entries left pending for this consumer by a previous run,
+    * then reads new entries with XREADGROUP BLOCK in batches of batch_size. Entries point into the reply they came with, which is
+    * shared by the batch, so nothing is copied on the way to handlers. Reader doesn't fetch more while batch_size entries wait in the queue.
+    *
+    * Handler returns true when entry is processed, such entries are acknowledged with one XACK per ack_batch_size entries
+    * on a connection leased from Pool::instance(). Entries whose handler returned false or threw stay pending and are
+    * retried when XAUTOCLAIM finds them idle for claim_idle_ms. The same claim takes over entries of dead consumers of the group.
+    * Delivery is at least once: entry can be handled again if it was not acknowledged in time, so handlers should be idempotent.
+    * XAUTOCLAIM needs redis 6.2, set claim_idle_ms to 0 on older servers.
+    *
+    *  F.e. :
+    *  Redis::StreamConsumer consumer("events", "indexer", "indexer-1", [](const Redis::StreamEntry& entry) {
+    *      return index(entry.get("doc"));
+    *  });
+    *  consumer.start();
+    * */
+    class StreamConsumer {
+    public:
+        /* Returns true if entry should be acknowledged */
+        typedef std::function<bool(const StreamEntry&)> Handler;
+
+        struct Options {
+            //Entries read at once, and max entries waiting for workers
+            size_t batch_size;
+            //How long a read waits for new entries. Stop waits up to it as well
+            long long block_ms;
+            size_t worker_count;
+            size_t ack_batch_size;
+            //Entries pending longer than that are claimed and retried, 0 disables claiming
+            long long claim_idle_ms;
+            unsigned int claim_interval_ms;
+            //Create group and stream on start if they don't exist
+            bool create_group;
+            //Id the created group starts after, "$" - only new entries, "0" - whole stream
+            std::string start_id;
+            Options() : batch_size(100), block_ms(1000), worker_count(4), ack_batch_size(100), claim_idle_ms(60000), claim_interval_ms(10000),
+                create_group(true), start_id("$") {}
+        };
+
+        StreamConsumer(const std::string& stream, const std::string& group, const std::string& consumer, const Handler& handler,
+                const ConnectionParam& param = ConnectionParam(), const Options& options = Options());
+
+        /* Stops processing */
+        ~StreamConsumer();
+        StreamConsumer(const StreamConsumer& other) = delete;
+        StreamConsumer& operator=(const StreamConsumer& other) = delete;
+
+        /* Creates group if needed and starts threads. Returns false if group could not be created */
+        bool start();
+
+        /* Waits for entries already read to be handled and acknowledged */
+        void stop();
+
+        bool is_running();
+
+        /* Entries passed to handler */
+        unsigned long long get_processed_count();
+        unsigned long long get_acked_count();
+        /* Entries whose handler returned false or threw */
+        unsigned long long get_failed_count();
+        /* Entries taken over by XAUTOCLAIM */
+        unsigned long long get_claimed_count();
+
+        /* Last error of reading, acknowledging or handler exception */
+        std::string get_error();
+
+    private:
+        class Impl;
+        Impl* d;
+    };
+}
\ No newline at end of file
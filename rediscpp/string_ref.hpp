@@ -0,0 +1,58 @@
+#pragma once
+#include <string>
+#include <cstring>
+#include <ostream>
+namespace Redis {
+
+    /* Non owning view of a part of a string or reply buffer.
+    *  It's valid only while the buffer it was created from is alive and unchanged.
+    *  For replies it means until the next command on the same connection.
+    * */
+    class StringRef {
+        const char* ptr;
+        size_t len;
+    public:
+        StringRef() : ptr(""), len(0) {}
+        StringRef(const char* _ptr, size_t _len) : ptr(_ptr), len(_len) {}
+        StringRef(const char* _ptr) : ptr(_ptr), len(std::strlen(_ptr)) {}
+        StringRef(const std::string& str) : ptr(str.data()), len(str.size()) {}
+
+        const char* data() const { return ptr; }
+        size_t size() const { return len; }
+        bool empty() const { return len == 0; }
+        char operator[](size_t index) const { return ptr[index]; }
+        const char* begin() const { return ptr; }
+        const char* end() const { return ptr + len; }
+
+        std::string str() const { return std::string(ptr, len); }
+        explicit operator std::string() const { return str(); }
+
+        StringRef substr(size_t pos, size_t count = std::string::npos) const {
+            if(pos > len) {
+                pos = len;
+            }
+            return StringRef(ptr + pos, count > len - pos ? len - pos : count);
+        }
+
+        bool starts_with(const StringRef& other) const {
+            return len >= other.len && std::memcmp(ptr, other.ptr, other.len) == 0;
+        }
+
+        bool operator==(const StringRef& other) const {
+            return len == other.len && std::memcmp(ptr, other.ptr, len) == 0;
+        }
+
+        bool operator!=(const StringRef& other) const {
+            return !operator==(other);
+        }
+
+        bool operator<(const StringRef& other) const {
+            int res = std::memcmp(ptr, other.ptr, len < other.len ? len : other.len);
+            return res < 0 || (res == 0 && len < other.len);
+        }
+    };
+
+    inline std::ostream& operator<<(std::ostream& os, const StringRef& ref) {
+        return os.write(ref.data(), static_cast<std::streamsize>(ref.size()));
+    }
+}
@@ -0,0 +1,460 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "redis.hpp"
+#include "mock_server.hpp"
+#include "fault_proxy.hpp"
+/*
+* Throughput benchmark against a running redis.
+* Usage: benchmark [host port [scenario]]
+*
+* Scenarios:
+*   socket - batched MSET/MGET and large SET/GET with default and tuned socket options
+*   codec  - CPU cost and compression ratio of available compressors, SET/GET of blobs with and without codec
+*   stampede - many threads reading one hot key through the pool, with and without SingleFlight
+*   autobatch - many threads reading different keys one by one through the pool and through AutoBatcher
+*   multiplexed - many threads doing SET/GET through the pool and through one MultiplexedConnection
+*   mock - SET/GET and batched MGET against in-process MockServer, without and with injected latency.
+*          Host and port are ignored, so client overhead is measured without cost of real server
+*   faults - threads doing SET+GET through the pool and FaultProxy, which injects latency, throttling, stall, resets
+*            and truncated replies for a while. Reports errors, their latency and time until errors stop after the fault
+*/
+
+typedef std::function<bool(Redis::Connection&, size_t)> BenchFn;
+
+static void report(const std::string& name, size_t ops, size_t bytes, double elapsed) {
+    std::cout << std::left << std::setw(40) << name
+            << std::right << std::setw(12) << static_cast<long long>(static_cast<double>(ops) / elapsed) << " ops/s"
+            << std::setw(12) << std::fixed << std::setprecision(1) << (static_cast<double>(bytes) / elapsed / 1048576) << " MiB/s" << std::endl;
+}
+
+static bool run(const std::string& name, const Redis::ConnectionParam& param, size_t iterations, size_t ops_per_iteration, size_t bytes_per_iteration, const BenchFn& fn) {
+    Redis::Connection conn(param);
+    //warm up connection and server side allocations
+    if(!fn(conn, 0)) {
+        std::cerr << name << ": " << conn.get_error() << std::endl;
+        return false;
+    }
+    double start = Redis::microtime();
+    for(size_t i = 0; i < iterations; i++) {
+        if(!fn(conn, i)) {
+            std::cerr << name << ": " << conn.get_error() << std::endl;
+            return false;
+        }
+    }
+    report(name, iterations * ops_per_iteration, iterations * bytes_per_iteration, Redis::microtime() - start);
+    return true;
+}
+
+static bool bench_socket(const Redis::ConnectionParam& base) {
+    static constexpr size_t batch_size = 1000;
+    static constexpr size_t small_value_size = 64;
+    static constexpr size_t large_value_size = 1024 * 1024;
+
+    std::vector<std::pair<std::string, Redis::ConnectionParam>> profiles;
+    profiles.push_back(std::make_pair("default", base));
+    Redis::ConnectionParam tuned(base);
+    tuned.tcp_keepalive = true;
+    tuned.send_buffer_size = 4 * 1024 * 1024;
+    tuned.recv_buffer_size = 4 * 1024 * 1024;
+    profiles.push_back(std::make_pair("buffers 4MiB + keepalive", tuned));
+    Redis::ConnectionParam busy_poll(tuned);
+    busy_poll.busy_poll_us = 50;
+    profiles.push_back(std::make_pair("buffers 4MiB + busy poll 50us", busy_poll));
+
+    std::vector<std::string> keys, values, results;
+    for(size_t i = 0; i < batch_size; i++) {
+        keys.push_back("bench_socket_" + std::to_string(i));
+        values.push_back(std::string(small_value_size, 'x'));
+    }
+    std::string large_value(large_value_size, 'x');
+    std::string large_result;
+
+    for(size_t i = 0; i < profiles.size(); i++) {
+        Redis::Connection probe(profiles[i].second);
+        Redis::Connection::SocketInfo info;
+        if(probe.set("bench_socket_probe", "1") && probe.get_socket_info(info)) {
+            std::cout << profiles[i].first << ": nodelay=" << info.tcp_nodelay << " keepalive=" << info.tcp_keepalive
+                    << " sndbuf=" << info.send_buffer_size << " rcvbuf=" << info.recv_buffer_size << " busy_poll=" << info.busy_poll_us << std::endl;
+        }
+        bool ok =
+            run(profiles[i].first + ": MSET x1000", profiles[i].second, 200, batch_size, batch_size * small_value_size,
+                [&](Redis::Connection& c, size_t) { return c.set(keys, values); }) &&
+            run(profiles[i].first + ": MGET x1000", profiles[i].second, 200, batch_size, batch_size * small_value_size,
+                [&](Redis::Connection& c, size_t) { return c.get(keys, results); }) &&
+            run(profiles[i].first + ": SET 1MiB", profiles[i].second, 100, 1, large_value_size,
+                [&](Redis::Connection& c, size_t) { return c.set("bench_socket_large", large_value); }) &&
+            run(profiles[i].first + ": GET 1MiB", profiles[i].second, 100, 1, large_value_size,
+                [&](Redis::Connection& c, size_t) { return c.get("bench_socket_large", large_result); });
+        if(!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//JSON-like document of roughly given size, compressible about as well as real API payloads
+static std::string make_document(size_t size, size_t seed) {
+    std::string doc("[");
+    for(size_t i = 0; doc.size() < size; i++) {
+        size_t id = seed * 1000003 + i * 7919;
+        doc += "{\"id\":" + std::to_string(id) + ",\"name\":\"user_" + std::to_string(id % 100000) +
+               "\",\"active\":" + (id % 3 ? "true" : "false") + ",\"score\":" + std::to_string(id % 977) +
+               ",\"tags\":[\"tag" + std::to_string(id % 17) + "\",\"tag" + std::to_string(id % 23) + "\"]},";
+    }
+    doc.back() = ']';
+    return doc;
+}
+
+static bool bench_codec(const Redis::ConnectionParam& base) {
+    static const size_t sizes[] = {2 * 1024, 20 * 1024, 200 * 1024};
+    static constexpr size_t cpu_bytes = 64 * 1024 * 1024;
+
+    std::vector<std::pair<std::string, std::shared_ptr<Redis::Compressor>>> compressors;
+    compressors.push_back(std::make_pair("lz4", Redis::lz4_compressor()));
+    compressors.push_back(std::make_pair("zstd 1", Redis::zstd_compressor(1)));
+    compressors.push_back(std::make_pair("zstd 3", Redis::zstd_compressor(3)));
+    std::vector<std::string> samples;
+    for(size_t i = 0; i < 1000; i++) {
+        samples.push_back(make_document(sizes[0], i + 1000));
+    }
+    std::string dictionary;
+    if(Redis::zstd_train_dictionary(samples, 32 * 1024, dictionary)) {
+        compressors.push_back(std::make_pair("zstd 3 + dictionary", Redis::zstd_compressor(3, dictionary)));
+    }
+
+    //First available compressor is the fastest one
+    std::shared_ptr<const Redis::ValueCodec> fastest;
+    std::string fastest_name;
+    for(size_t i = 0; i < compressors.size(); i++) {
+        if(compressors[i].second == nullptr) {
+            std::cout << compressors[i].first << ": not built in" << std::endl;
+            continue;
+        }
+        std::shared_ptr<const Redis::ValueCodec> codec = std::make_shared<Redis::CompressionCodec>(compressors[i].second, 0);
+        if(fastest == nullptr) {
+            fastest = codec;
+            fastest_name = compressors[i].first;
+        }
+        for(size_t size : sizes) {
+            std::string value = make_document(size, 1), encoded, decoded;
+            size_t iterations = cpu_bytes / value.size();
+            double start = Redis::microtime();
+            for(size_t j = 0; j < iterations; j++) {
+                codec->encode(value.data(), value.size(), encoded);
+            }
+            double encode_time = Redis::microtime() - start;
+            start = Redis::microtime();
+            for(size_t j = 0; j < iterations; j++) {
+                codec->decode(encoded.data(), encoded.size(), decoded);
+            }
+            double decode_time = Redis::microtime() - start;
+            if(decoded != value) {
+                std::cerr << compressors[i].first << ": roundtrip failed" << std::endl;
+                return false;
+            }
+            double mib = static_cast<double>(iterations * value.size()) / 1048576;
+            std::cout << std::left << std::setw(24) << compressors[i].first << std::right << std::setw(8) << value.size() / 1024 << " KiB"
+                    << "  ratio " << std::fixed << std::setprecision(2) << std::setw(6) << static_cast<double>(value.size()) / static_cast<double>(encoded.size())
+                    << "  encode " << std::setprecision(1) << std::setw(8) << mib / encode_time << " MiB/s"
+                    << "  decode " << std::setw(8) << mib / decode_time << " MiB/s" << std::endl;
+        }
+    }
+
+    std::string value = make_document(sizes[1], 1), result;
+    bool ok = run("SET 20KiB json: no codec", base, 2000, 1, value.size(),
+            [&](Redis::Connection& c, size_t) { return c.set("bench_codec", value); }) &&
+        run("GET 20KiB json: no codec", base, 2000, 1, value.size(),
+            [&](Redis::Connection& c, size_t) { return c.get("bench_codec", result); });
+    if(ok && fastest != nullptr) {
+        Redis::ConnectionParam param(base);
+        param.codec = fastest;
+        ok = run("SET 20KiB json: " + fastest_name, param, 2000, 1, value.size(),
+                [&](Redis::Connection& c, size_t) { return c.set("bench_codec", value); }) &&
+            run("GET 20KiB json: " + fastest_name, param, 2000, 1, value.size(),
+                [&](Redis::Connection& c, size_t) { return c.get("bench_codec", result) && result == value; });
+    }
+    return ok;
+}
+
+static bool bench_stampede(const Redis::ConnectionParam& base) {
+    static constexpr size_t thread_count = 200;
+    static constexpr size_t reads_per_thread = 500;
+    std::string value = make_document(20 * 1024, 1);
+    {
+        Redis::PoolWrapper conn = Redis::Pool::instance().get(base);
+        if(!conn->set("bench_stampede", value)) {
+            std::cerr << "stampede: " << conn->get_error() << std::endl;
+            return false;
+        }
+    }
+    Redis::SingleFlight single_flight;
+    for(bool coalesce : {false, true}) {
+        std::atomic<size_t> failed(0);
+        std::vector<std::thread> threads;
+        double start = Redis::microtime();
+        for(size_t i = 0; i < thread_count; i++) {
+            threads.emplace_back([&]() {
+                std::string result;
+                for(size_t j = 0; j < reads_per_thread; j++) {
+                    bool ok = coalesce ? single_flight.get(base, "bench_stampede", result) : Redis::Pool::instance().get(base)->get("bench_stampede", result);
+                    if(!ok || result.size() != value.size()) {
+                        failed++;
+                    }
+                }
+            });
+        }
+        for(size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+        double elapsed = Redis::microtime() - start;
+        if(failed != 0) {
+            std::cerr << "stampede: " << failed << " reads failed" << std::endl;
+            return false;
+        }
+        size_t reads = thread_count * reads_per_thread;
+        size_t requests = coalesce ? reads - static_cast<size_t>(single_flight.get_coalesced_count()) : reads;
+        report(std::string("GET hot 20KiB x") + std::to_string(thread_count) + " threads: " + (coalesce ? "single flight" : "pool"), reads, reads * value.size(), elapsed);
+        std::cout << "    requests sent: " << requests << std::endl;
+    }
+    return true;
+}
+
+static bool bench_autobatch(const Redis::ConnectionParam& base) {
+    static constexpr size_t thread_count = 64;
+    static constexpr size_t reads_per_thread = 5000;
+    static constexpr size_t key_count = 1000;
+    std::vector<std::string> keys, values;
+    for(size_t i = 0; i < key_count; i++) {
+        keys.push_back("bench_autobatch_" + std::to_string(i));
+        values.push_back(std::string(64, 'x'));
+    }
+    {
+        Redis::PoolWrapper conn = Redis::Pool::instance().get(base);
+        if(!conn->set(keys, values)) {
+            std::cerr << "autobatch: " << conn->get_error() << std::endl;
+            return false;
+        }
+    }
+    Redis::AutoBatcher batcher(base);
+    for(bool batched : {false, true}) {
+        std::atomic<size_t> failed(0);
+        std::vector<std::thread> threads;
+        double start = Redis::microtime();
+        for(size_t i = 0; i < thread_count; i++) {
+            threads.emplace_back([&, i]() {
+                std::string result;
+                for(size_t j = 0; j < reads_per_thread; j++) {
+                    const std::string& key = keys[(i * reads_per_thread + j) % key_count];
+                    bool ok = batched ? batcher.get(key, result) : Redis::Pool::instance().get(base)->get(key, result);
+                    if(!ok || result.size() != 64) {
+                        failed++;
+                    }
+                }
+            });
+        }
+        for(size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+        double elapsed = Redis::microtime() - start;
+        if(failed != 0) {
+            std::cerr << "autobatch: " << failed << " reads failed" << std::endl;
+            return false;
+        }
+        report(std::string("GET x") + std::to_string(thread_count) + " threads: " + (batched ? "auto batcher" : "pool"), thread_count * reads_per_thread, thread_count * reads_per_thread * 64, elapsed);
+    }
+    std::cout << "    average batch: " << static_cast<double>(batcher.get_request_count()) / static_cast<double>(batcher.get_batch_count()) << std::endl;
+    return true;
+}
+
+static bool bench_multiplexed(const Redis::ConnectionParam& base) {
+    static constexpr size_t thread_count = 200;
+    static constexpr size_t ops_per_thread = 2000;
+    std::string value(64, 'x');
+    Redis::MultiplexedConnection shared(base);
+    for(bool multiplexed : {false, true}) {
+        std::atomic<size_t> failed(0);
+        std::vector<std::thread> threads;
+        double start = Redis::microtime();
+        for(size_t i = 0; i < thread_count; i++) {
+            threads.emplace_back([&, i]() {
+                std::string key = "bench_multiplexed_" + std::to_string(i), result;
+                for(size_t j = 0; j < ops_per_thread; j += 2) {
+                    bool ok = multiplexed ?
+                        shared.set(key, value) && shared.get(key, result) :
+                        Redis::Pool::instance().get(base)->set(key, value) && Redis::Pool::instance().get(base)->get(key, result);
+                    if(!ok || result != value) {
+                        failed++;
+                    }
+                }
+            });
+        }
+        for(size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+        double elapsed = Redis::microtime() - start;
+        if(failed != 0) {
+            std::cerr << "multiplexed: " << failed << " operations failed" << std::endl;
+            return false;
+        }
+        report(std::string("SET+GET x") + std::to_string(thread_count) + " threads: " + (multiplexed ? "1 multiplexed socket" : "pool"), thread_count * ops_per_thread, thread_count * ops_per_thread * value.size(), elapsed);
+    }
+    return true;
+}
+
+static bool bench_mock() {
+    static constexpr size_t batch_size = 100;
+    static constexpr size_t value_size = 64;
+    Redis::MockServer server;
+    std::vector<std::string> keys, values, results;
+    for(size_t i = 0; i < batch_size; i++) {
+        keys.push_back("bench_mock_" + std::to_string(i));
+        values.push_back(std::string(value_size, 'x'));
+    }
+    std::string value(value_size, 'x'), result;
+    for(unsigned int latency_us : {0u, 100u}) {
+        Redis::MockServer::Faults faults;
+        faults.latency_us = latency_us;
+        server.set_faults(faults);
+        std::string suffix = latency_us == 0 ? "" : " +" + std::to_string(latency_us) + "us";
+        bool ok =
+            run("mock: SET+GET" + suffix, server.get_connection_param(), latency_us == 0 ? 20000 : 2000, 2, value_size * 2,
+                [&](Redis::Connection& c, size_t i) { return c.set(keys[i % batch_size], value) && c.get(keys[i % batch_size], result); }) &&
+            run("mock: MSET+MGET x100" + suffix, server.get_connection_param(), latency_us == 0 ? 2000 : 200, batch_size * 2, batch_size * value_size * 2,
+                [&](Redis::Connection& c, size_t) { return c.set(keys, values) && c.get(keys, results); });
+        if(!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct FaultSample {
+    double start;
+    double latency;
+    bool ok;
+};
+
+static double percentile(std::vector<double>& values, double p) {
+    if(values.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(p * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + static_cast<long>(index), values.end());
+    return values[index];
+}
+
+static bool bench_faults(const Redis::ConnectionParam& base) {
+    static constexpr size_t thread_count = 4;
+    static constexpr double before_s = 0.3;
+    static constexpr double fault_s = 0.7;
+    static constexpr double after_s = 1;
+    Redis::FaultProxy proxy(base.host, base.port);
+    std::vector<std::pair<std::string, Redis::FaultProxy::Faults>> faults(5);
+    faults[0].first = "latency 20ms";
+    faults[0].second.latency_us = 20000;
+    faults[1].first = "bandwidth 16KiB/s";
+    faults[1].second.bandwidth_bytes_per_s = 16 * 1024;
+    faults[2].first = "stall";
+    faults[2].second.stall = true;
+    faults[3].first = "reset";
+    faults[3].second.reset = true;
+    faults[4].first = "truncated reply";
+    faults[4].second.truncate_reply_bytes = 8;
+    std::string value(1024, 'x');
+    std::cout << std::left << std::setw(32) << "fault, op timeout 100ms" << std::right << std::setw(8) << "ops" << std::setw(8) << "errors"
+            << std::setw(12) << "err p50 ms" << std::setw(12) << "err p99 ms" << std::setw(12) << "err max ms" << std::setw(14) << "recovery ms" << std::endl;
+    for(size_t f = 0; f < faults.size(); f++) {
+        for(bool throw_on_error : {false, true}) {
+            Redis::ConnectionParam param = proxy.get_connection_param(base);
+            param.connect_timeout_ms = 100;
+            param.operation_timeout_ms = 100;
+            param.reconnect_on_failure = true;
+            param.throw_on_error = throw_on_error;
+            proxy.set_schedule({
+                Redis::FaultProxy::Phase(static_cast<unsigned int>(before_s * 1000)),
+                Redis::FaultProxy::Phase(static_cast<unsigned int>(fault_s * 1000), faults[f].second),
+                Redis::FaultProxy::Phase(static_cast<unsigned int>(after_s * 1000))
+            });
+            double start = Redis::microtime();
+            std::vector<std::vector<FaultSample>> samples(thread_count);
+            std::vector<std::thread> threads;
+            for(size_t i = 0; i < thread_count; i++) {
+                threads.emplace_back([&, i]() {
+                    std::string key = "bench_faults_" + std::to_string(i), result;
+                    while(Redis::microtime() - start < before_s + fault_s + after_s) {
+                        double op_start = Redis::microtime();
+                        bool ok = false;
+                        try {
+                            Redis::PoolWrapper conn = Redis::Pool::instance().get(param);
+                            ok = conn->set(key, value) && conn->get(key, result) && result == value;
+                        }
+                        catch(const Redis::Exception&) {
+                        }
+                        samples[i].push_back(FaultSample{op_start - start, Redis::microtime() - op_start, ok});
+                    }
+                });
+            }
+            for(size_t i = 0; i < threads.size(); i++) {
+                threads[i].join();
+            }
+            size_t ops = 0;
+            double recovered_at = before_s + fault_s;
+            std::vector<double> error_latencies;
+            for(size_t i = 0; i < samples.size(); i++) {
+                for(const FaultSample& sample : samples[i]) {
+                    ops++;
+                    if(!sample.ok) {
+                        error_latencies.push_back(sample.latency * 1000);
+                        recovered_at = std::max(recovered_at, sample.start + sample.latency);
+                    }
+                }
+            }
+            size_t errors = error_latencies.size();
+            double max_latency = errors == 0 ? 0 : *std::max_element(error_latencies.begin(), error_latencies.end());
+            std::cout << std::left << std::setw(32) << (faults[f].first + (throw_on_error ? ", throw" : ", no throw"))
+                    << std::right << std::setw(8) << ops << std::setw(8) << errors << std::fixed << std::setprecision(1)
+                    << std::setw(12) << percentile(error_latencies, 0.5) << std::setw(12) << percentile(error_latencies, 0.99)
+                    << std::setw(12) << max_latency << std::setw(14) << (recovered_at - before_s - fault_s) * 1000 << std::endl;
+        }
+    }
+    return true;
+}
+
+int main(int argc, const char** argv)
+{
+    Redis::ConnectionParam param;
+    if(argc >= 3) {
+        param.host = argv[1];
+        param.port = static_cast<unsigned int>(std::atoi(argv[2]));
+    }
+    std::string scenario = argc >= 4 ? argv[3] : "all";
+    bool ok = true;
+    if(scenario == "all" || scenario == "socket") {
+        ok = bench_socket(param) && ok;
+    }
+    if(scenario == "all" || scenario == "codec") {
+        ok = bench_codec(param) && ok;
+    }
+    if(scenario == "all" || scenario == "stampede") {
+        ok = bench_stampede(param) && ok;
+    }
+    if(scenario == "all" || scenario == "autobatch") {
+        ok = bench_autobatch(param) && ok;
+    }
+    if(scenario == "all" || scenario == "multiplexed") {
+        ok = bench_multiplexed(param) && ok;
+    }
+    if(scenario == "all" || scenario == "mock") {
+        ok = bench_mock() && ok;
+    }
+    if(scenario == "all" || scenario == "faults") {
+        ok = bench_faults(param) && ok;
+    }
+    return ok ? 0 : 1;
+}
@@ -1,6 +1,9 @@
 #include <algorithm>
 #include <thread>
 #include <chrono>
+#include <set>
+#include <map>
+#include <limits>
 #include "connection_test_abstract.hpp"
 #define RUN(command) if(!command) {CPPUNIT_FAIL(connection.get_error());}
 #define VERSION_REQUIRED(version) if(connection.get_version() < version) {CPPUNIT_FAIL(std::string("Redis version:")+std::to_string(connection.get_version())+" is not enough for performing test");}
@@ -433,6 +436,58 @@ void ConnectionTestAbstract::test_strlen() {
     CPPUNIT_ASSERT( str_len == 0 );
 }
 
+namespace {
+    struct TestPod {
+        int a;
+        double b;
+        char c[4];
+    };
+}
+
+namespace Redis {
+    template <> struct RawBytesCodec<TestPod> : std::true_type {};
+}
+
+void ConnectionTestAbstract::test_typed() {
+    long long ll_val = 0;
+    RUN( connection.set("test_typed_int", std::numeric_limits<long long>::min()) );
+    RUN( connection.get("test_typed_int", ll_val) );
+    CPPUNIT_ASSERT( ll_val == std::numeric_limits<long long>::min() );
+    // stored as decimal, so INCR works on typed values
+    RUN( connection.set("test_typed_int", 41) );
+    RUN( connection.incr("test_typed_int") );
+    unsigned short us_val = 0;
+    RUN( connection.get("test_typed_int", us_val) );
+    CPPUNIT_ASSERT( us_val == 42 );
+    RUN( connection.set("test_typed_int", "not a number") );
+    CPPUNIT_ASSERT( !connection.get("test_typed_int", us_val) );
+    CPPUNIT_ASSERT( connection.get_errno() == Redis::Connection::Error::CODEC_ERROR );
+
+    double d_val = 0;
+    RUN( connection.set("test_typed_double", 0.1) );
+    RUN( connection.get("test_typed_double", d_val) );
+    CPPUNIT_ASSERT( d_val == 0.1 );
+
+    TestPod pod = {7, 2.5, {'a', 'b', 'c', '\0'}}, pod_result = {0, 0, {0, 0, 0, 0}};
+    RUN( connection.hset("test_typed_hash", "pod", pod) );
+    RUN( connection.hget("test_typed_hash", "pod", pod_result) );
+    CPPUNIT_ASSERT( pod_result.a == 7 && pod_result.b == 2.5 && std::string(pod_result.c) == "abc" );
+
+    bool found = true;
+    RUN( connection.del("test_typed_missing") );
+    RUN( connection.get("test_typed_missing", d_val, found) );
+    CPPUNIT_ASSERT( !found && d_val == 0 );
+
+    std::vector<int> ints;
+    RUN( connection.set("test_typed_int", 5) );
+    RUN( connection.mget<int>(std::vector<std::string>{"test_typed_int", "test_typed_missing"}, ints) );
+    CPPUNIT_ASSERT( ints.size() == 2 && ints[0] == 5 && ints[1] == 0 );
+
+    RUN( connection.del("test_typed_int") );
+    RUN( connection.del("test_typed_double") );
+    RUN( connection.del("test_typed_hash") );
+}
+
 void ConnectionTestAbstract::test_expire() {
     // for redis 2.4, error between 0 and 1 second
     // for redis 2.6, error between 0 and 1 milisecond
@@ -466,6 +521,47 @@ void ConnectionTestAbstract::test_ttl() {
     CPPUNIT_ASSERT( sec_to_live == -2 );    // key should be vanished, return code = -2
 }
 
+void ConnectionTestAbstract::test_scan() {
+    static constexpr size_t key_count = 500;
+    std::set<std::string> expected;
+    for(size_t i = 0; i < key_count; i++) {
+        std::string key("test_scan_" + std::to_string(i));
+        RUN( connection.set(key, "1") );
+        expected.insert(key);
+    }
+    std::set<std::string> found;
+    Redis::KeyScanner scanner(connection, "test_scan_*", Redis::Scanner::min_count);
+    for(const Redis::StringRef& key : scanner) {
+        found.insert(key.str());
+    }
+    CPPUNIT_ASSERT( scanner.is_ok() );
+    CPPUNIT_ASSERT( found == expected );
+
+    // pattern without trailing star
+    unsigned long long cursor = 0;
+    size_t keys_found = 0;
+    do {
+        std::vector<std::string> keys;
+        RUN( connection.scan(cursor, keys, "test_scan_1?") );
+        for(size_t i = 0; i < keys.size(); i++) {
+            CPPUNIT_ASSERT( expected.count(keys[i]) == 1 );
+        }
+        keys_found += keys.size();
+    } while(cursor != 0);
+    CPPUNIT_ASSERT( keys_found == 10 );
+
+    // connection is usable after scanner is destroyed in the middle
+    {
+        Redis::KeyScanner partial(connection, "test_scan_*", Redis::Scanner::min_count);
+        Redis::StringRef key;
+        CPPUNIT_ASSERT( partial.next(key) );
+    }
+    CHECK_KEY( "test_scan_0", "1" );
+    for(size_t i = 0; i < key_count; i++) {
+        RUN( connection.del("test_scan_" + std::to_string(i)) );
+    }
+}
+
 void ConnectionTestAbstract::test_sadd() {
     std::string key("test_sadd");
     std::vector < std::string > result;
@@ -553,4 +649,84 @@ void ConnectionTestAbstract::test_smembers() {
 
 void ConnectionTestAbstract::test_zincrby() {
 
+}
+
+void ConnectionTestAbstract::test_collection_scan() {
+    static constexpr size_t member_count = 1000;
+    std::string hash_key("test_hscan"), set_key("test_sscan"), zset_key("test_zscan");
+    RUN( connection.del(hash_key) );
+    RUN( connection.del(set_key) );
+    RUN( connection.del(zset_key) );
+    std::map<std::string, std::string> expected_hash;
+    std::set<std::string> expected_set;
+    for(size_t i = 0; i < member_count; i++) {
+        std::string member("member_" + std::to_string(i));
+        RUN( connection.hset(hash_key, member, std::to_string(i)) );
+        RUN( connection.sadd(set_key, member) );
+        RUN( connection.zadd(zset_key, member, static_cast<double>(i)) );
+        expected_hash[member] = std::to_string(i);
+        expected_set.insert(member);
+    }
+
+    std::map<std::string, std::string> hash;
+    Redis::HashScanner hash_scanner(connection, hash_key, "*", Redis::Scanner::min_count);
+    CPPUNIT_ASSERT( hash_scanner.for_each([&](const Redis::StringRef& field, const Redis::StringRef& value) {
+        hash[field.str()] = value.str();
+        return true;
+    }) );
+    CPPUNIT_ASSERT( hash == expected_hash );
+
+    std::vector<std::string> page;
+    std::set<std::string> members;
+    Redis::SetScanner set_scanner(connection, set_key, "*", Redis::Scanner::min_count);
+    while(set_scanner.next_batch(page)) {
+        CPPUNIT_ASSERT( page.size() <= static_cast<size_t>(Redis::Scanner::max_count) );
+        members.insert(page.begin(), page.end());
+    }
+    CPPUNIT_ASSERT( set_scanner.is_ok() );
+    CPPUNIT_ASSERT( members == expected_set );
+
+    // member_1, member_10..19, member_100..199
+    double score_sum = 0;
+    size_t zset_size = 0;
+    Redis::SortedSetScanner zset_scanner(connection, zset_key, "member_1*");
+    Redis::StringRef member;
+    double score;
+    while(zset_scanner.next(member, score)) {
+        CPPUNIT_ASSERT( member.starts_with("member_1") );
+        score_sum += score;
+        zset_size++;
+    }
+    CPPUNIT_ASSERT( zset_scanner.is_ok() );
+    CPPUNIT_ASSERT( zset_size == 111 );
+    CPPUNIT_ASSERT( score_sum == 1 + 145 + 14950 );
+
+    unsigned long long cursor = 0;
+    size_t fields_found = 0;
+    do {
+        std::vector<std::pair<std::string, std::string>> fields;
+        RUN( connection.hscan(hash_key, cursor, fields, "member_99?") );
+        fields_found += fields.size();
+    } while(cursor != 0);
+    CPPUNIT_ASSERT( fields_found == 10 );
+
+    RUN( connection.del(hash_key) );
+    RUN( connection.del(set_key) );
+    RUN( connection.del(zset_key) );
+}
+
+void ConnectionTestAbstract::test_capabilities() {
+    std::shared_ptr<const Redis::Capabilities> capabilities = connection.get_capabilities();
+    CPPUNIT_ASSERT( capabilities != nullptr );
+    CPPUNIT_ASSERT( capabilities->version == connection.get_version() );
+    CPPUNIT_ASSERT( capabilities->resp3 == (connection.get_version() >= 60000) );
+    // other connections to the same endpoint don't ask server again
+    Redis::Connection other = get_connection();
+    CPPUNIT_ASSERT( other.get_capabilities() == capabilities );
+    VERSION_REQUIRED(20813);
+    bool supported = false;
+    RUN( connection.has_command("GET", supported) );
+    CPPUNIT_ASSERT( supported );
+    RUN( connection.has_command("no_such_command", supported) );
+    CPPUNIT_ASSERT( !supported );
 }
\ No newline at end of file
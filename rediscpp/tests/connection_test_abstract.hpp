@@ -26,9 +26,11 @@ class ConnectionTestAbstract : public CPPUNIT_NS::TestFixture
         CPPUNIT_TEST( test_set_bit );
         CPPUNIT_TEST( test_setrange );
         CPPUNIT_TEST( test_strlen );
+        CPPUNIT_TEST( test_typed );
 
         CPPUNIT_TEST( test_expire );
         CPPUNIT_TEST( test_ttl );
+        CPPUNIT_TEST( test_scan );
 
         CPPUNIT_TEST( test_sadd );
         CPPUNIT_TEST( test_scard );
@@ -37,6 +39,10 @@ class ConnectionTestAbstract : public CPPUNIT_NS::TestFixture
 
         CPPUNIT_TEST( test_zincrby );
 
+        CPPUNIT_TEST( test_collection_scan );
+
+        CPPUNIT_TEST( test_capabilities );
+
 
     CPPUNIT_TEST_SUITE_END_ABSTRACT();
 public:
@@ -61,9 +67,11 @@ protected:
     void test_set_bit();
     void test_setrange();
     void test_strlen();
+    void test_typed();
 
     void test_expire();
     void test_ttl();
+    void test_scan();
 
     void test_sadd();
     void test_scard();
@@ -71,8 +79,11 @@ protected:
     void test_smembers();
     void test_zincrby();
 
+    void test_collection_scan();
+
+    void test_capabilities();
+
 
 
-private:
     Redis::Connection connection;
 };
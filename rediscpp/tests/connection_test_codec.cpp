@@ -0,0 +1,94 @@
+#include "connection_test_codec.hpp"
+CPPUNIT_TEST_SUITE_REGISTRATION( ConnectionTestCodec );
+
+//Run length encoding. Doesn't depend on optional compression libraries
+class RleCompressor : public Redis::Compressor {
+public:
+    unsigned char get_id() const override {
+        return 100;
+    }
+
+    bool compress(const char* data, size_t size, std::string& out) const override {
+        for(size_t i = 0; i < size;) {
+            size_t run = 1;
+            while(i + run < size && run < 255 && data[i + run] == data[i]) {
+                run++;
+            }
+            out.push_back(static_cast<char>(run));
+            out.push_back(data[i]);
+            i += run;
+        }
+        return true;
+    }
+
+    bool decompress(const char* data, size_t size, size_t, std::string& out) const override {
+        if(size % 2 != 0) {
+            return false;
+        }
+        for(size_t i = 0; i < size; i += 2) {
+            out.append(static_cast<unsigned char>(data[i]), data[i + 1]);
+        }
+        return true;
+    }
+};
+
+static Redis::ConnectionParam get_codec_param() {
+    Redis::ConnectionParam param;
+    param.codec = std::make_shared<Redis::CompressionCodec>(std::make_shared<RleCompressor>(), 16);
+    return param;
+}
+
+Redis::Connection ConnectionTestCodec::get_connection() {
+    return Redis::Connection(get_codec_param());
+}
+
+void ConnectionTestCodec::test_compressed_representation() {
+    Redis::Connection codec_connection(get_codec_param());
+    Redis::Connection raw_connection;
+    std::string value(10000, 'a'), result, raw;
+    CPPUNIT_ASSERT( codec_connection.set("test_codec", value) );
+    CPPUNIT_ASSERT( raw_connection.get("test_codec", raw) );
+    CPPUNIT_ASSERT( raw.size() < 100 );
+    CPPUNIT_ASSERT( Redis::CompressionCodec::has_header(raw.data(), raw.size()) );
+    CPPUNIT_ASSERT( codec_connection.get("test_codec", result) );
+    CPPUNIT_ASSERT( result == value );
+    // GETSET stores encoded value and returns decoded old one
+    CPPUNIT_ASSERT( codec_connection.getset("test_codec", std::string(10000, 'b'), result) );
+    CPPUNIT_ASSERT( result == value );
+    CPPUNIT_ASSERT( raw_connection.get("test_codec", raw) && raw.size() < 100 );
+    CPPUNIT_ASSERT( codec_connection.get("test_codec", result) && result == std::string(10000, 'b') );
+
+    // incompressible and short values are stored as is, and values stored without codec are readable
+    std::string short_value("abc");
+    CPPUNIT_ASSERT( codec_connection.hset("test_codec_hash", "field", short_value) );
+    CPPUNIT_ASSERT( raw_connection.hget("test_codec_hash", "field", raw) );
+    CPPUNIT_ASSERT( raw == short_value );
+    CPPUNIT_ASSERT( raw_connection.hset("test_codec_hash", "field", "plain value written without codec") );
+    CPPUNIT_ASSERT( codec_connection.hget("test_codec_hash", "field", result) );
+    CPPUNIT_ASSERT( result == "plain value written without codec" );
+    CPPUNIT_ASSERT( codec_connection.del("test_codec") );
+    CPPUNIT_ASSERT( codec_connection.del("test_codec_hash") );
+}
+
+void ConnectionTestCodec::test_magic_collision() {
+    Redis::Connection codec_connection(get_codec_param());
+    std::string value("\xC0RZ\x64 looks like header"), result;
+    CPPUNIT_ASSERT( codec_connection.set("test_codec_magic", value) );
+    CPPUNIT_ASSERT( codec_connection.get("test_codec_magic", result) );
+    CPPUNIT_ASSERT( result == value );
+    CPPUNIT_ASSERT( codec_connection.del("test_codec_magic") );
+}
+
+void ConnectionTestCodec::test_unknown_compressor() {
+    Redis::Connection codec_connection(get_codec_param());
+    Redis::Connection raw_connection;
+    std::string result;
+    CPPUNIT_ASSERT( raw_connection.set("test_codec_unknown", std::string("\xC0RZ\x07\x03\0\0\0abc", 11)) );
+    CPPUNIT_ASSERT( !codec_connection.get("test_codec_unknown", result) );
+    CPPUNIT_ASSERT( codec_connection.get_errno() == Redis::Connection::Error::CODEC_ERROR );
+    // header of known compressor claiming 4 GiB is rejected without allocating
+    CPPUNIT_ASSERT( raw_connection.set("test_codec_unknown", std::string("\xC0RZ\x64\xF0\xFF\xFF\xFF\x02" "a", 10)) );
+    CPPUNIT_ASSERT( !codec_connection.get("test_codec_unknown", result) );
+    CPPUNIT_ASSERT( codec_connection.get_errno() == Redis::Connection::Error::CODEC_ERROR );
+    CPPUNIT_ASSERT( raw_connection.del("test_codec_unknown") );
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "connection_test_abstract.hpp"
+/*
+* Runs all connection tests through CompressionCodec and checks stored representation
+*/
+class ConnectionTestCodec : public ConnectionTestAbstract {
+    CPPUNIT_TEST_SUB_SUITE(ConnectionTestCodec, ConnectionTestAbstract);
+        CPPUNIT_TEST( test_compressed_representation );
+        CPPUNIT_TEST( test_magic_collision );
+        CPPUNIT_TEST( test_unknown_compressor );
+    CPPUNIT_TEST_SUITE_END();
+    protected:
+        virtual Redis::Connection get_connection();
+        void test_compressed_representation();
+        void test_magic_collision();
+        void test_unknown_compressor();
+};
@@ -0,0 +1,192 @@
+#include <chrono>
+#include <thread>
+#include "connection_test_mock.hpp"
+#include "mock_server.hpp"
+#include "fault_proxy.hpp"
+CPPUNIT_TEST_SUITE_REGISTRATION( ConnectionTestMock );
+
+static Redis::MockServer& get_server() {
+    static Redis::MockServer server;
+    return server;
+}
+
+Redis::Connection ConnectionTestMock::get_connection() {
+    return Redis::Connection(get_server().get_connection_param());
+}
+
+void ConnectionTestMock::tearDown() {
+    get_server().clear_faults();
+}
+
+void ConnectionTestMock::test_injected_latency() {
+    Redis::ConnectionParam param = get_server().get_connection_param();
+    param.operation_timeout_ms = 100;
+    Redis::Connection conn(param);
+    std::string value;
+    CPPUNIT_ASSERT( conn.set("test_mock_latency", "value") );
+    Redis::MockServer::Faults slow;
+    slow.latency_us = 300000;
+    get_server().set_command_faults("GET", slow);
+    auto start = std::chrono::steady_clock::now();
+    CPPUNIT_ASSERT( !conn.get("test_mock_latency", value) );
+    // one timeout and one retry after reconnect, not waiting for the slow reply
+    CPPUNIT_ASSERT( std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500) );
+    // other commands are not delayed
+    CPPUNIT_ASSERT( conn.set("test_mock_latency", "other") );
+    get_server().clear_faults();
+    CPPUNIT_ASSERT( conn.get("test_mock_latency", value) );
+    CPPUNIT_ASSERT( value == "other" );
+    CPPUNIT_ASSERT( conn.del("test_mock_latency") );
+}
+
+void ConnectionTestMock::test_injected_error() {
+    Redis::Connection conn = get_connection();
+    Redis::MockServer::Faults failing;
+    failing.error_rate = 1;
+    failing.error = "ERR mock failure";
+    get_server().set_command_faults("incr", failing);
+    CPPUNIT_ASSERT( !conn.incr("test_mock_error") );
+    CPPUNIT_ASSERT( conn.get_errno() == Redis::Connection::Error::REPLY_ERR );
+    CPPUNIT_ASSERT( conn.get_error().find("mock failure") != std::string::npos );
+    // error reply doesn't break connection
+    CPPUNIT_ASSERT( conn.set("test_mock_error", "1") );
+    get_server().clear_faults();
+    long long result = 0;
+    CPPUNIT_ASSERT( conn.incr("test_mock_error", result) );
+    CPPUNIT_ASSERT( result == 2 );
+    CPPUNIT_ASSERT( conn.del("test_mock_error") );
+}
+
+void ConnectionTestMock::test_disconnect() {
+    Redis::Connection conn = get_connection();
+    std::string value;
+    CPPUNIT_ASSERT( conn.set("test_mock_disconnect", "value") );
+    unsigned long long accepted = get_server().get_accepted_count();
+    // data survives, connection is restored on the next command
+    get_server().disconnect_all();
+    CPPUNIT_ASSERT( conn.get("test_mock_disconnect", value) );
+    CPPUNIT_ASSERT( value == "value" );
+    CPPUNIT_ASSERT( get_server().get_accepted_count() > accepted );
+
+    Redis::MockServer::Faults dropping;
+    dropping.disconnect_rate = 1;
+    get_server().set_command_faults("GET", dropping);
+    CPPUNIT_ASSERT( !conn.get("test_mock_disconnect", value) );
+    get_server().clear_faults();
+    CPPUNIT_ASSERT( conn.get("test_mock_disconnect", value) );
+    CPPUNIT_ASSERT( conn.del("test_mock_disconnect") );
+}
+
+void ConnectionTestMock::test_proxy_faults() {
+    Redis::FaultProxy proxy("127.0.0.1", get_server().get_port());
+    Redis::ConnectionParam param = proxy.get_connection_param(get_server().get_connection_param());
+    param.operation_timeout_ms = 100;
+    Redis::Connection conn(param);
+    std::string value;
+    CPPUNIT_ASSERT( conn.set("test_mock_proxy", "value") );
+
+    // silent peer is detected by timeout, connection recovers once bytes flow again
+    Redis::FaultProxy::Faults stall;
+    stall.stall = true;
+    proxy.set_faults(stall);
+    CPPUNIT_ASSERT( !conn.get("test_mock_proxy", value) );
+    proxy.set_faults(Redis::FaultProxy::Faults());
+    CPPUNIT_ASSERT( conn.get("test_mock_proxy", value) );
+    CPPUNIT_ASSERT( value == "value" );
+
+    // reply cut in the middle is an error, not a partial value
+    Redis::FaultProxy::Faults truncated;
+    truncated.truncate_reply_bytes = 4;
+    proxy.set_faults(truncated);
+    value.clear();
+    CPPUNIT_ASSERT( !conn.get("test_mock_proxy", value) );
+    CPPUNIT_ASSERT( value.empty() );
+    CPPUNIT_ASSERT( proxy.get_truncated_count() > 0 );
+    proxy.set_faults(Redis::FaultProxy::Faults());
+
+    proxy.reset_all();
+    CPPUNIT_ASSERT( conn.get("test_mock_proxy", value) );
+    CPPUNIT_ASSERT( value == "value" );
+    CPPUNIT_ASSERT( conn.del("test_mock_proxy") );
+}
+
+void ConnectionTestMock::test_sentinel_failover() {
+    Redis::MockServer first, second, sentinel;
+    sentinel.set_password("secret");
+    sentinel.set_sentinel_master("mymaster", "127.0.0.1", first.get_port());
+    Redis::ConnectionParam sentinel_param = sentinel.get_connection_param();
+    sentinel_param.password = "secret";
+
+    Redis::Sentinel watcher("mymaster", {sentinel_param});
+    CPPUNIT_ASSERT( watcher.get_master_param().port == first.get_port() );
+    CPPUNIT_ASSERT( watcher.get()->set("test_sentinel", "first") );
+    watcher.watch();
+    // subscription is made in background
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    // +switch-master is pushed to watcher, pool is retargeted without resolve()
+    sentinel.set_sentinel_master("mymaster", "127.0.0.1", second.get_port());
+    for(size_t i = 0; i < 100 && watcher.get_failover_count() == 0; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    CPPUNIT_ASSERT_MESSAGE( watcher.get_error(), watcher.get_failover_count() == 1 );
+    CPPUNIT_ASSERT( watcher.get_master_param().port == second.get_port() );
+    std::string value;
+    CPPUNIT_ASSERT( watcher.get()->get("test_sentinel", value) && value.empty() );
+    CPPUNIT_ASSERT( watcher.get()->set("test_sentinel", "second") );
+    watcher.stop();
+
+    // switch made while nobody listens is picked up by resolve
+    sentinel.set_sentinel_master("mymaster", "127.0.0.1", first.get_port());
+    CPPUNIT_ASSERT( watcher.resolve() && watcher.get_failover_count() == 2 );
+    CPPUNIT_ASSERT( watcher.get()->get("test_sentinel", value) && value == "first" );
+
+    // failback while a connection to the first master is leased: pool keeps connections to it again
+    {
+        Redis::PoolWrapper leased = watcher.get();
+        sentinel.set_sentinel_master("mymaster", "127.0.0.1", second.get_port());
+        CPPUNIT_ASSERT( watcher.resolve() && watcher.get_failover_count() == 3 );
+        sentinel.set_sentinel_master("mymaster", "127.0.0.1", first.get_port());
+        CPPUNIT_ASSERT( watcher.resolve() && watcher.get_failover_count() == 4 );
+        Redis::Connection::Id id;
+        {
+            Redis::PoolWrapper conn = watcher.get();
+            CPPUNIT_ASSERT( conn->get("test_sentinel", value) && value == "first" );
+            id = conn->get_id();
+        }
+        CPPUNIT_ASSERT( watcher.get()->get_id() == id );
+        CPPUNIT_ASSERT( leased->get("test_sentinel", value) && value == "first" );
+    }
+
+    // unknown master and wrong password
+    Redis::Sentinel unknown("other", {sentinel_param});
+    CPPUNIT_ASSERT( !unknown.resolve() );
+    sentinel_param.password = "wrong";
+    Redis::Sentinel denied("mymaster", {sentinel_param});
+    CPPUNIT_ASSERT( !denied.resolve() );
+    CPPUNIT_ASSERT( denied.get_error().find("authenticate") != std::string::npos );
+}
+
+void ConnectionTestMock::test_hedged_failover() {
+    Redis::MockServer failing, slow;
+    Redis::MockServer::Faults failing_faults;
+    failing_faults.latency_us = 20000;
+    failing_faults.disconnect_rate = 1;
+    failing.set_command_faults("GET", failing_faults);
+    Redis::MockServer::Faults slow_faults;
+    slow_faults.latency_us = 100000;
+    slow.set_command_faults("GET", slow_faults);
+    Redis::HedgedReader::Options options;
+    options.min_delay_us = 1000;
+    options.max_delay_us = 1000;
+    options.budget = 1;
+    Redis::HedgedReader reader({failing.get_connection_param(), slow.get_connection_param()}, options);
+    // each replica is asked first once and is hedged to the other one, which is the only reply while the failing one drops connection
+    std::string value;
+    for(size_t i = 0; i < 2; i++) {
+        CPPUNIT_ASSERT_MESSAGE( reader.get_error(), reader.get("test_hedged_failover", value) );
+    }
+    CPPUNIT_ASSERT( reader.get_hedge_count() == 2 );
+    // only the read answered by hedge counts as won, even if the primary failed before
+    CPPUNIT_ASSERT( reader.get_hedge_win_count() == 1 );
+}
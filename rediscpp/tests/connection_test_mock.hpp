@@ -0,0 +1,25 @@
+#pragma once
+#include "connection_test_abstract.hpp"
+/*
+* Runs all connection tests against in-process MockServer, so they don't need redis-server, and checks behaviour on injected server and network faults
+*/
+class ConnectionTestMock : public ConnectionTestAbstract {
+    CPPUNIT_TEST_SUB_SUITE(ConnectionTestMock, ConnectionTestAbstract);
+        CPPUNIT_TEST( test_injected_latency );
+        CPPUNIT_TEST( test_injected_error );
+        CPPUNIT_TEST( test_disconnect );
+        CPPUNIT_TEST( test_proxy_faults );
+        CPPUNIT_TEST( test_sentinel_failover );
+        CPPUNIT_TEST( test_hedged_failover );
+    CPPUNIT_TEST_SUITE_END();
+    public:
+        void tearDown();
+    protected:
+        virtual Redis::Connection get_connection();
+        void test_injected_latency();
+        void test_injected_error();
+        void test_disconnect();
+        void test_proxy_faults();
+        void test_sentinel_failover();
+        void test_hedged_failover();
+};
\ No newline at end of file
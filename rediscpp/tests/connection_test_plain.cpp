@@ -1,5 +1,743 @@
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 #include "connection_test_plain.hpp"
 CPPUNIT_TEST_SUITE_REGISTRATION( ConnectionTestPlain );
 Redis::Connection ConnectionTestPlain::get_connection() {
     return Redis::Connection();
+}
+
+void ConnectionTestPlain::test_hedged_read() {
+    CPPUNIT_ASSERT( connection.set("test_hedged_read", "value") );
+    CPPUNIT_ASSERT( connection.hset("test_hedged_read_hash", "field", "hash_value") );
+    CPPUNIT_ASSERT( connection.del("test_hedged_read_missing") );
+
+    // the same server twice, zero delay makes every read hedged while budget allows
+    Redis::HedgedReader::Options options;
+    options.min_delay_us = 0;
+    options.max_delay_us = 0;
+    Redis::HedgedReader reader({Redis::ConnectionParam(), Redis::ConnectionParam()}, options);
+    for(size_t i = 0; i < 20; i++) {
+        std::string value;
+        CPPUNIT_ASSERT_MESSAGE( reader.get_error(), reader.get("test_hedged_read", value) );
+        CPPUNIT_ASSERT( value == "value" );
+        CPPUNIT_ASSERT_MESSAGE( reader.get_error(), reader.hget("test_hedged_read_hash", "field", value) );
+        CPPUNIT_ASSERT( value == "hash_value" );
+        std::vector<std::string> values;
+        CPPUNIT_ASSERT_MESSAGE( reader.get_error(), reader.get(std::vector<std::string>{"test_hedged_read", "test_hedged_read_missing"}, values) );
+        CPPUNIT_ASSERT( values.size() == 2 && values[0] == "value" && values[1] == "" );
+    }
+    CPPUNIT_ASSERT( reader.get_request_count() == 60 );
+    CPPUNIT_ASSERT( reader.get_hedge_count() > 0 );
+    // budget: 5% of requests plus initial burst
+    CPPUNIT_ASSERT( reader.get_hedge_count() <= 13 );
+
+    CPPUNIT_ASSERT( connection.del("test_hedged_read") );
+    CPPUNIT_ASSERT( connection.del("test_hedged_read_hash") );
+}
+
+void ConnectionTestPlain::test_single_flight() {
+    std::string value(100000, 'x');
+    CPPUNIT_ASSERT( connection.set("test_single_flight", value) );
+    CPPUNIT_ASSERT( connection.hset("test_single_flight_hash", "field", "hash_value") );
+
+    Redis::SingleFlight single_flight;
+    std::atomic<size_t> failed(0);
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < 32; i++) {
+        threads.emplace_back([&]() {
+            std::string result;
+            for(size_t j = 0; j < 50; j++) {
+                if(!single_flight.get(Redis::ConnectionParam(), "test_single_flight", result) || result != value) {
+                    failed++;
+                }
+                if(!single_flight.hget(Redis::ConnectionParam(), "test_single_flight_hash", "field", result) || result != "hash_value") {
+                    failed++;
+                }
+            }
+        });
+    }
+    for(size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    CPPUNIT_ASSERT( failed == 0 );
+
+    // nothing is cached after flight is over
+    CPPUNIT_ASSERT( connection.set("test_single_flight", "new_value") );
+    std::string result;
+    CPPUNIT_ASSERT( single_flight.get(Redis::ConnectionParam(), "test_single_flight", result) );
+    CPPUNIT_ASSERT( result == "new_value" );
+
+    CPPUNIT_ASSERT( connection.del("test_single_flight") );
+    CPPUNIT_ASSERT( connection.del("test_single_flight_hash") );
+}
+
+void ConnectionTestPlain::test_auto_batcher() {
+    for(size_t i = 0; i < 10; i++) {
+        CPPUNIT_ASSERT( connection.set("test_auto_batcher_" + std::to_string(i), std::to_string(i)) );
+    }
+    CPPUNIT_ASSERT( connection.expire("test_auto_batcher_0", 100, Redis::Connection::ExpireType::SEC) );
+    CPPUNIT_ASSERT( connection.del("test_auto_batcher_missing") );
+
+    Redis::AutoBatcher::Options options;
+    options.window_us = 1000;
+    Redis::AutoBatcher batcher(Redis::ConnectionParam(), options);
+    std::atomic<size_t> failed(0);
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < 20; i++) {
+        threads.emplace_back([&batcher, &failed, i]() {
+            for(size_t j = 0; j < 100; j++) {
+                size_t index = (i + j) % 10;
+                std::string value;
+                bool exists = false;
+                long long ttl = 0;
+                if(!batcher.get("test_auto_batcher_" + std::to_string(index), value) || value != std::to_string(index)) {
+                    failed++;
+                }
+                if(!batcher.exists("test_auto_batcher_missing", exists) || exists) {
+                    failed++;
+                }
+                if(!batcher.ttl("test_auto_batcher_" + std::to_string(index), ttl) || (index == 0 ? ttl <= 0 : ttl != -1)) {
+                    failed++;
+                }
+            }
+        });
+    }
+    for(size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    CPPUNIT_ASSERT( failed == 0 );
+    CPPUNIT_ASSERT( batcher.get_request_count() == 6000 );
+    CPPUNIT_ASSERT( batcher.get_batch_count() < batcher.get_request_count() );
+
+    // futures of requests queued right before destruction are still completed
+    std::future<std::string> value;
+    {
+        Redis::AutoBatcher short_lived(Redis::ConnectionParam(), options);
+        value = short_lived.get_async("test_auto_batcher_1");
+    }
+    CPPUNIT_ASSERT( value.get() == "1" );
+
+    for(size_t i = 0; i < 10; i++) {
+        CPPUNIT_ASSERT( connection.del("test_auto_batcher_" + std::to_string(i)) );
+    }
+}
+
+void ConnectionTestPlain::test_multiplexed_connection() {
+    Redis::MultiplexedConnection shared;
+    CPPUNIT_ASSERT_MESSAGE( shared.get_error(), shared.del("test_multiplexed_counter") );
+    std::atomic<size_t> failed(0);
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < 32; i++) {
+        threads.emplace_back([&shared, &failed, i]() {
+            std::string key = "test_multiplexed_" + std::to_string(i);
+            std::vector<std::future<Redis::MultiplexedConnection::Reply>> increments;
+            for(size_t j = 0; j < 100; j++) {
+                std::string value = std::to_string(i * 1000 + j), result;
+                if(!shared.set(key, value) || !shared.get(key, result) || result != value) {
+                    failed++;
+                }
+                increments.push_back(shared.command_async({"INCR", "test_multiplexed_counter"}));
+            }
+            for(size_t j = 0; j < increments.size(); j++) {
+                if(increments[j].get().type != Redis::MultiplexedConnection::Reply::Type::INTEGER) {
+                    failed++;
+                }
+            }
+            shared.del(key);
+        });
+    }
+    for(size_t i = 0; i < threads.size(); i++) {
+        threads[i].join();
+    }
+    CPPUNIT_ASSERT( failed == 0 );
+    std::string counter;
+    CPPUNIT_ASSERT( shared.get("test_multiplexed_counter", counter) );
+    CPPUNIT_ASSERT( counter == "3200" );
+
+    // error reply fails only its own request
+    Redis::MultiplexedConnection::Reply reply;
+    CPPUNIT_ASSERT( !shared.command({"HGET", "test_multiplexed_counter", "field"}, reply) );
+    CPPUNIT_ASSERT( reply.type == Redis::MultiplexedConnection::Reply::Type::ERROR );
+    CPPUNIT_ASSERT( shared.command({"PING"}, reply) && reply.str == "PONG" );
+
+    // blocking commands would stall every other caller
+    CPPUNIT_ASSERT( !shared.command({"blpop", "test_multiplexed_list", "0"}, reply) );
+    CPPUNIT_ASSERT( !shared.command({"XREAD", "BLOCK", "0", "STREAMS", "test_multiplexed_stream", "$"}, reply) );
+    CPPUNIT_ASSERT( shared.del("test_multiplexed_counter") );
+}
+
+void ConnectionTestPlain::test_named_pool_warm_up() {
+    Redis::ConnectionParam unreachable("127.0.0.1", 1);
+    unreachable.connect_timeout_ms = 100;
+    unreachable.reconnect_on_failure = false;
+    Redis::NamedPool::create("test_named_pool_warm_up", {Redis::ConnectionParam(), unreachable});
+    Redis::NamedPool& pool = Redis::NamedPool::get_pool("test_named_pool_warm_up");
+    Redis::NamedPool::WarmUpReport report = pool.warm_up(3, 1000);
+    CPPUNIT_ASSERT( report.shards.size() == 2 );
+    CPPUNIT_ASSERT( report.shards[0].connected == 3 && report.shards[0].error.empty() );
+    CPPUNIT_ASSERT( report.shards[1].connected == 0 && !report.shards[1].error.empty() );
+    CPPUNIT_ASSERT( report.is_ok(0) && !report.is_ok(1) );
+}
+
+void ConnectionTestPlain::test_pool_socket_sharing() {
+    Redis::ConnectionParam first;
+    first.prefix = "test_pool_first:";
+    first.operation_timeout_ms = 500;
+    Redis::ConnectionParam second;
+    second.prefix = "test_pool_second:";
+    second.throw_on_error = true;
+    Redis::Connection::Id id;
+    {
+        Redis::PoolWrapper conn = Redis::Pool::instance().get(first);
+        CPPUNIT_ASSERT( conn->set("key", "first") );
+        id = conn->get_id();
+    }
+    {
+        // the same socket, but prefix of the lease
+        Redis::PoolWrapper conn = Redis::Pool::instance().get(second);
+        CPPUNIT_ASSERT( conn->get_id() == id );
+        std::string value;
+        CPPUNIT_ASSERT( conn->get("key", value) );
+        CPPUNIT_ASSERT( value.empty() );
+        CPPUNIT_ASSERT( conn->get_prefix() == "test_pool_second:" );
+    }
+    {
+        Redis::PoolWrapper conn = Redis::Pool::instance().get(first);
+        std::string value;
+        CPPUNIT_ASSERT( conn->get("key", value) );
+        CPPUNIT_ASSERT( value == "first" );
+        CPPUNIT_ASSERT( conn->del("key") );
+    }
+}
+
+void ConnectionTestPlain::test_deadline() {
+    Redis::ConnectionParam param;
+    param.operation_timeout_ms = 200;
+    Redis::Connection conn(param);
+    CPPUNIT_ASSERT( conn.del("test_deadline_list") );
+
+    // server timeout longer than operation timeout doesn't fail the call
+    std::vector<std::string> keys = {"test_deadline_list"};
+    std::string key, value;
+    CPPUNIT_ASSERT( conn.blpop(keys, 1, key, value) );
+    CPPUNIT_ASSERT( key.empty() && value.empty() );
+
+    // server timeout is cut by deadline
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+        Redis::DeadlineScope scope(Redis::Deadline(300));
+        CPPUNIT_ASSERT( conn.brpop(keys, 10, key, value) );
+        CPPUNIT_ASSERT( key.empty() && value.empty() );
+    }
+    CPPUNIT_ASSERT( std::chrono::steady_clock::now() - start < std::chrono::seconds(1) );
+
+    Redis::MultiplexedConnection pusher;
+    Redis::MultiplexedConnection::Reply reply;
+    CPPUNIT_ASSERT( pusher.command({"RPUSH", "test_deadline_list", "value"}, reply) );
+    CPPUNIT_ASSERT( conn.blpop(keys, 0, key, value) );
+    CPPUNIT_ASSERT( key == "test_deadline_list" && value == "value" );
+
+    // late request is not sent at all
+    {
+        Redis::DeadlineScope scope(Redis::Deadline(Redis::Deadline::Clock::now()));
+        CPPUNIT_ASSERT( !conn.set("test_deadline_key", "value") );
+        CPPUNIT_ASSERT( conn.get_errno() == Redis::Connection::Error::DEADLINE_EXCEEDED );
+    }
+    CPPUNIT_ASSERT( conn.set("test_deadline_key", "value") );
+    CPPUNIT_ASSERT( conn.del("test_deadline_key") );
+}
+
+void ConnectionTestPlain::test_admission_control() {
+    Redis::AdmissionControl::Limits limits;
+    limits.rate = 10;
+    limits.burst = 2;
+    Redis::AdmissionControl bucket(limits);
+    CPPUNIT_ASSERT( bucket.try_acquire() );
+    bucket.release();
+    CPPUNIT_ASSERT( bucket.try_acquire() );
+    bucket.release();
+    CPPUNIT_ASSERT( !bucket.try_acquire() );
+    CPPUNIT_ASSERT( bucket.get_admitted_count() == 2 && bucket.get_rejected_count() == 1 );
+    CPPUNIT_ASSERT( bucket.get_in_flight() == 0 );
+
+    // the next token comes in 100ms
+    limits.queue_timeout_ms = 500;
+    Redis::AdmissionControl queued(limits);
+    CPPUNIT_ASSERT( queued.acquire() && queued.acquire() && queued.acquire() );
+
+    // request blocked on server holds its slot, others fail fast
+    Redis::AdmissionControl::Limits in_flight_limits;
+    in_flight_limits.max_in_flight = 1;
+    Redis::ConnectionParam param;
+    param.admission = std::make_shared<Redis::AdmissionControl>(in_flight_limits);
+    Redis::Connection blocked(param);
+    Redis::Connection other(param);
+    CPPUNIT_ASSERT( other.del("test_admission_list") );
+    std::thread blocked_thread([&]() {
+        std::vector<std::string> keys = {"test_admission_list"};
+        std::string key, value;
+        blocked.blpop(keys, 1, key, value);
+    });
+    while(param.admission->get_in_flight() == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    CPPUNIT_ASSERT( !other.set("test_admission_key", "value") );
+    CPPUNIT_ASSERT( other.get_errno() == Redis::Connection::Error::ADMISSION_REJECTED );
+    blocked_thread.join();
+    CPPUNIT_ASSERT( param.admission->get_in_flight() == 0 );
+    CPPUNIT_ASSERT( other.set("test_admission_key", "value") );
+    CPPUNIT_ASSERT( other.del("test_admission_key") );
+
+    // shards on the same endpoint share limits
+    Redis::NamedPool::create("test_admission_control", {Redis::ConnectionParam(), Redis::ConnectionParam("127.0.0.1", 6379, "", 1)}, in_flight_limits);
+    Redis::NamedPool& pool = Redis::NamedPool::get_pool("test_admission_control");
+    CPPUNIT_ASSERT( pool.get_connection_param("a").admission != nullptr );
+    for(size_t i = 0; i < 10; i++) {
+        CPPUNIT_ASSERT( pool.get_connection_param("a").admission == pool.get_connection_param(std::to_string(i)).admission );
+    }
+    CPPUNIT_ASSERT( pool.get("a")->set("test_admission_key", "value") );
+    CPPUNIT_ASSERT( pool.get("a")->del("test_admission_key") );
+}
+
+void ConnectionTestPlain::test_script() {
+    CPPUNIT_ASSERT( Redis::sha1_hex("abc") == "a9993e364706816aba3e25717850c26c9cd0d89d" );
+    CPPUNIT_ASSERT( connection.set("test_script", "value") );
+
+    // unique source is not cached on server yet, so the first run falls back to EVAL
+    Redis::Script script("return {redis.call('STRLEN', KEYS[1]), tonumber(ARGV[1]), " + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + "}");
+    std::vector<long long> numbers;
+    CPPUNIT_ASSERT( script.run(connection, {"test_script"}, {"7"}, numbers) );
+    CPPUNIT_ASSERT( numbers.size() == 3 && numbers[0] == 5 && numbers[1] == 7 );
+    CPPUNIT_ASSERT( script.run(connection, {"test_script"}, {"8"}, numbers) );
+    CPPUNIT_ASSERT( numbers.size() == 3 && numbers[1] == 8 );
+
+    Redis::Script get("return redis.call('GET', KEYS[1])");
+    std::string value;
+    CPPUNIT_ASSERT( get.run(connection, {"test_script"}, {}, value) );
+    CPPUNIT_ASSERT( value == "value" );
+
+    Redis::Script failing("return redis.error_reply('failed')");
+    long long result = 0;
+    CPPUNIT_ASSERT( !failing.run(connection, {}, {}, result) );
+    CPPUNIT_ASSERT( connection.get_errno() == Redis::Connection::Error::REPLY_ERR );
+
+    // with throw_on_error NOSCRIPT still falls back to EVAL, errors of the script itself throw
+    Redis::ConnectionParam throwing_param;
+    throwing_param.throw_on_error = true;
+    Redis::Connection throwing(throwing_param);
+    Redis::MultiplexedConnection admin;
+    Redis::MultiplexedConnection::Reply reply;
+    CPPUNIT_ASSERT( admin.command({"SCRIPT", "FLUSH"}, reply) );
+    CPPUNIT_ASSERT( get.run(throwing, {"test_script"}, {}, value) && value == "value" );
+    CPPUNIT_ASSERT_THROW( failing.run(throwing, {}, {}, result), Redis::Exception );
+    CPPUNIT_ASSERT( connection.del("test_script") );
+}
+
+void ConnectionTestPlain::test_lock() {
+    CPPUNIT_ASSERT( connection.del("test_lock") );
+    CPPUNIT_ASSERT( connection.del("test_lock:wake") );
+    Redis::Lock::Options options;
+    options.ttl_ms = 1000;
+    Redis::Lock first("test_lock", Redis::ConnectionParam(), options);
+    Redis::Lock second("test_lock", Redis::ConnectionParam(), options);
+    bool acquired = false;
+    CPPUNIT_ASSERT( first.try_lock(acquired) && acquired );
+    CPPUNIT_ASSERT( first.is_locked() );
+    CPPUNIT_ASSERT( first.get_validity_ms() > 0 && first.get_validity_ms() <= 1000 );
+    CPPUNIT_ASSERT( second.try_lock(acquired) && !acquired );
+    CPPUNIT_ASSERT( !second.unlock() );
+    CPPUNIT_ASSERT( !second.lock(50, acquired) && !acquired );
+    CPPUNIT_ASSERT( first.extend() );
+    CPPUNIT_ASSERT( first.unlock() );
+    CPPUNIT_ASSERT( !first.is_locked() );
+    CPPUNIT_ASSERT( second.try_lock(acquired) && acquired );
+    CPPUNIT_ASSERT( second.unlock() );
+    // no wait still makes one attempt
+    CPPUNIT_ASSERT( second.lock(0, acquired) && acquired );
+    CPPUNIT_ASSERT( second.unlock() );
+
+    // release wakes the waiter long before the lease expires
+    options.ttl_ms = 10000;
+    Redis::Lock holder("test_lock", Redis::ConnectionParam(), options);
+    Redis::Lock waiter("test_lock", Redis::ConnectionParam(), options);
+    CPPUNIT_ASSERT( holder.try_lock(acquired) && acquired );
+    std::atomic<bool> waiter_acquired(false);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::thread waiter_thread([&]() {
+        bool waited = false;
+        waiter_acquired = waiter.lock(5000, waited) && waited;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CPPUNIT_ASSERT( holder.unlock() );
+    waiter_thread.join();
+    CPPUNIT_ASSERT( waiter_acquired );
+    CPPUNIT_ASSERT( std::chrono::steady_clock::now() - start < std::chrono::seconds(2) );
+    CPPUNIT_ASSERT( waiter.unlock() );
+
+    // fencing token grows with each acquisition
+    options.fencing = true;
+    Redis::Lock fenced("test_lock", Redis::ConnectionParam(), options);
+    CPPUNIT_ASSERT( fenced.try_lock(acquired) && acquired );
+    unsigned long long token = fenced.get_fencing_token();
+    CPPUNIT_ASSERT( token > 0 );
+    CPPUNIT_ASSERT( fenced.unlock() );
+    CPPUNIT_ASSERT( fenced.get_fencing_token() == 0 );
+    CPPUNIT_ASSERT( fenced.try_lock(acquired) && acquired );
+    CPPUNIT_ASSERT( fenced.get_fencing_token() > token );
+    CPPUNIT_ASSERT( fenced.unlock() );
+
+    // renewed lock outlives its ttl
+    options.ttl_ms = 300;
+    options.auto_renew = true;
+    Redis::Lock renewed("test_lock", Redis::ConnectionParam(), options);
+    CPPUNIT_ASSERT( renewed.try_lock(acquired) && acquired );
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    CPPUNIT_ASSERT( renewed.is_locked() );
+    CPPUNIT_ASSERT( second.try_lock(acquired) && !acquired );
+    CPPUNIT_ASSERT( renewed.unlock() );
+
+    // quorum of three databases standing for independent instances
+    Redis::Lock redlock("test_lock", {Redis::ConnectionParam(), Redis::ConnectionParam("127.0.0.1", 6379, "", 1), Redis::ConnectionParam("127.0.0.1", 6379, "", 2)});
+    CPPUNIT_ASSERT( redlock.try_lock(acquired) && acquired );
+    CPPUNIT_ASSERT( redlock.unlock() );
+
+    // scripts unknown to server don't throw on connections with throw_on_error
+    Redis::ConnectionParam throwing_param;
+    throwing_param.throw_on_error = true;
+    Redis::Lock throwing("test_lock", throwing_param, options);
+    Redis::MultiplexedConnection admin;
+    Redis::MultiplexedConnection::Reply reply;
+    CPPUNIT_ASSERT( admin.command({"SCRIPT", "FLUSH"}, reply) );
+    CPPUNIT_ASSERT( throwing.try_lock(acquired) && acquired );
+    CPPUNIT_ASSERT( admin.command({"SCRIPT", "FLUSH"}, reply) );
+    CPPUNIT_ASSERT( throwing.unlock() );
+    CPPUNIT_ASSERT( connection.del("test_lock:fencing") );
+    CPPUNIT_ASSERT( connection.del("test_lock:wake") );
+}
+
+void ConnectionTestPlain::test_rate_limiter() {
+    Redis::RateLimiter::Algorithm algorithms[] = {Redis::RateLimiter::Algorithm::GCRA, Redis::RateLimiter::Algorithm::SLIDING_WINDOW, Redis::RateLimiter::Algorithm::FIXED_WINDOW};
+    for(Redis::RateLimiter::Algorithm algorithm : algorithms) {
+        Redis::RateLimiter limiter(Redis::RateLimiter::Limit(5, 10000, algorithm));
+        CPPUNIT_ASSERT( limiter.reset("test_rate_limiter") );
+        Redis::RateLimiter::Decision decision;
+        for(long long i = 0; i < 5; i++) {
+            CPPUNIT_ASSERT( limiter.allow(connection, "test_rate_limiter", decision) );
+            CPPUNIT_ASSERT( decision.allowed && !decision.local );
+            CPPUNIT_ASSERT( decision.remaining == 4 - i );
+        }
+        CPPUNIT_ASSERT( limiter.allow("test_rate_limiter", decision) );
+        CPPUNIT_ASSERT( !decision.allowed && !decision.local );
+        CPPUNIT_ASSERT( decision.retry_after_ms > 0 && decision.retry_after_ms <= 10000 );
+        CPPUNIT_ASSERT( limiter.allow("test_rate_limiter", decision, 6) );
+        CPPUNIT_ASSERT( !decision.allowed && decision.local && decision.retry_after_ms == -1 );
+        CPPUNIT_ASSERT( limiter.reset("test_rate_limiter") );
+    }
+
+    // denied key is answered locally until retry_after
+    Redis::RateLimiter::Options options;
+    options.local_precheck = true;
+    Redis::RateLimiter gcra(Redis::RateLimiter::Limit(10, 100, Redis::RateLimiter::Algorithm::GCRA, 1), Redis::ConnectionParam(), options);
+    CPPUNIT_ASSERT( gcra.reset("test_rate_limiter") );
+    Redis::RateLimiter::Decision decision;
+    CPPUNIT_ASSERT( gcra.allow("test_rate_limiter", decision) && decision.allowed );
+    CPPUNIT_ASSERT( gcra.allow("test_rate_limiter", decision) && !decision.allowed && !decision.local );
+    CPPUNIT_ASSERT( decision.retry_after_ms > 0 && decision.retry_after_ms <= 10 );
+    CPPUNIT_ASSERT( gcra.allow("test_rate_limiter", decision) && !decision.allowed && decision.local );
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    CPPUNIT_ASSERT( gcra.allow("test_rate_limiter", decision) && decision.allowed );
+
+    // batch in one pipeline
+    Redis::RateLimiter batch(Redis::RateLimiter::Limit(2, 10000));
+    std::vector<std::string> keys = {"test_rate_limiter_a", "test_rate_limiter_b", "test_rate_limiter_a", "test_rate_limiter_a"};
+    CPPUNIT_ASSERT( batch.reset("test_rate_limiter_a") && batch.reset("test_rate_limiter_b") );
+    std::vector<Redis::RateLimiter::Decision> decisions;
+    CPPUNIT_ASSERT( batch.allow(keys, decisions) );
+    CPPUNIT_ASSERT( decisions.size() == 4 );
+    CPPUNIT_ASSERT( decisions[0].allowed && decisions[1].allowed && decisions[2].allowed && !decisions[3].allowed );
+    CPPUNIT_ASSERT( decisions[1].remaining == 1 && decisions[2].remaining == 0 );
+
+    // scripts unknown to server don't throw on connections with throw_on_error
+    Redis::ConnectionParam throwing_param;
+    throwing_param.throw_on_error = true;
+    Redis::RateLimiter throwing(Redis::RateLimiter::Limit(5, 10000), throwing_param);
+    Redis::MultiplexedConnection admin;
+    Redis::MultiplexedConnection::Reply reply;
+    CPPUNIT_ASSERT( throwing.reset("test_rate_limiter") );
+    CPPUNIT_ASSERT( admin.command({"SCRIPT", "FLUSH"}, reply) );
+    CPPUNIT_ASSERT( throwing.allow("test_rate_limiter", decision) && decision.allowed && decision.remaining == 4 );
+    CPPUNIT_ASSERT( admin.command({"SCRIPT", "FLUSH"}, reply) );
+    CPPUNIT_ASSERT( throwing.allow(std::vector<std::string>{"test_rate_limiter", "test_rate_limiter"}, decisions) );
+    CPPUNIT_ASSERT( decisions.size() == 2 && decisions[1].allowed && decisions[1].remaining == 2 );
+    CPPUNIT_ASSERT( gcra.reset("test_rate_limiter") && batch.reset("test_rate_limiter_a") && batch.reset("test_rate_limiter_b") );
+}
+
+void ConnectionTestPlain::test_bloom_filter() {
+    Redis::BloomFilter filter("test_bloom_filter", 1000, 0.01);
+    CPPUNIT_ASSERT( filter.clear() );
+    CPPUNIT_ASSERT( filter.get_hash_count() == 7 );
+    CPPUNIT_ASSERT( filter.get_shard_keys().size() == 1 );
+    bool added = false, found = true;
+    CPPUNIT_ASSERT( filter.contains("item", found) && !found );
+    CPPUNIT_ASSERT( filter.add("item", added) && added );
+    CPPUNIT_ASSERT( filter.add("item", added) && !added );
+    CPPUNIT_ASSERT( filter.contains("item", found) && found );
+    CPPUNIT_ASSERT( filter.clear() );
+
+    // small shards and pipelines split the batch
+    Redis::BloomFilter::Options options;
+    options.shard_bits = 1024;
+    options.pipeline_size = 100;
+    Redis::BloomFilter sharded("test_bloom_filter", 1000, 0.01, Redis::ConnectionParam(), options);
+    CPPUNIT_ASSERT( sharded.get_shard_keys().size() == 10 );
+    CPPUNIT_ASSERT( sharded.get_bits() >= 9585 );
+    std::vector<std::string> items, others;
+    for(size_t i = 0; i < 1000; i++) {
+        items.push_back("item_" + std::to_string(i));
+        others.push_back("other_" + std::to_string(i));
+    }
+    std::vector<bool> results;
+    CPPUNIT_ASSERT( sharded.add(items, results) );
+    CPPUNIT_ASSERT( results.size() == 1000 );
+    CPPUNIT_ASSERT( std::count(results.begin(), results.end(), true) > 950 );
+    CPPUNIT_ASSERT( sharded.contains(items, results) );
+    CPPUNIT_ASSERT( std::count(results.begin(), results.end(), true) == 1000 );
+    CPPUNIT_ASSERT( sharded.contains(others, results) );
+    CPPUNIT_ASSERT( std::count(results.begin(), results.end(), true) < 50 );
+    CPPUNIT_ASSERT( sharded.clear() );
+}
+
+void ConnectionTestPlain::test_bitfield() {
+    CPPUNIT_ASSERT( connection.del("test_bitfield") );
+    Redis::BitField operations;
+    operations.set(Redis::BitField::u(4), 0, 3).incrby(Redis::BitField::u(4), 0, 2).get(Redis::BitField::i(16), 8);
+    operations.overflow(Redis::BitField::Overflow::SAT).incrby(Redis::BitField::u(4), 4, 100);
+    operations.overflow(Redis::BitField::Overflow::FAIL).incrby(Redis::BitField::i(8), 8, -200);
+    std::vector<long long> results;
+    std::vector<bool> failed;
+    CPPUNIT_ASSERT( connection.bitfield("test_bitfield", operations, results, failed) );
+    CPPUNIT_ASSERT( results.size() == 5 && failed.size() == 5 );
+    CPPUNIT_ASSERT( results[0] == 0 && results[1] == 5 && results[2] == 0 && results[3] == 15 );
+    CPPUNIT_ASSERT( failed[4] && !failed[3] );
+    CPPUNIT_ASSERT_THROW( Redis::BitField::u(64), Redis::Exception );
+
+    // 2000 packed counters in parts of 300 sub-operations keep overflow mode
+    Redis::BitField counters(300);
+    counters.overflow(Redis::BitField::Overflow::SAT);
+    for(unsigned long long i = 0; i < 2000; i++) {
+        counters.incrby(Redis::BitField::u(2), i * 2, static_cast<long long>(i % 5));
+    }
+    CPPUNIT_ASSERT( connection.del("test_bitfield") );
+    CPPUNIT_ASSERT( connection.bitfield("test_bitfield", counters, results) );
+    CPPUNIT_ASSERT( results.size() == 2000 );
+    for(size_t i = 0; i < results.size(); i++) {
+        CPPUNIT_ASSERT( results[i] == std::min<long long>(static_cast<long long>(i % 5), 3) );
+    }
+
+    // parts with error reply are reported as failed, results stay aligned with operations
+    CPPUNIT_ASSERT( connection.del("test_bitfield") );
+    CPPUNIT_ASSERT( connection.hset("test_bitfield", "field", "value") );
+    CPPUNIT_ASSERT( !connection.bitfield("test_bitfield", counters, results, failed) );
+    CPPUNIT_ASSERT( results.size() == 2000 && failed.size() == 2000 );
+    CPPUNIT_ASSERT( std::count(failed.begin(), failed.end(), true) == 2000 );
+    CPPUNIT_ASSERT( connection.del("test_bitfield") );
+}
+
+void ConnectionTestPlain::test_hyperloglog() {
+    CPPUNIT_ASSERT( connection.del("test_hll_small") && connection.del("test_hll_large") && connection.del("test_hll_merged") );
+    bool altered = false;
+    CPPUNIT_ASSERT( connection.pfadd("test_hll_small", "a", altered) && altered );
+    CPPUNIT_ASSERT( connection.pfadd("test_hll_small", "a", altered) && !altered );
+    std::vector<std::string> elements;
+    for(size_t i = 0; i < 2500; i++) {
+        elements.push_back("element_" + std::to_string(i));
+    }
+    // 2500 elements are sent in three commands
+    CPPUNIT_ASSERT( connection.pfadd("test_hll_large", elements, altered) && altered );
+    CPPUNIT_ASSERT( connection.pfadd("test_hll_large", elements, altered) && !altered );
+    long long count = 0;
+    CPPUNIT_ASSERT( connection.pfcount("test_hll_small", count) && count == 1 );
+    CPPUNIT_ASSERT( connection.pfcount("test_hll_large", count) && count > 2450 && count < 2550 );
+    std::vector<std::string> keys = {"test_hll_small", "test_hll_large"};
+    long long union_count = 0;
+    CPPUNIT_ASSERT( connection.pfcount(keys, union_count) && union_count > count );
+    CPPUNIT_ASSERT( connection.pfmerge("test_hll_merged", keys) );
+    CPPUNIT_ASSERT( connection.pfcount("test_hll_merged", count) && count == union_count );
+
+    // local merge of sparse and dense values matches server
+    Redis::NamedPool::create("test_hyperloglog", {Redis::ConnectionParam()});
+    Redis::ShardedHyperLogLog single("test_hyperloglog");
+    CPPUNIT_ASSERT( single.count({"test_hll_small", "test_hll_large", "test_hll_missing"}, count) && count == union_count );
+    Redis::HyperLogLog merged;
+    CPPUNIT_ASSERT( single.merge({"test_hll_small"}, merged) && merged.count() == 1 );
+    CPPUNIT_ASSERT( connection.set("test_hll_string", "value") );
+    CPPUNIT_ASSERT( !single.count({"test_hll_string"}, count) );
+
+    // keys on different shards
+    Redis::NamedPool::create("test_hyperloglog_sharded", {Redis::ConnectionParam(), Redis::ConnectionParam("127.0.0.1", 6379, "", 1)});
+    Redis::NamedPool& pool = Redis::NamedPool::get_pool("test_hyperloglog_sharded");
+    std::vector<std::string> page_keys;
+    for(size_t i = 0; i < 10; i++) {
+        page_keys.push_back("test_hll_page_" + std::to_string(i));
+        std::vector<std::string> visitors(elements.begin() + static_cast<long>(i * 200), elements.begin() + static_cast<long>(i * 200 + 500));
+        CPPUNIT_ASSERT( pool.get(page_keys.back())->del(page_keys.back()) );
+        CPPUNIT_ASSERT( pool.get(page_keys.back())->pfadd(page_keys.back(), visitors) );
+    }
+    Redis::ShardedHyperLogLog sharded("test_hyperloglog_sharded");
+    CPPUNIT_ASSERT( sharded.count(page_keys, count) );
+    CPPUNIT_ASSERT( count > 2250 && count < 2350 );
+    for(size_t i = 0; i < page_keys.size(); i++) {
+        CPPUNIT_ASSERT( pool.get(page_keys[i])->del(page_keys[i]) );
+    }
+    CPPUNIT_ASSERT( connection.del("test_hll_small") && connection.del("test_hll_large") && connection.del("test_hll_merged") && connection.del("test_hll_string") );
+}
+
+void ConnectionTestPlain::test_streams() {
+    CPPUNIT_ASSERT( connection.del("test_stream") );
+    std::string id;
+    CPPUNIT_ASSERT( connection.xadd("test_stream", {{"field", "value"}, {"other", "x"}}, id) && !id.empty() );
+    std::vector<Redis::StreamFields> batch;
+    for(size_t i = 0; i < 10; i++) {
+        batch.push_back({{"n", std::to_string(i)}});
+    }
+    std::vector<std::string> ids;
+    CPPUNIT_ASSERT( connection.xadd("test_stream", batch, ids) && ids.size() == 10 );
+    long long length = 0;
+    CPPUNIT_ASSERT( connection.xlen("test_stream", length) && length == 11 );
+    std::vector<Redis::StreamEntry> entries;
+    CPPUNIT_ASSERT( connection.xrange("test_stream", "-", "+", 0, entries) && entries.size() == 11 );
+    CPPUNIT_ASSERT( entries[0].id == id && entries[0].get("other") == "x" && entries[0].get("missing").empty() );
+    CPPUNIT_ASSERT( entries[10].id == ids[9] && entries[10].get("n") == "9" );
+    CPPUNIT_ASSERT( connection.xrange("test_stream", "-", "+", 3, entries) && entries.size() == 3 );
+
+    // group reads new entries, acknowledged ones are not pending anymore
+    bool created = false;
+    CPPUNIT_ASSERT( connection.xgroup_create("test_stream", "group", "0", created) && created );
+    CPPUNIT_ASSERT( connection.xgroup_create("test_stream", "group", "0", created) && !created );
+    CPPUNIT_ASSERT( connection.xreadgroup("group", "first", "test_stream", ">", 5, -1, entries) && entries.size() == 5 );
+    CPPUNIT_ASSERT( entries[0].id == id && entries[0].get("field") == "value" );
+    std::vector<std::string> acked_ids = {entries[0].id.str(), entries[1].id.str()};
+    long long acknowledged = 0;
+    CPPUNIT_ASSERT( connection.xack("test_stream", "group", acked_ids, acknowledged) && acknowledged == 2 );
+    CPPUNIT_ASSERT( connection.xreadgroup("group", "first", "test_stream", "0", 100, -1, entries) && entries.size() == 3 );
+    CPPUNIT_ASSERT( connection.xreadgroup("group", "first", "test_stream", ">", 100, 10, entries) && entries.size() == 6 );
+    CPPUNIT_ASSERT( connection.xreadgroup("group", "first", "test_stream", ">", 100, 10, entries) && entries.empty() );
+
+    // pending entries of the first consumer are claimed by the second one
+    std::string cursor = "0-0";
+    CPPUNIT_ASSERT( connection.xautoclaim("test_stream", "group", "second", 0, cursor, 100, entries) && entries.size() == 9 );
+    CPPUNIT_ASSERT( cursor == "0-0" );
+    CPPUNIT_ASSERT( connection.xreadgroup("group", "first", "test_stream", "0", 100, -1, entries) && entries.empty() );
+
+    // trimming keeps the stream about maxlen long
+    CPPUNIT_ASSERT( connection.xadd("test_stream", {{"n", "last"}}, id, 5, false) );
+    CPPUNIT_ASSERT( connection.xlen("test_stream", length) && length == 5 );
+
+    // consumer handles each entry, the one failed once is claimed and retried
+    CPPUNIT_ASSERT( connection.del("test_stream_consumer") );
+    batch.clear();
+    for(size_t i = 0; i < 1000; i++) {
+        batch.push_back({{"n", std::to_string(i)}});
+    }
+    CPPUNIT_ASSERT( connection.xadd("test_stream_consumer", batch, ids) );
+    std::atomic<size_t> handled(0);
+    std::atomic<bool> failed_once(false);
+    Redis::StreamConsumer::Options options;
+    options.start_id = "0";
+    options.block_ms = 50;
+    options.claim_idle_ms = 100;
+    options.claim_interval_ms = 50;
+    Redis::StreamConsumer consumer("test_stream_consumer", "workers", "worker-1", [&](const Redis::StreamEntry& entry) {
+        if(entry.get("n") == "500" && !failed_once.exchange(true)) {
+            throw std::runtime_error("failed");
+        }
+        handled++;
+        return true;
+    }, Redis::ConnectionParam(), options);
+    CPPUNIT_ASSERT_MESSAGE( consumer.get_error(), consumer.start() );
+    for(size_t i = 0; i < 100 && consumer.get_acked_count() < 1000; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    consumer.stop();
+    CPPUNIT_ASSERT( !consumer.is_running() );
+    CPPUNIT_ASSERT_MESSAGE( consumer.get_error(), consumer.get_acked_count() == 1000 );
+    // delivery is at least once, an entry still queued when claim runs may be handled twice
+    CPPUNIT_ASSERT( handled >= 1000 && consumer.get_failed_count() == 1 && consumer.get_claimed_count() >= 1 );
+    CPPUNIT_ASSERT( connection.xreadgroup("workers", "worker-1", "test_stream_consumer", "0", 100, -1, entries) && entries.empty() );
+    CPPUNIT_ASSERT( connection.del("test_stream") && connection.del("test_stream_consumer") );
+}
+
+void ConnectionTestPlain::test_list_queue() {
+    CPPUNIT_ASSERT( connection.del("test_list") && connection.del("test_list_other") );
+    std::vector<std::string> values;
+    for(size_t i = 0; i < 2500; i++) {
+        values.push_back(std::to_string(i));
+    }
+    // 2500 values are sent in three commands
+    long long length = 0;
+    CPPUNIT_ASSERT( connection.rpush("test_list", values, length) && length == 2500 );
+    CPPUNIT_ASSERT( connection.lpush("test_list", "first") );
+    CPPUNIT_ASSERT( connection.llen("test_list", length) && length == 2501 );
+    std::vector<std::string> range;
+    CPPUNIT_ASSERT( connection.lrange("test_list", 0, 2, range) );
+    CPPUNIT_ASSERT( range == std::vector<std::string>({"first", "0", "1"}) );
+    std::string value;
+    CPPUNIT_ASSERT( connection.lpop("test_list", value) && value == "first" );
+    CPPUNIT_ASSERT( connection.rpop("test_list", value) && value == "2499" );
+    std::vector<std::string> popped;
+    CPPUNIT_ASSERT( connection.lpop("test_list", 3, popped) && popped == std::vector<std::string>({"0", "1", "2"}) );
+    CPPUNIT_ASSERT( connection.rpop("test_list", 2, popped) && popped == std::vector<std::string>({"2498", "2497"}) );
+    CPPUNIT_ASSERT( connection.ltrim("test_list", 0, 9) );
+    CPPUNIT_ASSERT( connection.llen("test_list", length) && length == 10 );
+    CPPUNIT_ASSERT( connection.rpush("test_list", "3") );
+    long long removed = 0;
+    CPPUNIT_ASSERT( connection.lrem("test_list", 0, "3", removed) && removed == 2 );
+    CPPUNIT_ASSERT( connection.lmove("test_list", "test_list_other", Redis::Connection::ListDirection::RIGHT, Redis::Connection::ListDirection::LEFT, value) );
+    CPPUNIT_ASSERT( value == "12" );
+    CPPUNIT_ASSERT( connection.rpoplpush("test_list_other", "test_list", value) && value == "12" );
+    CPPUNIT_ASSERT( connection.blmove("test_list_missing", "test_list", Redis::Connection::ListDirection::RIGHT, Redis::Connection::ListDirection::LEFT, 1, value) );
+    CPPUNIT_ASSERT( value.empty() );
+    CPPUNIT_ASSERT( connection.lpop("test_list_missing", value) && value.empty() );
+    CPPUNIT_ASSERT( connection.lpop("test_list_missing", 10, popped) && popped.empty() );
+    CPPUNIT_ASSERT( connection.del("test_list") );
+
+    // reliable queue keeps popped items until they are acknowledged
+    Redis::ListQueue::Options options;
+    options.processing_list = "test_list_queue:processing";
+    Redis::ListQueue queue("test_list_queue", Redis::ConnectionParam(), options);
+    CPPUNIT_ASSERT( connection.del("test_list_queue") && connection.del(options.processing_list) );
+    CPPUNIT_ASSERT( queue.push(values) && queue.push("last") );
+    CPPUNIT_ASSERT( queue.size(length) && length == 2501 );
+    std::vector<std::string> items;
+    CPPUNIT_ASSERT_MESSAGE( queue.get_error(), queue.pop(100, -1, items) && items.size() == 100 );
+    CPPUNIT_ASSERT( items.front() == "0" && items.back() == "99" );
+    size_t acknowledged = 0;
+    CPPUNIT_ASSERT( queue.ack(std::vector<std::string>(items.begin(), items.begin() + 60), acknowledged) && acknowledged == 60 );
+    CPPUNIT_ASSERT( connection.llen(options.processing_list, length) && length == 40 );
+
+    // unacknowledged items go back to the queue
+    size_t recovered = 0;
+    CPPUNIT_ASSERT( queue.recover(recovered) && recovered == 40 );
+    CPPUNIT_ASSERT( queue.size(length) && length == 2441 );
+    size_t total = 0;
+    while(queue.pop(1000, -1, items) && !items.empty()) {
+        total += items.size();
+        CPPUNIT_ASSERT( queue.ack(items) );
+    }
+    CPPUNIT_ASSERT( total == 2441 && items.empty() && queue.get_error().empty() );
+    CPPUNIT_ASSERT( connection.llen(options.processing_list, length) && length == 0 );
+
+    // blocked consumer wakes up on push without holding a pooled connection
+    Redis::ListQueue plain("test_list_queue");
+    std::thread producer([]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        Redis::ListQueue("test_list_queue").push(std::vector<std::string>({"a", "b"}));
+    });
+    CPPUNIT_ASSERT( plain.pop(10, 5, items) && !items.empty() && items.front() == "a" );
+    producer.join();
+    CPPUNIT_ASSERT( queue.pop(10, 1, items) && items == std::vector<std::string>({"b"}) && queue.ack(items) );
+    CPPUNIT_ASSERT( plain.pop(10, -1, items) && items.empty() );
+    CPPUNIT_ASSERT( connection.del("test_list_queue") && connection.del(options.processing_list) && connection.del("test_list_other") );
 }
\ No newline at end of file
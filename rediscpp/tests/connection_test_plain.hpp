@@ -2,7 +2,39 @@
 #include "connection_test_abstract.hpp"
 class ConnectionTestPlain : public ConnectionTestAbstract {
     CPPUNIT_TEST_SUB_SUITE(ConnectionTestPlain, ConnectionTestAbstract);
+        CPPUNIT_TEST( test_hedged_read );
+        CPPUNIT_TEST( test_single_flight );
+        CPPUNIT_TEST( test_auto_batcher );
+        CPPUNIT_TEST( test_multiplexed_connection );
+        CPPUNIT_TEST( test_named_pool_warm_up );
+        CPPUNIT_TEST( test_pool_socket_sharing );
+        CPPUNIT_TEST( test_deadline );
+        CPPUNIT_TEST( test_admission_control );
+        CPPUNIT_TEST( test_script );
+        CPPUNIT_TEST( test_lock );
+        CPPUNIT_TEST( test_rate_limiter );
+        CPPUNIT_TEST( test_bloom_filter );
+        CPPUNIT_TEST( test_bitfield );
+        CPPUNIT_TEST( test_hyperloglog );
+        CPPUNIT_TEST( test_streams );
+        CPPUNIT_TEST( test_list_queue );
     CPPUNIT_TEST_SUITE_END();
     protected:
         virtual Redis::Connection get_connection();
+        void test_hedged_read();
+        void test_single_flight();
+        void test_auto_batcher();
+        void test_multiplexed_connection();
+        void test_named_pool_warm_up();
+        void test_pool_socket_sharing();
+        void test_deadline();
+        void test_admission_control();
+        void test_script();
+        void test_lock();
+        void test_rate_limiter();
+        void test_bloom_filter();
+        void test_bitfield();
+        void test_hyperloglog();
+        void test_streams();
+        void test_list_queue();
 };
\ No newline at end of file
@@ -0,0 +1,6 @@
+#include "connection_test_unix.hpp"
+CPPUNIT_TEST_SUITE_REGISTRATION( ConnectionTestUnix );
+//Path should match unixsocket in tests/redis.conf
+Redis::Connection ConnectionTestUnix::get_connection() {
+    return Redis::Connection("unix:/tmp/rediscpp_test.sock");
+}
\ No newline at end of file
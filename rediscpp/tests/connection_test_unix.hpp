@@ -0,0 +1,8 @@
+#pragma once
+#include "connection_test_abstract.hpp"
+class ConnectionTestUnix : public ConnectionTestAbstract {
+    CPPUNIT_TEST_SUB_SUITE(ConnectionTestUnix, ConnectionTestAbstract);
+    CPPUNIT_TEST_SUITE_END();
+    protected:
+        virtual Redis::Connection get_connection();
+};
\ No newline at end of file
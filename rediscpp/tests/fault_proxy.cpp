@@ -0,0 +1,421 @@
+#include "fault_proxy.hpp"
+#include "../exception.hpp"
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+namespace Redis {
+    namespace {
+        typedef std::chrono::steady_clock Clock;
+
+        void set_nodelay(int fd) {
+            int nodelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        }
+
+        /* Closes socket with RST instead of FIN */
+        void reset_socket(int fd) {
+            struct linger linger;
+            linger.l_onoff = 1;
+            linger.l_linger = 0;
+            setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+            close(fd);
+        }
+
+        bool send_all(int fd, const char* data, size_t size) {
+            size_t sent = 0;
+            while(sent < size) {
+                ssize_t ret = send(fd, data + sent, size - sent, MSG_NOSIGNAL);
+                if(ret < 0 && errno == EINTR) {
+                    continue;
+                }
+                if(ret <= 0) {
+                    return false;
+                }
+                sent += static_cast<size_t>(ret);
+            }
+            return true;
+        }
+    }
+
+    class FaultProxy::Impl {
+        friend class FaultProxy;
+        //Proxy stops reading from peer which sends faster than faults let through
+        static constexpr size_t max_buffered = 4 * 1024 * 1024;
+        static constexpr int tick_ms = 10;
+
+        struct Chunk {
+            Clock::time_point release;
+            std::string data;
+            size_t offset;
+        };
+
+        /* One way of proxied connection */
+        struct Direction {
+            int from;
+            int to;
+            bool is_reply;
+            bool eof;
+            std::deque<Chunk> queue;
+            size_t buffered;
+            Clock::time_point next_send;
+            Direction(int _from, int _to, bool _is_reply) : from(_from), to(_to), is_reply(_is_reply), eof(false), queue(), buffered(0), next_send() {}
+        };
+
+        struct Client {
+            std::thread thread;
+            std::shared_ptr<std::atomic<bool>> done;
+            Client(std::thread&& _thread, std::shared_ptr<std::atomic<bool>> _done) : thread(std::move(_thread)), done(_done) {}
+        };
+
+        std::string upstream_host;
+        unsigned int upstream_port;
+        int listen_fd;
+        unsigned int port;
+        std::atomic<bool> stopping;
+        mutable std::mutex faults_lock;
+        Faults faults;
+        std::vector<Phase> schedule;
+        bool repeat;
+        Clock::time_point schedule_start;
+        std::atomic<unsigned long long> reset_generation;
+        std::atomic<unsigned long long> accepted_count;
+        std::atomic<unsigned long long> reset_count;
+        std::atomic<unsigned long long> truncated_count;
+        std::map<unsigned long long, Client> clients;
+        std::thread accept_thread;
+
+        Impl(const std::string& _upstream_host, unsigned int _upstream_port, unsigned int _port) :
+            upstream_host(_upstream_host),
+            upstream_port(_upstream_port),
+            listen_fd(-1),
+            port(_port),
+            stopping(false),
+            faults_lock(),
+            faults(),
+            schedule(),
+            repeat(false),
+            schedule_start(),
+            reset_generation(0),
+            accepted_count(0),
+            reset_count(0),
+            truncated_count(0),
+            clients(),
+            accept_thread()
+        {
+            listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+            if(listen_fd < 0) {
+                throw Redis::Exception(std::string("FaultProxy: could not create socket: ") + std::strerror(errno));
+            }
+            int reuse = 1;
+            setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            struct sockaddr_in addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(static_cast<uint16_t>(port));
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t addr_size = sizeof(addr);
+            if(bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), addr_size) != 0 ||
+                    listen(listen_fd, 512) != 0 ||
+                    getsockname(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), &addr_size) != 0) {
+                std::string error = std::strerror(errno);
+                close(listen_fd);
+                throw Redis::Exception("FaultProxy: could not listen on port " + std::to_string(port) + ": " + error);
+            }
+            port = ntohs(addr.sin_port);
+            accept_thread = std::thread(&Impl::accept_loop, this);
+        }
+
+        ~Impl() {
+            stopping = true;
+            accept_thread.join();
+            close(listen_fd);
+            for(auto& client : clients) {
+                client.second.thread.join();
+            }
+        }
+
+        Faults current_faults(int* phase = nullptr) const {
+            std::lock_guard<std::mutex> guard(faults_lock);
+            if(schedule.empty()) {
+                if(phase != nullptr) {
+                    *phase = -1;
+                }
+                return faults;
+            }
+            unsigned long long total_ms = 0;
+            for(size_t i = 0; i < schedule.size(); i++) {
+                total_ms += schedule[i].duration_ms;
+            }
+            unsigned long long elapsed_ms = static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - schedule_start).count());
+            if(repeat && total_ms != 0) {
+                elapsed_ms %= total_ms;
+            }
+            size_t current = 0;
+            while(current + 1 < schedule.size() && elapsed_ms >= schedule[current].duration_ms) {
+                elapsed_ms -= schedule[current].duration_ms;
+                current++;
+            }
+            if(phase != nullptr) {
+                *phase = static_cast<int>(current);
+            }
+            return schedule[current].faults;
+        }
+
+        int connect_upstream() {
+            struct addrinfo hints;
+            std::memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            struct addrinfo* addresses = nullptr;
+            if(getaddrinfo(upstream_host.c_str(), std::to_string(upstream_port).c_str(), &hints, &addresses) != 0) {
+                return -1;
+            }
+            int fd = -1;
+            for(struct addrinfo* address = addresses; address != nullptr && fd < 0; address = address->ai_next) {
+                fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+                if(fd >= 0 && connect(fd, address->ai_addr, address->ai_addrlen) != 0) {
+                    close(fd);
+                    fd = -1;
+                }
+            }
+            freeaddrinfo(addresses);
+            if(fd >= 0) {
+                set_nodelay(fd);
+            }
+            return fd;
+        }
+
+        /* Joins threads of closed connections */
+        void reap_clients() {
+            for(auto it = clients.begin(); it != clients.end();) {
+                if(it->second.done->load()) {
+                    it->second.thread.join();
+                    it = clients.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+        }
+
+        void accept_loop() {
+            unsigned long long client_id = 0;
+            while(!stopping) {
+                struct pollfd pfd;
+                pfd.fd = listen_fd;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+                if(poll(&pfd, 1, 50) <= 0) {
+                    continue;
+                }
+                int fd = accept(listen_fd, nullptr, nullptr);
+                if(fd < 0) {
+                    continue;
+                }
+                accepted_count++;
+                reap_clients();
+                if(current_faults().reset) {
+                    reset_socket(fd);
+                    reset_count++;
+                    continue;
+                }
+                set_nodelay(fd);
+                std::shared_ptr<std::atomic<bool>> done = std::make_shared<std::atomic<bool>>(false);
+                clients.emplace(client_id++, Client(std::thread(&Impl::serve, this, fd, done), done));
+            }
+        }
+
+        /* Reads what peer sent. Returns false on error */
+        bool receive(Direction& direction, const Faults& current, Clock::time_point now) {
+            char buffer[16384];
+            ssize_t size = recv(direction.from, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if(size < 0) {
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            }
+            if(size == 0) {
+                direction.eof = true;
+                return true;
+            }
+            direction.queue.push_back(Chunk{now + std::chrono::microseconds(current.latency_us), std::string(buffer, static_cast<size_t>(size)), 0});
+            direction.buffered += static_cast<size_t>(size);
+            return true;
+        }
+
+        /* Forwards bytes which are due. 1 - ok, 0 - connection should be closed, -1 - reply was truncated */
+        int forward(Direction& direction, const Faults& current, Clock::time_point now) {
+            while(!current.stall && !direction.queue.empty() && direction.queue.front().release <= now && direction.next_send <= now) {
+                Chunk& chunk = direction.queue.front();
+                size_t size = chunk.data.size() - chunk.offset;
+                if(current.bandwidth_bytes_per_s != 0) {
+                    //Small slices keep throughput smooth
+                    size = std::min(size, std::max<size_t>(current.bandwidth_bytes_per_s / 100, 1));
+                }
+                bool truncate = direction.is_reply && current.truncate_reply_bytes != 0;
+                if(truncate) {
+                    size = std::min(size, static_cast<size_t>(current.truncate_reply_bytes));
+                }
+                if(!send_all(direction.to, chunk.data.data() + chunk.offset, size)) {
+                    return 0;
+                }
+                if(truncate) {
+                    return -1;
+                }
+                if(current.bandwidth_bytes_per_s != 0) {
+                    direction.next_send = std::max(direction.next_send, now) + std::chrono::microseconds(static_cast<long long>(size * 1000000 / current.bandwidth_bytes_per_s));
+                }
+                chunk.offset += size;
+                direction.buffered -= size;
+                if(chunk.offset == chunk.data.size()) {
+                    direction.queue.pop_front();
+                }
+            }
+            return 1;
+        }
+
+        void serve(int client_fd, std::shared_ptr<std::atomic<bool>> done) {
+            int upstream_fd = connect_upstream();
+            if(upstream_fd < 0) {
+                reset_socket(client_fd);
+                done->store(true);
+                return;
+            }
+            unsigned long long generation = reset_generation.load();
+            Direction directions[2] = {Direction(client_fd, upstream_fd, false), Direction(upstream_fd, client_fd, true)};
+            bool reset = false;
+            while(!stopping) {
+                Faults current = current_faults();
+                if(current.reset || reset_generation.load() != generation) {
+                    reset = true;
+                    reset_count++;
+                    break;
+                }
+                Clock::time_point now = Clock::now();
+                int result = 1;
+                for(size_t i = 0; i < 2 && result == 1; i++) {
+                    result = forward(directions[i], current, now);
+                }
+                if(result == -1) {
+                    reset = true;
+                    truncated_count++;
+                    break;
+                }
+                if(result == 0 || ((directions[0].eof || directions[1].eof) && directions[0].queue.empty() && directions[1].queue.empty())) {
+                    break;
+                }
+                //Wait for data or for the moment held bytes are due
+                int wait_ms = tick_ms;
+                struct pollfd fds[2];
+                for(size_t i = 0; i < 2; i++) {
+                    Direction& direction = directions[i];
+                    fds[i].fd = direction.from;
+                    fds[i].events = static_cast<short>(!direction.eof && direction.buffered < max_buffered ? POLLIN : 0);
+                    fds[i].revents = 0;
+                    if(!current.stall && !direction.queue.empty()) {
+                        Clock::time_point due = std::max(direction.queue.front().release, direction.next_send);
+                        long long due_ms = std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count();
+                        wait_ms = static_cast<int>(std::max(0LL, std::min(due_ms, static_cast<long long>(wait_ms))));
+                    }
+                }
+                if(poll(fds, 2, wait_ms) < 0 && errno != EINTR) {
+                    break;
+                }
+                now = Clock::now();
+                bool ok = true;
+                for(size_t i = 0; i < 2 && ok; i++) {
+                    if(fds[i].revents != 0) {
+                        ok = receive(directions[i], current, now);
+                    }
+                }
+                if(!ok) {
+                    break;
+                }
+            }
+            if(reset) {
+                reset_socket(client_fd);
+                reset_socket(upstream_fd);
+            }
+            else {
+                close(client_fd);
+                close(upstream_fd);
+            }
+            done->store(true);
+        }
+    };
+    constexpr size_t FaultProxy::Impl::max_buffered;
+    constexpr int FaultProxy::Impl::tick_ms;
+
+    FaultProxy::FaultProxy(const std::string& upstream_host, unsigned int upstream_port, unsigned int port) :
+        d(new FaultProxy::Impl(upstream_host, upstream_port, port))
+    {}
+
+    FaultProxy::~FaultProxy() {
+        if(d != nullptr) {
+            delete d;
+        }
+    }
+
+    unsigned int FaultProxy::get_port() const {
+        return d->port;
+    }
+
+    ConnectionParam FaultProxy::get_connection_param(const ConnectionParam& param) const {
+        ConnectionParam result(param);
+        result.host = "127.0.0.1";
+        result.port = d->port;
+        return result;
+    }
+
+    void FaultProxy::set_faults(const Faults& faults) {
+        std::lock_guard<std::mutex> guard(d->faults_lock);
+        d->faults = faults;
+        d->schedule.clear();
+    }
+
+    void FaultProxy::set_schedule(const std::vector<Phase>& phases, bool repeat) {
+        std::lock_guard<std::mutex> guard(d->faults_lock);
+        d->schedule = phases;
+        d->repeat = repeat;
+        d->schedule_start = Clock::now();
+    }
+
+    FaultProxy::Faults FaultProxy::get_faults() const {
+        return d->current_faults();
+    }
+
+    int FaultProxy::get_phase() const {
+        int phase = -1;
+        d->current_faults(&phase);
+        return phase;
+    }
+
+    void FaultProxy::reset_all() {
+        d->reset_generation++;
+    }
+
+    unsigned long long FaultProxy::get_accepted_count() const {
+        return d->accepted_count.load();
+    }
+
+    unsigned long long FaultProxy::get_reset_count() const {
+        return d->reset_count.load();
+    }
+
+    unsigned long long FaultProxy::get_truncated_count() const {
+        return d->truncated_count.load();
+    }
+}
\ No newline at end of file
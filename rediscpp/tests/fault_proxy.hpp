@@ -0,0 +1,75 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "../connection_param.hpp"
+namespace Redis {
+    /**
+    * TCP proxy between client and redis (or MockServer) which injects network faults, for testing reconnect and timeout paths.
+    * Unlike MockServer faults, these happen below RESP: delayed and throttled bytes, sockets that stay open but go silent,
+    * connections reset by peer and replies cut in the middle.
+    * Faults can be switched by hand or follow a schedule of phases. Each client connection is served by its own thread.
+    *
+    *  F.e. :
+    *  Redis::FaultProxy proxy("127.0.0.1", 6379);
+    *  Redis::FaultProxy::Faults stall;
+    *  stall.stall = true;
+    *  proxy.set_schedule({{1000, Redis::FaultProxy::Faults()}, {500, stall}, {1000, Redis::FaultProxy::Faults()}});
+    *  Redis::Connection conn(proxy.get_connection_param());
+    * */
+    class FaultProxy {
+    public:
+        struct Faults {
+            //Delay of bytes in each direction
+            unsigned int latency_us;
+            //Throughput cap of each direction of each connection, 0 - unlimited
+            unsigned int bandwidth_bytes_per_s;
+            //Bytes are held until stall ends, sockets stay open, as with peer lost without FIN
+            bool stall;
+            //Existing connections are reset with RST and new ones are reset right after accept, as with restarting server
+            bool reset;
+            //Each chunk of reply is cut to this many bytes and connection is closed after it, 0 - disabled
+            unsigned int truncate_reply_bytes;
+            Faults() : latency_us(0), bandwidth_bytes_per_s(0), stall(false), reset(false), truncate_reply_bytes(0) {}
+        };
+
+        struct Phase {
+            unsigned int duration_ms;
+            Faults faults;
+            Phase(unsigned int _duration_ms = 0, const Faults& _faults = Faults()) : duration_ms(_duration_ms), faults(_faults) {}
+        };
+
+        /* port 0 picks a free one. Throws if port can't be bound */
+        FaultProxy(const std::string& upstream_host, unsigned int upstream_port, unsigned int port = 0);
+        ~FaultProxy();
+        FaultProxy(const FaultProxy& other) = delete;
+        FaultProxy& operator=(const FaultProxy& other) = delete;
+
+        unsigned int get_port() const;
+
+        /* Copy of param pointed at the proxy */
+        ConnectionParam get_connection_param(const ConnectionParam& param = ConnectionParam()) const;
+
+        /* Replaces faults and cancels schedule */
+        void set_faults(const Faults& faults);
+
+        /* Phases start right away one after another. The last one stays in effect, unless schedule repeats */
+        void set_schedule(const std::vector<Phase>& phases, bool repeat = false);
+
+        /* Faults in effect right now */
+        Faults get_faults() const;
+
+        /* Index of current phase of schedule, -1 if there is no schedule */
+        int get_phase() const;
+
+        /* Resets all open connections once */
+        void reset_all();
+
+        unsigned long long get_accepted_count() const;
+        unsigned long long get_reset_count() const;
+        unsigned long long get_truncated_count() const;
+
+    private:
+        class Impl;
+        Impl* d;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include "fault_proxy.hpp"
+/*
+* Standalone fault injecting proxy in front of redis.
+* Usage: fault_proxy port upstream_host upstream_port [--repeat] [phase ...]
+*
+* Phase is duration_ms[:fault,fault...], faults are:
+*   latency=US bandwidth=BYTES_PER_S truncate=BYTES stall reset
+* F.e. proxy which is healthy for 5s, then stalls for 1s, then resets everything for 2s, in loop:
+*   fault_proxy 6380 127.0.0.1 6379 --repeat 5000 1000:stall 2000:reset
+*/
+
+static bool parse_phase(const std::string& str, Redis::FaultProxy::Phase& phase) {
+    size_t colon = str.find(':');
+    phase.duration_ms = static_cast<unsigned int>(std::strtoul(str.substr(0, colon).c_str(), nullptr, 10));
+    phase.faults = Redis::FaultProxy::Faults();
+    while(colon != std::string::npos) {
+        size_t next = str.find(',', colon + 1);
+        std::string fault = str.substr(colon + 1, next == std::string::npos ? std::string::npos : next - colon - 1);
+        size_t eq = fault.find('=');
+        std::string name = fault.substr(0, eq);
+        unsigned int value = eq == std::string::npos ? 0 : static_cast<unsigned int>(std::strtoul(fault.substr(eq + 1).c_str(), nullptr, 10));
+        if(name == "latency") {
+            phase.faults.latency_us = value;
+        }
+        else if(name == "bandwidth") {
+            phase.faults.bandwidth_bytes_per_s = value;
+        }
+        else if(name == "truncate") {
+            phase.faults.truncate_reply_bytes = value;
+        }
+        else if(name == "stall") {
+            phase.faults.stall = true;
+        }
+        else if(name == "reset") {
+            phase.faults.reset = true;
+        }
+        else {
+            std::cerr << "Unknown fault: " << fault << std::endl;
+            return false;
+        }
+        colon = next;
+    }
+    return true;
+}
+
+int main(int argc, const char** argv)
+{
+    if(argc < 4) {
+        std::cerr << "Usage: fault_proxy port upstream_host upstream_port [--repeat] [duration_ms[:fault,...] ...]" << std::endl;
+        return 1;
+    }
+    bool repeat = false;
+    std::vector<Redis::FaultProxy::Phase> phases;
+    for(int i = 4; i < argc; i++) {
+        Redis::FaultProxy::Phase phase;
+        if(std::string(argv[i]) == "--repeat") {
+            repeat = true;
+        }
+        else if(parse_phase(argv[i], phase)) {
+            phases.push_back(phase);
+        }
+        else {
+            return 1;
+        }
+    }
+    Redis::FaultProxy proxy(argv[2], static_cast<unsigned int>(std::atoi(argv[3])), static_cast<unsigned int>(std::atoi(argv[1])));
+    if(!phases.empty()) {
+        proxy.set_schedule(phases, repeat);
+    }
+    std::cout << "Proxying 127.0.0.1:" << proxy.get_port() << " to " << argv[2] << ":" << argv[3] << std::endl;
+    int phase = -2;
+    while(true) {
+        if(proxy.get_phase() != phase) {
+            phase = proxy.get_phase();
+            std::cout << "phase " << phase << ", connections accepted " << proxy.get_accepted_count()
+                    << ", reset " << proxy.get_reset_count() << ", truncated " << proxy.get_truncated_count() << std::endl;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,2141 @@
+#include "mock_server.hpp"
+#include "../exception.hpp"
+#include <map>
+#include <set>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <memory>
+#include <functional>
+#include <limits>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cctype>
+#include <cmath>
+#include <unistd.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+namespace Redis {
+    namespace {
+        typedef std::vector<std::string> Args;
+        typedef std::chrono::steady_clock Clock;
+        static constexpr size_t db_count = 16;
+        static constexpr const char* server_version = "6.2.0";
+
+        /* Error reply of command. Thrown by argument and type checks, caught by dispatcher */
+        struct CommandError {
+            std::string message;
+        };
+
+        long long now_ms() {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        std::string to_upper(const std::string& str) {
+            std::string result(str);
+            std::transform(result.begin(), result.end(), result.begin(), ::toupper);
+            return result;
+        }
+
+        bool parse_integer(const std::string& str, long long& value) {
+            if(str.empty() || str.size() > 20 || std::isspace(static_cast<unsigned char>(str[0])) || str[0] == '+') {
+                return false;
+            }
+            errno = 0;
+            char* end = nullptr;
+            value = std::strtoll(str.c_str(), &end, 10);
+            return errno == 0 && end == str.c_str() + str.size();
+        }
+
+        bool parse_float(const std::string& str, long double& value) {
+            if(str.empty() || std::isspace(static_cast<unsigned char>(str[0]))) {
+                return false;
+            }
+            errno = 0;
+            char* end = nullptr;
+            value = std::strtold(str.c_str(), &end);
+            return errno == 0 && end == str.c_str() + str.size() && !std::isnan(value);
+        }
+
+        long long arg_integer(const std::string& str) {
+            long long value = 0;
+            if(!parse_integer(str, value)) {
+                throw CommandError{"ERR value is not an integer or out of range"};
+            }
+            return value;
+        }
+
+        long double arg_float(const std::string& str) {
+            long double value = 0;
+            if(!parse_float(str, value)) {
+                throw CommandError{"ERR value is not a valid float"};
+            }
+            return value;
+        }
+
+        /* Same as redis: fixed notation without trailing zeros */
+        std::string format_float(long double value) {
+            char buffer[128];
+            int size = std::snprintf(buffer, sizeof(buffer), "%.17Lf", value);
+            std::string result(buffer, size < 0 ? 0 : static_cast<size_t>(size));
+            if(result.find('.') != std::string::npos) {
+                while(!result.empty() && result.back() == '0') {
+                    result.pop_back();
+                }
+                if(!result.empty() && result.back() == '.') {
+                    result.pop_back();
+                }
+            }
+            return result;
+        }
+
+        std::string format_score(double value) {
+            char buffer[64];
+            int size = std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+            return std::string(buffer, size < 0 ? 0 : static_cast<size_t>(size));
+        }
+
+        /* Glob style pattern of KEYS and SCAN: *, ?, [abc], [^a-z] and \ escapes */
+        bool glob_match(const char* pattern, const char* pattern_end, const char* str, const char* str_end) {
+            while(pattern != pattern_end) {
+                switch(*pattern) {
+                    case '*':
+                        while(pattern + 1 != pattern_end && pattern[1] == '*') {
+                            pattern++;
+                        }
+                        if(pattern + 1 == pattern_end) {
+                            return true;
+                        }
+                        for(const char* s = str; s <= str_end; s++) {
+                            if(glob_match(pattern + 1, pattern_end, s, str_end)) {
+                                return true;
+                            }
+                        }
+                        return false;
+                    case '?':
+                        if(str == str_end) {
+                            return false;
+                        }
+                        str++;
+                        break;
+                    case '[': {
+                        if(str == str_end) {
+                            return false;
+                        }
+                        pattern++;
+                        bool negate = pattern != pattern_end && *pattern == '^';
+                        if(negate) {
+                            pattern++;
+                        }
+                        bool matched = false;
+                        while(pattern != pattern_end && *pattern != ']') {
+                            if(*pattern == '\\' && pattern + 1 != pattern_end) {
+                                pattern++;
+                                matched = matched || *pattern == *str;
+                            }
+                            else if(pattern + 2 < pattern_end && pattern[1] == '-') {
+                                char from = std::min(pattern[0], pattern[2]);
+                                char to = std::max(pattern[0], pattern[2]);
+                                matched = matched || (*str >= from && *str <= to);
+                                pattern += 2;
+                            }
+                            else {
+                                matched = matched || *pattern == *str;
+                            }
+                            pattern++;
+                        }
+                        if(matched == negate) {
+                            return false;
+                        }
+                        if(pattern == pattern_end) {
+                            return true;
+                        }
+                        str++;
+                        break;
+                    }
+                    case '\\':
+                        if(pattern + 1 != pattern_end) {
+                            pattern++;
+                        }
+                        //fall through
+                    default:
+                        if(str == str_end || *pattern != *str) {
+                            return false;
+                        }
+                        str++;
+                        break;
+                }
+                pattern++;
+            }
+            return str == str_end;
+        }
+
+        bool glob_match(const std::string& pattern, const std::string& str) {
+            return glob_match(pattern.data(), pattern.data() + pattern.size(), str.data(), str.data() + str.size());
+        }
+
+        void reply_status(std::string& out, const char* status) {
+            out.push_back('+');
+            out.append(status);
+            out.append("\r\n");
+        }
+
+        void reply_error(std::string& out, const std::string& error) {
+            out.push_back('-');
+            out.append(error);
+            out.append("\r\n");
+        }
+
+        void reply_integer(std::string& out, long long value) {
+            out.push_back(':');
+            out.append(std::to_string(value));
+            out.append("\r\n");
+        }
+
+        void reply_bulk(std::string& out, const std::string& value) {
+            out.push_back('$');
+            out.append(std::to_string(value.size()));
+            out.append("\r\n");
+            out.append(value);
+            out.append("\r\n");
+        }
+
+        void reply_nil(std::string& out) {
+            out.append("$-1\r\n");
+        }
+
+        void reply_nil_array(std::string& out) {
+            out.append("*-1\r\n");
+        }
+
+        void reply_array(std::string& out, size_t size) {
+            out.push_back('*');
+            out.append(std::to_string(size));
+            out.append("\r\n");
+        }
+
+        /* Reads number terminated by CRLF. 1 - done, 0 - more data is needed, -1 - protocol error */
+        int read_number(const std::string& in, size_t& pos, long long& value) {
+            size_t end = in.find("\r\n", pos);
+            if(end == std::string::npos) {
+                return in.size() - pos > 32 ? -1 : 0;
+            }
+            if(!parse_integer(in.substr(pos, end - pos), value)) {
+                return -1;
+            }
+            pos = end + 2;
+            return 1;
+        }
+
+        /* Parses one multibulk command. 1 - done, 0 - more data is needed, -1 - protocol error */
+        int parse_command(const std::string& in, size_t& pos, Args& args) {
+            static constexpr long long max_args = 1024 * 1024;
+            static constexpr long long max_bulk_size = 512 * 1024 * 1024;
+            size_t p = pos;
+            if(p >= in.size()) {
+                return 0;
+            }
+            if(in[p] != '*') {
+                return -1;
+            }
+            p++;
+            long long count = 0;
+            int ret = read_number(in, p, count);
+            if(ret != 1) {
+                return ret;
+            }
+            if(count <= 0 || count > max_args) {
+                return -1;
+            }
+            args.clear();
+            args.reserve(static_cast<size_t>(count));
+            for(long long i = 0; i < count; i++) {
+                if(p >= in.size()) {
+                    return 0;
+                }
+                if(in[p] != '$') {
+                    return -1;
+                }
+                p++;
+                long long size = 0;
+                ret = read_number(in, p, size);
+                if(ret != 1) {
+                    return ret;
+                }
+                if(size < 0 || size > max_bulk_size) {
+                    return -1;
+                }
+                if(in.size() < p + static_cast<size_t>(size) + 2) {
+                    return 0;
+                }
+                if(in[p + static_cast<size_t>(size)] != '\r' || in[p + static_cast<size_t>(size) + 1] != '\n') {
+                    return -1;
+                }
+                args.emplace_back(in, p, static_cast<size_t>(size));
+                p += static_cast<size_t>(size) + 2;
+            }
+            pos = p;
+            return 1;
+        }
+
+        bool send_all(int fd, const std::string& data) {
+            size_t sent = 0;
+            while(sent < data.size()) {
+                ssize_t ret = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+                if(ret < 0 && errno == EINTR) {
+                    continue;
+                }
+                if(ret <= 0) {
+                    return false;
+                }
+                sent += static_cast<size_t>(ret);
+            }
+            return true;
+        }
+    }
+
+    class MockServer::Impl {
+        friend class MockServer;
+        enum class Type { STRING, HASH, SET, ZSET, LIST };
+        struct Entry {
+            Type type;
+            std::string str;
+            std::map<std::string, std::string> hash;
+            std::set<std::string> set;
+            std::map<std::string, double> zset;
+            std::set<std::pair<double, std::string>> zset_order;
+            std::deque<std::string> list;
+            //Unix time in ms, 0 if key doesn't expire
+            long long expire_at;
+            Entry(Type _type) : type(_type), str(), hash(), set(), zset(), zset_order(), list(), expire_at(0) {}
+
+            bool is_expired(long long now) const {
+                return expire_at != 0 && expire_at <= now;
+            }
+
+            bool is_empty() const {
+                switch(type) {
+                    case Type::HASH: return hash.empty();
+                    case Type::SET: return set.empty();
+                    case Type::ZSET: return zset.empty();
+                    case Type::LIST: return list.empty();
+                    default: return false;
+                }
+            }
+        };
+        typedef std::map<std::string, Entry> Db;
+
+        struct Session {
+            int fd;
+            size_t db;
+            bool quit;
+            bool authenticated;
+            //Subscribed to +switch-master, replies are written under sentinel_lock
+            bool subscribed;
+            std::mt19937 random;
+            Session(int _fd, unsigned int seed) : fd(_fd), db(0), quit(false), authenticated(false), subscribed(false), random(seed) {}
+        };
+
+        struct Context {
+            const Args& args;
+            Session& session;
+            std::string& out;
+            std::unique_lock<std::mutex>& lock;
+        };
+
+        typedef void (Impl::*Handler)(Context&);
+        struct Command {
+            Handler handler;
+            //Negative arity is minimal number of arguments, as in COMMAND reply
+            int arity;
+        };
+
+        struct FaultConfig {
+            Faults all;
+            std::map<std::string, Faults> commands;
+            FaultConfig() : all(), commands() {}
+        };
+
+        struct Client {
+            int fd;
+            std::thread thread;
+            std::shared_ptr<std::atomic<bool>> done;
+            Client(int _fd, std::thread&& _thread, std::shared_ptr<std::atomic<bool>> _done) : fd(_fd), thread(std::move(_thread)), done(_done) {}
+        };
+
+        int listen_fd;
+        unsigned int port;
+        unsigned int seed;
+        std::atomic<bool> stopping;
+        std::map<std::string, Command> commands;
+        std::shared_ptr<const FaultConfig> faults;
+        std::mutex faults_lock;
+        std::vector<Db> dbs;
+        std::mutex store_lock;
+        std::condition_variable list_pushed;
+        std::map<unsigned long long, Client> clients;
+        mutable std::mutex clients_lock;
+        std::atomic<unsigned long long> command_count;
+        std::atomic<unsigned long long> accepted_count;
+        //Required by AUTH if not empty. Guarded by store_lock
+        std::string password;
+        //Masters announced as sentinel and descriptors of clients subscribed to their switches
+        std::map<std::string, std::pair<std::string, unsigned int>> sentinel_masters;
+        std::set<int> sentinel_subscribers;
+        std::mutex sentinel_lock;
+        std::thread accept_thread;
+
+        Impl(unsigned int _port, unsigned int _seed) :
+            listen_fd(-1),
+            port(_port),
+            seed(_seed),
+            stopping(false),
+            commands(),
+            faults(std::make_shared<FaultConfig>()),
+            faults_lock(),
+            dbs(db_count),
+            store_lock(),
+            list_pushed(),
+            clients(),
+            clients_lock(),
+            command_count(0),
+            accepted_count(0),
+            password(),
+            sentinel_masters(),
+            sentinel_subscribers(),
+            sentinel_lock(),
+            accept_thread()
+        {
+            register_commands();
+            listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+            if(listen_fd < 0) {
+                throw Redis::Exception(std::string("MockServer: could not create socket: ") + std::strerror(errno));
+            }
+            int reuse = 1;
+            setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            struct sockaddr_in addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(static_cast<uint16_t>(port));
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            socklen_t addr_size = sizeof(addr);
+            if(bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), addr_size) != 0 ||
+                    listen(listen_fd, 512) != 0 ||
+                    getsockname(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), &addr_size) != 0) {
+                std::string error = std::strerror(errno);
+                close(listen_fd);
+                throw Redis::Exception("MockServer: could not listen on port " + std::to_string(port) + ": " + error);
+            }
+            port = ntohs(addr.sin_port);
+            accept_thread = std::thread(&Impl::accept_loop, this);
+        }
+
+        ~Impl() {
+            stopping = true;
+            {
+                std::lock_guard<std::mutex> guard(store_lock);
+                list_pushed.notify_all();
+            }
+            accept_thread.join();
+            close(listen_fd);
+            std::lock_guard<std::mutex> guard(clients_lock);
+            for(auto& client : clients) {
+                shutdown(client.second.fd, SHUT_RDWR);
+            }
+            for(auto& client : clients) {
+                client.second.thread.join();
+                close(client.second.fd);
+            }
+        }
+
+        /* Joins threads of disconnected clients. clients_lock should be held */
+        void reap_clients() {
+            for(auto it = clients.begin(); it != clients.end();) {
+                if(it->second.done->load()) {
+                    it->second.thread.join();
+                    close(it->second.fd);
+                    it = clients.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+        }
+
+        void accept_loop() {
+            unsigned long long client_id = 0;
+            while(!stopping) {
+                struct pollfd pfd;
+                pfd.fd = listen_fd;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+                if(poll(&pfd, 1, 50) <= 0) {
+                    continue;
+                }
+                int fd = accept(listen_fd, nullptr, nullptr);
+                if(fd < 0) {
+                    continue;
+                }
+                int nodelay = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+                accepted_count++;
+                std::lock_guard<std::mutex> guard(clients_lock);
+                reap_clients();
+                std::shared_ptr<std::atomic<bool>> done = std::make_shared<std::atomic<bool>>(false);
+                unsigned int client_seed = seed + static_cast<unsigned int>(client_id);
+                clients.emplace(client_id++, Client(fd, std::thread(&Impl::serve, this, fd, client_seed, done), done));
+            }
+        }
+
+        void serve(int fd, unsigned int client_seed, std::shared_ptr<std::atomic<bool>> done) {
+            Session session(fd, client_seed);
+            std::string in;
+            std::string out;
+            Args args;
+            char buffer[16384];
+            bool open = true;
+            while(open && !stopping) {
+                ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+                if(size < 0 && errno == EINTR) {
+                    continue;
+                }
+                if(size <= 0) {
+                    break;
+                }
+                in.append(buffer, static_cast<size_t>(size));
+                size_t pos = 0;
+                while(open) {
+                    int ret = parse_command(in, pos, args);
+                    if(ret == 0) {
+                        break;
+                    }
+                    if(ret < 0) {
+                        reply_error(out, "ERR Protocol error");
+                        open = false;
+                        break;
+                    }
+                    open = execute(session, args, out);
+                }
+                in.erase(0, pos);
+                if(!out.empty()) {
+                    std::unique_lock<std::mutex> guard(sentinel_lock, std::defer_lock);
+                    if(session.subscribed) {
+                        guard.lock();
+                    }
+                    if(!send_all(fd, out)) {
+                        break;
+                    }
+                }
+                out.clear();
+            }
+            if(session.subscribed) {
+                std::lock_guard<std::mutex> guard(sentinel_lock);
+                sentinel_subscribers.erase(fd);
+            }
+            //Peer sees disconnect right away, descriptor is closed when thread is joined
+            shutdown(fd, SHUT_RDWR);
+            done->store(true);
+        }
+
+        bool roll(Session& session, double rate) {
+            if(rate <= 0) {
+                return false;
+            }
+            return std::uniform_real_distribution<double>(0, 1)(session.random) < rate;
+        }
+
+        /* Returns false if connection should be closed */
+        bool execute(Session& session, const Args& args, std::string& out) {
+            command_count++;
+            std::string name = to_upper(args[0]);
+            std::shared_ptr<const FaultConfig> config = std::atomic_load(&faults);
+            auto command_faults = config->commands.find(name);
+            const Faults& fault = command_faults != config->commands.end() ? command_faults->second : config->all;
+            unsigned int delay_us = fault.latency_us;
+            if(fault.jitter_us != 0) {
+                delay_us += std::uniform_int_distribution<unsigned int>(0, fault.jitter_us)(session.random);
+            }
+            if(delay_us != 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(delay_us));
+            }
+            if(roll(session, fault.disconnect_rate)) {
+                return false;
+            }
+            if(roll(session, fault.error_rate)) {
+                reply_error(out, fault.error);
+                return true;
+            }
+            auto it = commands.find(name);
+            if(it == commands.end()) {
+                reply_error(out, "ERR unknown command '" + args[0] + "'");
+                return true;
+            }
+            int arity = it->second.arity;
+            if((arity > 0 && args.size() != static_cast<size_t>(arity)) || (arity < 0 && args.size() < static_cast<size_t>(-arity))) {
+                reply_error(out, "ERR wrong number of arguments for '" + args[0] + "' command");
+                return true;
+            }
+            std::unique_lock<std::mutex> lock(store_lock);
+            if(!password.empty() && !session.authenticated && name != "AUTH" && name != "QUIT") {
+                reply_error(out, "NOAUTH Authentication required.");
+                return true;
+            }
+            Context context = {args, session, out, lock};
+            try {
+                (this->*(it->second.handler))(context);
+            }
+            catch(const CommandError& e) {
+                reply_error(out, e.message);
+            }
+            return !session.quit;
+        }
+
+        Db& db(Context& c) {
+            return dbs[c.session.db];
+        }
+
+        /* Entry of key, nullptr if it doesn't exist. Throws if entry has other type */
+        Entry* find(Context& c, const std::string& key, Type type) {
+            Entry* entry = find_any(c, key);
+            if(entry != nullptr && entry->type != type) {
+                throw CommandError{"WRONGTYPE Operation against a key holding the wrong kind of value"};
+            }
+            return entry;
+        }
+
+        Entry* find_any(Context& c, const std::string& key) {
+            auto it = db(c).find(key);
+            if(it == db(c).end()) {
+                return nullptr;
+            }
+            if(it->second.is_expired(now_ms())) {
+                db(c).erase(it);
+                return nullptr;
+            }
+            return &it->second;
+        }
+
+        Entry& find_or_create(Context& c, const std::string& key, Type type) {
+            Entry* entry = find(c, key, type);
+            if(entry != nullptr) {
+                return *entry;
+            }
+            return db(c).emplace(key, Entry(type)).first->second;
+        }
+
+        /* Redis doesn't keep empty collections */
+        void remove_if_empty(Context& c, const std::string& key) {
+            auto it = db(c).find(key);
+            if(it != db(c).end() && it->second.is_empty()) {
+                db(c).erase(it);
+            }
+        }
+
+        void set_string(Context& c, const std::string& key, const std::string& value, bool keep_ttl = false) {
+            long long expire_at = 0;
+            Entry* old = find_any(c, key);
+            if(keep_ttl && old != nullptr) {
+                expire_at = old->expire_at;
+            }
+            db(c).erase(key);
+            Entry& entry = db(c).emplace(key, Entry(Type::STRING)).first->second;
+            entry.str = value;
+            entry.expire_at = expire_at;
+        }
+
+        static void normalize_range(long long& start, long long& end, long long size) {
+            if(start < 0) {
+                start += size;
+            }
+            if(end < 0) {
+                end += size;
+            }
+            if(start < 0) {
+                start = 0;
+            }
+            if(end >= size) {
+                end = size - 1;
+            }
+        }
+
+        /* Connection */
+
+        void cmd_ping(Context& c) {
+            if(c.args.size() > 1) {
+                reply_bulk(c.out, c.args[1]);
+            }
+            else {
+                reply_status(c.out, "PONG");
+            }
+        }
+
+        void cmd_echo(Context& c) {
+            reply_bulk(c.out, c.args[1]);
+        }
+
+        void cmd_quit(Context& c) {
+            reply_status(c.out, "OK");
+            c.session.quit = true;
+        }
+
+        void cmd_select(Context& c) {
+            long long index = arg_integer(c.args[1]);
+            if(index < 0 || index >= static_cast<long long>(db_count)) {
+                throw CommandError{"ERR DB index is out of range"};
+            }
+            c.session.db = static_cast<size_t>(index);
+            reply_status(c.out, "OK");
+        }
+
+        void cmd_hello(Context& c) {
+            if(c.args.size() > 1 && c.args[1] != "2") {
+                throw CommandError{"NOPROTO unsupported protocol version"};
+            }
+            reply_array(c.out, 14);
+            reply_bulk(c.out, "server");
+            reply_bulk(c.out, "redis");
+            reply_bulk(c.out, "version");
+            reply_bulk(c.out, server_version);
+            reply_bulk(c.out, "proto");
+            reply_integer(c.out, 2);
+            reply_bulk(c.out, "id");
+            reply_integer(c.out, 1);
+            reply_bulk(c.out, "mode");
+            reply_bulk(c.out, "standalone");
+            reply_bulk(c.out, "role");
+            reply_bulk(c.out, "master");
+            reply_bulk(c.out, "modules");
+            reply_array(c.out, 0);
+        }
+
+        void cmd_info(Context& c) {
+            reply_bulk(c.out, std::string("# Server\r\nredis_version:") + server_version + "\r\nredis_mode:standalone\r\n");
+        }
+
+        void cmd_command(Context& c) {
+            reply_array(c.out, commands.size());
+            for(auto& command : commands) {
+                std::string name(command.first);
+                std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+                reply_array(c.out, 2);
+                reply_bulk(c.out, name);
+                reply_integer(c.out, command.second.arity);
+            }
+        }
+
+        void cmd_auth(Context& c) {
+            if(!password.empty() && c.args.back() != password) {
+                throw CommandError{"WRONGPASS invalid username-password pair or user is disabled."};
+            }
+            c.session.authenticated = true;
+            reply_status(c.out, "OK");
+        }
+
+        /* Sentinel */
+
+        void cmd_sentinel(Context& c) {
+            if(to_upper(c.args[1]) != "GET-MASTER-ADDR-BY-NAME" || c.args.size() != 3) {
+                throw CommandError{"ERR Unknown sentinel subcommand '" + c.args[1] + "'"};
+            }
+            std::lock_guard<std::mutex> guard(sentinel_lock);
+            auto it = sentinel_masters.find(c.args[2]);
+            if(it == sentinel_masters.end()) {
+                reply_nil_array(c.out);
+                return;
+            }
+            reply_array(c.out, 2);
+            reply_bulk(c.out, it->second.first);
+            reply_bulk(c.out, std::to_string(it->second.second));
+        }
+
+        /* Only +switch-master is published, other channels are accepted and stay silent */
+        void cmd_subscribe(Context& c) {
+            std::lock_guard<std::mutex> guard(sentinel_lock);
+            for(size_t i = 1; i < c.args.size(); i++) {
+                reply_array(c.out, 3);
+                reply_bulk(c.out, "subscribe");
+                reply_bulk(c.out, c.args[i]);
+                reply_integer(c.out, static_cast<long long>(i));
+                if(c.args[i] == "+switch-master") {
+                    sentinel_subscribers.insert(c.session.fd);
+                }
+            }
+            c.session.subscribed = true;
+        }
+
+        void set_sentinel_master(const std::string& name, const std::string& host, unsigned int master_port) {
+            std::lock_guard<std::mutex> guard(sentinel_lock);
+            auto it = sentinel_masters.find(name);
+            if(it == sentinel_masters.end()) {
+                sentinel_masters.emplace(name, std::make_pair(host, master_port));
+                return;
+            }
+            std::string message;
+            reply_array(message, 3);
+            reply_bulk(message, "message");
+            reply_bulk(message, "+switch-master");
+            reply_bulk(message, name + " " + it->second.first + " " + std::to_string(it->second.second) + " " + host + " " + std::to_string(master_port));
+            it->second = std::make_pair(host, master_port);
+            for(int fd : sentinel_subscribers) {
+                send_all(fd, message);
+            }
+        }
+
+        void cmd_ok(Context& c) {
+            reply_status(c.out, "OK");
+        }
+
+        void cmd_flushdb(Context& c) {
+            db(c).clear();
+            reply_status(c.out, "OK");
+        }
+
+        void cmd_flushall(Context& c) {
+            for(size_t i = 0; i < dbs.size(); i++) {
+                dbs[i].clear();
+            }
+            reply_status(c.out, "OK");
+        }
+
+        void cmd_dbsize(Context& c) {
+            reply_integer(c.out, static_cast<long long>(db(c).size()));
+        }
+
+        /* Keys */
+
+        void cmd_del(Context& c) {
+            long long deleted = 0;
+            for(size_t i = 1; i < c.args.size(); i++) {
+                if(find_any(c, c.args[i]) != nullptr) {
+                    db(c).erase(c.args[i]);
+                    deleted++;
+                }
+            }
+            reply_integer(c.out, deleted);
+        }
+
+        void cmd_exists(Context& c) {
+            long long found = 0;
+            for(size_t i = 1; i < c.args.size(); i++) {
+                found += find_any(c, c.args[i]) != nullptr ? 1 : 0;
+            }
+            reply_integer(c.out, found);
+        }
+
+        void cmd_type(Context& c) {
+            Entry* entry = find_any(c, c.args[1]);
+            static const char* names[] = {"string", "hash", "set", "zset", "list"};
+            reply_status(c.out, entry == nullptr ? "none" : names[static_cast<int>(entry->type)]);
+        }
+
+        void expire_key(Context& c, long long expire_at) {
+            Entry* entry = find_any(c, c.args[1]);
+            if(entry == nullptr) {
+                reply_integer(c.out, 0);
+                return;
+            }
+            if(expire_at <= now_ms()) {
+                db(c).erase(c.args[1]);
+            }
+            else {
+                entry->expire_at = expire_at;
+            }
+            reply_integer(c.out, 1);
+        }
+
+        void cmd_expire(Context& c) {
+            expire_key(c, now_ms() + arg_integer(c.args[2]) * 1000);
+        }
+
+        void cmd_pexpire(Context& c) {
+            expire_key(c, now_ms() + arg_integer(c.args[2]));
+        }
+
+        void cmd_expireat(Context& c) {
+            expire_key(c, arg_integer(c.args[2]) * 1000);
+        }
+
+        void cmd_pexpireat(Context& c) {
+            expire_key(c, arg_integer(c.args[2]));
+        }
+
+        void reply_ttl(Context& c, bool in_ms) {
+            Entry* entry = find_any(c, c.args[1]);
+            if(entry == nullptr) {
+                reply_integer(c.out, -2);
+            }
+            else if(entry->expire_at == 0) {
+                reply_integer(c.out, -1);
+            }
+            else {
+                long long ttl = entry->expire_at - now_ms();
+                reply_integer(c.out, in_ms ? ttl : (ttl + 500) / 1000);
+            }
+        }
+
+        void cmd_ttl(Context& c) {
+            reply_ttl(c, false);
+        }
+
+        void cmd_pttl(Context& c) {
+            reply_ttl(c, true);
+        }
+
+        void cmd_persist(Context& c) {
+            Entry* entry = find_any(c, c.args[1]);
+            bool had_ttl = entry != nullptr && entry->expire_at != 0;
+            if(had_ttl) {
+                entry->expire_at = 0;
+            }
+            reply_integer(c.out, had_ttl ? 1 : 0);
+        }
+
+        void cmd_keys(Context& c) {
+            long long now = now_ms();
+            std::vector<const std::string*> found;
+            for(auto& entry : db(c)) {
+                if(!entry.second.is_expired(now) && glob_match(c.args[1], entry.first)) {
+                    found.push_back(&entry.first);
+                }
+            }
+            reply_array(c.out, found.size());
+            for(size_t i = 0; i < found.size(); i++) {
+                reply_bulk(c.out, *found[i]);
+            }
+        }
+
+        struct ScanOptions {
+            std::string pattern;
+            size_t count;
+        };
+
+        static ScanOptions parse_scan_options(const Args& args, size_t first) {
+            ScanOptions options = {"*", 10};
+            for(size_t i = first; i < args.size(); i += 2) {
+                std::string option = to_upper(args[i]);
+                if(i + 1 >= args.size()) {
+                    throw CommandError{"ERR syntax error"};
+                }
+                if(option == "MATCH") {
+                    options.pattern = args[i + 1];
+                }
+                else if(option == "COUNT") {
+                    long long count = arg_integer(args[i + 1]);
+                    if(count < 1) {
+                        throw CommandError{"ERR syntax error"};
+                    }
+                    options.count = static_cast<size_t>(count);
+                }
+                else if(option != "TYPE") {
+                    throw CommandError{"ERR syntax error"};
+                }
+            }
+            return options;
+        }
+
+        static unsigned long long parse_cursor(const std::string& str) {
+            long long cursor = 0;
+            if(!parse_integer(str, cursor) || cursor < 0) {
+                throw CommandError{"ERR invalid cursor"};
+            }
+            return static_cast<unsigned long long>(cursor);
+        }
+
+        /* Cursor is offset in ordered container. Each call looks at count elements */
+        template <class Container, class Emit>
+        static void scan(std::string& out, const Container& container, unsigned long long cursor, const ScanOptions& options, size_t items_per_element, Emit emit) {
+            auto it = container.begin();
+            unsigned long long position = 0;
+            while(position < cursor && it != container.end()) {
+                ++it;
+                position++;
+            }
+            std::string items;
+            size_t item_count = 0;
+            for(size_t visited = 0; visited < options.count && it != container.end(); visited++, ++it, position++) {
+                if(emit(*it, items)) {
+                    item_count += items_per_element;
+                }
+            }
+            reply_array(out, 2);
+            reply_bulk(out, std::to_string(it == container.end() ? 0 : position));
+            reply_array(out, item_count);
+            out.append(items);
+        }
+
+        void cmd_scan(Context& c) {
+            unsigned long long cursor = parse_cursor(c.args[1]);
+            ScanOptions options = parse_scan_options(c.args, 2);
+            long long now = now_ms();
+            scan(c.out, db(c), cursor, options, 1, [&](const Db::value_type& entry, std::string& items) {
+                if(entry.second.is_expired(now) || !glob_match(options.pattern, entry.first)) {
+                    return false;
+                }
+                reply_bulk(items, entry.first);
+                return true;
+            });
+        }
+
+        /* Strings */
+
+        void cmd_get(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::STRING);
+            if(entry == nullptr) {
+                reply_nil(c.out);
+            }
+            else {
+                reply_bulk(c.out, entry->str);
+            }
+        }
+
+        void cmd_set(Context& c) {
+            long long ttl_ms = 0;
+            bool nx = false, xx = false, keep_ttl = false, get = false;
+            for(size_t i = 3; i < c.args.size(); i++) {
+                std::string option = to_upper(c.args[i]);
+                if((option == "EX" || option == "PX") && i + 1 < c.args.size()) {
+                    ttl_ms = arg_integer(c.args[++i]) * (option == "EX" ? 1000 : 1);
+                    if(ttl_ms <= 0) {
+                        throw CommandError{"ERR invalid expire time in 'set' command"};
+                    }
+                }
+                else if(option == "NX") {
+                    nx = true;
+                }
+                else if(option == "XX") {
+                    xx = true;
+                }
+                else if(option == "KEEPTTL") {
+                    keep_ttl = true;
+                }
+                else if(option == "GET") {
+                    get = true;
+                }
+                else {
+                    throw CommandError{"ERR syntax error"};
+                }
+            }
+            if(nx && xx) {
+                throw CommandError{"ERR syntax error"};
+            }
+            Entry* old = get ? find(c, c.args[1], Type::STRING) : find_any(c, c.args[1]);
+            bool exists = old != nullptr;
+            std::string old_value = exists ? old->str : std::string();
+            bool do_set = !(nx && exists) && !(xx && !exists);
+            if(do_set) {
+                set_string(c, c.args[1], c.args[2], keep_ttl);
+                if(ttl_ms != 0) {
+                    db(c).find(c.args[1])->second.expire_at = now_ms() + ttl_ms;
+                }
+            }
+            if(get) {
+                exists ? reply_bulk(c.out, old_value) : reply_nil(c.out);
+            }
+            else if(do_set) {
+                reply_status(c.out, "OK");
+            }
+            else {
+                reply_nil(c.out);
+            }
+        }
+
+        void set_with_ttl(Context& c, long long ttl_ms) {
+            if(ttl_ms <= 0) {
+                throw CommandError{"ERR invalid expire time in '" + c.args[0] + "' command"};
+            }
+            set_string(c, c.args[1], c.args[3]);
+            db(c).find(c.args[1])->second.expire_at = now_ms() + ttl_ms;
+            reply_status(c.out, "OK");
+        }
+
+        void cmd_setex(Context& c) {
+            set_with_ttl(c, arg_integer(c.args[2]) * 1000);
+        }
+
+        void cmd_psetex(Context& c) {
+            set_with_ttl(c, arg_integer(c.args[2]));
+        }
+
+        void cmd_setnx(Context& c) {
+            if(find_any(c, c.args[1]) != nullptr) {
+                reply_integer(c.out, 0);
+                return;
+            }
+            set_string(c, c.args[1], c.args[2]);
+            reply_integer(c.out, 1);
+        }
+
+        void cmd_getset(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::STRING);
+            if(entry == nullptr) {
+                reply_nil(c.out);
+            }
+            else {
+                reply_bulk(c.out, entry->str);
+            }
+            set_string(c, c.args[1], c.args[2]);
+        }
+
+        void cmd_mget(Context& c) {
+            reply_array(c.out, c.args.size() - 1);
+            for(size_t i = 1; i < c.args.size(); i++) {
+                Entry* entry = find_any(c, c.args[i]);
+                if(entry == nullptr || entry->type != Type::STRING) {
+                    reply_nil(c.out);
+                }
+                else {
+                    reply_bulk(c.out, entry->str);
+                }
+            }
+        }
+
+        void cmd_mset(Context& c) {
+            if(c.args.size() % 2 != 1) {
+                throw CommandError{"ERR wrong number of arguments for '" + c.args[0] + "' command"};
+            }
+            for(size_t i = 1; i + 1 < c.args.size(); i += 2) {
+                set_string(c, c.args[i], c.args[i + 1]);
+            }
+            reply_status(c.out, "OK");
+        }
+
+        void cmd_msetnx(Context& c) {
+            if(c.args.size() % 2 != 1) {
+                throw CommandError{"ERR wrong number of arguments for '" + c.args[0] + "' command"};
+            }
+            for(size_t i = 1; i + 1 < c.args.size(); i += 2) {
+                if(find_any(c, c.args[i]) != nullptr) {
+                    reply_integer(c.out, 0);
+                    return;
+                }
+            }
+            for(size_t i = 1; i + 1 < c.args.size(); i += 2) {
+                set_string(c, c.args[i], c.args[i + 1]);
+            }
+            reply_integer(c.out, 1);
+        }
+
+        void cmd_append(Context& c) {
+            Entry& entry = find_or_create(c, c.args[1], Type::STRING);
+            entry.str.append(c.args[2]);
+            reply_integer(c.out, static_cast<long long>(entry.str.size()));
+        }
+
+        void cmd_strlen(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::STRING);
+            reply_integer(c.out, entry == nullptr ? 0 : static_cast<long long>(entry->str.size()));
+        }
+
+        void cmd_getrange(Context& c) {
+            long long start = arg_integer(c.args[2]);
+            long long end = arg_integer(c.args[3]);
+            Entry* entry = find(c, c.args[1], Type::STRING);
+            long long size = entry == nullptr ? 0 : static_cast<long long>(entry->str.size());
+            normalize_range(start, end, size);
+            if(size == 0 || start > end) {
+                reply_bulk(c.out, "");
+                return;
+            }
+            reply_bulk(c.out, entry->str.substr(static_cast<size_t>(start), static_cast<size_t>(end - start + 1)));
+        }
+
+        void cmd_setrange(Context& c) {
+            long long offset = arg_integer(c.args[2]);
+            if(offset < 0 || offset > 512 * 1024 * 1024) {
+                throw CommandError{"ERR offset is out of range"};
+            }
+            const std::string& value = c.args[3];
+            Entry* existing = find(c, c.args[1], Type::STRING);
+            if(existing == nullptr && value.empty()) {
+                reply_integer(c.out, 0);
+                return;
+            }
+            Entry& entry = find_or_create(c, c.args[1], Type::STRING);
+            if(!value.empty()) {
+                size_t position = static_cast<size_t>(offset);
+                if(entry.str.size() < position + value.size()) {
+                    entry.str.resize(position + value.size(), '\0');
+                }
+                entry.str.replace(position, value.size(), value);
+            }
+            reply_integer(c.out, static_cast<long long>(entry.str.size()));
+        }
+
+        void increment(Context& c, long long by) {
+            Entry* entry = find(c, c.args[1], Type::STRING);
+            long long value = 0;
+            if(entry != nullptr && !parse_integer(entry->str, value)) {
+                throw CommandError{"ERR value is not an integer or out of range"};
+            }
+            if((by > 0 && value > std::numeric_limits<long long>::max() - by) || (by < 0 && value < std::numeric_limits<long long>::min() - by)) {
+                throw CommandError{"ERR increment or decrement would overflow"};
+            }
+            value += by;
+            Entry& target = find_or_create(c, c.args[1], Type::STRING);
+            target.str = std::to_string(value);
+            reply_integer(c.out, value);
+        }
+
+        void cmd_incr(Context& c) {
+            increment(c, 1);
+        }
+
+        void cmd_decr(Context& c) {
+            increment(c, -1);
+        }
+
+        void cmd_incrby(Context& c) {
+            increment(c, arg_integer(c.args[2]));
+        }
+
+        void cmd_decrby(Context& c) {
+            long long by = arg_integer(c.args[2]);
+            if(by == std::numeric_limits<long long>::min()) {
+                throw CommandError{"ERR decrement would overflow"};
+            }
+            increment(c, -by);
+        }
+
+        void cmd_incrbyfloat(Context& c) {
+            long double by = arg_float(c.args[2]);
+            Entry* entry = find(c, c.args[1], Type::STRING);
+            long double value = 0;
+            if(entry != nullptr && !parse_float(entry->str, value)) {
+                throw CommandError{"ERR value is not a valid float"};
+            }
+            value += by;
+            if(std::isinf(value)) {
+                throw CommandError{"ERR increment would produce NaN or Infinity"};
+            }
+            Entry& target = find_or_create(c, c.args[1], Type::STRING);
+            target.str = format_float(value);
+            reply_bulk(c.out, target.str);
+        }
+
+        static unsigned long long arg_bit_offset(const std::string& str) {
+            long long offset = 0;
+            if(!parse_integer(str, offset) || offset < 0 || offset >= 4LL * 1024 * 1024 * 1024) {
+                throw CommandError{"ERR bit offset is not an integer or out of range"};
+            }
+            return static_cast<unsigned long long>(offset);
+        }
+
+        static int get_bit(const std::string& str, unsigned long long offset) {
+            size_t byte = static_cast<size_t>(offset >> 3);
+            if(byte >= str.size()) {
+                return 0;
+            }
+            return (static_cast<unsigned char>(str[byte]) >> (7 - (offset & 7))) & 1;
+        }
+
+        void cmd_getbit(Context& c) {
+            unsigned long long offset = arg_bit_offset(c.args[2]);
+            Entry* entry = find(c, c.args[1], Type::STRING);
+            reply_integer(c.out, entry == nullptr ? 0 : get_bit(entry->str, offset));
+        }
+
+        void cmd_setbit(Context& c) {
+            unsigned long long offset = arg_bit_offset(c.args[2]);
+            if(c.args[3] != "0" && c.args[3] != "1") {
+                throw CommandError{"ERR bit is not an integer or out of range"};
+            }
+            Entry& entry = find_or_create(c, c.args[1], Type::STRING);
+            size_t byte = static_cast<size_t>(offset >> 3);
+            if(entry.str.size() <= byte) {
+                entry.str.resize(byte + 1, '\0');
+            }
+            int old = get_bit(entry.str, offset);
+            unsigned char mask = static_cast<unsigned char>(1 << (7 - (offset & 7)));
+            unsigned char value = static_cast<unsigned char>(entry.str[byte]);
+            entry.str[byte] = static_cast<char>(c.args[3] == "1" ? value | mask : value & ~mask);
+            reply_integer(c.out, old);
+        }
+
+        void cmd_bitcount(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::STRING);
+            if(c.args.size() != 2 && c.args.size() != 4) {
+                throw CommandError{"ERR syntax error"};
+            }
+            long long size = entry == nullptr ? 0 : static_cast<long long>(entry->str.size());
+            long long start = 0, end = size - 1;
+            if(c.args.size() == 4) {
+                start = arg_integer(c.args[2]);
+                end = arg_integer(c.args[3]);
+                normalize_range(start, end, size);
+            }
+            long long count = 0;
+            for(long long i = start; i <= end && i < size; i++) {
+                unsigned char byte = static_cast<unsigned char>(entry->str[static_cast<size_t>(i)]);
+                for(; byte != 0; byte = static_cast<unsigned char>(byte & (byte - 1))) {
+                    count++;
+                }
+            }
+            reply_integer(c.out, count);
+        }
+
+        void cmd_bitop(Context& c) {
+            std::string operation = to_upper(c.args[1]);
+            if(operation != "AND" && operation != "OR" && operation != "XOR" && operation != "NOT") {
+                throw CommandError{"ERR syntax error"};
+            }
+            if(operation == "NOT" && c.args.size() != 4) {
+                throw CommandError{"ERR BITOP NOT must be called with a single source key."};
+            }
+            std::vector<std::string> sources;
+            size_t size = 0;
+            for(size_t i = 3; i < c.args.size(); i++) {
+                Entry* entry = find(c, c.args[i], Type::STRING);
+                sources.push_back(entry == nullptr ? std::string() : entry->str);
+                size = std::max(size, sources.back().size());
+            }
+            std::string result(size, '\0');
+            for(size_t byte = 0; byte < size; byte++) {
+                unsigned char value = byte < sources[0].size() ? static_cast<unsigned char>(sources[0][byte]) : 0;
+                if(operation == "NOT") {
+                    value = static_cast<unsigned char>(~value);
+                }
+                for(size_t i = 1; i < sources.size(); i++) {
+                    unsigned char other = byte < sources[i].size() ? static_cast<unsigned char>(sources[i][byte]) : 0;
+                    if(operation == "AND") {
+                        value &= other;
+                    }
+                    else if(operation == "OR") {
+                        value |= other;
+                    }
+                    else {
+                        value ^= other;
+                    }
+                }
+                result[byte] = static_cast<char>(value);
+            }
+            if(result.empty()) {
+                db(c).erase(c.args[2]);
+            }
+            else {
+                set_string(c, c.args[2], result);
+            }
+            reply_integer(c.out, static_cast<long long>(size));
+        }
+
+        void cmd_bitpos(Context& c) {
+            if(c.args[2] != "0" && c.args[2] != "1") {
+                throw CommandError{"ERR The bit argument must be 1 or 0."};
+            }
+            int bit = c.args[2] == "1" ? 1 : 0;
+            Entry* entry = find(c, c.args[1], Type::STRING);
+            if(entry == nullptr) {
+                reply_integer(c.out, bit == 1 ? -1 : 0);
+                return;
+            }
+            long long size = static_cast<long long>(entry->str.size());
+            long long start = 0, end = size - 1;
+            bool end_given = c.args.size() > 4;
+            if(c.args.size() > 3) {
+                start = arg_integer(c.args[3]);
+                if(end_given) {
+                    end = arg_integer(c.args[4]);
+                }
+                normalize_range(start, end, size);
+            }
+            for(long long i = start; i <= end; i++) {
+                for(unsigned long long j = 0; j < 8; j++) {
+                    unsigned long long offset = static_cast<unsigned long long>(i) * 8 + j;
+                    if(get_bit(entry->str, offset) == bit) {
+                        reply_integer(c.out, static_cast<long long>(offset));
+                        return;
+                    }
+                }
+            }
+            //Clear bit is found right after the string, unless range is limited explicitly
+            reply_integer(c.out, bit == 0 && !end_given && start <= end ? (end + 1) * 8 : -1);
+        }
+
+        /* Hashes */
+
+        void cmd_hset(Context& c) {
+            if(c.args.size() % 2 != 0) {
+                throw CommandError{"ERR wrong number of arguments for '" + c.args[0] + "' command"};
+            }
+            Entry& entry = find_or_create(c, c.args[1], Type::HASH);
+            long long added = 0;
+            for(size_t i = 2; i + 1 < c.args.size(); i += 2) {
+                added += entry.hash.count(c.args[i]) == 0 ? 1 : 0;
+                entry.hash[c.args[i]] = c.args[i + 1];
+            }
+            if(to_upper(c.args[0]) == "HMSET") {
+                reply_status(c.out, "OK");
+            }
+            else {
+                reply_integer(c.out, added);
+            }
+        }
+
+        void cmd_hsetnx(Context& c) {
+            Entry& entry = find_or_create(c, c.args[1], Type::HASH);
+            bool added = entry.hash.emplace(c.args[2], c.args[3]).second;
+            reply_integer(c.out, added ? 1 : 0);
+        }
+
+        void cmd_hget(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::HASH);
+            auto it = entry == nullptr ? std::map<std::string, std::string>::const_iterator() : entry->hash.find(c.args[2]);
+            if(entry == nullptr || it == entry->hash.end()) {
+                reply_nil(c.out);
+            }
+            else {
+                reply_bulk(c.out, it->second);
+            }
+        }
+
+        void cmd_hmget(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::HASH);
+            reply_array(c.out, c.args.size() - 2);
+            for(size_t i = 2; i < c.args.size(); i++) {
+                auto it = entry == nullptr ? std::map<std::string, std::string>::const_iterator() : entry->hash.find(c.args[i]);
+                if(entry == nullptr || it == entry->hash.end()) {
+                    reply_nil(c.out);
+                }
+                else {
+                    reply_bulk(c.out, it->second);
+                }
+            }
+        }
+
+        void cmd_hdel(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::HASH);
+            long long deleted = 0;
+            for(size_t i = 2; entry != nullptr && i < c.args.size(); i++) {
+                deleted += static_cast<long long>(entry->hash.erase(c.args[i]));
+            }
+            remove_if_empty(c, c.args[1]);
+            reply_integer(c.out, deleted);
+        }
+
+        void cmd_hexists(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::HASH);
+            reply_integer(c.out, entry != nullptr && entry->hash.count(c.args[2]) != 0 ? 1 : 0);
+        }
+
+        void cmd_hlen(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::HASH);
+            reply_integer(c.out, entry == nullptr ? 0 : static_cast<long long>(entry->hash.size()));
+        }
+
+        void cmd_hgetall(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::HASH);
+            if(entry == nullptr) {
+                reply_array(c.out, 0);
+                return;
+            }
+            reply_array(c.out, entry->hash.size() * 2);
+            for(auto& field : entry->hash) {
+                reply_bulk(c.out, field.first);
+                reply_bulk(c.out, field.second);
+            }
+        }
+
+        void cmd_hkeys(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::HASH);
+            if(entry == nullptr) {
+                reply_array(c.out, 0);
+                return;
+            }
+            reply_array(c.out, entry->hash.size());
+            for(auto& field : entry->hash) {
+                reply_bulk(c.out, field.first);
+            }
+        }
+
+        void cmd_hvals(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::HASH);
+            if(entry == nullptr) {
+                reply_array(c.out, 0);
+                return;
+            }
+            reply_array(c.out, entry->hash.size());
+            for(auto& field : entry->hash) {
+                reply_bulk(c.out, field.second);
+            }
+        }
+
+        void cmd_hincrby(Context& c) {
+            long long by = arg_integer(c.args[3]);
+            Entry& entry = find_or_create(c, c.args[1], Type::HASH);
+            long long value = 0;
+            auto it = entry.hash.find(c.args[2]);
+            if(it != entry.hash.end() && !parse_integer(it->second, value)) {
+                remove_if_empty(c, c.args[1]);
+                throw CommandError{"ERR hash value is not an integer"};
+            }
+            if((by > 0 && value > std::numeric_limits<long long>::max() - by) || (by < 0 && value < std::numeric_limits<long long>::min() - by)) {
+                remove_if_empty(c, c.args[1]);
+                throw CommandError{"ERR increment or decrement would overflow"};
+            }
+            value += by;
+            entry.hash[c.args[2]] = std::to_string(value);
+            reply_integer(c.out, value);
+        }
+
+        void cmd_hincrbyfloat(Context& c) {
+            long double by = arg_float(c.args[3]);
+            Entry& entry = find_or_create(c, c.args[1], Type::HASH);
+            long double value = 0;
+            auto it = entry.hash.find(c.args[2]);
+            if(it != entry.hash.end() && !parse_float(it->second, value)) {
+                remove_if_empty(c, c.args[1]);
+                throw CommandError{"ERR hash value is not a float"};
+            }
+            std::string result = format_float(value + by);
+            entry.hash[c.args[2]] = result;
+            reply_bulk(c.out, result);
+        }
+
+        void cmd_hscan(Context& c) {
+            unsigned long long cursor = parse_cursor(c.args[2]);
+            ScanOptions options = parse_scan_options(c.args, 3);
+            Entry* entry = find(c, c.args[1], Type::HASH);
+            std::map<std::string, std::string> empty;
+            scan(c.out, entry == nullptr ? empty : entry->hash, cursor, options, 2, [&](const std::pair<const std::string, std::string>& field, std::string& items) {
+                if(!glob_match(options.pattern, field.first)) {
+                    return false;
+                }
+                reply_bulk(items, field.first);
+                reply_bulk(items, field.second);
+                return true;
+            });
+        }
+
+        /* Sets */
+
+        void cmd_sadd(Context& c) {
+            Entry& entry = find_or_create(c, c.args[1], Type::SET);
+            long long added = 0;
+            for(size_t i = 2; i < c.args.size(); i++) {
+                added += entry.set.insert(c.args[i]).second ? 1 : 0;
+            }
+            reply_integer(c.out, added);
+        }
+
+        void cmd_srem(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::SET);
+            long long removed = 0;
+            for(size_t i = 2; entry != nullptr && i < c.args.size(); i++) {
+                removed += static_cast<long long>(entry->set.erase(c.args[i]));
+            }
+            remove_if_empty(c, c.args[1]);
+            reply_integer(c.out, removed);
+        }
+
+        void cmd_scard(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::SET);
+            reply_integer(c.out, entry == nullptr ? 0 : static_cast<long long>(entry->set.size()));
+        }
+
+        void cmd_sismember(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::SET);
+            reply_integer(c.out, entry != nullptr && entry->set.count(c.args[2]) != 0 ? 1 : 0);
+        }
+
+        static void reply_set(std::string& out, const std::set<std::string>& set) {
+            reply_array(out, set.size());
+            for(auto& member : set) {
+                reply_bulk(out, member);
+            }
+        }
+
+        void cmd_smembers(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::SET);
+            reply_set(c.out, entry == nullptr ? std::set<std::string>() : entry->set);
+        }
+
+        enum class SetOperation { INTER, UNION, DIFF };
+
+        std::set<std::string> combine_sets(Context& c, size_t first, SetOperation operation) {
+            std::set<std::string> result;
+            for(size_t i = first; i < c.args.size(); i++) {
+                Entry* entry = find(c, c.args[i], Type::SET);
+                const std::set<std::string> empty;
+                const std::set<std::string>& members = entry == nullptr ? empty : entry->set;
+                if(i == first || operation == SetOperation::UNION) {
+                    result.insert(members.begin(), members.end());
+                    continue;
+                }
+                std::set<std::string> combined;
+                if(operation == SetOperation::INTER) {
+                    std::set_intersection(result.begin(), result.end(), members.begin(), members.end(), std::inserter(combined, combined.end()));
+                }
+                else {
+                    std::set_difference(result.begin(), result.end(), members.begin(), members.end(), std::inserter(combined, combined.end()));
+                }
+                result.swap(combined);
+            }
+            return result;
+        }
+
+        void store_set(Context& c, std::set<std::string>&& members) {
+            size_t size = members.size();
+            db(c).erase(c.args[1]);
+            if(size != 0) {
+                db(c).emplace(c.args[1], Entry(Type::SET)).first->second.set = std::move(members);
+            }
+            reply_integer(c.out, static_cast<long long>(size));
+        }
+
+        void cmd_sinter(Context& c) {
+            reply_set(c.out, combine_sets(c, 1, SetOperation::INTER));
+        }
+
+        void cmd_sunion(Context& c) {
+            reply_set(c.out, combine_sets(c, 1, SetOperation::UNION));
+        }
+
+        void cmd_sdiff(Context& c) {
+            reply_set(c.out, combine_sets(c, 1, SetOperation::DIFF));
+        }
+
+        void cmd_sinterstore(Context& c) {
+            store_set(c, combine_sets(c, 2, SetOperation::INTER));
+        }
+
+        void cmd_sunionstore(Context& c) {
+            store_set(c, combine_sets(c, 2, SetOperation::UNION));
+        }
+
+        void cmd_sdiffstore(Context& c) {
+            store_set(c, combine_sets(c, 2, SetOperation::DIFF));
+        }
+
+        void cmd_sscan(Context& c) {
+            unsigned long long cursor = parse_cursor(c.args[2]);
+            ScanOptions options = parse_scan_options(c.args, 3);
+            Entry* entry = find(c, c.args[1], Type::SET);
+            std::set<std::string> empty;
+            scan(c.out, entry == nullptr ? empty : entry->set, cursor, options, 1, [&](const std::string& member, std::string& items) {
+                if(!glob_match(options.pattern, member)) {
+                    return false;
+                }
+                reply_bulk(items, member);
+                return true;
+            });
+        }
+
+        /* Sorted sets */
+
+        static void zset_put(Entry& entry, const std::string& member, double score) {
+            auto it = entry.zset.find(member);
+            if(it != entry.zset.end()) {
+                entry.zset_order.erase(std::make_pair(it->second, member));
+                it->second = score;
+            }
+            else {
+                entry.zset.emplace(member, score);
+            }
+            entry.zset_order.emplace(score, member);
+        }
+
+        static double arg_score(const std::string& str) {
+            long double score = 0;
+            std::string lower(str);
+            std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+            if(lower == "inf" || lower == "+inf") {
+                return std::numeric_limits<double>::infinity();
+            }
+            if(lower == "-inf") {
+                return -std::numeric_limits<double>::infinity();
+            }
+            if(!parse_float(str, score)) {
+                throw CommandError{"ERR value is not a valid float"};
+            }
+            return static_cast<double>(score);
+        }
+
+        void cmd_zadd(Context& c) {
+            if(c.args.size() % 2 != 0) {
+                throw CommandError{"ERR syntax error"};
+            }
+            std::vector<double> scores;
+            for(size_t i = 2; i + 1 < c.args.size(); i += 2) {
+                scores.push_back(arg_score(c.args[i]));
+            }
+            Entry& entry = find_or_create(c, c.args[1], Type::ZSET);
+            long long added = 0;
+            for(size_t i = 2; i + 1 < c.args.size(); i += 2) {
+                added += entry.zset.count(c.args[i + 1]) == 0 ? 1 : 0;
+                zset_put(entry, c.args[i + 1], scores[(i - 2) / 2]);
+            }
+            reply_integer(c.out, added);
+        }
+
+        void cmd_zincrby(Context& c) {
+            double by = arg_score(c.args[2]);
+            Entry& entry = find_or_create(c, c.args[1], Type::ZSET);
+            auto it = entry.zset.find(c.args[3]);
+            double score = (it == entry.zset.end() ? 0 : it->second) + by;
+            zset_put(entry, c.args[3], score);
+            reply_bulk(c.out, format_score(score));
+        }
+
+        void cmd_zscore(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::ZSET);
+            auto it = entry == nullptr ? std::map<std::string, double>::const_iterator() : entry->zset.find(c.args[2]);
+            if(entry == nullptr || it == entry->zset.end()) {
+                reply_nil(c.out);
+            }
+            else {
+                reply_bulk(c.out, format_score(it->second));
+            }
+        }
+
+        void cmd_zcard(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::ZSET);
+            reply_integer(c.out, entry == nullptr ? 0 : static_cast<long long>(entry->zset.size()));
+        }
+
+        void cmd_zrem(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::ZSET);
+            long long removed = 0;
+            for(size_t i = 2; entry != nullptr && i < c.args.size(); i++) {
+                auto it = entry->zset.find(c.args[i]);
+                if(it != entry->zset.end()) {
+                    entry->zset_order.erase(std::make_pair(it->second, it->first));
+                    entry->zset.erase(it);
+                    removed++;
+                }
+            }
+            remove_if_empty(c, c.args[1]);
+            reply_integer(c.out, removed);
+        }
+
+        void zrange(Context& c, bool reverse) {
+            long long start = arg_integer(c.args[2]);
+            long long end = arg_integer(c.args[3]);
+            bool with_scores = c.args.size() > 4;
+            if(c.args.size() > 5 || (with_scores && to_upper(c.args[4]) != "WITHSCORES")) {
+                throw CommandError{"ERR syntax error"};
+            }
+            Entry* entry = find(c, c.args[1], Type::ZSET);
+            long long size = entry == nullptr ? 0 : static_cast<long long>(entry->zset.size());
+            normalize_range(start, end, size);
+            if(size == 0 || start > end) {
+                reply_array(c.out, 0);
+                return;
+            }
+            std::vector<const std::pair<double, std::string>*> ordered;
+            for(auto& item : entry->zset_order) {
+                ordered.push_back(&item);
+            }
+            if(reverse) {
+                std::reverse(ordered.begin(), ordered.end());
+            }
+            reply_array(c.out, static_cast<size_t>(end - start + 1) * (with_scores ? 2 : 1));
+            for(long long i = start; i <= end; i++) {
+                reply_bulk(c.out, ordered[static_cast<size_t>(i)]->second);
+                if(with_scores) {
+                    reply_bulk(c.out, format_score(ordered[static_cast<size_t>(i)]->first));
+                }
+            }
+        }
+
+        void cmd_zrange(Context& c) {
+            zrange(c, false);
+        }
+
+        void cmd_zrevrange(Context& c) {
+            zrange(c, true);
+        }
+
+        void cmd_zremrangebyrank(Context& c) {
+            long long start = arg_integer(c.args[2]);
+            long long end = arg_integer(c.args[3]);
+            Entry* entry = find(c, c.args[1], Type::ZSET);
+            long long size = entry == nullptr ? 0 : static_cast<long long>(entry->zset.size());
+            normalize_range(start, end, size);
+            if(size == 0 || start > end) {
+                reply_integer(c.out, 0);
+                return;
+            }
+            auto first = std::next(entry->zset_order.begin(), static_cast<long>(start));
+            auto last = std::next(first, static_cast<long>(end - start + 1));
+            for(auto it = first; it != last; ++it) {
+                entry->zset.erase(it->second);
+            }
+            entry->zset_order.erase(first, last);
+            remove_if_empty(c, c.args[1]);
+            reply_integer(c.out, end - start + 1);
+        }
+
+        void cmd_zscan(Context& c) {
+            unsigned long long cursor = parse_cursor(c.args[2]);
+            ScanOptions options = parse_scan_options(c.args, 3);
+            Entry* entry = find(c, c.args[1], Type::ZSET);
+            std::map<std::string, double> empty;
+            scan(c.out, entry == nullptr ? empty : entry->zset, cursor, options, 2, [&](const std::pair<const std::string, double>& member, std::string& items) {
+                if(!glob_match(options.pattern, member.first)) {
+                    return false;
+                }
+                reply_bulk(items, member.first);
+                reply_bulk(items, format_score(member.second));
+                return true;
+            });
+        }
+
+        /* Lists */
+
+        void push(Context& c, bool left) {
+            Entry& entry = find_or_create(c, c.args[1], Type::LIST);
+            for(size_t i = 2; i < c.args.size(); i++) {
+                if(left) {
+                    entry.list.push_front(c.args[i]);
+                }
+                else {
+                    entry.list.push_back(c.args[i]);
+                }
+            }
+            reply_integer(c.out, static_cast<long long>(entry.list.size()));
+            list_pushed.notify_all();
+        }
+
+        void cmd_lpush(Context& c) {
+            push(c, true);
+        }
+
+        void cmd_rpush(Context& c) {
+            push(c, false);
+        }
+
+        /* Pops from non empty list, removes it if it becomes empty */
+        std::string pop(Context& c, const std::string& key, bool left) {
+            Entry* entry = find(c, key, Type::LIST);
+            std::string value = left ? entry->list.front() : entry->list.back();
+            if(left) {
+                entry->list.pop_front();
+            }
+            else {
+                entry->list.pop_back();
+            }
+            remove_if_empty(c, key);
+            return value;
+        }
+
+        void cmd_lpop(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::LIST);
+            entry == nullptr ? reply_nil(c.out) : reply_bulk(c.out, pop(c, c.args[1], true));
+        }
+
+        void cmd_rpop(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::LIST);
+            entry == nullptr ? reply_nil(c.out) : reply_bulk(c.out, pop(c, c.args[1], false));
+        }
+
+        void cmd_llen(Context& c) {
+            Entry* entry = find(c, c.args[1], Type::LIST);
+            reply_integer(c.out, entry == nullptr ? 0 : static_cast<long long>(entry->list.size()));
+        }
+
+        void cmd_lrange(Context& c) {
+            long long start = arg_integer(c.args[2]);
+            long long end = arg_integer(c.args[3]);
+            Entry* entry = find(c, c.args[1], Type::LIST);
+            long long size = entry == nullptr ? 0 : static_cast<long long>(entry->list.size());
+            normalize_range(start, end, size);
+            if(size == 0 || start > end) {
+                reply_array(c.out, 0);
+                return;
+            }
+            reply_array(c.out, static_cast<size_t>(end - start + 1));
+            for(long long i = start; i <= end; i++) {
+                reply_bulk(c.out, entry->list[static_cast<size_t>(i)]);
+            }
+        }
+
+        void cmd_lindex(Context& c) {
+            long long index = arg_integer(c.args[2]);
+            Entry* entry = find(c, c.args[1], Type::LIST);
+            long long size = entry == nullptr ? 0 : static_cast<long long>(entry->list.size());
+            if(index < 0) {
+                index += size;
+            }
+            if(index < 0 || index >= size) {
+                reply_nil(c.out);
+                return;
+            }
+            reply_bulk(c.out, entry->list[static_cast<size_t>(index)]);
+        }
+
+        void move_element(Context& c, const std::string& source, const std::string& destination) {
+            Entry* target = find(c, destination, Type::LIST);
+            (void)target;
+            std::string value = pop(c, source, false);
+            find_or_create(c, destination, Type::LIST).list.push_front(value);
+            reply_bulk(c.out, value);
+            list_pushed.notify_all();
+        }
+
+        void cmd_rpoplpush(Context& c) {
+            if(find(c, c.args[1], Type::LIST) == nullptr) {
+                reply_nil(c.out);
+                return;
+            }
+            move_element(c, c.args[1], c.args[2]);
+        }
+
+        /* Waits until timeout (seconds, 0 - forever) for any of keys to get elements. Store lock is released while waiting */
+        bool wait_for_list(Context& c, size_t first_key, size_t last_key, const std::string& timeout_str, std::string& found_key) {
+            long double timeout = arg_float(timeout_str);
+            if(timeout < 0) {
+                throw CommandError{"ERR timeout is negative"};
+            }
+            Clock::time_point until = Clock::now() + std::chrono::microseconds(static_cast<long long>(timeout * 1000000));
+            while(true) {
+                for(size_t i = first_key; i < last_key; i++) {
+                    if(find(c, c.args[i], Type::LIST) != nullptr) {
+                        found_key = c.args[i];
+                        return true;
+                    }
+                }
+                if(stopping || (timeout != 0 && Clock::now() >= until)) {
+                    return false;
+                }
+                if(timeout == 0) {
+                    list_pushed.wait_for(c.lock, std::chrono::milliseconds(100));
+                }
+                else {
+                    list_pushed.wait_until(c.lock, std::min(until, Clock::now() + std::chrono::milliseconds(100)));
+                }
+            }
+        }
+
+        void blocking_pop(Context& c, bool left) {
+            std::string key;
+            if(!wait_for_list(c, 1, c.args.size() - 1, c.args.back(), key)) {
+                reply_nil_array(c.out);
+                return;
+            }
+            std::string value = pop(c, key, left);
+            reply_array(c.out, 2);
+            reply_bulk(c.out, key);
+            reply_bulk(c.out, value);
+        }
+
+        void cmd_blpop(Context& c) {
+            blocking_pop(c, true);
+        }
+
+        void cmd_brpop(Context& c) {
+            blocking_pop(c, false);
+        }
+
+        void cmd_brpoplpush(Context& c) {
+            std::string key;
+            if(!wait_for_list(c, 1, 2, c.args[3], key)) {
+                reply_nil(c.out);
+                return;
+            }
+            move_element(c, c.args[1], c.args[2]);
+        }
+
+        void register_commands() {
+            commands = {
+                {"PING", {&Impl::cmd_ping, -1}},
+                {"ECHO", {&Impl::cmd_echo, 2}},
+                {"QUIT", {&Impl::cmd_quit, 1}},
+                {"SELECT", {&Impl::cmd_select, 2}},
+                {"HELLO", {&Impl::cmd_hello, -1}},
+                {"INFO", {&Impl::cmd_info, -1}},
+                {"COMMAND", {&Impl::cmd_command, -1}},
+                {"CLIENT", {&Impl::cmd_ok, -2}},
+                {"AUTH", {&Impl::cmd_auth, -2}},
+                {"SENTINEL", {&Impl::cmd_sentinel, -2}},
+                {"SUBSCRIBE", {&Impl::cmd_subscribe, -2}},
+                {"BGSAVE", {&Impl::cmd_ok, -1}},
+                {"BGREWRITEAOF", {&Impl::cmd_ok, 1}},
+                {"FLUSHDB", {&Impl::cmd_flushdb, -1}},
+                {"FLUSHALL", {&Impl::cmd_flushall, -1}},
+                {"DBSIZE", {&Impl::cmd_dbsize, 1}},
+
+                {"DEL", {&Impl::cmd_del, -2}},
+                {"UNLINK", {&Impl::cmd_del, -2}},
+                {"EXISTS", {&Impl::cmd_exists, -2}},
+                {"TYPE", {&Impl::cmd_type, 2}},
+                {"EXPIRE", {&Impl::cmd_expire, 3}},
+                {"PEXPIRE", {&Impl::cmd_pexpire, 3}},
+                {"EXPIREAT", {&Impl::cmd_expireat, 3}},
+                {"PEXPIREAT", {&Impl::cmd_pexpireat, 3}},
+                {"TTL", {&Impl::cmd_ttl, 2}},
+                {"PTTL", {&Impl::cmd_pttl, 2}},
+                {"PERSIST", {&Impl::cmd_persist, 2}},
+                {"KEYS", {&Impl::cmd_keys, 2}},
+                {"SCAN", {&Impl::cmd_scan, -2}},
+
+                {"GET", {&Impl::cmd_get, 2}},
+                {"SET", {&Impl::cmd_set, -3}},
+                {"SETEX", {&Impl::cmd_setex, 4}},
+                {"PSETEX", {&Impl::cmd_psetex, 4}},
+                {"SETNX", {&Impl::cmd_setnx, 3}},
+                {"GETSET", {&Impl::cmd_getset, 3}},
+                {"MGET", {&Impl::cmd_mget, -2}},
+                {"MSET", {&Impl::cmd_mset, -3}},
+                {"MSETNX", {&Impl::cmd_msetnx, -3}},
+                {"APPEND", {&Impl::cmd_append, 3}},
+                {"STRLEN", {&Impl::cmd_strlen, 2}},
+                {"GETRANGE", {&Impl::cmd_getrange, 4}},
+                {"SETRANGE", {&Impl::cmd_setrange, 4}},
+                {"INCR", {&Impl::cmd_incr, 2}},
+                {"DECR", {&Impl::cmd_decr, 2}},
+                {"INCRBY", {&Impl::cmd_incrby, 3}},
+                {"DECRBY", {&Impl::cmd_decrby, 3}},
+                {"INCRBYFLOAT", {&Impl::cmd_incrbyfloat, 3}},
+                {"GETBIT", {&Impl::cmd_getbit, 3}},
+                {"SETBIT", {&Impl::cmd_setbit, 4}},
+                {"BITCOUNT", {&Impl::cmd_bitcount, -2}},
+                {"BITOP", {&Impl::cmd_bitop, -4}},
+                {"BITPOS", {&Impl::cmd_bitpos, -3}},
+
+                {"HSET", {&Impl::cmd_hset, -4}},
+                {"HMSET", {&Impl::cmd_hset, -4}},
+                {"HSETNX", {&Impl::cmd_hsetnx, 4}},
+                {"HGET", {&Impl::cmd_hget, 3}},
+                {"HMGET", {&Impl::cmd_hmget, -3}},
+                {"HDEL", {&Impl::cmd_hdel, -3}},
+                {"HEXISTS", {&Impl::cmd_hexists, 3}},
+                {"HLEN", {&Impl::cmd_hlen, 2}},
+                {"HGETALL", {&Impl::cmd_hgetall, 2}},
+                {"HKEYS", {&Impl::cmd_hkeys, 2}},
+                {"HVALS", {&Impl::cmd_hvals, 2}},
+                {"HINCRBY", {&Impl::cmd_hincrby, 4}},
+                {"HINCRBYFLOAT", {&Impl::cmd_hincrbyfloat, 4}},
+                {"HSCAN", {&Impl::cmd_hscan, -3}},
+
+                {"SADD", {&Impl::cmd_sadd, -3}},
+                {"SREM", {&Impl::cmd_srem, -3}},
+                {"SCARD", {&Impl::cmd_scard, 2}},
+                {"SISMEMBER", {&Impl::cmd_sismember, 3}},
+                {"SMEMBERS", {&Impl::cmd_smembers, 2}},
+                {"SINTER", {&Impl::cmd_sinter, -2}},
+                {"SUNION", {&Impl::cmd_sunion, -2}},
+                {"SDIFF", {&Impl::cmd_sdiff, -2}},
+                {"SINTERSTORE", {&Impl::cmd_sinterstore, -3}},
+                {"SUNIONSTORE", {&Impl::cmd_sunionstore, -3}},
+                {"SDIFFSTORE", {&Impl::cmd_sdiffstore, -3}},
+                {"SSCAN", {&Impl::cmd_sscan, -3}},
+
+                {"ZADD", {&Impl::cmd_zadd, -4}},
+                {"ZINCRBY", {&Impl::cmd_zincrby, 4}},
+                {"ZSCORE", {&Impl::cmd_zscore, 3}},
+                {"ZCARD", {&Impl::cmd_zcard, 2}},
+                {"ZREM", {&Impl::cmd_zrem, -3}},
+                {"ZRANGE", {&Impl::cmd_zrange, -4}},
+                {"ZREVRANGE", {&Impl::cmd_zrevrange, -4}},
+                {"ZREMRANGEBYRANK", {&Impl::cmd_zremrangebyrank, 4}},
+                {"ZSCAN", {&Impl::cmd_zscan, -3}},
+
+                {"LPUSH", {&Impl::cmd_lpush, -3}},
+                {"RPUSH", {&Impl::cmd_rpush, -3}},
+                {"LPOP", {&Impl::cmd_lpop, 2}},
+                {"RPOP", {&Impl::cmd_rpop, 2}},
+                {"LLEN", {&Impl::cmd_llen, 2}},
+                {"LRANGE", {&Impl::cmd_lrange, 4}},
+                {"LINDEX", {&Impl::cmd_lindex, 3}},
+                {"RPOPLPUSH", {&Impl::cmd_rpoplpush, 3}},
+                {"BLPOP", {&Impl::cmd_blpop, -3}},
+                {"BRPOP", {&Impl::cmd_brpop, -3}},
+                {"BRPOPLPUSH", {&Impl::cmd_brpoplpush, 4}}
+            };
+        }
+
+        void update_faults(std::function<void(FaultConfig&)> update) {
+            std::lock_guard<std::mutex> guard(faults_lock);
+            std::shared_ptr<FaultConfig> config = std::make_shared<FaultConfig>(*std::atomic_load(&faults));
+            update(*config);
+            std::atomic_store(&faults, std::shared_ptr<const FaultConfig>(config));
+        }
+    };
+
+    MockServer::MockServer(unsigned int port, unsigned int seed) :
+        d(new MockServer::Impl(port, seed))
+    {}
+
+    MockServer::~MockServer() {
+        if(d != nullptr) {
+            delete d;
+        }
+    }
+
+    unsigned int MockServer::get_port() const {
+        return d->port;
+    }
+
+    ConnectionParam MockServer::get_connection_param() const {
+        return ConnectionParam("127.0.0.1", d->port);
+    }
+
+    void MockServer::set_faults(const Faults& faults) {
+        d->update_faults([&](Impl::FaultConfig& config) {
+            config.all = faults;
+        });
+    }
+
+    void MockServer::set_command_faults(const std::string& command, const Faults& faults) {
+        d->update_faults([&](Impl::FaultConfig& config) {
+            config.commands[to_upper(command)] = faults;
+        });
+    }
+
+    void MockServer::clear_faults() {
+        d->update_faults([](Impl::FaultConfig& config) {
+            config = Impl::FaultConfig();
+        });
+    }
+
+    void MockServer::disconnect_all() {
+        std::lock_guard<std::mutex> guard(d->clients_lock);
+        for(auto& client : d->clients) {
+            shutdown(client.second.fd, SHUT_RDWR);
+        }
+    }
+
+    void MockServer::set_password(const std::string& password) {
+        std::lock_guard<std::mutex> guard(d->store_lock);
+        d->password = password;
+    }
+
+    void MockServer::set_sentinel_master(const std::string& name, const std::string& host, unsigned int port) {
+        d->set_sentinel_master(name, host, port);
+    }
+
+    void MockServer::flush_all() {
+        std::lock_guard<std::mutex> guard(d->store_lock);
+        for(size_t i = 0; i < d->dbs.size(); i++) {
+            d->dbs[i].clear();
+        }
+    }
+
+    unsigned long long MockServer::get_command_count() const {
+        return d->command_count.load();
+    }
+
+    size_t MockServer::get_client_count() const {
+        std::lock_guard<std::mutex> guard(d->clients_lock);
+        size_t count = 0;
+        for(auto& client : d->clients) {
+            count += client.second.done->load() ? 0 : 1;
+        }
+        return count;
+    }
+
+    unsigned long long MockServer::get_accepted_count() const {
+        return d->accepted_count.load();
+    }
+}
\ No newline at end of file
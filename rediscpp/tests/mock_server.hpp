@@ -0,0 +1,74 @@
+#pragma once
+#include <string>
+#include "../connection_param.hpp"
+namespace Redis {
+    /**
+    * In-process stand-in for redis-server speaking RESP2 on 127.0.0.1, for hermetic tests and for measuring client overhead without server cost.
+    * Keeps strings, hashes, sets, sorted sets and lists in memory and serves the commands Connection uses. Each client is served by its own thread.
+    * Latency, error replies and disconnects can be injected for all commands or for a single one, so timeout and reconnect paths can be reproduced.
+    * Random faults are drawn from generator seeded with seed and client number, so a single client sees the same sequence on every run.
+    * Not a full redis: no persistence, transactions, scripting or pub/sub other than sentinel +switch-master. SCAN cursors are offsets, so keys removed during scan may shift others out of it.
+    *
+    *  F.e. :
+    *  Redis::MockServer server;
+    *  Redis::Connection conn(server.get_connection_param());
+    * */
+    class MockServer {
+    public:
+        struct Faults {
+            //Delay before each reply, plus uniformly distributed jitter
+            unsigned int latency_us;
+            unsigned int jitter_us;
+            //Share of commands answered with error instead of being executed
+            double error_rate;
+            std::string error;
+            //Share of commands after which connection is closed without reply
+            double disconnect_rate;
+            Faults() : latency_us(0), jitter_us(0), error_rate(0), error("ERR injected error"), disconnect_rate(0) {}
+        };
+
+        /* port 0 picks a free one. Throws if port can't be bound */
+        explicit MockServer(unsigned int port = 0, unsigned int seed = 0);
+        ~MockServer();
+        MockServer(const MockServer& other) = delete;
+        MockServer& operator=(const MockServer& other) = delete;
+
+        unsigned int get_port() const;
+
+        /* Default connection param pointed at the server */
+        ConnectionParam get_connection_param() const;
+
+        /* Faults of all commands without own faults */
+        void set_faults(const Faults& faults);
+
+        /* Faults of single command, f.e. "GET" */
+        void set_command_faults(const std::string& command, const Faults& faults);
+
+        /* Removes all injected faults */
+        void clear_faults();
+
+        /* Closes connections of all clients, like restart of server which kept its data */
+        void disconnect_all();
+
+        /* Commands other than AUTH fail with NOAUTH until client authenticates with password. Empty password disables the check */
+        void set_password(const std::string& password);
+
+        /*
+        * Makes server act as a sentinel monitoring master name: SENTINEL get-master-addr-by-name returns host and port,
+        * and changing them publishes +switch-master to clients subscribed with SUBSCRIBE
+        */
+        void set_sentinel_master(const std::string& name, const std::string& host, unsigned int port);
+
+        /* Removes all keys of all databases */
+        void flush_all();
+
+        unsigned long long get_command_count() const;
+        /* Clients connected right now */
+        size_t get_client_count() const;
+        unsigned long long get_accepted_count() const;
+
+    private:
+        class Impl;
+        Impl* d;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,159 @@
+#pragma once
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <type_traits>
+namespace Redis {
+
+    /**
+    * Serialization of typed values for templated Connection::get/set/hget/hset/mget.
+    * Values are encoded directly into the buffer passed to hiredis and decoded directly from reply bytes, without intermediate strings.
+    * Specialize it for own types:
+    *
+    *  template <> struct Codec<MyType> {
+    *      static constexpr bool defined = true;
+    *      //Upper bound of encoded size
+    *      static size_t max_size(const MyType& value);
+    *      //Writes at most max_size(value) bytes, returns number of bytes written
+    *      static size_t encode(const MyType& value, char* buffer);
+    *      static bool decode(const char* data, size_t size, MyType& value);
+    *  };
+    *
+    * Trivially copyable structs can be stored as raw bytes instead by opting in:
+    *
+    *  template <> struct RawBytesCodec<MyPod> : std::true_type {};
+    * */
+    template <class T, class Enable = void>
+    struct Codec {
+        static constexpr bool defined = false;
+    };
+
+    /*
+    * Opt-in for raw bytes encoding of a trivially copyable struct. Not automatic, as structs holding pointers
+    * (StringRef for example) would store addresses instead of the data they point to.
+    */
+    template <class T>
+    struct RawBytesCodec : std::false_type {};
+
+    /* Decimal representation, compatible with INCR/DECR */
+    template <class T>
+    struct Codec<T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value>::type> {
+        static constexpr bool defined = true;
+        typedef typename std::make_unsigned<T>::type Unsigned;
+
+        static size_t max_size(const T&) {
+            return std::numeric_limits<T>::digits10 + 2;
+        }
+
+        static size_t encode(const T& value, char* buffer) {
+            char digits[std::numeric_limits<Unsigned>::digits10 + 1];
+            size_t count = 0;
+            bool negative = value < 0;
+            //Works for min value as well, as unsigned negation is modulo
+            Unsigned magnitude = negative ? static_cast<Unsigned>(0 - static_cast<Unsigned>(value)) : static_cast<Unsigned>(value);
+            do {
+                digits[count++] = static_cast<char>('0' + magnitude % 10);
+                magnitude = static_cast<Unsigned>(magnitude / 10);
+            } while(magnitude != 0);
+            size_t size = 0;
+            if(negative) {
+                buffer[size++] = '-';
+            }
+            while(count != 0) {
+                buffer[size++] = digits[--count];
+            }
+            return size;
+        }
+
+        static bool decode(const char* data, size_t size, T& value) {
+            if(size == 0) {
+                return false;
+            }
+            bool negative = data[0] == '-';
+            if(negative && (!std::is_signed<T>::value || size == 1)) {
+                return false;
+            }
+            const Unsigned limit = negative ?
+                static_cast<Unsigned>(static_cast<Unsigned>(std::numeric_limits<T>::max()) + 1) :
+                static_cast<Unsigned>(std::numeric_limits<T>::max());
+            Unsigned magnitude = 0;
+            for(size_t i = negative ? 1 : 0; i < size; i++) {
+                if(data[i] < '0' || data[i] > '9') {
+                    return false;
+                }
+                Unsigned digit = static_cast<Unsigned>(data[i] - '0');
+                if(magnitude > (limit - digit) / 10) {
+                    return false;
+                }
+                magnitude = static_cast<Unsigned>(magnitude * 10 + digit);
+            }
+            value = negative ? static_cast<T>(0 - magnitude) : static_cast<T>(magnitude);
+            return true;
+        }
+    };
+
+    /* Text with max_digits10 significant digits, which restores exactly the same value. Compatible with INCRBYFLOAT */
+    template <class T>
+    struct Codec<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+        static constexpr bool defined = true;
+        static constexpr size_t buffer_size = 32;
+
+        static size_t max_size(const T&) {
+            return buffer_size;
+        }
+
+        static size_t encode(const T& value, char* buffer) {
+            int size = std::snprintf(buffer, buffer_size, "%.*Lg", std::numeric_limits<T>::max_digits10, static_cast<long double>(value));
+            return size < 0 ? 0 : static_cast<size_t>(size);
+        }
+
+        static bool decode(const char* data, size_t size, T& value) {
+            //Reply strings are not required to be null terminated
+            char buffer[64];
+            if(size == 0 || size >= sizeof(buffer)) {
+                return false;
+            }
+            std::memcpy(buffer, data, size);
+            buffer[size] = '\0';
+            char* end = nullptr;
+            //Parse with precision of T to avoid double rounding
+            long double result =
+                std::is_same<T, float>::value ? std::strtof(buffer, &end) :
+                std::is_same<T, double>::value ? std::strtod(buffer, &end) :
+                std::strtold(buffer, &end);
+            if(end != buffer + size) {
+                return false;
+            }
+            value = static_cast<T>(result);
+            return true;
+        }
+    };
+
+    /*
+    * Raw bytes of enums and structs opted in with RawBytesCodec. Representation depends on platform and struct layout,
+    * so values can be read back only by the same binary or compatible ones.
+    */
+    template <class T>
+    struct Codec<T, typename std::enable_if<(std::is_enum<T>::value || (std::is_class<T>::value && RawBytesCodec<T>::value)) && std::is_trivially_copyable<T>::value>::type> {
+        static constexpr bool defined = true;
+
+        static size_t max_size(const T&) {
+            return sizeof(T);
+        }
+
+        static size_t encode(const T& value, char* buffer) {
+            std::memcpy(buffer, &value, sizeof(T));
+            return sizeof(T);
+        }
+
+        static bool decode(const char* data, size_t size, T& value) {
+            if(size != sizeof(T)) {
+                return false;
+            }
+            std::memcpy(&value, data, sizeof(T));
+            return true;
+        }
+    };
+}